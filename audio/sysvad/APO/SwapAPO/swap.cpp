@@ -43,37 +43,118 @@ void CopyFrames(
 }
 #pragma AVRT_CODE_END
 
+//
+// The swap kernels exchange adjacent samples, so with an even number of
+// channels a whole vector of samples can be swapped with one shuffle.
+//
+#if defined(_M_IX86) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SWAP_VECTORS
+typedef __m128 SWAP_VECTOR;
+#define SwapLoad(p)         _mm_loadu_ps(p)
+#define SwapStore(p, v)     _mm_storeu_ps(p, v)
+#define SwapPairs(v)        _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))
+#define SwapMul(a, b)       _mm_mul_ps(a, b)
+#elif defined(_M_ARM) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SWAP_VECTORS
+typedef float32x4_t SWAP_VECTOR;
+#define SwapLoad(p)         vld1q_f32(p)
+#define SwapStore(p, v)     vst1q_f32(p, v)
+#define SwapPairs(v)        vrev64q_f32(v)
+#define SwapMul(a, b)       vmulq_f32(a, b)
+#endif
+
+#define SWAP_VECTOR_SAMPLES 4
+
 #pragma AVRT_CODE_BEGIN
-void ProcessSwap(
+//
+// Swaps (and optionally scales) one frame at a time. Used for channel
+// counts the vector kernels don't handle. With an odd channel count the
+// last channel is passed through unchanged.
+//
+static void ProcessSwapFrames(
     FLOAT32 *pf32OutputFrames,
     const FLOAT32 *pf32InputFrames,
     UINT32   u32ValidFrameCount,
-    UINT32   u32SamplesPerFrame )
+    UINT32   u32SamplesPerFrame,
+    const FLOAT32 *pf32Coefficients )
 {
     UINT32   u32SampleIndex;
     FLOAT32  fSwap32;
 
-    ASSERT_REALTIME();
-    ATLASSERT( IS_VALID_TYPED_READ_POINTER(pf32InputFrames) );
-    ATLASSERT( IS_VALID_TYPED_WRITE_POINTER(pf32OutputFrames) );
-
     // loop through samples
     while (u32ValidFrameCount--)
     {
         for (u32SampleIndex=0; u32SampleIndex+1<u32SamplesPerFrame; u32SampleIndex += 2)
         {
-            // apply swap
+            // save left channel
             fSwap32 = *pf32InputFrames;
-            *pf32OutputFrames = *(pf32InputFrames + 1);
-            pf32OutputFrames++;
-            *pf32OutputFrames = fSwap32;
-            pf32OutputFrames++;
+
+            if (pf32Coefficients)
+            {
+                // left output equals right input times 1st coefficient
+                *pf32OutputFrames = *(pf32InputFrames + 1) * pf32Coefficients[u32SampleIndex];
+                pf32OutputFrames++;
+
+                // right output equals left input times 2nd coefficient
+                *pf32OutputFrames = fSwap32 * pf32Coefficients[u32SampleIndex+1];
+                pf32OutputFrames++;
+            }
+            else
+            {
+                *pf32OutputFrames = *(pf32InputFrames + 1);
+                pf32OutputFrames++;
+                *pf32OutputFrames = fSwap32;
+                pf32OutputFrames++;
+            }
+
             pf32InputFrames += 2;
         }
+
+        if (u32SampleIndex < u32SamplesPerFrame)
+        {
+            *pf32OutputFrames++ = *pf32InputFrames++;
+        }
     }
 }
 #pragma AVRT_CODE_END
 
+#pragma AVRT_CODE_BEGIN
+void ProcessSwap(
+    FLOAT32 *pf32OutputFrames,
+    const FLOAT32 *pf32InputFrames,
+    UINT32   u32ValidFrameCount,
+    UINT32   u32SamplesPerFrame )
+{
+    ASSERT_REALTIME();
+    ATLASSERT( IS_VALID_TYPED_READ_POINTER(pf32InputFrames) );
+    ATLASSERT( IS_VALID_TYPED_WRITE_POINTER(pf32OutputFrames) );
+
+    if (u32SamplesPerFrame % 2)
+    {
+        ProcessSwapFrames(pf32OutputFrames, pf32InputFrames,
+                          u32ValidFrameCount, u32SamplesPerFrame, NULL);
+        return;
+    }
+
+    // With an even channel count the buffer is nothing but stereo pairs.
+    UINT32   u32Samples = u32ValidFrameCount * u32SamplesPerFrame;
+    UINT32   u32Index = 0;
+
+#ifdef SWAP_VECTORS
+    for (; u32Index + SWAP_VECTOR_SAMPLES <= u32Samples; u32Index += SWAP_VECTOR_SAMPLES)
+    {
+        SWAP_VECTOR v = SwapLoad(pf32InputFrames + u32Index);
+        SwapStore(pf32OutputFrames + u32Index, SwapPairs(v));
+    }
+#endif
+
+    ProcessSwapFrames(pf32OutputFrames + u32Index, pf32InputFrames + u32Index,
+                      (u32Samples - u32Index) / 2, 2, NULL);
+}
+#pragma AVRT_CODE_END
+
 
 #pragma AVRT_CODE_BEGIN
 void ProcessSwapScale(
@@ -83,32 +164,51 @@ void ProcessSwapScale(
     UINT32   u32SamplesPerFrame,
     FLOAT32  *pf32Coefficients )
 {
-    UINT32   u32SampleIndex;
-    FLOAT32  fSwap32;
-
     ASSERT_REALTIME();
     ATLASSERT( IS_VALID_TYPED_READ_POINTER(pf32InputFrames) );
     ATLASSERT( IS_VALID_TYPED_READ_POINTER(pf32OutputFrames) );
 
-    // loop through samples
-    while (u32ValidFrameCount--)
+#ifdef SWAP_VECTORS
+    if (u32SamplesPerFrame == 2)
     {
-        for (u32SampleIndex=0; u32SampleIndex+1<u32SamplesPerFrame; u32SampleIndex += 2)
+        // Two frames per vector, the coefficients repeat every pair.
+        FLOAT32  af32Coefficients[SWAP_VECTOR_SAMPLES] =
+            { pf32Coefficients[0], pf32Coefficients[1], pf32Coefficients[0], pf32Coefficients[1] };
+        SWAP_VECTOR vCoefficients = SwapLoad(af32Coefficients);
+        UINT32   u32Samples = u32ValidFrameCount * 2;
+        UINT32   u32Index = 0;
+
+        for (; u32Index + SWAP_VECTOR_SAMPLES <= u32Samples; u32Index += SWAP_VECTOR_SAMPLES)
         {
-            // apply swap for each stereo pair and scale
+            SWAP_VECTOR v = SwapLoad(pf32InputFrames + u32Index);
+            SwapStore(pf32OutputFrames + u32Index, SwapMul(SwapPairs(v), vCoefficients));
+        }
 
-            // save left channel
-            fSwap32 = *pf32InputFrames;
-            // left output equals right input times 1st coefficient
-            *pf32OutputFrames = *(pf32InputFrames + 1) * pf32Coefficients[u32SampleIndex];
-            pf32OutputFrames++;
-            
-            // right output equals left input times 2nd coefficient
-            *pf32OutputFrames = fSwap32  * pf32Coefficients[u32SampleIndex+1];      
-            pf32OutputFrames++;
+        ProcessSwapFrames(pf32OutputFrames + u32Index, pf32InputFrames + u32Index,
+                          (u32Samples - u32Index) / 2, 2, pf32Coefficients);
+        return;
+    }
 
-            pf32InputFrames += 2;
+    if (u32SamplesPerFrame % SWAP_VECTOR_SAMPLES == 0)
+    {
+        // Whole vectors per frame, the coefficients line up with the samples.
+        while (u32ValidFrameCount--)
+        {
+            for (UINT32 u32Index = 0; u32Index < u32SamplesPerFrame; u32Index += SWAP_VECTOR_SAMPLES)
+            {
+                SWAP_VECTOR v = SwapLoad(pf32InputFrames + u32Index);
+                SwapStore(pf32OutputFrames + u32Index,
+                          SwapMul(SwapPairs(v), SwapLoad(pf32Coefficients + u32Index)));
+            }
+
+            pf32InputFrames += u32SamplesPerFrame;
+            pf32OutputFrames += u32SamplesPerFrame;
         }
+        return;
     }
+#endif
+
+    ProcessSwapFrames(pf32OutputFrames, pf32InputFrames,
+                      u32ValidFrameCount, u32SamplesPerFrame, pf32Coefficients);
 }
 #pragma AVRT_CODE_END
@@ -169,27 +169,29 @@ STDMETHODIMP_(void) CSwapAPOMFX::APOProcess(
                               GetSamplesPerFrame() );
             }
 
-            // swap and apply coefficients to the input buffer in-place
+            // swap and apply coefficients straight into the output buffer
+            // (or in-place when there is no output connection), so that
+            // processing out of place needs no separate copy
             if (
                 !IsEqualGUID(m_AudioProcessingMode, AUDIO_SIGNALPROCESSINGMODE_RAW) &&
                 m_fEnableSwapMFX &&
                 (1 < m_u32SamplesPerFrame)
             )
             {
-                ProcessSwapScale(pf32InputFrames, pf32InputFrames,
+                ProcessSwapScale((0 != u32NumOutputConnections) ? pf32OutputFrames : pf32InputFrames,
+                            pf32InputFrames,
                             ppInputConnections[0]->u32ValidFrameCount,
                             m_u32SamplesPerFrame, m_pf32Coefficients );
             }
-            
             // copy the memory only if there is an output connection, and input/output pointers are unequal
-            if ( (0 != u32NumOutputConnections) &&
+            else if ( (0 != u32NumOutputConnections) &&
                   (ppOutputConnections[0]->pBuffer != ppInputConnections[0]->pBuffer) )
             {
                 CopyFrames( pf32OutputFrames, pf32InputFrames,
                             ppInputConnections[0]->u32ValidFrameCount,
                             GetSamplesPerFrame() );
             }
-            
+
             // pass along buffer flags
             ppOutputConnections[0]->u32BufferFlags = ppInputConnections[0]->u32BufferFlags;
 
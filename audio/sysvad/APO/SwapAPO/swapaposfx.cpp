@@ -118,19 +118,21 @@ STDMETHODIMP_(void) CSwapAPOSFX::APOProcess(
                               GetSamplesPerFrame() );
             }
 
-            // swap the input buffer in-place
+            // swap straight into the output buffer
+            // (or in-place when there is no output connection), so that
+            // processing out of place needs no separate copy
             if (
                 !IsEqualGUID(m_AudioProcessingMode, AUDIO_SIGNALPROCESSINGMODE_RAW) &&
                 m_fEnableSwapSFX
             )
             {
-                ProcessSwap(pf32InputFrames, pf32InputFrames,
+                ProcessSwap((0 != u32NumOutputConnections) ? pf32OutputFrames : pf32InputFrames,
+                            pf32InputFrames,
                             ppInputConnections[0]->u32ValidFrameCount,
                             m_u32SamplesPerFrame);
             }
-
             // copy the memory only if there is an output connection, and input/output pointers are unequal
-            if ( (0 != u32NumOutputConnections) &&
+            else if ( (0 != u32NumOutputConnections) &&
                   (ppOutputConnections[0]->pBuffer != ppInputConnections[0]->pBuffer) )
             {
                 CopyFrames( pf32OutputFrames, pf32InputFrames,
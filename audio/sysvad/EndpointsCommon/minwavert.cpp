@@ -407,6 +407,10 @@ Return Value:
     m_ulMixDrmContentId                 = 0;
     m_LoopbackProtection                = CONSTRICTOR_OPTION_DISABLE;
     RtlZeroMemory(&m_MixDrmRights, sizeof(m_MixDrmRights));
+    KeInitializeSpinLock(&m_LoopbackMixLock);
+    m_ulLoopbackMixRefs                 = 0;
+    m_plLoopbackMix                     = NULL;
+    m_pulLoopbackMixFrame               = NULL;
 
     // 
     // For port notification support.
@@ -1214,6 +1218,361 @@ BOOL CMiniportWaveRT::IsKeywordDetectorPin(ULONG nPinId)
     return (pinType == KeywordCapturePin);
 }
 
+//=============================================================================
+#pragma code_seg("PAGE")
+NTSTATUS
+CMiniportWaveRT::AcquireLoopbackMix
+(
+    _In_ PWAVEFORMATEX pWfx
+)
+/*++
+
+Routine Description:
+
+  Takes a reference on the loopback mix, creating it in the given format if
+  this is the first loopback stream. The render streams are mixed into the
+  loopback mix only while it exists, so this costs nothing when there is no
+  loopback stream reading it.
+
+Arguments:
+
+  pWfx - format of the loopback stream. Only 16 bit PCM is supported.
+
+Return Value:
+
+  STATUS_NOT_SUPPORTED if the format differs from the one of the existing
+  loopback mix.
+
+--*/
+{
+    PAGED_CODE();
+
+    NTSTATUS    ntStatus    = STATUS_SUCCESS;
+    PLONG       plMix       = NULL;
+    PULONG      pulFrame    = NULL;
+    KIRQL       oldIrql;
+
+    DPF_ENTER(("[CMiniportWaveRT::AcquireLoopbackMix]"));
+
+    if (pWfx->wBitsPerSample != 16 ||
+        pWfx->nChannels == 0 ||
+        pWfx->nChannels > LOOPBACK_MIX_MAX_CHANNELS ||
+        pWfx->nBlockAlign != pWfx->nChannels * sizeof(SHORT))
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    plMix = (PLONG)ExAllocatePoolWithTag(NonPagedPoolNx, LOOPBACK_MIX_FRAMES * pWfx->nChannels * sizeof(LONG), MINWAVERT_POOLTAG);
+    pulFrame = (PULONG)ExAllocatePoolWithTag(NonPagedPoolNx, LOOPBACK_MIX_FRAMES * sizeof(ULONG), MINWAVERT_POOLTAG);
+    if (plMix == NULL || pulFrame == NULL)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Done;
+    }
+
+    // No slot holds a frame yet.
+    RtlFillMemory(pulFrame, LOOPBACK_MIX_FRAMES * sizeof(ULONG), 0xFF);
+
+    KeAcquireSpinLock(&m_LoopbackMixLock, &oldIrql);
+
+    if (m_ulLoopbackMixRefs == 0)
+    {
+        LARGE_INTEGER qpcFrequency;
+
+        m_plLoopbackMix = plMix;
+        m_pulLoopbackMixFrame = pulFrame;
+        m_ulLoopbackMixChannels = pWfx->nChannels;
+        m_ulLoopbackMixSamplesPerSec = pWfx->nSamplesPerSec;
+        m_ullLoopbackMixBaseQpc = (ULONGLONG)KeQueryPerformanceCounter(&qpcFrequency).QuadPart;
+        m_ullLoopbackMixQpcFrequency = (ULONGLONG)qpcFrequency.QuadPart;
+        plMix = NULL;
+        pulFrame = NULL;
+        m_ulLoopbackMixRefs = 1;
+    }
+    else if (m_ulLoopbackMixChannels == pWfx->nChannels &&
+             m_ulLoopbackMixSamplesPerSec == pWfx->nSamplesPerSec)
+    {
+        m_ulLoopbackMixRefs++;
+    }
+    else
+    {
+        ntStatus = STATUS_NOT_SUPPORTED;
+    }
+
+    KeReleaseSpinLock(&m_LoopbackMixLock, oldIrql);
+
+Done:
+    if (plMix)
+    {
+        ExFreePoolWithTag(plMix, MINWAVERT_POOLTAG);
+    }
+
+    if (pulFrame)
+    {
+        ExFreePoolWithTag(pulFrame, MINWAVERT_POOLTAG);
+    }
+
+    return ntStatus;
+}
+
+//=============================================================================
+#pragma code_seg("PAGE")
+VOID
+CMiniportWaveRT::ReleaseLoopbackMix()
+{
+    PAGED_CODE();
+
+    PLONG       plMix       = NULL;
+    PULONG      pulFrame    = NULL;
+    KIRQL       oldIrql;
+
+    DPF_ENTER(("[CMiniportWaveRT::ReleaseLoopbackMix]"));
+
+    KeAcquireSpinLock(&m_LoopbackMixLock, &oldIrql);
+
+    ASSERT(m_ulLoopbackMixRefs > 0);
+    if (--m_ulLoopbackMixRefs == 0)
+    {
+        plMix = m_plLoopbackMix;
+        pulFrame = m_pulLoopbackMixFrame;
+        m_plLoopbackMix = NULL;
+        m_pulLoopbackMixFrame = NULL;
+    }
+
+    KeReleaseSpinLock(&m_LoopbackMixLock, oldIrql);
+
+    if (plMix)
+    {
+        ExFreePoolWithTag(plMix, MINWAVERT_POOLTAG);
+    }
+
+    if (pulFrame)
+    {
+        ExFreePoolWithTag(pulFrame, MINWAVERT_POOLTAG);
+    }
+}
+
+//=============================================================================
+#pragma code_seg()
+ULONGLONG
+CMiniportWaveRT::GetLoopbackMixFrame
+(
+    _In_ LARGE_INTEGER ilQPC
+)
+{
+    // Frames since the loopback mix was created. Every stream maps its QPC
+    // to the same frame, so streams started at different times line up.
+    if ((ULONGLONG)ilQPC.QuadPart <= m_ullLoopbackMixBaseQpc)
+    {
+        return 0;
+    }
+
+    return ((ULONGLONG)ilQPC.QuadPart - m_ullLoopbackMixBaseQpc) * m_ulLoopbackMixSamplesPerSec /
+           m_ullLoopbackMixQpcFrequency;
+}
+
+//=============================================================================
+#pragma code_seg()
+VOID
+CMiniportWaveRT::MixLoopbackBytes
+(
+    _In_                            PWAVEFORMATEX   pWfx,
+    _In_                            LARGE_INTEGER   ilQPC,
+    _In_reads_bytes_(ulBufferSize)  PBYTE           pBuffer,
+    _In_                            ULONG           ulBufferSize,
+    _In_                            ULONG           ulBufferOffset,
+    _In_                            ULONG           ulByteCount,
+    _In_reads_(LOOPBACK_MIX_MAX_CHANNELS) const LONG * plGains
+)
+/*++
+
+Routine Description:
+
+  Adds the bytes a render stream just played to the loopback mix. The bytes
+  end at ilQPC and are scaled by the stream's Q15 gains. Each slot of the
+  mix records which frame it holds, so the first stream to reach a frame
+  starts it from silence and no one has to clear the ring.
+
+  Only streams in the format of the loopback mix are mixed, there is no
+  sample rate conversion.
+
+Arguments:
+
+  pWfx - format of the render stream.
+
+  ilQPC - time the last byte was played.
+
+  pBuffer, ulBufferSize - the render stream's cyclic buffer.
+
+  ulBufferOffset - offset of the first byte played.
+
+  ulByteCount - number of bytes played.
+
+  plGains - Q15 gain of each channel.
+
+--*/
+{
+    ULONG       ulChannels;
+    ULONG       ulFrames;
+    ULONG       ulBlockAlign = pWfx->nBlockAlign;
+    ULONGLONG   ullFrame;
+
+    // Unlocked check, nothing to do until a loopback stream is created.
+    if (m_plLoopbackMix == NULL)
+    {
+        return;
+    }
+
+    KeAcquireSpinLockAtDpcLevel(&m_LoopbackMixLock);
+
+    ulChannels = m_ulLoopbackMixChannels;
+
+    if (m_plLoopbackMix == NULL ||
+        pWfx->wBitsPerSample != 16 ||
+        pWfx->nChannels != ulChannels ||
+        pWfx->nSamplesPerSec != m_ulLoopbackMixSamplesPerSec ||
+        ulBlockAlign != ulChannels * sizeof(SHORT) ||
+        (ulBufferSize % ulBlockAlign) != 0)
+    {
+        goto Done;
+    }
+
+    ulFrames = ulByteCount / ulBlockAlign;
+
+    // The ring keeps only the most recent frames.
+    if (ulFrames > LOOPBACK_MIX_FRAMES)
+    {
+        ulBufferOffset = (ulBufferOffset + (ulFrames - LOOPBACK_MIX_FRAMES) * ulBlockAlign) % ulBufferSize;
+        ulFrames = LOOPBACK_MIX_FRAMES;
+    }
+
+    ullFrame = GetLoopbackMixFrame(ilQPC);
+    if (ullFrame < ulFrames)
+    {
+        goto Done;
+    }
+    ullFrame -= ulFrames;
+
+    for (ULONG i = 0; i < ulFrames; i++, ullFrame++)
+    {
+        ULONG   ulSlot      = (ULONG)ullFrame & (LOOPBACK_MIX_FRAMES - 1);
+        PLONG   plMix       = m_plLoopbackMix + ulSlot * ulChannels;
+        SHORT * psSample    = (SHORT *)(pBuffer + ulBufferOffset);
+
+        if (m_pulLoopbackMixFrame[ulSlot] != (ULONG)ullFrame)
+        {
+            m_pulLoopbackMixFrame[ulSlot] = (ULONG)ullFrame;
+            RtlZeroMemory(plMix, ulChannels * sizeof(LONG));
+        }
+
+        for (ULONG ch = 0; ch < ulChannels; ch++)
+        {
+            plMix[ch] += ((LONG)psSample[ch] * plGains[ch]) >> 15;
+        }
+
+        ulBufferOffset += ulBlockAlign;
+        if (ulBufferOffset == ulBufferSize)
+        {
+            ulBufferOffset = 0;
+        }
+    }
+
+Done:
+    KeReleaseSpinLockFromDpcLevel(&m_LoopbackMixLock);
+}
+
+//=============================================================================
+#pragma code_seg()
+VOID
+CMiniportWaveRT::ReadLoopbackBytes
+(
+    _In_                            LARGE_INTEGER   ilQPC,
+    _Out_writes_bytes_(ulBufferSize) PBYTE          pBuffer,
+    _In_                            ULONG           ulBufferSize,
+    _In_                            ULONG           ulBufferOffset,
+    _In_                            ULONG           ulByteCount
+)
+/*++
+
+Routine Description:
+
+  Fills a loopback stream's cyclic buffer with the loopback mix. The bytes
+  end LOOPBACK_MIX_DELAY_MS before ilQPC, so that the render streams have
+  had the chance to mix them. Frames no stream rendered are silence.
+
+  The loopback stream must have acquired the loopback mix, so its format is
+  the one of the mix.
+
+Arguments:
+
+  ilQPC - current time.
+
+  pBuffer, ulBufferSize - the loopback stream's cyclic buffer.
+
+  ulBufferOffset - offset of the first byte to fill.
+
+  ulByteCount - number of bytes to fill.
+
+--*/
+{
+    KeAcquireSpinLockAtDpcLevel(&m_LoopbackMixLock);
+
+    ASSERT(m_plLoopbackMix != NULL);
+
+    ULONG       ulChannels      = m_ulLoopbackMixChannels;
+    ULONG       ulBlockAlign    = ulChannels * sizeof(SHORT);
+    ULONG       ulFrames        = ulByteCount / ulBlockAlign;
+    ULONGLONG   ullDelay        = (ULONGLONG)m_ulLoopbackMixSamplesPerSec * LOOPBACK_MIX_DELAY_MS / 1000 + ulFrames;
+    ULONGLONG   ullFrame        = GetLoopbackMixFrame(ilQPC);
+    BOOL        bSilence        = (m_LoopbackProtection == CONSTRICTOR_OPTION_MUTE);
+
+    ASSERT((ulBufferSize % ulBlockAlign) == 0);
+
+    // Frames before the loopback mix was created are silence.
+    ullFrame -= ullDelay;
+
+    for (ULONG i = 0; i < ulFrames; i++, ullFrame++)
+    {
+        ULONG   ulSlot      = (ULONG)ullFrame & (LOOPBACK_MIX_FRAMES - 1);
+        SHORT * psSample    = (SHORT *)(pBuffer + ulBufferOffset);
+
+        if (bSilence ||
+            (LONGLONG)ullFrame < 0 ||
+            m_pulLoopbackMixFrame[ulSlot] != (ULONG)ullFrame)
+        {
+            RtlZeroMemory(psSample, ulBlockAlign);
+        }
+        else
+        {
+            PLONG plMix = m_plLoopbackMix + ulSlot * ulChannels;
+
+            for (ULONG ch = 0; ch < ulChannels; ch++)
+            {
+                LONG lSample = plMix[ch];
+
+                if (lSample > _I16_MAX)
+                {
+                    lSample = _I16_MAX;
+                }
+                else if (lSample < _I16_MIN)
+                {
+                    lSample = _I16_MIN;
+                }
+
+                psSample[ch] = (SHORT)lSample;
+            }
+        }
+
+        ulBufferOffset += ulBlockAlign;
+        if (ulBufferOffset == ulBufferSize)
+        {
+            ulBufferOffset = 0;
+        }
+    }
+
+    KeReleaseSpinLockFromDpcLevel(&m_LoopbackMixLock);
+}
+
 
 //=============================================================================
 #pragma code_seg("PAGE")
@@ -3445,6 +3804,7 @@ CKeywordDetector::CKeywordDetector()
     m_streamRunning(FALSE),
     m_qpcStartCapture(0),
     m_nLastQueuedPacket(-1),
+    m_nNextReadPacket(0),
     m_SoundDetectorArmed1(FALSE),
     m_SoundDetectorArmed2(FALSE),
     m_SoundDetectorData1(0),
@@ -3454,9 +3814,6 @@ CKeywordDetector::CKeywordDetector()
 {
     PAGED_CODE();
 
-    // Initialize our pool of packets and the list structures
-    KeInitializeSpinLock(&PacketPoolSpinLock);
-    KeInitializeSpinLock(&PacketFifoSpinLock);
     ResetFifo();
 }
 
@@ -3627,13 +3984,11 @@ VOID CKeywordDetector::ResetFifo()
 
     m_qpcStartCapture = 0;
     m_nLastQueuedPacket = (-1);
-    InitializeListHead(&PacketPoolHead);
-    InitializeListHead(&PacketFifoHead);
+    m_nNextReadPacket = 0;
 
-    for (int i = 0; i < ARRAYSIZE(PacketPool); i++)
-    {
-        InsertTailList(&PacketPoolHead, &PacketPool[i].ListEntry);
-    }
+    // The simulated detector only produces silence, so the samples are
+    // cleared here once instead of for every packet in the DPC.
+    RtlZeroMemory(PacketRing, sizeof(PacketRing));
     return;
 }
 
@@ -3754,7 +4109,7 @@ VOID CKeywordDetector::StartBufferingStream()
     PAGED_CODE();
 
     NT_ASSERT(m_qpcStartCapture == 0);
-    NT_ASSERT(IsListEmpty(&PacketFifoHead));
+    NT_ASSERT(m_nLastQueuedPacket < m_nNextReadPacket);
 
     qpc = KeQueryPerformanceCounter(&qpcFrequency);
     m_qpcStartCapture = qpc.QuadPart;
@@ -3824,7 +4179,7 @@ _IRQL_requires_min_(DISPATCH_LEVEL)
 VOID CKeywordDetector::DpcRoutine(_In_ LONGLONG PerformanceCounter, _In_ LONGLONG PerformanceFrequency)
 {
     LONGLONG currentPacket;
-    LONGLONG packetsToQueue;
+    LONGLONG packetNumber;
 
     if (m_qpcStartCapture <= 0)
     {
@@ -3832,38 +4187,25 @@ VOID CKeywordDetector::DpcRoutine(_In_ LONGLONG PerformanceCounter, _In_ LONGLON
     }
 
     currentPacket = (PerformanceCounter - m_qpcStartCapture) * (SamplesPerSecond / SamplesPerPacket) / PerformanceFrequency;
-    packetsToQueue = currentPacket - m_nLastQueuedPacket;
+    packetNumber = m_nLastQueuedPacket + 1;
 
-    while (packetsToQueue > 0)
+    // Packets older than the ring would be overwritten in this same pass, skip them.
+    if (packetNumber < currentPacket - HistoryPackets + 1)
     {
-        LIST_ENTRY*     packetListEntry;
-        PACKET_ENTRY*   packetEntry;
-
-        do
-        {
-            packetListEntry = ExInterlockedRemoveHeadList(&PacketPoolHead, &PacketPoolSpinLock);
-            if (packetListEntry != NULL) break;
-
-            // Pool is empty, no room to buffer more, an overrun is occurring. Drop and reuse the
-            // oldest packet from head of fifo.
-
-            // Since the pool is empty, the fifo should be full. However, although unlikely, the
-            // driver might empty the fifo before this routine removes a packet. In that case, the
-            // pool should have packets available again. Therefore this is a retry loop.
-            packetListEntry = ExInterlockedRemoveHeadList(&PacketFifoHead, &PacketFifoSpinLock);
-            if (packetListEntry != NULL) break;
-        } while (TRUE);
-
-        packetEntry = CONTAINING_RECORD(packetListEntry, PACKET_ENTRY, ListEntry);
-
-        packetEntry->PacketNumber = ++m_nLastQueuedPacket;
-        packetEntry->QpcWhenSampled = m_qpcStartCapture + (packetEntry->PacketNumber * PerformanceFrequency * SamplesPerPacket / SamplesPerSecond);
+        packetNumber = currentPacket - HistoryPackets + 1;
+    }
 
-        RtlZeroMemory(&packetEntry->Samples[0], sizeof(packetEntry->Samples));
+    // The ring has a single writer, so no lock is needed. Each packet is
+    // published only once its slot is filled in; the reader drops the
+    // oldest packets itself when it falls more than a ring behind.
+    for (; packetNumber <= currentPacket; packetNumber++)
+    {
+        PACKET_ENTRY* packetEntry = &PacketRing[packetNumber % HistoryPackets];
 
-        ExInterlockedInsertTailList(&PacketFifoHead, packetListEntry, &PacketFifoSpinLock);
+        packetEntry->PacketNumber = packetNumber;
+        packetEntry->QpcWhenSampled = m_qpcStartCapture + (packetNumber * PerformanceFrequency * SamplesPerPacket / SamplesPerSecond);
 
-        packetsToQueue -= 1;
+        WriteRelease64(&m_nLastQueuedPacket, packetNumber);
     }
 }
 
@@ -3882,38 +4224,58 @@ NTSTATUS CKeywordDetector::GetReadPacket
     NTSTATUS ntStatus;
     BYTE *packetData;
     PACKET_ENTRY *packetEntry;
-    LIST_ENTRY *packetListEntry = NULL;
+    LONGLONG lastQueuedPacket;
+    LONGLONG readPacket;
+    ULONGLONG qpcWhenSampled;
     ULONG packetSize = WaveRtBufferSize / PacketsPerWaveRtBuffer;
 
     NT_ASSERT(SamplesPerPacket * 2 == packetSize);
     NT_ASSERT(sizeof(packetEntry->Samples) == packetSize);
 
-    packetListEntry = ExInterlockedRemoveHeadList(&PacketFifoHead, &PacketFifoSpinLock);
-    if (packetListEntry == NULL)
+    readPacket = m_nNextReadPacket;
+    for (;;)
     {
-        ntStatus = STATUS_DEVICE_NOT_READY;
-        goto Exit;
-    }
-    packetEntry = CONTAINING_RECORD(packetListEntry, PACKET_ENTRY, ListEntry);
+        lastQueuedPacket = ReadAcquire64(&m_nLastQueuedPacket);
+        if (readPacket > lastQueuedPacket)
+        {
+            ntStatus = STATUS_DEVICE_NOT_READY;
+            goto Exit;
+        }
+
+        // An overrun is occurring, drop the packets the DPC is about to reuse.
+        if (lastQueuedPacket - readPacket >= HistoryPackets - 1)
+        {
+            readPacket = lastQueuedPacket - HistoryPackets + 2;
+        }
 
-    packetData = WaveRtBuffer + ((packetEntry->PacketNumber * packetSize) % WaveRtBufferSize);
+        packetEntry = &PacketRing[readPacket % HistoryPackets];
+        packetData = WaveRtBuffer + ((readPacket * packetSize) % WaveRtBufferSize);
 
-    ntStatus = RtlLongLongToULong(packetEntry->PacketNumber, PacketNumber);
+        qpcWhenSampled = packetEntry->QpcWhenSampled;
+        RtlCopyMemory(packetData, packetEntry->Samples, sizeof(packetEntry->Samples));
+
+        // If the DPC wrapped onto this slot while it was copied, the packet
+        // is gone; retry with the oldest one still in the ring. The barrier
+        // keeps the reads of the slot above from moving past the re-check.
+        KeMemoryBarrier();
+        lastQueuedPacket = ReadAcquire64(&m_nLastQueuedPacket);
+        if (lastQueuedPacket - readPacket < HistoryPackets - 1)
+        {
+            break;
+        }
+    }
+
+    ntStatus = RtlLongLongToULong(readPacket, PacketNumber);
     if (!NT_SUCCESS(ntStatus))
     {
         goto Exit;
     }
 
-    *PerformanceCounterValue = packetEntry->QpcWhenSampled;
-    *MoreData = !IsListEmpty(&PacketFifoHead);
-    RtlCopyMemory(packetData, packetEntry->Samples, sizeof(packetEntry->Samples));
+    m_nNextReadPacket = readPacket + 1;
+    *PerformanceCounterValue = qpcWhenSampled;
+    *MoreData = (readPacket < lastQueuedPacket);
 
 Exit:
-    if (packetListEntry != NULL)
-    {
-        ExInterlockedInsertTailList(&PacketPoolHead, packetListEntry, &PacketPoolSpinLock);
-    }
-
     return ntStatus;
 }
 
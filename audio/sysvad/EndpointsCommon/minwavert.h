@@ -28,6 +28,18 @@ Abstract:
 class CMiniportWaveRTStream;
 typedef CMiniportWaveRTStream *PCMiniportWaveRTStream;
 
+//=============================================================================
+// Defines
+//=============================================================================
+// Size in frames of the ring the render streams are mixed into for loopback.
+// Must be a power of two.
+#define LOOPBACK_MIX_FRAMES             16384
+// How far behind the render streams loopback reads the mix, in ms. This
+// covers the time between two position updates of the render streams.
+#define LOOPBACK_MIX_DELAY_MS           50
+// Most channels a loopback mix can have.
+#define LOOPBACK_MIX_MAX_CHANNELS       8
+
 //=============================================================================
 // Classes
 //=============================================================================
@@ -93,9 +105,13 @@ private:
     static const int SamplesPerSecond = 16000;
     static const int SamplesPerPacket = (10 * SamplesPerSecond / 1000);
 
+    // Packets kept in the history ring, enough for 2 seconds of audio data.
+    // One slot is always left for the DPC to write, so the reader can
+    // consume up to HistoryPackets - 1 packets.
+    static const int HistoryPackets = (2 * SamplesPerSecond / SamplesPerPacket);
+
     typedef struct
     {
-        LIST_ENTRY  ListEntry;
         LONGLONG    PacketNumber;
         LONGLONG    QpcWhenSampled;
         UINT16      Samples[SamplesPerPacket];
@@ -110,17 +126,14 @@ private:
 
     LONGLONG        m_qpcStartCapture;
     LONGLONG        m_qpcFrequency;
-    LONGLONG        m_nLastQueuedPacket;
+    volatile LONG64 m_nLastQueuedPacket;    // Written by the DPC only.
+    LONGLONG        m_nNextReadPacket;      // Written by GetReadPacket only.
 
     ULONGLONG       m_ullKeywordStartTimestamp;
     ULONGLONG       m_ullKeywordStopTimestamp;
 
-    KSPIN_LOCK      PacketPoolSpinLock;
-    LIST_ENTRY      PacketPoolHead;
-    PACKET_ENTRY    PacketPool[1 * SamplesPerSecond / SamplesPerPacket];    // Enough storage for 1 second of audio data
-
-    KSPIN_LOCK      PacketFifoSpinLock;
-    LIST_ENTRY      PacketFifoHead;
+    // Packet n is kept in slot n % HistoryPackets.
+    PACKET_ENTRY    PacketRing[HistoryPackets];
 
 };
 
@@ -166,6 +179,16 @@ private:
     ULONG                               m_ulMixDrmContentId;
     CONSTRICTOR_OPTION                  m_LoopbackProtection;
 
+    // Loopback mix of the render streams, shared by the loopback streams.
+    KSPIN_LOCK                          m_LoopbackMixLock;
+    ULONG                               m_ulLoopbackMixRefs;        // PASSIVE_LEVEL only.
+    PLONG                               m_plLoopbackMix;            // frames * channels accumulators.
+    PULONG                              m_pulLoopbackMixFrame;      // frame index each slot holds.
+    ULONG                               m_ulLoopbackMixChannels;
+    ULONG                               m_ulLoopbackMixSamplesPerSec;
+    ULONGLONG                           m_ullLoopbackMixBaseQpc;
+    ULONGLONG                           m_ullLoopbackMixQpcFrequency;
+
     CKeywordDetector                    m_KeywordDetector;
 
     union {
@@ -598,6 +621,42 @@ protected:
 
     BOOL IsKeywordDetectorPin(ULONG nPinId);
 
+    _IRQL_requires_max_(PASSIVE_LEVEL)
+    NTSTATUS AcquireLoopbackMix
+    (
+        _In_ PWAVEFORMATEX pWfx
+    );
+
+    _IRQL_requires_max_(PASSIVE_LEVEL)
+    VOID ReleaseLoopbackMix();
+
+    ULONGLONG GetLoopbackMixFrame
+    (
+        _In_ LARGE_INTEGER ilQPC
+    );
+
+    _IRQL_requires_(DISPATCH_LEVEL)
+    VOID MixLoopbackBytes
+    (
+        _In_                            PWAVEFORMATEX   pWfx,
+        _In_                            LARGE_INTEGER   ilQPC,
+        _In_reads_bytes_(ulBufferSize)  PBYTE           pBuffer,
+        _In_                            ULONG           ulBufferSize,
+        _In_                            ULONG           ulBufferOffset,
+        _In_                            ULONG           ulByteCount,
+        _In_reads_(LOOPBACK_MIX_MAX_CHANNELS) const LONG * plGains
+    );
+
+    _IRQL_requires_(DISPATCH_LEVEL)
+    VOID ReadLoopbackBytes
+    (
+        _In_                            LARGE_INTEGER   ilQPC,
+        _Out_writes_bytes_(ulBufferSize) PBYTE          pBuffer,
+        _In_                            ULONG           ulBufferSize,
+        _In_                            ULONG           ulBufferOffset,
+        _In_                            ULONG           ulByteCount
+    );
+
     // These three pins are the pins used by the audio engine for host, loopback, and offload.
     ULONG GetSystemPinId()
     {
@@ -50,6 +50,12 @@ Return Value:
             m_bUnregisterStream = FALSE;
         }
         
+        if (m_bLoopbackMix)
+        {
+            m_pMiniport->ReleaseLoopbackMix();
+            m_bLoopbackMix = FALSE;
+        }
+
         m_pMiniport->Release();
         m_pMiniport = NULL;
     }
@@ -131,6 +137,7 @@ NTSTATUS CMiniportWaveRTStream::ReadRegistrySettings()
         { NULL,   RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_TYPECHECK, L"LoopbackCaptureToneDCOffset",     &m_dwLoopbackCaptureToneDCOffset,       (REG_DWORD << RTL_QUERY_REGISTRY_TYPECHECK_SHIFT) | REG_DWORD,  &m_dwLoopbackCaptureToneDCOffset,           sizeof(DWORD) },
         { NULL,   RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_TYPECHECK, L"HostCaptureToneInitialPhase",     &m_dwHostCaptureToneInitialPhase,       (REG_DWORD << RTL_QUERY_REGISTRY_TYPECHECK_SHIFT) | REG_DWORD,  &m_dwHostCaptureToneInitialPhase,           sizeof(DWORD) },
         { NULL,   RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_TYPECHECK, L"LoopbackCaptureToneInitialPhase", &m_dwLoopbackCaptureToneInitialPhase,   (REG_DWORD << RTL_QUERY_REGISTRY_TYPECHECK_SHIFT) | REG_DWORD,  &m_dwLoopbackCaptureToneInitialPhase,       sizeof(DWORD) },
+        { NULL,   RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_TYPECHECK, L"LoopbackCaptureMix",              &m_dwLoopbackCaptureMix,                (REG_DWORD << RTL_QUERY_REGISTRY_TYPECHECK_SHIFT) | REG_DWORD,  &m_dwLoopbackCaptureMix,                    sizeof(DWORD) },
         { NULL,   0,                                                        NULL,                               NULL,                                   0,                                                              NULL,                                       0 }
     };
 
@@ -223,7 +230,11 @@ Return Value:
     m_ullLastDPCTimeStamp = 0;
     m_hnsDPCTimeCarryForward = 0;
     m_ulDmaMovementRate = 0;
-    m_byteDisplacementCarryForward = 0;
+    m_ullDmaQpcTimeStamp = 0;
+    m_ullFrameClockRemainder = 0;
+    m_ullPositionUpdates = 0;
+    m_ulMinFramesPerUpdate = ULONG_MAX;
+    m_ulMaxFramesPerUpdate = 0;
     m_bLfxEnabled = FALSE;
     m_pbMuted = NULL;
     m_plVolumeLevel = NULL;
@@ -250,6 +261,8 @@ Return Value:
     m_dwLoopbackCaptureToneDCOffset = 0; 
     m_dwHostCaptureToneInitialPhase = 0; 
     m_dwLoopbackCaptureToneInitialPhase = 0; 
+    m_dwLoopbackCaptureMix = 0; // loopback tone by default, for test validation
+    m_bLoopbackMix = FALSE;
 
 
 #if defined(SYSVAD_BTH_BYPASS) || defined(SYSVAD_USB_SIDEBAND)
@@ -408,6 +421,24 @@ Return Value:
         {
             return ntStatus;
         }
+
+        if (m_dwLoopbackCaptureMix && m_pMiniport->IsLoopbackPin(Pin_))
+        {
+            //
+            // Loopback the mix of the render streams. Falls back to the tone
+            // if the format can't be mixed.
+            //
+            ntStatus = m_pMiniport->AcquireLoopbackMix(&m_pWfExt->Format);
+            if (NT_SUCCESS(ntStatus))
+            {
+                m_bLoopbackMix = TRUE;
+            }
+            else
+            {
+                DPF(D_TERSE, ("Loopback mix not available, 0x%x, using a tone", ntStatus));
+                ntStatus = STATUS_SUCCESS;
+            }
+        }
     }
     else if (!g_DoNotCreateDataFiles)
     {
@@ -1206,7 +1237,7 @@ NTSTATUS CMiniportWaveRTStream::SetState
 
             KeReleaseSpinLock(&m_PositionSpinLock, oldIrql);
 
-            // Wait until all work items are completed.
+            // Wait until the buffered render data is saved.
             if (!m_bCapture && !g_DoNotCreateDataFiles)
             {
                 m_SaveData.WaitAllWorkItems();
@@ -1255,6 +1286,11 @@ NTSTATUS CMiniportWaveRTStream::SetState
                     m_pMiniport->m_KeywordDetector.Stop();
                 }
 
+                DPF(D_VERBOSE, ("SetState: KSSTATE_PAUSE, %I64u position updates, %u..%u frames per update",
+                    m_ullPositionUpdates,
+                    m_ullPositionUpdates ? m_ulMinFramesPerUpdate : 0,
+                    m_ulMaxFramesPerUpdate));
+
                 // Pause DMA
                 if (m_ulNotificationIntervalMs > 0)
                 {
@@ -1338,6 +1374,10 @@ NTSTATUS CMiniportWaveRTStream::SetState
             }
             ullPerfCounterTemp = KeQueryPerformanceCounter(&m_ullPerformanceCounterFrequency);
             m_ullLastDPCTimeStamp = m_ullDmaTimeStamp = KSCONVERT_PERFORMANCE_TIME(m_ullPerformanceCounterFrequency.QuadPart, ullPerfCounterTemp);
+            m_ullDmaQpcTimeStamp = ullPerfCounterTemp.QuadPart;
+            m_ullPositionUpdates = 0;
+            m_ulMinFramesPerUpdate = ULONG_MAX;
+            m_ulMaxFramesPerUpdate = 0;
 
             if (m_ulNotificationIntervalMs > 0)
             {
@@ -1396,31 +1436,48 @@ VOID CMiniportWaveRTStream::UpdatePosition
 {
     // Convert ticks to 100ns units.
     LONGLONG  hnsCurrentTime = KSCONVERT_PERFORMANCE_TIME(m_ullPerformanceCounterFrequency.QuadPart, ilQPC);
-    
-    // Calculate the time elapsed since the last call to GetPosition() or since the
-    // DMA engine started.  Note that the division by 10000 to convert to milliseconds
-    // may cause us to lose some of the time, so we will carry the remainder forward 
-    // to the next GetPosition() call.
-    //
-    ULONG TimeElapsedInMS = (ULONG)(hnsCurrentTime - m_ullDmaTimeStamp + m_hnsElapsedTimeCarryForward)/10000;
-    
-    // Carry forward the remainder of this division so we don't fall behind with our position too much.
+    ULONGLONG ullFrequency = (ULONGLONG)m_ullPerformanceCounterFrequency.QuadPart;
+    ULONG     ulSamplesPerSecond = m_pWfExt->Format.nSamplesPerSec;
+
+    // Calculate how many whole frames were processed since the last call to
+    // GetPosition() or since the DMA engine started. The clock is kept in
+    // QPC ticks * frames per second, so the division leaves an exact
+    // remainder (a fraction of a frame) which is carried forward to the
+    // next call. The position therefore never drifts and always moves by
+    // whole frames, however often it is sampled.
     //
-    m_hnsElapsedTimeCarryForward = (hnsCurrentTime - m_ullDmaTimeStamp + m_hnsElapsedTimeCarryForward) % 10000;
-    
-    // Calculate how many bytes in the DMA buffer would have been processed in the elapsed
-    // time.  Note that the division by 1000 to convert to milliseconds may cause us to 
-    // lose some bytes, so we will carry the remainder forward to the next GetPosition() call.
+    ULONGLONG ullFrameTicks = ((ULONGLONG)ilQPC.QuadPart - m_ullDmaQpcTimeStamp) * ulSamplesPerSecond +
+                              m_ullFrameClockRemainder;
+    ULONG     ulFrames = (ULONG)(ullFrameTicks / ullFrequency);
+
+    m_ullFrameClockRemainder = ullFrameTicks % ullFrequency;
+
+    // Keep the carried forward time in 100ns units for GetReadPacket.
     //
-    // need to divide by 1000 because m_ulDmaMovementRate is average bytes per sec.
+    m_hnsElapsedTimeCarryForward = m_ullFrameClockRemainder * 10000000 / (ullFrequency * ulSamplesPerSecond);
+
+    ULONG ByteDisplacement = ulFrames * m_pWfExt->Format.nBlockAlign;
 
-    ULONG ByteDisplacement = ((m_ulDmaMovementRate * TimeElapsedInMS) + m_byteDisplacementCarryForward) / 1000 ;
-    m_byteDisplacementCarryForward = ((m_ulDmaMovementRate * TimeElapsedInMS) + m_byteDisplacementCarryForward) % 1000;
+    if (ulFrames > 0)
+    {
+        m_ullPositionUpdates++;
+        m_ulMinFramesPerUpdate = min(m_ulMinFramesPerUpdate, ulFrames);
+        m_ulMaxFramesPerUpdate = max(m_ulMaxFramesPerUpdate, ulFrames);
+    }
 
     // Increment presentation position even after last buffer is rendered.
     m_ullPresentationPosition += ByteDisplacement;
 
-    if (m_bCapture)
+    if (m_bLoopbackMix)
+    {
+        // Copy the mix of the render streams to buffer.
+        m_pMiniport->ReadLoopbackBytes(ilQPC,
+                                       m_pDmaBuffer,
+                                       m_ulDmaBufferSize,
+                                       m_ullLinearPosition % m_ulDmaBufferSize,
+                                       ByteDisplacement);
+    }
+    else if (m_bCapture)
     {
         // Write sine wave to buffer.
         WriteBytes(ByteDisplacement);
@@ -1464,6 +1521,9 @@ VOID CMiniportWaveRTStream::UpdatePosition
                                         0);
         }
 
+        // Mix what was rendered into the loopback stream, if any.
+        MixLoopbackBytes(ilQPC, ByteDisplacement);
+
         if (!g_DoNotCreateDataFiles)
         {
             // Read from buffer and write to a file.
@@ -1485,6 +1545,7 @@ VOID CMiniportWaveRTStream::UpdatePosition
     // Update the DMA time stamp for the next call to GetPosition()
     //
     m_ullDmaTimeStamp = hnsCurrentTime;
+    m_ullDmaQpcTimeStamp = ilQPC.QuadPart;
 }
 
 //=============================================================================
@@ -1548,6 +1609,65 @@ ByteDisplacement - # of bytes to process.
     }
 }
 
+//=============================================================================
+#pragma code_seg()
+VOID CMiniportWaveRTStream::MixLoopbackBytes
+(
+    _In_ LARGE_INTEGER ilQPC,
+    _In_ ULONG ByteDisplacement
+)
+/*++
+
+Routine Description:
+
+This function adds the rendered bytes to the loopback mix, scaled by the
+stream's mute and volume.
+
+Arguments:
+
+ilQPC - time the last byte was rendered.
+
+ByteDisplacement - # of bytes to process.
+
+--*/
+{
+    LONG    gains[LOOPBACK_MIX_MAX_CHANNELS] = { 0 };
+    ULONG   channels = min(m_pWfExt->Format.nChannels, (ULONG)LOOPBACK_MIX_MAX_CHANNELS);
+
+    if (ByteDisplacement == 0)
+    {
+        return;
+    }
+
+    for (ULONG i = 0; i < channels; i++)
+    {
+        if (m_pbMuted[i])
+        {
+            continue;
+        }
+
+        // Volume is in 1/65536 dB, attenuate in whole dB steps of
+        // 10^(-1/20) in Q15. Gains above 0 dB are not applied.
+        LONG attenuation = m_plVolumeLevel[i] < 0 ? (-m_plVolumeLevel[i] + 0x8000) >> 16 : 0;
+        LONG gain = 1 << 15;
+
+        for (LONG dB = 0; dB < attenuation && gain > 0; dB++)
+        {
+            gain = (gain * 29205) >> 15;
+        }
+
+        gains[i] = gain;
+    }
+
+    m_pMiniport->MixLoopbackBytes(&m_pWfExt->Format,
+                                  ilQPC,
+                                  m_pDmaBuffer,
+                                  m_ulDmaBufferSize,
+                                  m_ullLinearPosition % m_ulDmaBufferSize,
+                                  ByteDisplacement,
+                                  gains);
+}
+
 //=============================================================================
 #pragma code_seg("PAGE")
 STDMETHODIMP_(NTSTATUS) 
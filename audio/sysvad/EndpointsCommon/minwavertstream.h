@@ -111,7 +111,11 @@ protected:
     ULONGLONG                   m_hnsElapsedTimeCarryForward;
     ULONGLONG                   m_ullLastDPCTimeStamp;
     ULONGLONG                   m_hnsDPCTimeCarryForward;
-    ULONG                       m_byteDisplacementCarryForward;
+    ULONGLONG                   m_ullDmaQpcTimeStamp;
+    ULONGLONG                   m_ullFrameClockRemainder;
+    ULONGLONG                   m_ullPositionUpdates;
+    ULONG                       m_ulMinFramesPerUpdate;
+    ULONG                       m_ulMaxFramesPerUpdate;
     ULONG                       m_ulDmaMovementRate;
     BOOL                        m_bLfxEnabled;
     PBOOL                       m_pbMuted;
@@ -139,6 +143,8 @@ protected:
     DWORD                       m_dwHostCaptureToneInitialPhase;   // must be between -31416 to 31416
     DWORD                       m_dwLoopbackCaptureToneInitialPhase; // must be between -31416 to 31416
     // Member variable as config params for tone generator
+    DWORD                       m_dwLoopbackCaptureMix;     // loopback captures the render streams, not a tone
+    BOOL                        m_bLoopbackMix;             // this loopback stream reads the loopback mix
 
 #if defined(SYSVAD_BTH_BYPASS) || defined(SYSVAD_USB_SIDEBAND)
     BOOL                        m_SidebandOpen;
@@ -290,6 +296,12 @@ private:
     (
         _In_ ULONG ByteDisplacement
     );
+
+    VOID MixLoopbackBytes
+    (
+        _In_ LARGE_INTEGER ilQPC,
+        _In_ ULONG ByteDisplacement
+    );
     
     VOID UpdatePosition
     (
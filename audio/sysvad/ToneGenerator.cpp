@@ -55,7 +55,10 @@ ToneGenerator::ToneGenerator()
   m_Mute(false),
   m_PartialFrame(NULL),
   m_PartialFrameBytes(0),
-  m_FrameSize(0)
+  m_FrameSize(0),
+  m_Table(NULL),
+  m_TableBytes(0),
+  m_TableOffset(0)
 {
     // Theta (double) and SampleIncrement (double) are init in the Init() method 
     // after saving the floating point state. 
@@ -72,6 +75,13 @@ ToneGenerator::~ToneGenerator()
         m_PartialFrame = NULL;
         m_PartialFrameBytes = 0;
     }
+
+    if (m_Table)
+    {
+        ExFreePoolWithTag(m_Table, SYSVAD_POOLTAG);
+        m_Table = NULL;
+        m_TableBytes = 0;
+    }
 }
 
 // 
@@ -96,31 +106,53 @@ VOID ToneGenerator::InitNewFrame
         RtlZeroMemory(Frame, FrameSize);
         return;
     }
-    
-    for(ULONG i = 0; i < m_ChannelCount; ++i)
+
+    //
+    // All channels carry the same sample, so convert it once.
+    //
+    switch (m_BitsPerSample)
     {
-        if (m_BitsPerSample == 8)
+    case 8:
         {
-            unsigned char *dataBuffer = reinterpret_cast<unsigned char *>(Frame);
-             dataBuffer[i] = ConvertToUChar(sinValue);
+            unsigned char value = ConvertToUChar(sinValue);
+            for (ULONG i = 0; i < m_ChannelCount; ++i)
+            {
+                Frame[i] = value;
+            }
         }
-        else if (m_BitsPerSample == 16)
+        break;
+
+    case 16:
         {
             short *dataBuffer = reinterpret_cast<short *>(Frame);
-            dataBuffer[i] = ConvertToShort(sinValue);
+            short value = ConvertToShort(sinValue);
+            for (ULONG i = 0; i < m_ChannelCount; ++i)
+            {
+                dataBuffer[i] = value;
+            }
         }
-        else if (m_BitsPerSample == 24)
+        break;
+
+    case 24:
         {
-            BYTE *dataBuffer = Frame;
-            long val = ConvertToLong(sinValue);
-            val = val >> 8;
-            RtlCopyMemory(dataBuffer, &val, 3);
+            long value = ConvertToLong(sinValue) >> 8;
+            for (ULONG i = 0; i < m_ChannelCount; ++i)
+            {
+                RtlCopyMemory(Frame + i * 3, &value, 3);
+            }
         }
-        else if (m_BitsPerSample == 32)
+        break;
+
+    case 32:
         {
             long *dataBuffer = reinterpret_cast<long *>(Frame);
-            dataBuffer[i] = ConvertToLong(sinValue);
+            long value = ConvertToLong(sinValue);
+            for (ULONG i = 0; i < m_ChannelCount; ++i)
+            {
+                dataBuffer[i] = value;
+            }
         }
+        break;
     }
 
     m_Theta += m_SampleIncrement;
@@ -129,6 +161,59 @@ VOID ToneGenerator::InitNewFrame
         m_Theta -= TWO_PI;
     }
 }
+
+//
+// Precompute one full period of the tone.
+// The tone repeats every SamplesPerSecond / gcd(Frequency, SamplesPerSecond)
+// frames; when that period is short enough, it is rendered once here and
+// GenerateSine replays it without any floating point work.
+// Note: caller will save and restore the floatingpoint state.
+//
+VOID ToneGenerator::InitTable()
+{
+    DWORD       a = m_Frequency;
+    DWORD       b = m_SamplesPerSecond;
+    ULONGLONG   periodFrames;
+    ULONGLONG   tableBytes;
+
+    while (b != 0)
+    {
+        DWORD t = a % b;
+        a = b;
+        b = t;
+    }
+
+    if (a == 0 || m_FrameSize == 0)
+    {
+        return;
+    }
+
+    periodFrames = m_SamplesPerSecond / a;
+    tableBytes = periodFrames * m_FrameSize;
+
+    if (tableBytes > TONE_TABLE_MAX_BYTES)
+    {
+        return;
+    }
+
+    m_Table = (BYTE*)ExAllocatePoolWithTag(
+                            NonPagedPoolNx,
+                            (SIZE_T)tableBytes,
+                            SYSVAD_POOLTAG);
+    if (m_Table == NULL)
+    {
+        // Not fatal, fall back to generating each frame.
+        return;
+    }
+
+    for (ULONGLONG i = 0; i < periodFrames; ++i)
+    {
+        InitNewFrame(m_Table + i * m_FrameSize, m_FrameSize);
+    }
+
+    m_TableBytes  = (DWORD)tableBytes;
+    m_TableOffset = 0;
+}
 #pragma warning(pop)
 
 //
@@ -158,6 +243,31 @@ void ToneGenerator::GenerateSine
     {
         goto ZeroBuffer;
     }
+
+    //
+    // Replay the precomputed period if there is one. Partial frames need no
+    // special handling since the table is consumed as a byte stream.
+    //
+    if (m_Table)
+    {
+        buffer = Buffer;
+        length = BufferLength;
+
+        while (length > 0)
+        {
+            copyBytes = MIN(length, (size_t)(m_TableBytes - m_TableOffset));
+            RtlCopyMemory(buffer, m_Table + m_TableOffset, copyBytes);
+            buffer += copyBytes;
+            length -= copyBytes;
+
+            m_TableOffset += (DWORD)copyBytes;
+            if (m_TableOffset == m_TableBytes)
+            {
+                m_TableOffset = 0;
+            }
+        }
+        return;
+    }
     
     status = KeSaveFloatingPointState(&saveData);
     if (!NT_SUCCESS(status))
@@ -262,6 +372,8 @@ NTSTATUS ToneGenerator::Init
     m_SampleIncrement   = (m_Frequency * TWO_PI) / (double)m_SamplesPerSecond;
     m_FrameSize         = (DWORD)m_ChannelCount * m_BitsPerSample/8;
     ASSERT(m_FrameSize == WfExt->Format.nBlockAlign);
+
+    InitTable();
     
     //
     // Restore floating state.
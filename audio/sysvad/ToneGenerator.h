@@ -19,6 +19,12 @@ Abstract:
 #include <math.h>
 #include <limits.h>
 
+//
+// Largest single-period frame table the generator will allocate. Tones whose
+// period does not fit are synthesized frame by frame instead.
+//
+#define TONE_TABLE_MAX_BYTES    (64 * 1024)
+
 class ToneGenerator
 {
 public:
@@ -34,6 +40,9 @@ public:
     DWORD           m_FrameSize;
     double          m_ToneAmplitude;
     double          m_ToneDCOffset;
+    BYTE*           m_Table;
+    DWORD           m_TableBytes;
+    DWORD           m_TableOffset;
 
 public:
     ToneGenerator();
@@ -66,6 +75,8 @@ public:
     }
 
 private:
+    VOID InitTable();
+
     VOID InitNewFrame
     (
         _Out_writes_bytes_(FrameSize)   BYTE*  Frame, 
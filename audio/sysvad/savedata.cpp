@@ -11,10 +11,13 @@ Abstract:
     Implementation of SYSVAD data saving class.
 
     To save the playback data to disk, this class maintains a circular data
-    buffer, associated frame structures and worker items to save frames to
+    buffer and a dedicated writer thread which saves it to disk.
+    The stream is the only producer and the writer thread the only consumer
+    of the buffer, so each side advances its own byte count and no lock is
+    needed. The writer thread saves the buffer in frames (large blocks) as
+    they fill up. If the disk falls behind and the buffer is full, the data
+    is dropped and counted as an overrun; the stream never waits for the
     disk.
-    Each frame structure represents a portion of buffer. When that portion
-    of frame is full, a workitem is scheduled to save it to disk.
 
 
 
@@ -52,8 +55,6 @@ Abstract:
 #define OFFLOAD_FILE_NAME           L"OFFLOAD"
 #define HOST_FILE_NAME              L"HOST"
 
-#define MAX_WORKER_ITEM_COUNT       15
-
 //=============================================================================
 // Statics
 //=============================================================================
@@ -69,12 +70,15 @@ ULONG CSaveData::m_ulOffloadStreamId = 0;
 CSaveData::CSaveData()
 :   m_pDataBuffer(NULL),
     m_FileHandle(NULL),
-    m_ulFrameCount(DEFAULT_FRAME_COUNT),
     m_ulBufferSize(DEFAULT_BUFFER_SIZE),
     m_ulFrameSize(DEFAULT_FRAME_SIZE),
-    m_ulBufferOffset(0),
-    m_ulFrameIndex(0),
-    m_fFrameUsed(NULL),
+    m_llBytesWritten(0),
+    m_llBytesSaved(0),
+    m_ulOverruns(0),
+    m_ullBytesDropped(0),
+    m_pWriterThread(NULL),
+    m_lFlushRequested(0),
+    m_fWriterExit(FALSE),
     m_waveFormat(NULL),
     m_pFilePtr(NULL),
     m_fWriteDisabled(FALSE),
@@ -101,6 +105,10 @@ CSaveData::~CSaveData()
 
     DPF_ENTER(("[CSaveData::~CSaveData]"));
 
+    // Save whatever is left in the buffer.
+    //
+    StopWriterThread();
+
     // Update the wave header in data file with real file size.
     //
     if(m_pFilePtr)
@@ -138,13 +146,6 @@ CSaveData::~CSaveData()
         m_waveFormat = NULL;
     }
 
-    if (m_fFrameUsed)
-    {
-        ExFreePoolWithTag(m_fFrameUsed, SAVEDATA_POOLTAG2);
-        m_fFrameUsed = NULL;
-        // NOTE : Do not release m_pFilePtr.
-    }
-
     if (m_FileName.Buffer)
     {
         ExFreePoolWithTag(m_FileName.Buffer, SAVEDATA_POOLTAG3);
@@ -158,31 +159,6 @@ CSaveData::~CSaveData()
     }
 } // CSaveData
 
-//=============================================================================
-void
-CSaveData::DestroyWorkItems
-(
-    void
-)
-{
-    PAGED_CODE();
-
-    if (m_pWorkItems)
-    {
-        for (int i = 0; i < MAX_WORKER_ITEM_COUNT; i++)
-        {
-            if (m_pWorkItems[i].WorkItem!=NULL)
-            {
-                IoFreeWorkItem(m_pWorkItems[i].WorkItem);
-                m_pWorkItems[i].WorkItem = NULL;
-            }
-        }
-        ExFreePoolWithTag(m_pWorkItems, SAVEDATA_POOLTAG);
-        m_pWorkItems = NULL;
-    }
-
-} // DestroyWorkItems
-
 //=============================================================================
 void
 CSaveData::Disable
@@ -405,41 +381,6 @@ CSaveData::GetDeviceObject
     return m_pDeviceObject;
 }
 
-#pragma code_seg()
-//=============================================================================
-PSAVEWORKER_PARAM
-CSaveData::GetNewWorkItem
-(
-    void
-)
-{
-    LARGE_INTEGER               timeOut = { 0 };
-    NTSTATUS                    ntStatus;
-
-    for (int i = 0; i < MAX_WORKER_ITEM_COUNT; i++)
-    {
-        ntStatus =
-            KeWaitForSingleObject
-            (
-                &m_pWorkItems[i].EventDone,
-                Executive,
-                KernelMode,
-                FALSE,
-                &timeOut
-            );
-        if (STATUS_SUCCESS == ntStatus)
-        {
-            if (m_pWorkItems[i].WorkItem)
-                return &(m_pWorkItems[i]);
-            else
-                return NULL;
-        }
-    }
-
-    return NULL;
-} // GetNewWorkItem
-#pragma code_seg("PAGE")
-
 //=============================================================================
 NTSTATUS
 CSaveData::Initialize
@@ -549,42 +490,21 @@ CSaveData::Initialize
         }
     }
 
-    // Allocate memory for frame usage flags and m_pFilePtr.
-    //
-    if (NT_SUCCESS(ntStatus))
-    {
-        m_fFrameUsed = (PBOOL)
-            ExAllocatePoolWithTag
-            (
-                NonPagedPoolNx,
-                m_ulFrameCount * sizeof(BOOL) +
-                sizeof(LARGE_INTEGER),
-                SAVEDATA_POOLTAG2
-            );
-        if (!m_fFrameUsed)
-        {
-            DPF(D_TERSE, ("[Could not allocate memory for frame flags]"));
-            ntStatus = STATUS_INSUFFICIENT_RESOURCES;
-        }
-    }
-
-    // Initialize the spinlock to synchronize access to the frames
-    //
-    KeInitializeSpinLock ( &m_FrameInUseSpinLock ) ;
-
     // Initialize the file mutex
     //
     KeInitializeMutex( &m_FileSync, 1 ) ;
 
+    // Initialize the writer thread events
+    //
+    KeInitializeEvent( &m_WriterEvent, SynchronizationEvent, FALSE );
+    KeInitializeEvent( &m_FlushDoneEvent, NotificationEvent, FALSE );
+
     // Open the data file.
     //
     if (NT_SUCCESS(ntStatus))
     {
-        // m_fFrameUsed has additional memory to hold m_pFilePtr
-        //
-        m_pFilePtr = (PLARGE_INTEGER)
-            (((PBYTE) m_fFrameUsed) + m_ulFrameCount * sizeof(BOOL));
-        RtlZeroMemory(m_fFrameUsed, m_ulFrameCount * sizeof(BOOL) + sizeof(LARGE_INTEGER));
+        m_pFilePtr = &m_FilePtr;
+        m_pFilePtr->QuadPart = 0;
 
         // Create data file.
         InitializeObjectAttributes
@@ -622,121 +542,96 @@ CSaveData::Initialize
         }
     }
 
-    return ntStatus;
-} // Initialize
-
-//=============================================================================
-NTSTATUS
-CSaveData::InitializeWorkItems
-(
-    _In_  PDEVICE_OBJECT        DeviceObject
-)
-{
-    PAGED_CODE();
-
-    ASSERT(DeviceObject);
-
-    NTSTATUS                    ntStatus = STATUS_SUCCESS;
-
-    DPF_ENTER(("[CSaveData::InitializeWorkItems]"));
-
-    if (m_pWorkItems != NULL)
-    {
-        return ntStatus;
-    }
-
-    m_pWorkItems = (PSAVEWORKER_PARAM)
-        ExAllocatePoolWithTag
-        (
-            NonPagedPoolNx,
-            sizeof(SAVEWORKER_PARAM) * MAX_WORKER_ITEM_COUNT,
-            SAVEDATA_POOLTAG
-        );
-    if (m_pWorkItems)
+    // Start the writer thread.
+    //
+    if (NT_SUCCESS(ntStatus))
     {
-        for (int i = 0; i < MAX_WORKER_ITEM_COUNT; i++)
-        {
+        HANDLE hThread;
 
-            m_pWorkItems[i].WorkItem = IoAllocateWorkItem(DeviceObject);
-            if(m_pWorkItems[i].WorkItem == NULL)
-            {
-              return STATUS_INSUFFICIENT_RESOURCES;
-            }
-            KeInitializeEvent
+        ntStatus =
+            PsCreateSystemThread
             (
-                &m_pWorkItems[i].EventDone,
-                NotificationEvent,
-                TRUE
+                &hThread,
+                THREAD_ALL_ACCESS,
+                NULL,
+                NULL,
+                NULL,
+                SaveDataWriterThread,
+                this
             );
+        if (NT_SUCCESS(ntStatus))
+        {
+            ntStatus =
+                ObReferenceObjectByHandle
+                (
+                    hThread,
+                    THREAD_ALL_ACCESS,
+                    *PsThreadType,
+                    KernelMode,
+                    (PVOID *)&m_pWriterThread,
+                    NULL
+                );
+            // A kernel handle to a thread we just created can't be invalid.
+            ASSERT(NT_SUCCESS(ntStatus));
+
+            ZwClose(hThread);
+        }
+        else
+        {
+            DPF(D_TERSE, ("[Could not create the writer thread]"));
         }
-    }
-    else
-    {
-        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
     }
 
     return ntStatus;
-} // InitializeWorkItems
+} // Initialize
 
 //=============================================================================
-
-IO_WORKITEM_ROUTINE SaveFrameWorkerCallback;
-
 VOID
-SaveFrameWorkerCallback
+SaveDataWriterThread
 (
-    _In_        PDEVICE_OBJECT         pDeviceObject, 
-    _In_opt_    PVOID                  Context
+    _In_        PVOID                  Context
 )
 {
-    UNREFERENCED_PARAMETER(pDeviceObject);
-
     PAGED_CODE();
 
     ASSERT(Context);
 
-    PSAVEWORKER_PARAM           pParam = (PSAVEWORKER_PARAM) Context;
-    PCSaveData                  pSaveData;
-    
-    if (NULL == pParam)
-    {
-        // This is completely unexpected, assert here.
-        //
-        ASSERT(pParam);
-        return;
-    }
+    PCSaveData                  pSaveData = (PCSaveData) Context;
+    BOOL                        fFlush;
+    BOOL                        fExit;
 
-    DPF(D_VERBOSE, ("[SaveFrameWorkerCallback], %d", pParam->ulFrameNo));
+    for (;;)
+    {
+        KeWaitForSingleObject
+        (
+            &pSaveData->m_WriterEvent,
+            Executive,
+            KernelMode,
+            FALSE,
+            NULL
+        );
 
-    ASSERT(pParam->pSaveData);
-    ASSERT(pParam->pSaveData->m_fFrameUsed);
+        fFlush = InterlockedExchange(&pSaveData->m_lFlushRequested, 0);
+        fExit = pSaveData->m_fWriterExit;
 
-    if (pParam->WorkItem)
-    {
-        pSaveData = pParam->pSaveData;
+        // Whole frames are saved as they fill up, everything else is
+        // saved when flushing or exiting.
+        //
+        pSaveData->SaveRing(fFlush || fExit);
 
-        if (STATUS_SUCCESS == KeWaitForSingleObject
-            (
-                &pSaveData->m_FileSync,
-                Executive,
-                KernelMode,
-                FALSE,
-                NULL
-            ))
+        if (fFlush)
         {
-            if (NT_SUCCESS(pSaveData->FileOpen(FALSE)))
-            { 
-                pSaveData->FileWrite(pParam->pData, pParam->ulDataSize);
-                pSaveData->FileClose();
-            }
-            InterlockedExchange( (LONG *)&(pSaveData->m_fFrameUsed[pParam->ulFrameNo]), FALSE );
+            KeSetEvent(&pSaveData->m_FlushDoneEvent, IO_NO_INCREMENT, FALSE);
+        }
 
-            KeReleaseMutex( &pSaveData->m_FileSync, FALSE );
+        if (fExit)
+        {
+            break;
         }
     }
 
-    KeSetEvent(&pParam->EventDone, 0, FALSE);
-} // SaveFrameWorkerCallback
+    PsTerminateSystemThread(STATUS_SUCCESS);
+} // SaveDataWriterThread
 
 //=============================================================================
 NTSTATUS
@@ -815,6 +710,11 @@ CSaveData::SetMaxWriteSize
  
     DPF_ENTER(("[CSaveData::SetMaxWriteSize]"));
 
+    //
+    // The writer thread must be done with the old buffer.
+    //
+    WaitAllWorkItems();
+
     // 
     // Compute new buffer size.
     //
@@ -884,63 +784,141 @@ CSaveData::ReadData
 } // ReadData
 
 //=============================================================================
-#pragma code_seg()
 void
-CSaveData::SaveFrame
+CSaveData::SaveRing
 (
-    _In_ ULONG                  ulFrameNo,
-    _In_ ULONG                  ulDataSize
+    _In_ BOOL                   fSaveAll
 )
 {
-    PSAVEWORKER_PARAM           pParam = NULL;
+    PAGED_CODE();
 
-    DPF_ENTER(("[CSaveData::SaveFrame]"));
+    LONG64                      llPending;
+    ULONG                       ulOffset;
+    ULONG                       ulSize;
 
-    pParam = GetNewWorkItem();
-    if (pParam)
+    llPending = ReadAcquire64(&m_llBytesWritten) - m_llBytesSaved;
+    if (llPending == 0 || (!fSaveAll && llPending < m_ulFrameSize))
     {
-        pParam->pSaveData = this;
-        pParam->ulFrameNo = ulFrameNo;
-        pParam->ulDataSize = ulDataSize;
-        pParam->pData = m_pDataBuffer + ulFrameNo * m_ulFrameSize;
-        KeResetEvent(&pParam->EventDone);
-        IoQueueWorkItem(pParam->WorkItem, SaveFrameWorkerCallback,
-                        CriticalWorkQueue, (PVOID)pParam);
+        return;
     }
-} // SaveFrame
-#pragma code_seg("PAGE")
+
+    if (STATUS_SUCCESS != KeWaitForSingleObject
+        (
+            &m_FileSync,
+            Executive,
+            KernelMode,
+            FALSE,
+            NULL
+        ))
+    {
+        return;
+    }
+
+    if (NT_SUCCESS(FileOpen(FALSE)))
+    {
+        for (;;)
+        {
+            llPending = ReadAcquire64(&m_llBytesWritten) - m_llBytesSaved;
+            ulOffset = (ULONG)(m_llBytesSaved % m_ulBufferSize);
+            ulSize = (ULONG)min(llPending, (LONG64)(m_ulBufferSize - ulOffset));
+
+            // Unless everything is to be saved, write whole frames only.
+            // The run up to the end of the buffer is always written, so
+            // writes line up with the frames again after a partial save.
+            //
+            if (!fSaveAll && ulOffset + ulSize < m_ulBufferSize)
+            {
+                ulSize -= ulSize % m_ulFrameSize;
+            }
+
+            if (ulSize == 0)
+            {
+                break;
+            }
+
+            DPF(D_VERBOSE, ("[CSaveData::SaveRing], offset %lu size %lu", ulOffset, ulSize));
+
+            FileWrite(m_pDataBuffer + ulOffset, ulSize);
+
+            WriteRelease64(&m_llBytesSaved, m_llBytesSaved + ulSize);
+        }
+
+        FileClose();
+    }
+    else
+    {
+        // Don't let the buffer fill up behind a file that can't be opened.
+        //
+        WriteRelease64(&m_llBytesSaved, ReadAcquire64(&m_llBytesWritten));
+    }
+
+    KeReleaseMutex( &m_FileSync, FALSE );
+} // SaveRing
+
 //=============================================================================
 void
-CSaveData::WaitAllWorkItems
+CSaveData::StopWriterThread
 (
     void
 )
 {
     PAGED_CODE();
 
-    DPF_ENTER(("[CSaveData::WaitAllWorkItems]"));
-
-    // Save the last partially-filled frame
-    if (m_ulBufferOffset > m_ulFrameIndex * m_ulFrameSize)
+    if (m_pWriterThread)
     {
-        ULONG size;
-        
-        size = m_ulBufferOffset - m_ulFrameIndex * m_ulFrameSize;
-        SaveFrame(m_ulFrameIndex, size);
-    }
-    
-    for (int i = 0; i < MAX_WORKER_ITEM_COUNT; i++)
-    {
-        DPF(D_VERBOSE, ("[Waiting for WorkItem] %d", i));
+        m_fWriterExit = TRUE;
+        KeSetEvent(&m_WriterEvent, IO_NO_INCREMENT, FALSE);
+
         KeWaitForSingleObject
         (
-            &(m_pWorkItems[i].EventDone),
+            m_pWriterThread,
             Executive,
             KernelMode,
             FALSE,
             NULL
         );
+
+        ObDereferenceObject(m_pWriterThread);
+        m_pWriterThread = NULL;
+    }
+
+    if (m_ulOverruns)
+    {
+        DPF(D_TERSE, ("[CSaveData: %lu overruns, %I64u bytes dropped]", m_ulOverruns, m_ullBytesDropped));
     }
+} // StopWriterThread
+
+//=============================================================================
+void
+CSaveData::WaitAllWorkItems
+(
+    void
+)
+{
+    PAGED_CODE();
+
+    DPF_ENTER(("[CSaveData::WaitAllWorkItems]"));
+
+    if (!m_pWriterThread)
+    {
+        return;
+    }
+
+    // Have the writer thread save everything in the buffer, including the
+    // last partially-filled frame, and wait for it to be done.
+    //
+    KeClearEvent(&m_FlushDoneEvent);
+    InterlockedExchange(&m_lFlushRequested, 1);
+    KeSetEvent(&m_WriterEvent, IO_NO_INCREMENT, FALSE);
+
+    KeWaitForSingleObject
+    (
+        &m_FlushDoneEvent,
+        Executive,
+        KernelMode,
+        FALSE,
+        NULL
+    );
 } // WaitAllWorkItems
 
 #pragma code_seg()
@@ -954,9 +932,10 @@ CSaveData::WriteData
 {
     ASSERT(pBuffer);
 
-    BOOL                        fSaveFrame = FALSE;
-    ULONG                       ulSaveFrameIndex = 0;
-    KIRQL                       oldIrql;
+    LONG64                      llWritten;
+    ULONG                       ulUsed;
+    ULONG                       ulOffset;
+    ULONG                       ulWriteBytes;
 
     // If stream writing is disabled, then exit.
     //
@@ -972,80 +951,39 @@ CSaveData::WriteData
         return;
     }
 
-    // The logic below assumes that write size is <= than frame size.
-    if (ulByteCount > m_ulFrameSize)
+    llWritten = m_llBytesWritten;
+    ulUsed = (ULONG)(llWritten - ReadAcquire64(&m_llBytesSaved));
+
+    // Drop the data rather than wait for the disk if the writer thread
+    // is behind.
+    //
+    if (ulByteCount > m_ulBufferSize - ulUsed)
     {
-        ulByteCount = m_ulFrameSize;
+        m_ulOverruns++;
+        m_ullBytesDropped += ulByteCount;
+        DPF(D_BLAB, ("[Buffer overrun, dropping %lu bytes]", ulByteCount));
+        return;
     }
-        
-    // Check to see if this frame is available.
-    KeAcquireSpinLock(&m_FrameInUseSpinLock, &oldIrql);
-    if (!m_fFrameUsed[m_ulFrameIndex])
-    {
-        KeReleaseSpinLock(&m_FrameInUseSpinLock, oldIrql );
-
-        ULONG ulWriteBytes = ulByteCount;
-
-        if( (m_ulBufferSize - m_ulBufferOffset) < ulWriteBytes )
-        {
-            ulWriteBytes = m_ulBufferSize - m_ulBufferOffset;
-        }
 
-        RtlCopyMemory(m_pDataBuffer + m_ulBufferOffset, pBuffer, ulWriteBytes);
-        m_ulBufferOffset += ulWriteBytes;
+    ulOffset = (ULONG)(llWritten % m_ulBufferSize);
+    ulWriteBytes = min(ulByteCount, m_ulBufferSize - ulOffset);
 
-        // Check to see if we need to save this frame
-        if (m_ulBufferOffset >= ((m_ulFrameIndex + 1) * m_ulFrameSize))
-        {
-            fSaveFrame = TRUE;
-        }
+    RtlCopyMemory(m_pDataBuffer + ulOffset, pBuffer, ulWriteBytes);
 
-        // Loop the buffer, if we reached the end.
-        if (m_ulBufferOffset == m_ulBufferSize)
-        {
-            fSaveFrame = TRUE;
-            m_ulBufferOffset = 0;
-        }
-
-        if (fSaveFrame)
-        {
-            InterlockedExchange( (LONG *)&(m_fFrameUsed[m_ulFrameIndex]), TRUE );
-            ulSaveFrameIndex = m_ulFrameIndex;
-            m_ulFrameIndex = (m_ulFrameIndex + 1) % m_ulFrameCount;
-        }
+    // Wrap around for the left over.
+    //
+    if (ulWriteBytes != ulByteCount)
+    {
+        RtlCopyMemory(m_pDataBuffer, pBuffer + ulWriteBytes, ulByteCount - ulWriteBytes);
+    }
 
-        // Write the left over if the next frame is available.
-        if (ulWriteBytes != ulByteCount)
-        {
-            KeAcquireSpinLock(&m_FrameInUseSpinLock, &oldIrql );
-            if (!m_fFrameUsed[m_ulFrameIndex])
-            {
-                KeReleaseSpinLock(&m_FrameInUseSpinLock, oldIrql );
-                RtlCopyMemory
-                (
-                    m_pDataBuffer + m_ulBufferOffset,
-                    pBuffer + ulWriteBytes,
-                    ulByteCount - ulWriteBytes
-                );
-                
-                m_ulBufferOffset += ulByteCount - ulWriteBytes;
-            }
-            else
-            {
-                KeReleaseSpinLock(&m_FrameInUseSpinLock, oldIrql);
-                DPF(D_BLAB, ("[Frame overflow, next frame is in use]"));
-            }
-        }
+    WriteRelease64(&m_llBytesWritten, llWritten + ulByteCount);
 
-        if (fSaveFrame)
-        {
-            SaveFrame(ulSaveFrameIndex, m_ulFrameSize);
-        }
-    }
-    else
+    // Wake up the writer thread once there is a frame to save.
+    //
+    if (ulUsed + ulByteCount >= m_ulFrameSize)
     {
-        KeReleaseSpinLock(&m_FrameInUseSpinLock, oldIrql );
-        DPF(D_BLAB, ("[Frame %d is in use]", m_ulFrameIndex));
+        KeSetEvent(&m_WriterEvent, IO_NO_INCREMENT, FALSE);
     }
 
 } // WriteData
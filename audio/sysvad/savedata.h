@@ -28,19 +28,6 @@ typedef CSaveData *PCSaveData;
 //  Structs
 //-----------------------------------------------------------------------------
 
-// Parameter to workitem.
-#include <pshpack1.h>
-typedef struct _SAVEWORKER_PARAM {
-    PIO_WORKITEM     WorkItem;
-    ULONG            ulFrameNo;
-    ULONG            ulDataSize;
-    PBYTE            pData;
-    PCSaveData       pSaveData;
-    KEVENT           EventDone;
-} SAVEWORKER_PARAM;
-typedef SAVEWORKER_PARAM *PSAVEWORKER_PARAM;
-#include <poppack.h>
-
 // wave file header.
 #include <pshpack1.h>
 typedef struct _OUTPUT_FILE_HEADER
@@ -70,35 +57,40 @@ typedef OUTPUT_DATA_HEADER *POUTPUT_DATA_HEADER;
 // CSaveData
 //   Saves the wave data to disk.
 //
-IO_WORKITEM_ROUTINE SaveFrameWorkerCallback;
+KSTART_ROUTINE SaveDataWriterThread;
 
 class CSaveData
 {
 protected:
     UNICODE_STRING              m_FileName;         // DataFile name.
     HANDLE                      m_FileHandle;       // DataFile handle.
-    PBYTE                       m_pDataBuffer;      // Data buffer.
+    PBYTE                       m_pDataBuffer;      // Ring buffer.
     ULONG                       m_ulBufferSize;     // Total buffer size.
 
-    ULONG                       m_ulFrameIndex;     // Current Frame.
-    ULONG                       m_ulFrameCount;     // Frame count.
-    ULONG                       m_ulFrameSize;
-    ULONG                       m_ulBufferOffset;   // index in buffer.
-    PBOOL                       m_fFrameUsed;       // Frame usage table.
-    KSPIN_LOCK                  m_FrameInUseSpinLock; // Spinlock for synch.
+    ULONG                       m_ulFrameSize;      // Size of each file write.
+    volatile LONG64             m_llBytesWritten;   // Bytes put in the ring (stream).
+    volatile LONG64             m_llBytesSaved;     // Bytes saved to disk (writer thread).
+    ULONG                       m_ulOverruns;       // Writes dropped, ring was full.
+    ULONGLONG                   m_ullBytesDropped;  // Bytes in those writes.
     KMUTEX                      m_FileSync;         // Synchronizes file access
 
+    PKTHREAD                    m_pWriterThread;    // Saves the ring to disk.
+    KEVENT                      m_WriterEvent;      // Wakes up the writer thread.
+    KEVENT                      m_FlushDoneEvent;   // Ring was drained on request.
+    volatile LONG               m_lFlushRequested;
+    BOOL                        m_fWriterExit;
+
     OBJECT_ATTRIBUTES           m_objectAttributes; // Used for opening file.
 
     OUTPUT_FILE_HEADER          m_FileHeader;
     PWAVEFORMATEX               m_waveFormat;
     OUTPUT_DATA_HEADER          m_DataHeader;
+    LARGE_INTEGER               m_FilePtr;
     PLARGE_INTEGER              m_pFilePtr;
 
     static PDEVICE_OBJECT       m_pDeviceObject;
     static ULONG                m_ulStreamId;
     static ULONG                m_ulOffloadStreamId;
-    static PSAVEWORKER_PARAM    m_pWorkItems;
 
     BOOL                        m_fWriteDisabled;
 
@@ -108,22 +100,10 @@ public:
     CSaveData();
     ~CSaveData();
 
-    static NTSTATUS             InitializeWorkItems
-    (
-        _In_  PDEVICE_OBJECT    DeviceObject
-    );
-    static void                 DestroyWorkItems
-    (
-        void
-    );
     void                        Disable
     (
         _In_ BOOL               fDisable
     );
-    static PSAVEWORKER_PARAM    GetNewWorkItem
-    (
-        void
-    );
     NTSTATUS                    Initialize
     (
         _In_ BOOL               _bOffloaded
@@ -178,14 +158,17 @@ private:
         void
     );
 
-    void                        SaveFrame
+    void                        SaveRing
     (
-        _In_ ULONG              ulFrameNo,
-        _In_ ULONG              ulDataSize
+        _In_ BOOL               fSaveAll
+    );
+    void                        StopWriterThread
+    (
+        void
     );
 
     friend
-    IO_WORKITEM_ROUTINE         SaveFrameWorkerCallback;
+    KSTART_ROUTINE              SaveDataWriterThread;
 };
 typedef CSaveData *PCSaveData;
 
@@ -660,6 +660,22 @@ Return Value:
         return FALSE;
     }
 
+    //
+    // Allocate a buffer for the static background.  It is rendered by the
+    // first call to Synthesize().
+    //
+    m_Background = new (PagedPool) UCHAR[m_Length];
+    NT_ASSERT(m_Background);
+    if( !m_Background )
+    {
+        SAFE_DELETE_ARRAY( m_GradientBmp );
+        SAFE_DELETE_ARRAY( m_Buffer );
+        return FALSE;
+    }
+    m_BackgroundValid = FALSE;
+    m_DirtyTop = m_Height;
+    m_DirtyBottom = 0;
+
     return TRUE;
 }
 
@@ -701,6 +717,8 @@ Return Value:
 
     SAFE_DELETE_ARRAY( m_Buffer );
     SAFE_DELETE_ARRAY( m_GradientBmp );
+    SAFE_DELETE_ARRAY( m_Background );
+    m_BackgroundValid = FALSE;
 
     LONGLONG EndTime = KeQueryPerformanceCounter(NULL).QuadPart;
     LONGLONG FPS = ((LONGLONG)m_SynthesisCount * NANOSECONDS) / ( ConvertPerfTime( m_Frequency.QuadPart, (EndTime - m_StartTime) ) + (NANOSECONDS/2) );
@@ -743,107 +761,112 @@ Return Value:
         return STATUS_INVALID_DEVICE_STATE;
     }
 
-    const COLOR *CurColor = m_ColorBars;
-    ULONG ColorCount = SIZEOF_ARRAY (m_ColorBars);
-
     //
-    // Set the default cursor...
+    // The registration boxes are m_Height/16 pixels wide.  Compute the
+    // columns where the bars start and stop on the top and bottom lines.
     //
-    GetImageLocation (0, 0);
+    ULONG BoxSize  = m_Height / 16;
+    ULONG BarStart = min(BoxSize, m_Width);
+    ULONG BarEnd   = (BoxSize && m_Width >= BoxSize) ? max(m_Width - BoxSize + 1, BarStart) : m_Width;
 
     //
     // Synthesize a single line.
     //
-    PUCHAR ImageStart = m_Cursor;
-    for (ULONG x = 0; x < m_Width; x++)
-    {
-        PutPixel (m_ColorBars [((x * ColorCount) / m_Width)]);
-    }
-
-    PUCHAR ImageEnd = m_Cursor;
+    PUCHAR ImageStart = GetImageLocation (0, 0);
+    PutColorBars (0, m_Width);
 
     //
     // Copy the synthesized line to all subsequent lines.
     //
-    for (ULONG line = 0; line < m_Height; line++)
+    for (ULONG line = 1; line < m_Height; line++)
     {
-        GetImageLocation (0, line);
-
         RtlCopyMemory (
-            m_Cursor,
+            GetImageLocation (0, line),
             ImageStart,
-            ImageEnd - ImageStart
+            m_Width * sizeof(KS_RGBQUAD)
         );
     }
 
     //  Paint the top left and top right registrations boxes.
-    GetImageLocation(0,0);
-
-    ImageStart = m_Cursor;
-    for(ULONG x =0; x < m_Width; x++)
-    {
-        if(x < (m_Height/16))
-        {
-            PutPixel(g_TopLeft);
-        }
-        else if(x > (m_Width - (m_Height / 16)))
-        {
-            PutPixel(g_TopRight);
-        }
-        else
-        {
-            PutPixel (m_ColorBars [((x * ColorCount) / m_Width)]);
-        }
-    }
-
-    ImageEnd = m_Cursor;
+    ImageStart = GetImageLocation (0, 0);
+    PutPixels (g_TopLeft, BarStart);
+    PutColorBars (BarStart, BarEnd);
+    PutPixels (g_TopRight, m_Width - BarEnd);
 
-    for (ULONG line = 0; line < m_Height/16; line++)
+    for (ULONG line = 1; line < BoxSize; line++)
     {
-        GetImageLocation (0, line);
-
         RtlCopyMemory (
-            m_Cursor,
+            GetImageLocation (0, line),
             ImageStart,
-            ImageEnd - ImageStart
+            m_Width * sizeof(KS_RGBQUAD)
         );
     }
 
     //  Paint the bottom left and bottom right registrations boxes.
-    GetImageLocation(0, (15*m_Height) / 16);
-    ImageStart = m_Cursor;
-    for(ULONG x =0; x < m_Width; x++)
-    {
-        if(x < (m_Height/16))
-        {
-            PutPixel(g_BotLeft);
-        }
-        else if(x > (m_Width - (m_Height / 16)))
-        {
-            PutPixel(g_BotRight);
-        }
-        else
-        {
-            PutPixel (m_ColorBars [((x * ColorCount) / m_Width)]);
-        }
-    }
-
-    ImageEnd = m_Cursor;
+    ImageStart = GetImageLocation (0, (15*m_Height) / 16);
+    PutPixels (g_BotLeft, BarStart);
+    PutColorBars (BarStart, BarEnd);
+    PutPixels (g_BotRight, m_Width - BarEnd);
 
-    for (ULONG line = 0; line < m_Height/16; line++)
+    for (ULONG line = 1; line < BoxSize; line++)
     {
-        GetImageLocation (0, line+(15*m_Height) / 16);
-
         RtlCopyMemory (
-            m_Cursor,
+            GetImageLocation (0, line+(15*m_Height) / 16),
             ImageStart,
-            ImageEnd - ImageStart
+            m_Width * sizeof(KS_RGBQUAD)
         );
     }
 
+    SetDirty (0, m_Height);
+
     return STATUS_SUCCESS;
 }
 
+void
+CSynthesizer::
+PutColorBars(
+    _In_ ULONG Start,
+    _In_ ULONG End
+)
+/*++
+
+Routine Description:
+
+    Place the color bars for columns [Start, End) of a line at the default
+    cursor location.  Column x belongs to bar (x * ColorCount) / m_Width, so
+    each bar is rendered as a single span instead of pixel by pixel.
+
+Arguments:
+
+    Start -
+        The first column to render.
+
+    End -
+        One past the last column to render.
+
+Return Value:
+
+    void
+
+--*/
+{
+    PAGED_CODE();
+
+    ULONG ColorCount = SIZEOF_ARRAY (m_ColorBars);
+
+    while (Start < End)
+    {
+        ULONG Bar = (Start * ColorCount) / m_Width;
+
+        //  First column of the next bar.
+        ULONG Next = ((Bar + 1) * m_Width + ColorCount - 1) / ColorCount;
+
+        Next = min(Next, End);
+        PutPixels (m_ColorBars [Bar], Next - Start);
+        Start = Next;
+    }
+}
+
 void
 CSynthesizer::
 EncodeNumber(
@@ -894,21 +917,13 @@ Return Value:
     PUCHAR ImageStart = m_Cursor;
     for(ULONG i = 0; i < 32; i++)
     {
-        for(ULONG j = 0; j < m_Width/32; j++)
-        {
-            if(Number & mask)
-            {
-                PutPixel(HighColor);
-            }
-            else
-            {
-                PutPixel(LowColor);
-            }
-        }
+        PutPixels((Number & mask) ? HighColor : LowColor, m_Width/32);
         mask = mask << 1;
     }
     PUCHAR ImageEnd = m_Cursor;
 
+    SetDirty(LocY, LocY + max(m_Height/16, 1));
+
     //
     // Copy the synthesized line to all subsequent lines.
     //
@@ -1064,6 +1079,8 @@ Return Value:
     ULONG SpaceX = m_Width - LocX;
     ULONG SpaceY = m_Height - LocY;
 
+    SetDirty (LocY, LocY + LenY);
+
     //
     // Set the default cursor position.
     //
@@ -1074,13 +1091,7 @@ Return Value:
     //
     if( SpaceY )
     {
-        if( BgColor != TRANSPARENT )
-        {
-            for (ULONG x = 0; x < LenX && x < SpaceX; x++)
-            {
-                PutPixel (BgColor);
-            }
-        }
+        PutPixels (BgColor, min(LenX, SpaceX));
         SpaceY--;
     }
     LocY++;
@@ -1100,7 +1111,7 @@ Return Value:
         ULONG CurSpaceX = SpaceX;
         if (CurSpaceX)
         {
-            PutPixel (BgColor);
+            PutPixels (BgColor, 1);
             CurSpaceX--;
         }
 
@@ -1113,18 +1124,10 @@ Return Value:
             UCHAR CharBase = m_FontData [m_Rotation==AcpiPldRotation90][*CurChar++][row];
             for (ULONG mask = 0x80; mask && CurSpaceX; mask >>= 1)
             {
-                for (ULONG scale = 0; scale < Scaling && CurSpaceX; scale++)
-                {
-                    if (CharBase & mask)
-                    {
-                        PutPixel (FgColor);
-                    }
-                    else
-                    {
-                        PutPixel (BgColor);
-                    }
-                    CurSpaceX--;
-                }
+                ULONG Span = min(Scaling, CurSpaceX);
+
+                PutPixels ((CharBase & mask) ? FgColor : BgColor, Span);
+                CurSpaceX -= Span;
             }
 
             //
@@ -1135,7 +1138,7 @@ Return Value:
 #ifndef NO_CHARACTER_SEPARATION
             if (CurSpaceX)
             {
-                PutPixel (BgColor);
+                PutPixels (BgColor, 1);
                 CurSpaceX--;
             }
 #endif // NO_CHARACTER_SEPARATION
@@ -1148,7 +1151,7 @@ Return Value:
 #ifdef NO_CHARACTER_SEPARATION
         if (CurSpaceX)
         {
-            PutPixel (BgColor);
+            PutPixels (BgColor, 1);
             CurSpaceX--;
         }
 #endif // NO_CHARACTER_SEPARATION
@@ -1170,12 +1173,9 @@ Return Value:
     // Add the bottom section of the overlay.
     //
     GetImageLocation (LocX, LocY);
-    if (BgColor != TRANSPARENT && SpaceY)
+    if (SpaceY)
     {
-        for (ULONG x = 0; x < LenX && x < SpaceX; x++)
-        {
-            PutPixel (BgColor);
-        }
+        PutPixels (BgColor, min(LenX, SpaceX));
     }
 }
 
@@ -1213,6 +1213,8 @@ Return Value:
 
     NT_ASSERT(LocY <= m_Height);
 
+    SetDirty(LocY, LocY + m_Height/16);
+
     PUCHAR Image = GetImageLocation(0, LocY);
     PUCHAR  RowBmp = reinterpret_cast<PUCHAR>(&m_GradientBmp[Gradient*m_Width]);
     ULONG   Stride = m_Width * sizeof(CKsRgbQuad);
@@ -1264,16 +1266,40 @@ Return Value:
         return STATUS_INVALID_DEVICE_STATE;
     }
 
+    if( m_BackgroundValid )
+    {
+        //
+        // The bars and gradients do not change.  Only restore the rows the
+        // overlays of the last frame were drawn on.
+        //
+        if( m_DirtyTop < m_DirtyBottom )
+        {
+            RtlCopyMemory(
+                GetImageLocation(0, m_DirtyTop),
+                m_Background + (m_DirtyTop * m_SynthesisStride),
+                (m_DirtyBottom - m_DirtyTop) * m_SynthesisStride
+            );
+        }
+    }
+    else
+    {
+        SynthesizeBars();
+
+        ApplyGradient( (m_Height)/16, RED);
+        ApplyGradient( (2*m_Height)/16, GREEN);
+        ApplyGradient( (3*m_Height)/16, BLUE);
+        ApplyGradient( (4*m_Height)/16, WHITE);
+
+        RtlCopyMemory( m_Background, m_Buffer, m_Length );
+        m_BackgroundValid = TRUE;
+    }
+    m_DirtyTop = m_Height;
+    m_DirtyBottom = 0;
+
     //
     // Generate a "time stamp" just to overlay it onto the capture image.
     // It makes it more exciting than bars that do nothing.
     //
-    SynthesizeBars();
-
-    ApplyGradient( (m_Height)/16, RED);
-    ApplyGradient( (2*m_Height)/16, GREEN);
-    ApplyGradient( (3*m_Height)/16, BLUE);
-    ApplyGradient( (4*m_Height)/16, WHITE);
 
     EncodeNumber((5*m_Height)/16, (UINT32)m_Attrib[FrameNumber], BLACK, WHITE);
     EncodeNumber((6*m_Height)/16, (UINT32)m_Attrib[QpcTime], BLACK, WHITE);
@@ -168,6 +168,21 @@ protected:
     //  Bitmap with a gradient applied for each color in the color pallet.
     CKsRgbQuad *m_GradientBmp;
 
+    //
+    //  A copy of the static part of the image (the bars and gradients).
+    //  Synthesize() renders it once and, for later frames, only restores
+    //  the rows that have been drawn on since from this copy.
+    //
+    PUCHAR  m_Background;
+    BOOLEAN m_BackgroundValid;
+
+    //
+    //  The range of rows drawn on since the background was last restored.
+    //  The range is empty when m_DirtyTop >= m_DirtyBottom.
+    //
+    ULONG   m_DirtyTop;
+    ULONG   m_DirtyBottom;
+
     //
     // The default cursor.  This is a pointer into the synthesis buffer where
     // a non specific PutPixel will be placed.
@@ -222,6 +237,10 @@ public:
         , m_Buffer(nullptr)
         , m_Cursor(nullptr)
         , m_GradientBmp(nullptr)
+        , m_Background(nullptr)
+        , m_BackgroundValid(FALSE)
+        , m_DirtyTop(Height)
+        , m_DirtyBottom(0)
         , m_SynthesisStride(m_Width * sizeof(KS_RGBQUAD))
         , m_OutputStride(0)
         , m_FormatName(Name)
@@ -300,6 +319,7 @@ public:
     {
         m_Width = Width;
         m_Height = Height;
+        m_BackgroundValid = FALSE;
     }
 
     //
@@ -508,5 +528,70 @@ protected:
                 (m_Buffer + (sizeof(CKsRgbQuad) * LocX) + (LocY * m_SynthesisStride));
     }
 
+    //
+    // GetPixelColor
+    //
+    // Get the internal 32 bit representation of a palette color, as
+    // PutPixel() would store it.
+    //
+    ULONG
+    GetPixelColor (
+        _In_    COLOR Color
+    )
+    {
+        return  ((ULONG) m_Colors[Color][2] << 16) |
+                ((ULONG) m_Colors[Color][1] << 8)  |
+                ((ULONG) m_Colors[Color][0]);
+    }
+
+    //
+    // PutPixels
+    //
+    // Place a span of Count pixels of the same color at the default cursor
+    // location and advance the cursor past it.  This is the fast path used
+    // to render bars, numbers and text; a TRANSPARENT span only moves the
+    // cursor.
+    //
+    void
+    PutPixels (
+        _In_    COLOR Color,
+        _In_    ULONG Count
+    )
+    {
+        if (Color != TRANSPARENT)
+        {
+            RtlFillMemoryUlong (m_Cursor, Count * sizeof(KS_RGBQUAD), GetPixelColor(Color));
+        }
+        m_Cursor += Count * sizeof(KS_RGBQUAD);
+    }
+
+    //
+    // PutColorBars
+    //
+    // Place the EIA-189-A color bars for columns [Start, End) of a line at
+    // the default cursor location, one span per bar.
+    //
+    void
+    PutColorBars (
+        _In_    ULONG Start,
+        _In_    ULONG End
+    );
+
+    //
+    // SetDirty
+    //
+    // Note that rows [Top, Bottom) have been drawn on and must be restored
+    // from the background before the next frame is synthesized.
+    //
+    void
+    SetDirty (
+        _In_    ULONG Top,
+        _In_    ULONG Bottom
+    )
+    {
+        m_DirtyTop = min(m_DirtyTop, Top);
+        m_DirtyBottom = max(m_DirtyBottom, min(Bottom, m_Height));
+    }
+
 };
 
@@ -118,6 +118,8 @@ CHardwareSimulation (
     , m_ScatterGatherMappingsQueued(0)
     , m_ScatterGatherBytesQueued(0)
     , m_NumFramesSkipped(0)
+    , m_NumFramesLate(0)
+    , m_NumFramesNotSynthesized(0)
     , m_InterruptTime(0)
     , m_LastReportedExposureTime(DEF_EXPOSURE_TIME) // Assume the default exposure time for now.
     , m_LastReportedWhiteBalance(0)
@@ -272,6 +274,8 @@ Return Value:
     m_NumMappingsCompleted = 0;
     m_ScatterGatherMappingsQueued = 0;
     m_NumFramesSkipped = 0;
+    m_NumFramesLate = 0;
+    m_NumFramesNotSynthesized = 0;
     m_InterruptTime = 0;
 
     KeQuerySystemTime (&m_StartTime);
@@ -417,6 +421,8 @@ Return Value:
         bCancel = (m_PinState == PinRunning);
         m_PinState = PinStopped;
 
+        ReportFrameCounters();
+
         //  Free the synthesis buffer.
         m_Synthesizer->Destroy();
 
@@ -1242,6 +1248,18 @@ Return Value:
             m_Sensor->SetSynthesizerAttributeList(SIZEOF_ARRAY(AttributeList), AttributeList);
         }
 
+        //
+        //  If no frame buffer is queued, the frame would be dropped.  Don't
+        //  spend the time synthesizing it; that time is better left to the
+        //  other pins of the sensor.
+        //
+        if (IsListEmpty(&m_ScatterGatherMappings))
+        {
+            m_NumFramesSkipped++;
+            m_NumFramesNotSynthesized++;
+            goto interrupt;
+        }
+
         m_Synthesizer->DoSynthesize();
 
         CHAR Text[64];
@@ -1272,7 +1290,7 @@ Return Value:
         //
         //  Add the estimated FPS
         LONGLONG Target = NANOSECONDS / m_TimePerFrame;
-        LONGLONG FPS = ((LONGLONG)m_InterruptTime * NANOSECONDS) / ((Now.QuadPart - m_StartTime.QuadPart) + (NANOSECONDS / 2));
+        LONGLONG FPS = ((LONGLONG)(m_InterruptTime - m_NumFramesLate) * NANOSECONDS) / ((Now.QuadPart - m_StartTime.QuadPart) + (NANOSECONDS / 2));
         RtlStringCbPrintfA(Text, sizeof(Text), "%lld/%lld FPS", FPS, Target);
         len = 0;
         RtlStringCchLengthA(Text, sizeof(Text), &len);
@@ -1294,6 +1312,7 @@ Return Value:
         }
     }
 
+interrupt:
     //
     // Issue an interrupt to our hardware sink.  This is a "fake" interrupt.
     // It will occur at DISPATCH_LEVEL.
@@ -1303,24 +1322,99 @@ Return Value:
     //
     //  Schedule the timer for the next interrupt time, if the pin is still running.
     //
-    if (m_PinState == PinRunning)
+    ScheduleNextFrame();
+}
+
+void
+CHardwareSimulation::
+ScheduleNextFrame()
+
+/*++
+
+Routine Description:
+
+    Set the timer for the next frame time, if the pin is still running.
+
+    If this frame was handled so late that the next frame times have
+    already passed, those frames are counted as late and skipped.  Setting
+    the timer in the past instead would make it fire immediately, once for
+    each missed frame, and the backlog would only add to the load that
+    made this pin late in the first place.
+
+    Must be called with m_ListLock held.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+    PAGED_CODE();
+
+    if (m_PinState != PinRunning)
     {
-        LARGE_INTEGER NextTime;
-        NextTime.QuadPart = m_StartTime.QuadPart +
-            (m_TimePerFrame * (m_InterruptTime + 1));
+        return;
+    }
 
-#ifdef ENABLE_TRACING  // To keep us from a tight spin when trying to debug this code...
-        LARGE_INTEGER Now;
-        KeQuerySystemTime(&Now);
+    LARGE_INTEGER NextTime;
+    LARGE_INTEGER Now;
 
-        if (Now.QuadPart >= NextTime.QuadPart)
-        {
-            NextTime.QuadPart = 0LL - m_TimePerFrame;
-        }
+    NextTime.QuadPart = m_StartTime.QuadPart +
+        (m_TimePerFrame * (m_InterruptTime + 1));
+
+    KeQuerySystemTime(&Now);
+
+    if (Now.QuadPart >= NextTime.QuadPart)
+    {
+        LONGLONG Missed = ((Now.QuadPart - NextTime.QuadPart) / m_TimePerFrame) + 1;
+
+        m_NumFramesLate += Missed;
+        m_InterruptTime += Missed;
+        NextTime.QuadPart += Missed * m_TimePerFrame;
 
-#endif
-        m_IsrTimer.Set(NextTime);
+        DBG_TRACE("m_PinID=%d: %lld frame times missed", m_PinID, Missed);
     }
+
+    m_IsrTimer.Set(NextTime);
+}
+
+void
+CHardwareSimulation::
+ReportFrameCounters()
+
+/*++
+
+Routine Description:
+
+    Trace the frame counters of this pin.  Dropped frames are either
+    skipped (no frame buffer was queued, so back-pressure from the client)
+    or late (the simulation could not keep up with the frame rate).
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+    PAGED_CODE();
+
+    DBG_TRACE("m_PinID=%d: Frames=%lld, Completed=%u, Skipped=%lld (not synthesized=%lld), Late=%lld",
+              m_PinID,
+              m_InterruptTime,
+              m_NumMappingsCompleted,
+              m_NumFramesSkipped,
+              m_NumFramesNotSynthesized,
+              m_NumFramesLate);
 }
 
 ULONGLONG
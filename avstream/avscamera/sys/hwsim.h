@@ -117,6 +117,8 @@ protected:
     ULONG m_ScatterGatherMappingsQueued;
     ULONG m_ScatterGatherBytesQueued;
     LONGLONG    m_NumFramesSkipped;
+    LONGLONG    m_NumFramesLate;            // Frame times missed because the timer ran late.
+    LONGLONG    m_NumFramesNotSynthesized;  // Frames not synthesized, no buffer was queued.
     LONGLONG    m_InterruptTime;
     LARGE_INTEGER m_StartTime;
 
@@ -175,6 +177,14 @@ protected:
         _In_        ULONG       DataUsed=0
     );
 
+    //  Set the timer for the next frame, skipping frame times already missed.
+    void
+    ScheduleNextFrame();
+
+    //  Trace the per-pin frame counters.
+    void
+    ReportFrameCounters();
+
     //  Release our entire queue.
     void
     FreeSGList(
@@ -191,6 +201,11 @@ public:
         return m_NumFramesSkipped;
     }
 
+    LONGLONG GetLateFrameCount()
+    {
+        return m_NumFramesLate;
+    }
+
     //  Constructor
     CHardwareSimulation (
         _Inout_ CSensor *Sensor,
@@ -160,6 +160,8 @@ Return Value:
     m_NumMappingsCompleted = 0;
     m_ScatterGatherMappingsQueued = 0;
     m_NumFramesSkipped = 0;
+    m_NumFramesLate = 0;
+    m_NumFramesNotSynthesized = 0;
     m_InterruptTime = 0;
     m_bTriggered = FALSE;
     m_bEndOfSequence = FALSE;
@@ -983,24 +985,7 @@ Return Value:
     //
     //  Schedule the timer for the next interrupt time, if the pin is still running.
     //
-    if( m_PinState == PinRunning )
-    {
-        LARGE_INTEGER NextTime;
-        NextTime.QuadPart = m_StartTime.QuadPart +
-                            (m_TimePerFrame * (m_InterruptTime + 1));
-
-#ifdef ENABLE_TRACING  // To keep us from a tight spin when trying to debug this code...
-        LARGE_INTEGER Now;
-        KeQuerySystemTime(&Now);
-
-        if( Now.QuadPart >= NextTime.QuadPart )
-        {
-            NextTime.QuadPart = 0LL - m_TimePerFrame ;
-        }
-
-#endif
-        m_IsrTimer.Set( NextTime );
-    }
+    ScheduleNextFrame();
 }
 
 NTSTATUS
@@ -211,6 +211,8 @@ Return Value:
     m_NumMappingsCompleted = 0;
     m_ScatterGatherMappingsQueued = 0;
     m_NumFramesSkipped = 0;
+    m_NumFramesSynthesized = 0;
+    m_SynthesisTime = 0;
     m_InterruptTime = 0;
 
     KeQuerySystemTime (&m_StartTime);
@@ -230,6 +232,25 @@ Return Value:
         Status = STATUS_INSUFFICIENT_RESOURCES;
     }
 
+    //
+    // Allocate a buffer to prerender the color bars into.
+    //
+    if (NT_SUCCESS (Status)) {
+        m_BackgroundBuffer = reinterpret_cast <PUCHAR> (
+            ExAllocatePoolZero (
+                NonPagedPoolNx,
+                m_ImageSize,
+                AVSHWS_POOLTAG
+                )
+            );
+
+        if (!m_BackgroundBuffer) {
+            ExFreePool (m_SynthesisBuffer);
+            m_SynthesisBuffer = NULL;
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
     //
     // If everything is ok, start issuing interrupts.
     //
@@ -253,6 +274,7 @@ Return Value:
         //
         m_ImageSynth -> SetImageSize (m_Width, m_Height);
         m_ImageSynth -> SetBuffer (m_SynthesisBuffer);
+        m_ImageSynth -> SetBackgroundBuffer (m_BackgroundBuffer);
 
         LARGE_INTEGER NextTime;
         NextTime.QuadPart = m_StartTime.QuadPart + m_TimePerFrame;
@@ -411,12 +433,30 @@ Return Value:
     // sake, NULL out the image synthesis buffer and toast it.
     //
     m_ImageSynth -> SetBuffer (NULL);
+    m_ImageSynth -> SetBackgroundBuffer (NULL);
 
     if (m_SynthesisBuffer) {
         ExFreePool (m_SynthesisBuffer);
         m_SynthesisBuffer = NULL;
     }
 
+    if (m_BackgroundBuffer) {
+        ExFreePool (m_BackgroundBuffer);
+        m_BackgroundBuffer = NULL;
+    }
+
+    //
+    // Report how long synthesizing the frames took.
+    //
+    if (m_NumFramesSynthesized) {
+        LARGE_INTEGER Frequency;
+        KeQueryPerformanceCounter (&Frequency);
+
+        _DbgPrintF (DEBUGLVL_TERSE, ("%lux%lu: %lu frames synthesized, %I64d us/frame",
+            m_Width, m_Height, m_NumFramesSynthesized,
+            (m_SynthesisTime * 1000000 / Frequency.QuadPart) / m_NumFramesSynthesized));
+    }
+
     //
     // Protect the S/G list
     //
@@ -755,10 +795,14 @@ Return Value:
         ULONG RemSec = (ULONG)(RemMin % 10000000);
         ULONG Hund = (ULONG)(RemSec / 100000);
     
+        LONGLONG SynthesisStart = KeQueryPerformanceCounter (NULL).QuadPart;
+
         //
-        // Synthesize a buffer in scratch space.
+        // Synthesize a buffer in scratch space.  The bars are prerendered,
+        // only the rows the overlays of the previous frame were drawn on
+        // need to be restored.
         //
-        m_ImageSynth -> SynthesizeBars ();
+        m_ImageSynth -> RestoreBars ();
     
         CHAR Text [256];
         Text[0] = '\0';
@@ -789,6 +833,9 @@ Return Value:
             BLUE
             );
 
+        m_SynthesisTime += KeQueryPerformanceCounter (NULL).QuadPart - SynthesisStart;
+        m_NumFramesSynthesized++;
+
         //
         // Fill scatter gather buffers
         //
@@ -73,6 +73,19 @@ private:
     //
     PUCHAR m_SynthesisBuffer;
 
+    //
+    // The background buffer.  The color bars are rendered into it once at
+    // start and each frame only restores the rows the overlays touched.
+    //
+    PUCHAR m_BackgroundBuffer;
+
+    //
+    // Number of frames synthesized and the time spent synthesizing them
+    // (performance counter ticks) since the start of the hardware.
+    //
+    ULONG m_NumFramesSynthesized;
+    LONGLONG m_SynthesisTime;
+
     //
     // Key information regarding the frames we generate.
     //
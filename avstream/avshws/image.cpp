@@ -390,6 +390,67 @@ Return Value:
             ImageEnd - ImageStart
             );
     }
+
+    SetDirty (0, m_Height);
+}
+
+/*************************************************/
+
+
+void
+CImageSynthesizer::
+RestoreBars (
+    )
+
+/*++
+
+Routine Description:
+
+    Put EIA-189-A standard color bars back onto the image.  The first call
+    renders them with SynthesizeBars() and saves them to the background
+    buffer.  Later calls only copy back the rows which overlays have been
+    drawn on since, which is much cheaper than rendering every pixel of
+    every frame.
+
+    Without a background buffer, this is the same as SynthesizeBars().
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+    ULONG LineSize = m_Width * GetBytesPerPixel ();
+
+    if (!m_BackgroundBuffer) {
+        SynthesizeBars ();
+    } else if (!m_BackgroundValid) {
+        SynthesizeBars ();
+        RtlCopyMemory (m_BackgroundBuffer, m_SynthesisBuffer, LineSize * m_Height);
+        m_BackgroundValid = TRUE;
+    } else {
+        //
+        // Rows may be stored bottom up, so copy them one at a time.
+        //
+        for (ULONG line = m_DirtyTop; line < m_DirtyBottom; line++) {
+
+            GetImageLocation (0, line);
+
+            RtlCopyMemory (
+                m_Cursor,
+                m_BackgroundBuffer + (m_Cursor - m_SynthesisBuffer),
+                LineSize
+                );
+        }
+    }
+
+    m_DirtyTop = m_Height;
+    m_DirtyBottom = 0;
 }
 
 /*************************************************/
@@ -503,6 +564,8 @@ Return Value:
     ULONG SpaceX = m_Width - LocX;
     ULONG SpaceY = m_Height - LocY;
 
+    SetDirty (LocY, LocY + LenY);
+
     //
     // Set the default cursor position.
     //
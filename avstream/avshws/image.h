@@ -83,6 +83,22 @@ protected:
     //
     PUCHAR m_SynthesisBuffer;
 
+    //
+    // The background buffer.  If set with SetBackgroundBuffer(), it holds a
+    // prerendered copy of the color bars so that RestoreBars() only needs to
+    // copy back the rows overlays were drawn on instead of rendering the
+    // bars again.
+    //
+    PUCHAR m_BackgroundBuffer;
+    BOOLEAN m_BackgroundValid;
+
+    //
+    // The rows [m_DirtyTop, m_DirtyBottom) that have been drawn on since the
+    // bars were last restored.
+    //
+    ULONG m_DirtyTop;
+    ULONG m_DirtyBottom;
+
     //
     // The default cursor.  This is a pointer into the synthesis buffer where
     // a non specific PutPixel will be placed. 
@@ -150,6 +166,7 @@ public:
     {
         m_Width = Width;
         m_Height = Height;
+        m_BackgroundValid = FALSE;
     }
 
     //
@@ -163,6 +180,38 @@ public:
         )
     {
         m_SynthesisBuffer = SynthesisBuffer;
+        m_BackgroundValid = FALSE;
+    }
+
+    //
+    // SetBackgroundBuffer():
+    //
+    // Set the buffer the color bars are prerendered to.  It must be the
+    // same size as the synthesis buffer.  NULL disables the prerendering.
+    //
+    void
+    SetBackgroundBuffer (
+        PUCHAR BackgroundBuffer
+        )
+    {
+        m_BackgroundBuffer = BackgroundBuffer;
+        m_BackgroundValid = FALSE;
+    }
+
+    //
+    // SetDirty():
+    //
+    // Note that the rows [Top, Bottom) have been drawn on.
+    //
+    void
+    SetDirty (
+        ULONG Top,
+        ULONG Bottom
+        )
+    {
+        if (Bottom > m_Height) Bottom = m_Height;
+        if (Top < m_DirtyTop) m_DirtyTop = Top;
+        if (Bottom > m_DirtyBottom) m_DirtyBottom = Bottom;
     }
 
     //
@@ -174,6 +223,16 @@ public:
     SynthesizeBars (
         );
 
+    //
+    // RestoreBars():
+    //
+    // Put the color bars back onto the image, from the prerendered
+    // background when there is one.
+    //
+    void
+    RestoreBars (
+        );
+
     //
     // OverlayText():
     //
@@ -196,7 +255,11 @@ public:
         ) :
         m_Width (0),
         m_Height (0),
-        m_SynthesisBuffer (NULL)
+        m_SynthesisBuffer (NULL),
+        m_BackgroundBuffer (NULL),
+        m_BackgroundValid (FALSE),
+        m_DirtyTop (0),
+        m_DirtyBottom (0)
     {
     }
 
@@ -209,7 +272,11 @@ public:
         ) :
         m_Width (Width),
         m_Height (Height),
-        m_SynthesisBuffer (NULL)
+        m_SynthesisBuffer (NULL),
+        m_BackgroundBuffer (NULL),
+        m_BackgroundValid (FALSE),
+        m_DirtyTop (0),
+        m_DirtyBottom (0)
     {
     }
 
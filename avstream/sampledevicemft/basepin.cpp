@@ -587,6 +587,29 @@ HRESULT COutPin::FlushQueues()
     return hr;
 }
 /*++
+COutPin::QueueStatistics
+Description:
+Returns the queue counters of the pin. Passing NULL resets them instead
+--*/
+HRESULT COutPin::QueueStatistics(
+    _Out_opt_ PDMFT_PIN_QUEUE_STATISTICS pStatistics
+    )
+{
+    HRESULT hr = S_OK;
+    CAutoLock Lock(lock());
+    DMFTCHECKNULL_GOTO(m_queue, done, MF_E_INVALID_STREAM_STATE);
+    if (pStatistics)
+    {
+        m_queue->GetStatistics(pStatistics);
+    }
+    else
+    {
+        m_queue->ResetStatistics();
+    }
+done:
+    return hr;
+}
+/*++
 COutPin::ChangeMediaTypeFromInpin
 Description:
 called from the Device Transform when the input media type is changed. This will result in 
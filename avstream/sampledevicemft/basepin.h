@@ -572,6 +572,9 @@ public:
     STDMETHODIMP_(VOID) SetFirstSample(
         _In_    BOOL 
         );
+    HRESULT QueueStatistics(
+        _Out_opt_ PDMFT_PIN_QUEUE_STATISTICS pStatistics
+        );
 
     STDMETHODIMP_(VOID) SetAllocator(
         _In_    IMFVideoSampleAllocator* pAllocator
@@ -38,6 +38,28 @@ DEFINE_GUID(CLSID_MultiPinMFT,
 DEFINE_GUID(AVSTREAM_CUSTOM_PIN_IMAGE,
     0x888c4105, 0xb328, 0x4ed6, 0xa3, 0xca, 0x2f, 0xf4, 0xc0, 0x3a, 0x9f, 0x33);
 
+//
+// Property set serviced by the Device Transform itself and never sent to the driver. It
+// returns the queue statistics of an output pin so the latency the transform adds to a
+// stream can be measured. Send a KSP_PIN with PinId set to the output stream id and
+// KSPROPERTY_TYPE_GET; the data is a DMFT_PIN_QUEUE_STATISTICS. KSPROPERTY_TYPE_SET resets
+// the counters.
+//
+DEFINE_GUID(PROPSETID_DMFT_PINSTATISTICS,
+    0x5b1e3c7a, 0x2d94, 0x4f0b, 0x9a, 0x61, 0x3e, 0x8c, 0x07, 0xd2, 0x4b, 0x15);
+
+#define KSPROPERTY_DMFT_PINSTATISTICS_QUEUE 0
+
+typedef struct _DMFT_PIN_QUEUE_STATISTICS {
+    ULONGLONG   SamplesQueued;      // Samples inserted in the queue
+    ULONGLONG   SamplesDelivered;   // Samples handed out by ProcessOutput
+    ULONGLONG   SamplesFlushed;     // Samples dropped by a flush
+    ULONG       QueueDepth;         // Samples in the queue now
+    ULONG       MaxQueueDepth;      // Most samples the queue ever held
+    LONGLONG    TotalLatency;       // Sum of insert to ProcessOutput times, 100ns units
+    LONGLONG    MaxLatency;         // Longest insert to ProcessOutput time, 100ns units
+} DMFT_PIN_QUEUE_STATISTICS, *PDMFT_PIN_QUEUE_STATISTICS;
+
 
 
 //TP_NORMAL
@@ -232,7 +254,8 @@ typedef enum _DMFT_conversion_type{
 
 typedef  std::vector< IMFMediaType *> IMFMediaTypeArray;
 typedef  std::vector< CBasePin *>     CBasePinArray;
-typedef  std::vector< IMFSample *>    IMFSampleList;
+typedef  std::pair< IMFSample *, MFTIME > QueuedSample;  // Sample and the time it was queued
+typedef  std::vector< QueuedSample >   IMFSampleList;
 typedef  std::pair< std::multimap<int, int>::iterator, std::multimap<int, int>::iterator > MMFTMMAPITERATOR;
 
 
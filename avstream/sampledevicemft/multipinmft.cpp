@@ -1111,6 +1111,16 @@ STDMETHODIMP CMultipinMft::KsProperty(
         DMFTRACE(DMFT_GENERAL, TRACE_LEVEL_INFORMATION, "%!FUNC! Warm Start Control %d Passed ", pProperty->Id);
     }
 
+    if (IsEqualCLSID(pProperty->Set, PROPSETID_DMFT_PINSTATISTICS))
+    {
+        //
+        // Serviced here, the driver does not know about this set
+        //
+        DMFTCHECKHR_GOTO(PinStatisticsHandler(pProperty,
+            ulPropertyLength, pvPropertyData, ulDataLength, pulBytesReturned), done);
+        goto done;
+    }
+
     if (IsEqualCLSID(pProperty->Set, KSPROPERTYSETID_ExtendedCameraControl))
     {
         DMFTRACE(DMFT_GENERAL, TRACE_LEVEL_INFORMATION, "%!FUNC! Extended Control %d Passed ",pProperty->Id);
@@ -1155,6 +1165,62 @@ done:
     return hr;
 }
 
+/*++
+    Description:
+    Services PROPSETID_DMFT_PINSTATISTICS. Get returns the queue counters of the output
+    pin named in the KSP_PIN, set resets them.
+--*/
+HRESULT CMultipinMft::PinStatisticsHandler(
+    _In_reads_bytes_(ulPropertyLength) PKSPROPERTY pProperty,
+    _In_ ULONG ulPropertyLength,
+    _Inout_updates_bytes_(ulDataLength) LPVOID pvPropertyData,
+    _In_ ULONG ulDataLength,
+    _Inout_ ULONG* pulBytesReturned
+    )
+{
+    HRESULT hr = S_OK;
+    ComPtr<COutPin> spoPin;
+    PKSP_PIN pPinProperty = reinterpret_cast<PKSP_PIN>(pProperty);
+
+    *pulBytesReturned = 0;
+    if (pProperty->Id != KSPROPERTY_DMFT_PINSTATISTICS_QUEUE)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+        goto done;
+    }
+    if (ulPropertyLength < sizeof(KSP_PIN))
+    {
+        hr = E_INVALIDARG;
+        goto done;
+    }
+
+    spoPin = GetOutPin(pPinProperty->PinId);
+    DMFTCHECKNULL_GOTO(spoPin.Get(), done, MF_E_INVALIDSTREAMNUMBER);
+
+    if (pProperty->Flags & KSPROPERTY_TYPE_GET)
+    {
+        if (ulDataLength < sizeof(DMFT_PIN_QUEUE_STATISTICS))
+        {
+            *pulBytesReturned = sizeof(DMFT_PIN_QUEUE_STATISTICS);
+            hr = HRESULT_FROM_WIN32(ERROR_MORE_DATA);
+            goto done;
+        }
+        DMFTCHECKNULL_GOTO(pvPropertyData, done, E_INVALIDARG);
+        DMFTCHECKHR_GOTO(spoPin->QueueStatistics(static_cast<PDMFT_PIN_QUEUE_STATISTICS>(pvPropertyData)), done);
+        *pulBytesReturned = sizeof(DMFT_PIN_QUEUE_STATISTICS);
+    }
+    else if (pProperty->Flags & KSPROPERTY_TYPE_SET)
+    {
+        DMFTCHECKHR_GOTO(spoPin->QueueStatistics(nullptr), done);
+    }
+    else
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+done:
+    return hr;
+}
+
 STDMETHODIMP CMultipinMft::KsMethod(
     _In_reads_bytes_(ulPropertyLength) PKSMETHOD   pMethod,
     _In_ ULONG ulPropertyLength,
@@ -352,6 +352,13 @@ protected:
     HRESULT BridgeInputPinOutputPin(
         _In_ CInPin* pInPin,
         _In_ COutPin* pOutPin);
+    HRESULT PinStatisticsHandler(
+        _In_reads_bytes_(ulPropertyLength)  PKSPROPERTY pProperty,
+        _In_                                ULONG       ulPropertyLength,
+        _Inout_updates_bytes_(ulDataLength) LPVOID      pvPropertyData,
+        _In_                                ULONG       ulDataLength,
+        _Inout_                             ULONG*      pulBytesReturned
+        );
 #if defined (MF_DEVICEMFT_WARMSTART_HANDLING)
     HRESULT CMultipinMft::WarmStartHandler(
         _In_    PKSPROPERTY Property,
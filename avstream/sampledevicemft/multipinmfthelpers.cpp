@@ -18,6 +18,8 @@ CPinQueue::CPinQueue(   _In_ DWORD dwPinId ,
                         _In_ IMFDeviceTransform* pParent)
     :m_dwInPinId(dwPinId),
     m_pTransform(pParent),
+    m_ulHead(0),
+    m_ulCount(0),
     m_cRef(1)
     
     /*
@@ -26,6 +28,7 @@ CPinQueue::CPinQueue(   _In_ DWORD dwPinId ,
     */
 {
     m_streamCategory = GUID_NULL;
+    ZeroMemory(&m_statistics, sizeof(m_statistics));
 }
 CPinQueue::~CPinQueue( )
 {
@@ -34,14 +37,34 @@ CPinQueue::~CPinQueue( )
 
 /*++
 Description:
-    Insert sample into the list once we reach the open queue
+    Insert sample into the ring once we reach the open queue. The ring only grows, so once
+    it holds as many samples as the pipeline keeps outstanding no further allocations are
+    made while streaming.
 --*/
 STDMETHODIMP_(VOID) CPinQueue::InsertInternal( _In_ IMFSample *pSample )
 {
     pSample->AddRef();
     HRESULT hr = ExceptionBoundary([&]()
     {
-        m_sampleList.push_back(pSample);
+        ULONG ulSize = (ULONG)m_sampleList.size();
+        if (m_ulCount == ulSize)
+        {
+            //
+            // Full, double the ring and unwrap the samples into the new one
+            //
+            IMFSampleList newList(ulSize ? ulSize * 2 : 8);
+            for (ULONG i = 0; i < m_ulCount; i++)
+            {
+                newList[i] = m_sampleList[(m_ulHead + i) & (ulSize - 1)];
+            }
+            m_sampleList.swap(newList);
+            m_ulHead = 0;
+            ulSize = (ULONG)m_sampleList.size();
+        }
+        m_sampleList[(m_ulHead + m_ulCount) & (ulSize - 1)] = QueuedSample(pSample, MFGetSystemTime());
+        m_ulCount++;
+        m_statistics.SamplesQueued++;
+        m_statistics.MaxQueueDepth = max(m_statistics.MaxQueueDepth, m_ulCount);
     });
 
     if (SUCCEEDED(hr) && m_pTransform)
@@ -76,13 +99,22 @@ STDMETHODIMP CPinQueue::Remove( _Outptr_result_maybenull_ IMFSample **ppSample)
     DMFTCHECKNULL_GOTO( ppSample, done,E_INVALIDARG );
     *ppSample = nullptr;
 
-    if ( !m_sampleList.empty() )
+    if ( !Empty() )
     {
-        *ppSample = m_sampleList.front();
+        QueuedSample& entry = m_sampleList[m_ulHead];
+        LONGLONG llLatency = MFGetSystemTime() - entry.second;
+
+        *ppSample = entry.first;
+        entry.first = nullptr;
+        m_ulHead = (m_ulHead + 1) & ((ULONG)m_sampleList.size() - 1);
+        m_ulCount--;
+
+        m_statistics.SamplesDelivered++;
+        m_statistics.TotalLatency += llLatency;
+        m_statistics.MaxLatency = max(m_statistics.MaxLatency, llLatency);
     }
 
     DMFTCHECKNULL_GOTO( *ppSample, done, MF_E_TRANSFORM_NEED_MORE_INPUT );
-    m_sampleList.erase( m_sampleList.begin() );
 done:
     return hr;
 }
@@ -104,9 +136,28 @@ VOID CPinQueue::Clear( )
 
     while ( !Empty() )
     {
-        ComPtr<IMFSample> spSample;
-        Remove( spSample.GetAddressOf());
+        SAFE_RELEASE(m_sampleList[m_ulHead].first);
+        m_ulHead = (m_ulHead + 1) & ((ULONG)m_sampleList.size() - 1);
+        m_ulCount--;
+        m_statistics.SamplesFlushed++;
     }
+    m_ulHead = 0;
+}
+
+/*++
+Description:
+    Returns the counters of the queue. The caller holds the pin lock.
+--*/
+STDMETHODIMP_(VOID) CPinQueue::GetStatistics( _Out_ PDMFT_PIN_QUEUE_STATISTICS pStatistics )
+{
+    *pStatistics = m_statistics;
+    pStatistics->QueueDepth = m_ulCount;
+}
+
+STDMETHODIMP_(VOID) CPinQueue::ResetStatistics()
+{
+    ZeroMemory(&m_statistics, sizeof(m_statistics));
+    m_statistics.MaxQueueDepth = m_ulCount;
 }
 
 /*++
@@ -135,13 +135,15 @@ public:
         _In_opt_ IMFVideoSampleAllocator* pAllcoator);
 #endif
     STDMETHODIMP_(VOID) Clear();
+    STDMETHODIMP_(VOID) GetStatistics   ( _Out_ PDMFT_PIN_QUEUE_STATISTICS pStatistics );
+    STDMETHODIMP_(VOID) ResetStatistics ();
   
     //
     //Inline functions
     //
     __inline BOOL Empty()
     {
-        return (!m_sampleList.size());
+        return (m_ulCount == 0);
     }
     __inline DWORD pinStreamId()
     {
@@ -200,7 +202,10 @@ public:
 
 private:
     DWORD                m_dwInPinId;           /* This is the input pin       */
-    IMFSampleList        m_sampleList;          /* List storing the samples    */
+    IMFSampleList        m_sampleList;          /* Ring storing the samples, size is a power of 2 */
+    ULONG                m_ulHead;              /* Oldest sample in the ring   */
+    ULONG                m_ulCount;             /* Samples in the ring         */
+    DMFT_PIN_QUEUE_STATISTICS m_statistics;
     IMFDeviceTransform*  m_pTransform;         /* Weak reference to the the device MFT */
     GUID                 m_streamCategory;
     ULONG                m_cRef;
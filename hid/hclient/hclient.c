@@ -660,12 +660,10 @@ CLM_PrintInputReport(
     }
     printf("\n");
 
-    if (FALSE == UnpackReport (pDevice->InputReportBuffer,
-                                pDevice->Caps.InputReportByteLength,
-                                HidP_Input,
-                                pDevice->InputData,
-                                pDevice->InputDataLength,
-                                pDevice->Ppd))
+    if (FALSE == UnpackDeviceReport (pDevice,
+                                      HidP_Input,
+                                      pDevice->InputReportBuffer,
+                                      pDevice->Caps.InputReportByteLength))
     {
         printf("Failed parsing the report data\n");
     }
@@ -736,6 +734,22 @@ Done:
     CloseHidDevice(&syncDevice);
 }
 
+void
+CLM_PrintPumpStatistics(
+    _In_ PHID_PUMP_STATISTICS pStatistics)
+{
+    printf("Reports: %u (%u/sec), dropped: %u, read errors: %u\n",
+           pStatistics->ReportsReceived,
+           pStatistics->ReportsPerSecond,
+           pStatistics->ReportsDropped,
+           pStatistics->ReadErrors);
+
+    printf("Interval: %u us, jitter: %u us, latency: %u us\n",
+           pStatistics->MeanIntervalUs,
+           pStatistics->JitterUs,
+           pStatistics->LatencyUs);
+}
+
 void
 CLM_AsyncRead(
     _In_ PHID_DEVICE pDevice,
@@ -748,7 +762,7 @@ CLM_AsyncRead(
     if (!OpenHidDevice(pDevice->DevicePath, 
                         TRUE,
                         FALSE,
-                        FALSE,
+                        TRUE,
                         FALSE,
                         &asyncDevice))
     {
@@ -778,6 +792,7 @@ CLM_AsyncRead(
         ResumeThread(readThread);
         WaitForSingleObject(readThread, INFINITE);
         printf("Asychronous read stopped.\n");
+        CLM_PrintPumpStatistics(&readContext.Statistics);
     }
 
     if (readThread != NULL)
@@ -2274,6 +2289,40 @@ bReadDlgProc(
                                    0);
             }
 
+            //
+            // Asynchronous reads go through the input pump, show its counters
+            //
+
+            if (pDevice == &asyncDevice)
+            {
+                StringCbPrintf(szTempBuff,
+                               sizeof(szTempBuff),
+                               "Reports: %u (%u/sec), Dropped: %u, Interval: %u us, Jitter: %u us, Latency: %u us",
+                               readContext.Statistics.ReportsReceived,
+                               readContext.Statistics.ReportsPerSecond,
+                               readContext.Statistics.ReportsDropped,
+                               readContext.Statistics.MeanIntervalUs,
+                               readContext.Statistics.JitterUs,
+                               readContext.Statistics.LatencyUs);
+
+                SendDlgItemMessage(hDlg,
+                                   IDC_OUTPUT,
+                                   LB_ADDSTRING,
+                                   0,
+                                   (LPARAM) szTempBuff);
+
+                iLbCounter++;
+
+                if (iLbCounter > MAX_LB_ITEMS)
+                {
+                    SendDlgItemMessage(hDlg,
+                                       IDC_OUTPUT,
+                                       LB_DELETESTRING,
+                                       0,
+                                       0);
+                }
+            }
+
             for (uLoop = 0; uLoop < pDevice->InputDataLength; uLoop++)
             {
                 ReportToString(pData, szTempBuff, sizeof(szTempBuff));
@@ -3697,157 +3746,190 @@ AsynchReadThreadProc(
     PREAD_THREAD_CONTEXT    Context
 )
 {
-    HANDLE  completionEvent;
-    BOOL    readResult;
-    DWORD   waitStatus;
-    ULONG   numReadsDone;
-    OVERLAPPED overlap;
-    DWORD      bytesTransferred;
+    HID_INPUT_PUMP  pump;
+    PHID_DEVICE     hidDevice;
+    PCHAR           reports;
+    LONGLONG        timestamps[HID_PUMP_RING_SIZE];
+    LARGE_INTEGER   now;
+    ULONG           numReadsDone;
+    ULONG           numReports;
+    ULONG           maxReports;
+    ULONG           reportLength;
+    ULONG           latencyUs;
+    ULONG           iIndex;
+    BOOL            pumpStarted = FALSE;
 
-    
-    //
-    // Create the completion event to send to the the OverlappedRead routine
-    //
+    hidDevice = Context -> HidDevice;
+    reportLength = hidDevice -> Caps.InputReportByteLength;
+
+    memset(&Context -> Statistics, 0, sizeof(HID_PUMP_STATISTICS));
+
+    reports = (PCHAR) calloc(HID_PUMP_RING_SIZE, reportLength);
 
-    completionEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (NULL == reports)
+    {
+        goto AsyncRead_End;
+    }
 
     //
-    // If NULL returned, then we cannot proceed any farther so we just exit the 
-    //  the thread
+    // Start the input pump, which keeps several reads outstanding so no
+    //  report is lost while we are decoding or displaying the previous ones.
+    //  For a single read, there is no point in reading ahead.
     //
-    
-    if (NULL == completionEvent) 
+
+    pumpStarted = StartInputPump(hidDevice,
+                                 (1 == Context -> NumberOfReads) ? 1 : HID_PUMP_DEFAULT_READS,
+                                 &pump);
+
+    if (!pumpStarted)
     {
         goto AsyncRead_End;
     }
 
     //
     // Now we enter the main read loop, which does the following:
-    //  1) Calls ReadOverlapped()
-    //  2) Waits for read completion with a timeout just to check if 
-    //      the main thread wants us to terminate our the read request
-    //  3) If the read fails, we simply break out of the loop
-    //      and exit the thread
-    //  4) If the read succeeds, we call UnpackReport to get the relevant
-    //      info and then post a message to main thread to indicate that
-    //      there is new data to display.
-    //  5) We then block on the display event until the main thread says
-    //      it has properly displayed the new data
-    //  6) Look to repeat this loop if we are doing more than one read
+    //  1) Waits for the pump to queue reports, with a timeout just to check
+    //      if the main thread wants us to terminate
+    //  2) Takes all queued reports out of the pump's ring and decodes them,
+    //      which leaves the input info holding the latest values
+    //  3) If the pump stopped because a read failed, we simply break out of
+    //      the loop and exit the thread
+    //  4) Posts a message to main thread to indicate that there is new data
+    //      to display, and blocks on the display event until the main thread
+    //      says it has properly displayed the new data.  Reports that
+    //      arrive meanwhile are queued by the pump.
+    //  5) Look to repeat this loop if we are doing more than one read
     //      and the main thread has yet to want us to terminate
     //
 
     numReadsDone = 0;
 
-    do 
+    while (!Context -> TerminateThread &&
+           (INFINITE_READS == Context -> NumberOfReads ||
+            numReadsDone < Context -> NumberOfReads))
     {
-        //
-        // Call ReadOverlapped() and if the return status is TRUE, the ReadFile
-        //  succeeded so we need to block on completionEvent, otherwise, we just
-        //  exit
-        //
+        maxReports = HID_PUMP_RING_SIZE;
 
-        readResult = ReadOverlapped( Context->HidDevice, completionEvent, &overlap );
+        if (INFINITE_READS != Context -> NumberOfReads)
+        {
+            maxReports = min(maxReports, Context -> NumberOfReads - numReadsDone);
+        }
 
+        numReports = PopInputReports(&pump, reports, timestamps, maxReports);
 
-        if (!readResult)
+        if (0 == numReports)
         {
-           break;
+            if (pump.Failed)
+            {
+                break;
+            }
+
+            WaitForSingleObject(pump.ReportEvent, READ_THREAD_TIMEOUT);
+            continue;
         }
 
-        while (!Context -> TerminateThread) 
-        {
-            //
-            // Wait for the completion event to be signaled or a timeout
-            //
-            
-            waitStatus = WaitForSingleObject (completionEvent, READ_THREAD_TIMEOUT );
+        numReadsDone += numReports;
 
-            //
-            // If completionEvent was signaled, then a read just completed
-            //   so let's get the status and leave this loop and process the data 
-            //
-            
-            if ( WAIT_OBJECT_0 == waitStatus)
+        if (NULL != hidDevice -> InputDecoder)
+        {
+            DecodeReports(hidDevice -> InputDecoder,
+                          reports,
+                          (USHORT) reportLength,
+                          numReports,
+                          hidDevice -> Ppd);
+        }
+        else
+        {
+            for (iIndex = 0; iIndex < numReports; iIndex++)
             {
-                readResult = GetOverlappedResult(Context->HidDevice->HidDevice, &overlap, &bytesTransferred, TRUE);
-                break;
+                UnpackReport(reports + (iIndex * reportLength),
+                             (USHORT) reportLength,
+                             HidP_Input,
+                             hidDevice -> InputData,
+                             hidDevice -> InputDataLength,
+                             hidDevice -> Ppd);
             }
         }
 
         //
-        // Check the TerminateThread again...If it is not set, then data has
-        //  been read.  In this case, we want to Unpack the report into our
-        //  input info and then send a message to the main thread to display
-        //  the new data.
+        // Keep the latest report in the device's input buffer, which is
+        //  what the raw report display shows.
         //
+
+        memcpy(hidDevice -> InputReportBuffer,
+               reports + ((numReports - 1) * reportLength),
+               reportLength);
+
+        GetInputPumpStatistics(&pump, &Context -> Statistics);
+
+        QueryPerformanceCounter(&now);
+        Context -> Statistics.LatencyUs = (ULONG) (((now.QuadPart - timestamps[numReports - 1]) * 1000000) /
+                                                  pump.Frequency.QuadPart);
         
-        if (!Context -> TerminateThread) 
+        if (NULL != Context -> DisplayEvent)
         {
-            numReadsDone++;
-
-            UnpackReport(Context -> HidDevice -> InputReportBuffer,
-                          Context -> HidDevice -> Caps.InputReportByteLength,
-                          HidP_Input,
-                          Context -> HidDevice -> InputData,
-                          Context -> HidDevice -> InputDataLength,
-                          Context -> HidDevice -> Ppd);
-            
-            if (NULL != Context -> DisplayEvent)
-            {
-                PostMessage(Context -> DisplayWindow,
-                            WM_DISPLAY_READ_DATA,
-                            0,
-                            (LPARAM) Context -> HidDevice);
+            PostMessage(Context -> DisplayWindow,
+                        WM_DISPLAY_READ_DATA,
+                        0,
+                        (LPARAM) Context -> HidDevice);
 
-                WaitForSingleObject( Context -> DisplayEvent, INFINITE );
-            }
-            else if (NULL != Context->DisplayWindow)
-            {
-                CHAR        szTempBuff[1024];
-                PHID_DEVICE pDevice;
-                PHID_DATA   pData;
-                UINT        uLoop;
+            WaitForSingleObject( Context -> DisplayEvent, INFINITE );
+        }
+        else if (NULL != Context->DisplayWindow)
+        {
+            CHAR        szTempBuff[1024];
+            PHID_DEVICE pDevice;
+            PHID_DATA   pData;
+            UINT        uLoop;
 
-                pDevice = (PHID_DEVICE)Context->HidDevice;
+            pDevice = (PHID_DEVICE)Context->HidDevice;
 
-                //
-                // Display all the data stored in the Input data field for the device
-                //
-                pData = pDevice->InputData;
+            //
+            // Display all the data stored in the Input data field for the device
+            //
+            pData = pDevice->InputData;
+
+            SendMessage(GetDlgItem(Context->DisplayWindow, IDC_CALLOUTPUT),
+                LB_ADDSTRING,
+                0,
+                (LPARAM)"-------------------------------------------");
+
+            for (uLoop = 0; uLoop < pDevice->InputDataLength; uLoop++)
+            {
+                ReportToString(pData, szTempBuff, sizeof(szTempBuff));
 
                 SendMessage(GetDlgItem(Context->DisplayWindow, IDC_CALLOUTPUT),
                     LB_ADDSTRING,
                     0,
-                    (LPARAM)"-------------------------------------------");
-
-                for (uLoop = 0; uLoop < pDevice->InputDataLength; uLoop++)
-                {
-                    ReportToString(pData, szTempBuff, sizeof(szTempBuff));
-
-                    SendMessage(GetDlgItem(Context->DisplayWindow, IDC_CALLOUTPUT),
-                        LB_ADDSTRING,
-                        0,
-                        (LPARAM)szTempBuff);
+                    (LPARAM)szTempBuff);
 
-                    pData++;
-                }
-            }
-            else if (NULL == Context -> DisplayWindow)
-            {
-                // Running in console mode
-                printf("Read #%d\n", numReadsDone);
-                CLM_PrintInputReport(Context -> HidDevice);
+                pData++;
             }
         }
-    } while ( readResult &&
-              !Context->TerminateThread &&
-              (INFINITE_READS == Context -> NumberOfReads || 
-              numReadsDone < Context -> NumberOfReads));
-
+        else if (NULL == Context -> DisplayWindow)
+        {
+            // Running in console mode
+            printf("Read #%d\n", numReadsDone);
+            CLM_PrintInputReport(Context -> HidDevice);
+        }
+    }
 
 AsyncRead_End:
 
+    if (pumpStarted)
+    {
+        StopInputPump(&pump);
+
+        latencyUs = Context -> Statistics.LatencyUs;
+        GetInputPumpStatistics(&pump, &Context -> Statistics);
+        Context -> Statistics.LatencyUs = latencyUs;
+    }
+
+    if (NULL != reports)
+    {
+        free(reports);
+    }
+
     PostMessage( Context -> DisplayWindow, WM_READ_DONE, 0, 0);
     ExitThread(0);
     return (0);
@@ -3869,12 +3951,10 @@ SynchReadThreadProc(
 
         numReadsDone ++;
 
-        UnpackReport(Context -> HidDevice -> InputReportBuffer,
-                     Context -> HidDevice -> Caps.InputReportByteLength,
-                     HidP_Input,
-                     Context -> HidDevice -> InputData,
-                     Context -> HidDevice -> InputDataLength,
-                     Context -> HidDevice -> Ppd);
+        UnpackDeviceReport(Context -> HidDevice,
+                           HidP_Input,
+                           Context -> HidDevice -> InputReportBuffer,
+                           Context -> HidDevice -> Caps.InputReportByteLength);
 
         if (NULL != Context -> DisplayEvent) 
         {
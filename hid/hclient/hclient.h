@@ -44,6 +44,8 @@ typedef struct _READ_THREAD_CONTEXT
     ULONG       NumberOfReads;
     BOOL        TerminateThread;
 
+    HID_PUMP_STATISTICS Statistics;  // Input pump counters as of the last display
+
 } READ_THREAD_CONTEXT, *PREAD_THREAD_CONTEXT;
 
 
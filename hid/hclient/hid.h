@@ -83,6 +83,59 @@ typedef struct _HID_DATA {
    };
 } HID_DATA, *PHID_DATA;
 
+//
+// A report decoder is a flat table, compiled once per report type from the
+// preparsed data, that gives the bit offset and size of every field of every
+// HID_DATA structure, grouped by report ID.  With it a report is unpacked by
+// extracting bits directly instead of asking the HidP_ functions to search
+// the preparsed data for each usage on each report.
+//
+// Items the compiler cannot describe exactly (array buttons, value arrays,
+// values whose scaling it cannot reproduce) are left uncompiled and are
+// handled through the HidP_ functions as before.
+//
+
+#define HID_MAX_REPORT_IDS      256
+#define HID_MAX_BUTTON_FIELDS   256
+
+typedef struct _HID_FIELD {
+   ULONG       BitOffset;   // Offset of the field from the start of the report,
+                            //  including the report ID byte
+   UCHAR       BitSize;     // Size of the field, 1 to 32 bits
+   UCHAR       Reserved;
+   USAGE       Usage;       // Button usage reported when the bit is set
+} HID_FIELD, *PHID_FIELD;
+
+typedef struct _HID_ITEM {
+   PHID_DATA   Data;        // HID_DATA structure this item fills in
+   BOOLEAN     IsCompiled;  // FALSE if the item is handled by the HidP_ functions
+   BOOLEAN     IsSigned;    // Value is sign extended before scaling
+   BOOLEAN     HasNull;     // Out of range values are null values
+   UCHAR       Reserved;
+   ULONG       FirstField;  // Index of the item's first HID_FIELD
+   ULONG       FieldCount;
+   LONG        LogicalMin;
+   LONG        LogicalMax;
+   LONG        PhysicalMin;
+   LONG        PhysicalMax;
+} HID_ITEM, *PHID_ITEM;
+
+typedef struct _HID_REPORT_DECODER {
+   HIDP_REPORT_TYPE ReportType;
+   USHORT      ReportLength;
+   ULONG       ItemCount;
+   ULONG       CompiledCount;   // Number of items that were compiled
+   ULONG       FieldCount;
+   PHID_ITEM   Items;           // Items sorted by report ID
+   PHID_FIELD  Fields;
+
+   //
+   // The items of report ID n are Items[ReportStart[n]] up to, not including,
+   // Items[ReportStart[n + 1]].
+   //
+   ULONG       ReportStart[HID_MAX_REPORT_IDS + 1];
+} HID_REPORT_DECODER, *PHID_REPORT_DECODER;
+
 typedef struct _HID_DEVICE {   
     PCHAR                DevicePath;
     HANDLE               HidDevice; // A file handle to the hid device.
@@ -114,8 +167,64 @@ typedef struct _HID_DEVICE {
     ULONG                FeatureDataLength;
     PHIDP_BUTTON_CAPS    FeatureButtonCaps;
     PHIDP_VALUE_CAPS     FeatureValueCaps;
+
+    PHID_REPORT_DECODER  InputDecoder;   // NULL if the decoder could not be built
+    PHID_REPORT_DECODER  OutputDecoder;
+    PHID_REPORT_DECODER  FeatureDecoder;
 } HID_DEVICE, *PHID_DEVICE;
 
+//
+// An input pump keeps several overlapped reads outstanding on a device opened
+// for overlapped I/O, so reports are not lost while one read is being
+// completed and reissued.  Each report is timestamped when its read completes
+// and queued in a ring that has a single producer, the pump thread, and a
+// single consumer, the thread decoding and displaying the reports.  When the
+// consumer falls behind and the ring is full, new reports are dropped and
+// counted.
+//
+
+#define HID_PUMP_MAX_READS      16
+#define HID_PUMP_DEFAULT_READS  8
+#define HID_PUMP_RING_SIZE      256     // Must be a power of two
+
+typedef struct _HID_PUMP_STATISTICS {
+   ULONG       ReportsReceived;
+   ULONG       ReportsDropped;  // Reports discarded because the ring was full
+   ULONG       ReadErrors;
+   ULONG       ReportsPerSecond;
+   ULONG       MeanIntervalUs;  // Smoothed time between reports
+   ULONG       JitterUs;        // Smoothed variation of the time between reports
+   ULONG       LatencyUs;       // Time from completion to decoding, set by the consumer
+} HID_PUMP_STATISTICS, *PHID_PUMP_STATISTICS;
+
+typedef struct _HID_INPUT_PUMP {
+    PHID_DEVICE          HidDevice;
+    ULONG                NumberOfReads;
+    HANDLE               Thread;
+    HANDLE               ReportEvent;   // Signaled when reports are queued
+    volatile BOOL        Terminate;
+    volatile BOOL        Failed;        // A read failed and the pump stopped
+
+    OVERLAPPED           Overlap[HID_PUMP_MAX_READS];
+    BOOL                 Pending[HID_PUMP_MAX_READS];
+    PCHAR                ReadBuffers;   // One report per outstanding read
+
+    PCHAR                RingReports;   // HID_PUMP_RING_SIZE reports
+    LONGLONG             RingTimestamps[HID_PUMP_RING_SIZE];
+    volatile LONG        RingHead;      // Only advanced by the pump
+    volatile LONG        RingTail;      // Only advanced by the consumer
+
+    LARGE_INTEGER        Frequency;
+    LONGLONG             StartTime;
+    LONGLONG             LastArrival;   // Pump thread only
+    LONGLONG             LastInterval;  // Pump thread only
+    volatile LONG        ReportsReceived;
+    volatile LONG        ReportsDropped;
+    volatile LONG        ReadErrors;
+    volatile LONG        MeanIntervalUs;
+    volatile LONG        JitterUs;
+} HID_INPUT_PUMP, *PHID_INPUT_PUMP;
+
 
 BOOLEAN
 OpenHidDevice (
@@ -162,6 +271,32 @@ ReadOverlapped (
     LPOVERLAPPED    Overlap
    );
    
+BOOLEAN
+StartInputPump (
+   IN       PHID_DEVICE          HidDevice,
+   IN       ULONG                NumberOfReads,
+   OUT      PHID_INPUT_PUMP      Pump
+   );
+
+VOID
+StopInputPump (
+   IN OUT   PHID_INPUT_PUMP      Pump
+   );
+
+ULONG
+PopInputReports (
+   IN OUT   PHID_INPUT_PUMP      Pump,
+   _Out_writes_bytes_(MaxReports * Pump->HidDevice->Caps.InputReportByteLength) PCHAR Reports,
+   _Out_writes_opt_(MaxReports) PLONGLONG Timestamps,
+   IN       ULONG                MaxReports
+   );
+
+VOID
+GetInputPumpStatistics (
+   IN       PHID_INPUT_PUMP      Pump,
+   OUT      PHID_PUMP_STATISTICS Statistics
+   );
+   
 BOOLEAN
 Write (
    PHID_DEVICE    HidDevice
@@ -187,6 +322,58 @@ PackReport (
    IN       PHIDP_PREPARSED_DATA Ppd
    );
 
+BOOLEAN
+UnpackDeviceReport (
+   IN       PHID_DEVICE          HidDevice,
+   IN       HIDP_REPORT_TYPE     ReportType,
+   _In_reads_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN       USHORT               ReportBufferLength
+   );
+
+PHID_REPORT_DECODER
+CompileReportDecoder (
+   IN       HIDP_REPORT_TYPE     ReportType,
+   IN       USHORT               ReportLength,
+   _In_reads_(DataLength) PHID_DATA Data,
+   IN       ULONG                DataLength,
+   _In_reads_(NumberButtonCaps) PHIDP_BUTTON_CAPS ButtonCaps,
+   IN       USHORT               NumberButtonCaps,
+   _In_reads_(NumberValueCaps) PHIDP_VALUE_CAPS ValueCaps,
+   IN       USHORT               NumberValueCaps,
+   IN       PHIDP_PREPARSED_DATA Ppd
+   );
+
+VOID
+FreeReportDecoder (
+   IN       PHID_REPORT_DECODER  Decoder
+   );
+
+BOOLEAN
+DecodeReport (
+   IN       PHID_REPORT_DECODER  Decoder,
+   _In_reads_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN       USHORT               ReportBufferLength,
+   IN       PHIDP_PREPARSED_DATA Ppd
+   );
+
+ULONG
+DecodeReports (
+   IN       PHID_REPORT_DECODER  Decoder,
+   _In_reads_bytes_(ReportBufferLength * NumberReports)PCHAR Reports,
+   IN       USHORT               ReportBufferLength,
+   IN       ULONG                NumberReports,
+   IN       PHIDP_PREPARSED_DATA Ppd
+   );
+
+BOOLEAN
+EncodeReport (
+   IN       PHID_REPORT_DECODER  Decoder,
+   IN       UCHAR                ReportID,
+   _Out_writes_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN       USHORT               ReportBufferLength,
+   IN       PHIDP_PREPARSED_DATA Ppd
+   );
+
 BOOLEAN
 SetFeature (
    PHID_DEVICE    HidDevice
@@ -867,6 +867,41 @@ FillDeviceInfo(
             dataIdx++;
         }
     }
+
+    //
+    // Compile the report decoders.  A device without one is still usable,
+    //  its reports are then unpacked with the HidP_ functions.
+    //
+
+    HidDevice->InputDecoder = CompileReportDecoder (HidP_Input,
+                                                    HidDevice->Caps.InputReportByteLength,
+                                                    HidDevice->InputData,
+                                                    HidDevice->InputDataLength,
+                                                    HidDevice->InputButtonCaps,
+                                                    HidDevice->Caps.NumberInputButtonCaps,
+                                                    HidDevice->InputValueCaps,
+                                                    HidDevice->Caps.NumberInputValueCaps,
+                                                    HidDevice->Ppd);
+
+    HidDevice->OutputDecoder = CompileReportDecoder (HidP_Output,
+                                                     HidDevice->Caps.OutputReportByteLength,
+                                                     HidDevice->OutputData,
+                                                     HidDevice->OutputDataLength,
+                                                     HidDevice->OutputButtonCaps,
+                                                     HidDevice->Caps.NumberOutputButtonCaps,
+                                                     HidDevice->OutputValueCaps,
+                                                     HidDevice->Caps.NumberOutputValueCaps,
+                                                     HidDevice->Ppd);
+
+    HidDevice->FeatureDecoder = CompileReportDecoder (HidP_Feature,
+                                                      HidDevice->Caps.FeatureReportByteLength,
+                                                      HidDevice->FeatureData,
+                                                      HidDevice->FeatureDataLength,
+                                                      HidDevice->FeatureButtonCaps,
+                                                      HidDevice->Caps.NumberFeatureButtonCaps,
+                                                      HidDevice->FeatureValueCaps,
+                                                      HidDevice->Caps.NumberFeatureValueCaps,
+                                                      HidDevice->Ppd);
     
     bRet = TRUE;
 
@@ -916,6 +951,19 @@ CloseHidDevice (
         HidDevice -> Ppd = NULL;
     }
 
+    //
+    // The decoders point into the HID_DATA arrays, free them first
+    //
+
+    FreeReportDecoder(HidDevice -> InputDecoder);
+    HidDevice -> InputDecoder = NULL;
+
+    FreeReportDecoder(HidDevice -> OutputDecoder);
+    HidDevice -> OutputDecoder = NULL;
+
+    FreeReportDecoder(HidDevice -> FeatureDecoder);
+    HidDevice -> FeatureDecoder = NULL;
+
     if (NULL != HidDevice -> InputReportBuffer)
     {
         free(HidDevice -> InputReportBuffer);
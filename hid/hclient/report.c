@@ -22,6 +22,34 @@ Environment:
 #include "hidsdi.h"
 #include "hid.h"
 
+//
+// Main item flag that distinguishes variable fields, where each button has
+// its own bit, from array fields, which report the usages of the pressed
+// buttons as indexes.
+//
+#define HID_MAIN_ITEM_VARIABLE  0x0002
+
+#define HID_FIELD_MASK(BitSize) \
+    ((32 == (BitSize)) ? 0xFFFFFFFF : ((1UL << (BitSize)) - 1))
+
+static BOOLEAN
+UnpackData (
+   _In_reads_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN       USHORT               ReportBufferLength,
+   IN       HIDP_REPORT_TYPE     ReportType,
+   IN OUT   PHID_DATA            Data,
+   IN       PHIDP_PREPARSED_DATA Ppd
+   );
+
+static BOOLEAN
+PackData (
+   _Inout_updates_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN       USHORT               ReportBufferLength,
+   IN       HIDP_REPORT_TYPE     ReportType,
+   IN OUT   PHID_DATA            Data,
+   IN       PHIDP_PREPARSED_DATA Ppd
+   );
+
 
 BOOLEAN
 Read (
@@ -51,12 +79,10 @@ RoutineDescription:
         goto Done;
     }
 
-    result = UnpackReport (HidDevice->InputReportBuffer,
-                           HidDevice->Caps.InputReportByteLength,
-                           HidP_Input,
-                           HidDevice->InputData,
-                           HidDevice->InputDataLength,
-                           HidDevice->Ppd);
+    result = UnpackDeviceReport (HidDevice,
+                                 HidP_Input,
+                                 HidDevice->InputReportBuffer,
+                                 HidDevice->Caps.InputReportByteLength);
 Done:
     return result;
 }
@@ -125,6 +151,431 @@ RoutineDescription:
     }
 }
 
+//
+// How long the pump thread waits on a read before checking whether it was
+//  asked to stop.
+//
+
+#define PUMP_WAIT_TIMEOUT       100
+
+static BOOLEAN
+PumpIssueRead (
+    PHID_INPUT_PUMP Pump,
+    ULONG           Index
+   )
+/*++
+RoutineDescription:
+   Start the overlapped read of the given slot of the pump.  Completion, even
+   a synchronous one, is signalled through the slot's event.
+--*/
+{
+    HANDLE      event;
+    DWORD       reportLength;
+
+    reportLength = Pump -> HidDevice -> Caps.InputReportByteLength;
+
+    event = Pump -> Overlap[Index].hEvent;
+    memset(&Pump -> Overlap[Index], 0, sizeof(OVERLAPPED));
+    Pump -> Overlap[Index].hEvent = event;
+
+    if (!ReadFile (Pump -> HidDevice -> HidDevice,
+                   Pump -> ReadBuffers + (Index * reportLength),
+                   reportLength,
+                   NULL,
+                   &Pump -> Overlap[Index]) &&
+        ERROR_IO_PENDING != GetLastError())
+    {
+        return (FALSE);
+    }
+
+    Pump -> Pending[Index] = TRUE;
+    return (TRUE);
+}
+
+static VOID
+PumpQueueReport (
+    PHID_INPUT_PUMP Pump,
+    PCHAR           Report,
+    LONGLONG        Timestamp
+   )
+/*++
+RoutineDescription:
+   Account for a report that just arrived and add it to the ring, or drop it
+   if the consumer has not made room.  Only called by the pump thread.
+--*/
+{
+    DWORD       reportLength;
+    LONG        head;
+    LONGLONG    interval;
+    LONGLONG    variation;
+
+    reportLength = Pump -> HidDevice -> Caps.InputReportByteLength;
+
+    //
+    // Track the time between reports and its variation, both smoothed over
+    //  the last 16 or so reports, in microseconds.
+    //
+
+    if (0 != Pump -> LastArrival)
+    {
+        interval = ((Timestamp - Pump -> LastArrival) * 1000000) / Pump -> Frequency.QuadPart;
+
+        if (0 != Pump -> LastInterval)
+        {
+            variation = interval - Pump -> LastInterval;
+            if (variation < 0)
+            {
+                variation = -variation;
+            }
+
+            Pump -> JitterUs += (LONG) ((variation - Pump -> JitterUs) / 16);
+            Pump -> MeanIntervalUs += (LONG) ((interval - Pump -> MeanIntervalUs) / 16);
+        }
+        else
+        {
+            Pump -> MeanIntervalUs = (LONG) interval;
+        }
+
+        Pump -> LastInterval = interval;
+    }
+
+    Pump -> LastArrival = Timestamp;
+
+    InterlockedIncrement(&Pump -> ReportsReceived);
+
+    head = Pump -> RingHead;
+
+    if (head - Pump -> RingTail == HID_PUMP_RING_SIZE)
+    {
+        InterlockedIncrement(&Pump -> ReportsDropped);
+        return;
+    }
+
+    memcpy(Pump -> RingReports + ((head & (HID_PUMP_RING_SIZE - 1)) * reportLength),
+           Report,
+           reportLength);
+
+    Pump -> RingTimestamps[head & (HID_PUMP_RING_SIZE - 1)] = Timestamp;
+
+    //
+    // Publish the entry only once its contents are written
+    //
+
+    InterlockedExchange(&Pump -> RingHead, head + 1);
+    SetEvent(Pump -> ReportEvent);
+}
+
+static DWORD WINAPI
+InputPumpThreadProc (
+    LPVOID  Parameter
+   )
+/*++
+RoutineDescription:
+   Keep the pump's reads outstanding.  Reads complete in the order they were
+   issued, so the pump always waits on the oldest one, queues its report and
+   reissues it, which makes it the newest.
+--*/
+{
+    PHID_INPUT_PUMP pump = (PHID_INPUT_PUMP) Parameter;
+    LARGE_INTEGER   now;
+    DWORD           reportLength;
+    DWORD           bytesRead;
+    DWORD           waitStatus;
+    ULONG           next;
+    ULONG           Index;
+
+    reportLength = pump -> HidDevice -> Caps.InputReportByteLength;
+
+    for (Index = 0; Index < pump -> NumberOfReads; Index++)
+    {
+        if (!PumpIssueRead (pump, Index))
+        {
+            InterlockedIncrement(&pump -> ReadErrors);
+            pump -> Failed = TRUE;
+            goto Cancel;
+        }
+    }
+
+    next = 0;
+
+    while (!pump -> Terminate)
+    {
+        waitStatus = WaitForSingleObject (pump -> Overlap[next].hEvent, PUMP_WAIT_TIMEOUT);
+
+        if (WAIT_TIMEOUT == waitStatus)
+        {
+            continue;
+        }
+
+        if (WAIT_OBJECT_0 != waitStatus)
+        {
+            pump -> Failed = TRUE;
+            break;
+        }
+
+        QueryPerformanceCounter(&now);
+
+        pump -> Pending[next] = FALSE;
+
+        if (!GetOverlappedResult (pump -> HidDevice -> HidDevice,
+                                  &pump -> Overlap[next],
+                                  &bytesRead,
+                                  FALSE) ||
+            bytesRead != reportLength)
+        {
+            //
+            // Most likely the device went away
+            //
+
+            InterlockedIncrement(&pump -> ReadErrors);
+            pump -> Failed = TRUE;
+            break;
+        }
+
+        PumpQueueReport (pump,
+                         pump -> ReadBuffers + (next * reportLength),
+                         now.QuadPart);
+
+        if (!PumpIssueRead (pump, next))
+        {
+            InterlockedIncrement(&pump -> ReadErrors);
+            pump -> Failed = TRUE;
+            break;
+        }
+
+        next = (next + 1) % pump -> NumberOfReads;
+    }
+
+Cancel:
+
+    //
+    // CancelIo only cancels the reads issued by this thread, which are all
+    //  of them.  Wait for each to complete before the buffers are freed.
+    //
+
+    CancelIo (pump -> HidDevice -> HidDevice);
+
+    for (Index = 0; Index < pump -> NumberOfReads; Index++)
+    {
+        if (pump -> Pending[Index])
+        {
+            GetOverlappedResult (pump -> HidDevice -> HidDevice,
+                                 &pump -> Overlap[Index],
+                                 &bytesRead,
+                                 TRUE);
+            pump -> Pending[Index] = FALSE;
+        }
+    }
+
+    //
+    // Wake up the consumer so it notices the pump stopped
+    //
+
+    SetEvent(pump -> ReportEvent);
+    return (0);
+}
+
+BOOLEAN
+StartInputPump (
+    PHID_DEVICE     HidDevice,
+    ULONG           NumberOfReads,
+    PHID_INPUT_PUMP Pump
+   )
+/*++
+RoutineDescription:
+   Given a struct _HID_DEVICE opened for overlapped I/O, start a thread that
+   keeps NumberOfReads reads outstanding on it and queues the reports in the
+   pump's ring.  Use PopInputReports to consume them and StopInputPump when
+   done.
+--*/
+{
+    DWORD       reportLength;
+    ULONG       Index;
+
+    memset(Pump, 0, sizeof(HID_INPUT_PUMP));
+
+    reportLength = HidDevice -> Caps.InputReportByteLength;
+
+    if (0 == reportLength || !HidDevice -> OpenedOverlapped)
+    {
+        return (FALSE);
+    }
+
+    Pump -> HidDevice = HidDevice;
+    Pump -> NumberOfReads = max(1, min(NumberOfReads, HID_PUMP_MAX_READS));
+
+    Pump -> ReadBuffers = (PCHAR) calloc (Pump -> NumberOfReads, reportLength);
+    Pump -> RingReports = (PCHAR) calloc (HID_PUMP_RING_SIZE, reportLength);
+    Pump -> ReportEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    if (NULL == Pump -> ReadBuffers ||
+        NULL == Pump -> RingReports ||
+        NULL == Pump -> ReportEvent)
+    {
+        goto Error;
+    }
+
+    for (Index = 0; Index < Pump -> NumberOfReads; Index++)
+    {
+        Pump -> Overlap[Index].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+        if (NULL == Pump -> Overlap[Index].hEvent)
+        {
+            goto Error;
+        }
+    }
+
+    QueryPerformanceFrequency(&Pump -> Frequency);
+    QueryPerformanceCounter((PLARGE_INTEGER) &Pump -> StartTime);
+
+    Pump -> Thread = CreateThread(NULL,
+                                  0,
+                                  InputPumpThreadProc,
+                                  Pump,
+                                  0,
+                                  NULL);
+
+    if (NULL == Pump -> Thread)
+    {
+        goto Error;
+    }
+
+    return (TRUE);
+
+Error:
+    StopInputPump (Pump);
+    return (FALSE);
+}
+
+VOID
+StopInputPump (
+    PHID_INPUT_PUMP Pump
+   )
+/*++
+RoutineDescription:
+   Stop the pump thread, cancelling its outstanding reads, and free the
+   pump's resources.  Reports still in the ring are discarded.
+--*/
+{
+    ULONG       Index;
+
+    if (NULL != Pump -> Thread)
+    {
+        Pump -> Terminate = TRUE;
+        WaitForSingleObject(Pump -> Thread, INFINITE);
+        CloseHandle(Pump -> Thread);
+        Pump -> Thread = NULL;
+    }
+
+    for (Index = 0; Index < HID_PUMP_MAX_READS; Index++)
+    {
+        if (NULL != Pump -> Overlap[Index].hEvent)
+        {
+            CloseHandle(Pump -> Overlap[Index].hEvent);
+            Pump -> Overlap[Index].hEvent = NULL;
+        }
+    }
+
+    if (NULL != Pump -> ReportEvent)
+    {
+        CloseHandle(Pump -> ReportEvent);
+        Pump -> ReportEvent = NULL;
+    }
+
+    if (NULL != Pump -> ReadBuffers)
+    {
+        free(Pump -> ReadBuffers);
+        Pump -> ReadBuffers = NULL;
+    }
+
+    if (NULL != Pump -> RingReports)
+    {
+        free(Pump -> RingReports);
+        Pump -> RingReports = NULL;
+    }
+}
+
+ULONG
+PopInputReports (
+    PHID_INPUT_PUMP Pump,
+    _Out_writes_bytes_(MaxReports * Pump->HidDevice->Caps.InputReportByteLength) PCHAR Reports,
+    _Out_writes_opt_(MaxReports) PLONGLONG Timestamps,
+    ULONG           MaxReports
+   )
+/*++
+RoutineDescription:
+   Copy up to MaxReports of the oldest queued reports, and optionally the
+   time their reads completed, out of the pump's ring.  Returns the number of
+   reports copied.  Must only be called by a single consumer thread.
+--*/
+{
+    DWORD       reportLength;
+    LONG        head;
+    LONG        tail;
+    ULONG       numReports;
+    ULONG       Index;
+
+    reportLength = Pump -> HidDevice -> Caps.InputReportByteLength;
+
+    head = Pump -> RingHead;
+    MemoryBarrier();
+    tail = Pump -> RingTail;
+
+    numReports = min((ULONG) (head - tail), MaxReports);
+
+    for (Index = 0; Index < numReports; Index++, tail++)
+    {
+        memcpy(Reports + (Index * reportLength),
+               Pump -> RingReports + ((tail & (HID_PUMP_RING_SIZE - 1)) * reportLength),
+               reportLength);
+
+        if (NULL != Timestamps)
+        {
+            Timestamps[Index] = Pump -> RingTimestamps[tail & (HID_PUMP_RING_SIZE - 1)];
+        }
+    }
+
+    //
+    // Hand the entries back to the pump only once they are copied
+    //
+
+    InterlockedExchange(&Pump -> RingTail, tail);
+
+    return (numReports);
+}
+
+VOID
+GetInputPumpStatistics (
+    PHID_INPUT_PUMP      Pump,
+    PHID_PUMP_STATISTICS Statistics
+   )
+/*++
+RoutineDescription:
+   Take a snapshot of the pump's counters.  The average rate is computed
+   over the time since the pump was started.
+--*/
+{
+    LARGE_INTEGER   now;
+    LONGLONG        elapsed;
+
+    memset(Statistics, 0, sizeof(HID_PUMP_STATISTICS));
+
+    Statistics -> ReportsReceived = Pump -> ReportsReceived;
+    Statistics -> ReportsDropped = Pump -> ReportsDropped;
+    Statistics -> ReadErrors = Pump -> ReadErrors;
+    Statistics -> MeanIntervalUs = Pump -> MeanIntervalUs;
+    Statistics -> JitterUs = Pump -> JitterUs;
+
+    QueryPerformanceCounter(&now);
+    elapsed = now.QuadPart - Pump -> StartTime;
+
+    if (elapsed > 0)
+    {
+        Statistics -> ReportsPerSecond = (ULONG) ((Statistics -> ReportsReceived *
+                                                   Pump -> Frequency.QuadPart) / elapsed);
+    }
+}
+
 BOOLEAN
 Write (
    PHID_DEVICE    HidDevice
@@ -172,15 +623,27 @@ RoutineDescription:
             /*
             // Package the report for this data structure.  PackReport will
             //    set the IsDataSet fields of this structure and any other
-            //    structures that it includes in the report with this structure
+            //    structures that it includes in the report with this structure,
+            //    and so will EncodeReport using the compiled decoder.
             */
 
-            PackReport (HidDevice->OutputReportBuffer,
-                     HidDevice->Caps.OutputReportByteLength,
-                     HidP_Output,
-                     pData,
-                     HidDevice->OutputDataLength - Index,
-                     HidDevice->Ppd);
+            if (NULL != HidDevice -> OutputDecoder)
+            {
+                EncodeReport (HidDevice->OutputDecoder,
+                              (UCHAR) pData->ReportID,
+                              HidDevice->OutputReportBuffer,
+                              HidDevice->Caps.OutputReportByteLength,
+                              HidDevice->Ppd);
+            }
+            else
+            {
+                PackReport (HidDevice->OutputReportBuffer,
+                         HidDevice->Caps.OutputReportByteLength,
+                         HidP_Output,
+                         pData,
+                         HidDevice->OutputDataLength - Index,
+                         HidDevice->Ppd);
+            }
 
             /*
             // Now a report has been packaged up...Send it down to the device
@@ -242,15 +705,27 @@ pack it into multiple reports and send it to the hid device via HidD_SetFeature(
             /*
             // Package the report for this data structure.  PackReport will
             //    set the IsDataSet fields of this structure and any other 
-            //    structures that it includes in the report with this structure
+            //    structures that it includes in the report with this structure,
+            //    and so will EncodeReport using the compiled decoder.
             */
 
-            PackReport (HidDevice->FeatureReportBuffer,
-                     HidDevice->Caps.FeatureReportByteLength,
-                     HidP_Feature,
-                     pData,
-                     HidDevice->FeatureDataLength - Index,
-                     HidDevice->Ppd);
+            if (NULL != HidDevice -> FeatureDecoder)
+            {
+                EncodeReport (HidDevice->FeatureDecoder,
+                              (UCHAR) pData->ReportID,
+                              HidDevice->FeatureReportBuffer,
+                              HidDevice->Caps.FeatureReportByteLength,
+                              HidDevice->Ppd);
+            }
+            else
+            {
+                PackReport (HidDevice->FeatureReportBuffer,
+                         HidDevice->Caps.FeatureReportByteLength,
+                         HidP_Feature,
+                         pData,
+                         HidDevice->FeatureDataLength - Index,
+                         HidDevice->Ppd);
+            }
 
             /*
             // Now a report has been packaged up...Send it down to the device
@@ -331,12 +806,10 @@ RoutineDescription:
 
             if (FeatureStatus) 
             {
-                FeatureStatus = UnpackReport ( HidDevice->FeatureReportBuffer,
-                                           HidDevice->Caps.FeatureReportByteLength,
-                                           HidP_Feature,
-                                           HidDevice->FeatureData,
-                                           HidDevice->FeatureDataLength,
-                                           HidDevice->Ppd);
+                FeatureStatus = UnpackDeviceReport ( HidDevice,
+                                                 HidP_Feature,
+                                                 HidDevice->FeatureReportBuffer,
+                                                 HidDevice->Caps.FeatureReportByteLength);
             }
 
             Status = Status && FeatureStatus;
@@ -363,11 +836,8 @@ Routine Description:
    in the Data list from the given report.
 --*/
 {
-    ULONG       numUsages; // Number of usages returned from GetUsages.
     ULONG       i;
     UCHAR       reportID;
-    ULONG       Index;
-    ULONG       nextUsage;
     BOOLEAN     result = FALSE;
 
     reportID = ReportBuffer[0];
@@ -376,102 +846,14 @@ Routine Description:
     {
         if (reportID == Data->ReportID) 
         {
-            if (Data->IsButtonData) 
+            if (!UnpackData (ReportBuffer,
+                             ReportBufferLength,
+                             ReportType,
+                             Data,
+                             Ppd))
             {
-                numUsages = Data->ButtonData.MaxUsageLength;
-
-                Data->Status = HidP_GetUsages (ReportType,
-                                               Data->UsagePage,
-                                               0, // All collections
-                                               Data->ButtonData.Usages,
-                                               &numUsages,
-                                               Ppd,
-                                               ReportBuffer,
-                                               ReportBufferLength);
-
-                if (HIDP_STATUS_SUCCESS != Data->Status)
-                {
-                    goto Done;
-                }
-                
-                //
-                // Get usages writes the list of usages into the buffer
-                // Data->ButtonData.Usages newUsage is set to the number of usages
-                // written into this array.
-                // A usage cannot not be defined as zero, so we'll mark a zero
-                // following the list of usages to indicate the end of the list of
-                // usages
-                //
-                // NOTE: One anomaly of the GetUsages function is the lack of ability
-                //        to distinguish the data for one ButtonCaps from another
-                //        if two different caps structures have the same UsagePage
-                //        For instance:
-                //          Caps1 has UsagePage 07 and UsageRange of 0x00 - 0x167
-                //          Caps2 has UsagePage 07 and UsageRange of 0xe0 - 0xe7
-                //
-                //        However, calling GetUsages for each of the data structs
-                //          will return the same list of usages.  It is the 
-                //          responsibility of the caller to set in the HID_DEVICE
-                //          structure which usages actually are valid for the
-                //          that structure. 
-                //      
-
-                /*
-                // Search through the usage list and remove those that 
-                //    correspond to usages outside the define ranged for this
-                //    data structure.
-                */
-                
-                for (Index = 0, nextUsage = 0; Index < numUsages; Index++) 
-                {
-                    if (Data -> ButtonData.UsageMin <= Data -> ButtonData.Usages[Index] &&
-                            Data -> ButtonData.Usages[Index] <= Data -> ButtonData.UsageMax) 
-                    {
-                        Data -> ButtonData.Usages[nextUsage++] = Data -> ButtonData.Usages[Index];
-                        
-                    }
-                }
-
-                if (nextUsage < Data -> ButtonData.MaxUsageLength) 
-                {
-                    Data->ButtonData.Usages[nextUsage] = 0;
-                }
+                goto Done;
             }
-            else 
-            {
-                Data->Status = HidP_GetUsageValue (
-                                                ReportType,
-                                                Data->UsagePage,
-                                                0,               // All Collections.
-                                                Data->ValueData.Usage,
-                                                &Data->ValueData.Value,
-                                                Ppd,
-                                                ReportBuffer,
-                                                ReportBufferLength);
-
-                if (HIDP_STATUS_SUCCESS != Data->Status)
-                {
-                    goto Done;
-                }
-
-                Data->Status = HidP_GetScaledUsageValue (
-                                                       ReportType,
-                                                       Data->UsagePage,
-                                                       0, // All Collections.
-                                                       Data->ValueData.Usage,
-                                                       &Data->ValueData.ScaledValue,
-                                                       Ppd,
-                                                       ReportBuffer,
-                                                       ReportBufferLength);
-
-                if (HIDP_STATUS_SUCCESS != Data->Status &&
-                    HIDP_STATUS_NULL != Data->Status)
-                {
-                    goto Done;
-                }
-
-            } 
-            Data -> IsDataSet = TRUE;
         }
     }
 
@@ -481,18 +863,140 @@ Done:
     return (result);
 }
 
-
-BOOLEAN
-PackReport (
-   _Out_writes_bytes_(ReportBufferLength)PCHAR ReportBuffer,
-   IN  USHORT               ReportBufferLength,
-   IN  HIDP_REPORT_TYPE     ReportType,
-   IN  PHID_DATA            Data,
-   IN  ULONG                DataLength,
-   IN  PHIDP_PREPARSED_DATA Ppd
-   )
-/*++
-Routine Description:
+static BOOLEAN
+UnpackData (
+   _In_reads_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN       USHORT               ReportBufferLength,
+   IN       HIDP_REPORT_TYPE     ReportType,
+   IN OUT   PHID_DATA            Data,
+   IN       PHIDP_PREPARSED_DATA Ppd
+)
+/*++
+Routine Description:
+   Extract a single HID_DATA from the given report using the HidP_ functions.
+--*/
+{
+    ULONG       numUsages; // Number of usages returned from GetUsages.
+    ULONG       Index;
+    ULONG       nextUsage;
+    BOOLEAN     result = FALSE;
+
+    if (Data->IsButtonData) 
+    {
+        numUsages = Data->ButtonData.MaxUsageLength;
+
+        Data->Status = HidP_GetUsages (ReportType,
+                                       Data->UsagePage,
+                                       0, // All collections
+                                       Data->ButtonData.Usages,
+                                       &numUsages,
+                                       Ppd,
+                                       ReportBuffer,
+                                       ReportBufferLength);
+
+        if (HIDP_STATUS_SUCCESS != Data->Status)
+        {
+            goto Done;
+        }
+        
+        //
+        // Get usages writes the list of usages into the buffer
+        // Data->ButtonData.Usages newUsage is set to the number of usages
+        // written into this array.
+        // A usage cannot not be defined as zero, so we'll mark a zero
+        // following the list of usages to indicate the end of the list of
+        // usages
+        //
+        // NOTE: One anomaly of the GetUsages function is the lack of ability
+        //        to distinguish the data for one ButtonCaps from another
+        //        if two different caps structures have the same UsagePage
+        //        For instance:
+        //          Caps1 has UsagePage 07 and UsageRange of 0x00 - 0x167
+        //          Caps2 has UsagePage 07 and UsageRange of 0xe0 - 0xe7
+        //
+        //        However, calling GetUsages for each of the data structs
+        //          will return the same list of usages.  It is the 
+        //          responsibility of the caller to set in the HID_DEVICE
+        //          structure which usages actually are valid for the
+        //          that structure. 
+        //      
+
+        /*
+        // Search through the usage list and remove those that 
+        //    correspond to usages outside the define ranged for this
+        //    data structure.
+        */
+        
+        for (Index = 0, nextUsage = 0; Index < numUsages; Index++) 
+        {
+            if (Data -> ButtonData.UsageMin <= Data -> ButtonData.Usages[Index] &&
+                    Data -> ButtonData.Usages[Index] <= Data -> ButtonData.UsageMax) 
+            {
+                Data -> ButtonData.Usages[nextUsage++] = Data -> ButtonData.Usages[Index];
+                
+            }
+        }
+
+        if (nextUsage < Data -> ButtonData.MaxUsageLength) 
+        {
+            Data->ButtonData.Usages[nextUsage] = 0;
+        }
+    }
+    else 
+    {
+        Data->Status = HidP_GetUsageValue (
+                                        ReportType,
+                                        Data->UsagePage,
+                                        0,               // All Collections.
+                                        Data->ValueData.Usage,
+                                        &Data->ValueData.Value,
+                                        Ppd,
+                                        ReportBuffer,
+                                        ReportBufferLength);
+
+        if (HIDP_STATUS_SUCCESS != Data->Status)
+        {
+            goto Done;
+        }
+
+        Data->Status = HidP_GetScaledUsageValue (
+                                               ReportType,
+                                               Data->UsagePage,
+                                               0, // All Collections.
+                                               Data->ValueData.Usage,
+                                               &Data->ValueData.ScaledValue,
+                                               Ppd,
+                                               ReportBuffer,
+                                               ReportBufferLength);
+
+        if (HIDP_STATUS_SUCCESS != Data->Status &&
+            HIDP_STATUS_NULL != Data->Status)
+        {
+            goto Done;
+        }
+
+    } 
+
+    Data -> IsDataSet = TRUE;
+
+    result = TRUE;
+
+Done:
+    return (result);
+}
+
+
+BOOLEAN
+PackReport (
+   _Out_writes_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN  USHORT               ReportBufferLength,
+   IN  HIDP_REPORT_TYPE     ReportType,
+   IN  PHID_DATA            Data,
+   IN  ULONG                DataLength,
+   IN  PHIDP_PREPARSED_DATA Ppd
+   )
+/*++
+Routine Description:
    This routine takes in a list of HID_DATA structures (DATA) and builds 
       in ReportBuffer the given report for all data values in the list that 
       correspond to the report ID of the first item in the list.  
@@ -509,7 +1013,6 @@ Routine Description:
       ID were set without error.
 --*/
 {
-    ULONG       numUsages; // Number of usages to set for a given report.
     ULONG       i;
     ULONG       CurrReportID;
     BOOLEAN     result = FALSE;
@@ -546,31 +1049,11 @@ Routine Description:
 
         if (Data -> ReportID == CurrReportID) 
         {
-            if (Data->IsButtonData) 
-            {
-                numUsages = Data->ButtonData.MaxUsageLength;
-                Data->Status = HidP_SetUsages (ReportType,
-                                               Data->UsagePage,
-                                               0, // All collections
-                                               Data->ButtonData.Usages,
-                                               &numUsages,
-                                               Ppd,
-                                               ReportBuffer,
-                                               ReportBufferLength);
-            }
-            else
-            {
-                Data->Status = HidP_SetUsageValue (ReportType,
-                                                   Data->UsagePage,
-                                                   0, // All Collections.
-                                                   Data->ValueData.Usage,
-                                                   Data->ValueData.Value,
-                                                   Ppd,
-                                                   ReportBuffer,
-                                                   ReportBufferLength);
-            }
-
-            if (HIDP_STATUS_SUCCESS != Data->Status)
+            if (!PackData (ReportBuffer,
+                           ReportBufferLength,
+                           ReportType,
+                           Data,
+                           Ppd))
             {
                 goto Done;
             }
@@ -599,3 +1082,875 @@ Done:
     return result;
 }
 
+
+static BOOLEAN
+PackData (
+   _Inout_updates_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN       USHORT               ReportBufferLength,
+   IN       HIDP_REPORT_TYPE     ReportType,
+   IN OUT   PHID_DATA            Data,
+   IN       PHIDP_PREPARSED_DATA Ppd
+)
+/*++
+Routine Description:
+   Set a single HID_DATA in the given report using the HidP_ functions.
+--*/
+{
+    ULONG       numUsages; // Number of usages to set for a given report.
+
+    if (Data->IsButtonData) 
+    {
+        numUsages = Data->ButtonData.MaxUsageLength;
+        Data->Status = HidP_SetUsages (ReportType,
+                                       Data->UsagePage,
+                                       0, // All collections
+                                       Data->ButtonData.Usages,
+                                       &numUsages,
+                                       Ppd,
+                                       ReportBuffer,
+                                       ReportBufferLength);
+    }
+    else
+    {
+        Data->Status = HidP_SetUsageValue (ReportType,
+                                           Data->UsagePage,
+                                           0, // All Collections.
+                                           Data->ValueData.Usage,
+                                           Data->ValueData.Value,
+                                           Ppd,
+                                           ReportBuffer,
+                                           ReportBufferLength);
+    }
+
+    return (HIDP_STATUS_SUCCESS == Data->Status);
+}
+
+BOOLEAN
+UnpackDeviceReport (
+   IN       PHID_DEVICE          HidDevice,
+   IN       HIDP_REPORT_TYPE     ReportType,
+   _In_reads_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN       USHORT               ReportBufferLength
+)
+/*++
+Routine Description:
+   Unpack a report of the given type into the matching HID_DATA array of the
+   device, using the device's compiled decoder for that report type if it
+   has one and the HidP_ functions otherwise.
+--*/
+{
+    PHID_REPORT_DECODER decoder;
+    PHID_DATA           data;
+    ULONG               dataLength;
+
+    switch (ReportType)
+    {
+    case HidP_Input:
+        decoder = HidDevice -> InputDecoder;
+        data = HidDevice -> InputData;
+        dataLength = HidDevice -> InputDataLength;
+        break;
+
+    case HidP_Output:
+        decoder = HidDevice -> OutputDecoder;
+        data = HidDevice -> OutputData;
+        dataLength = HidDevice -> OutputDataLength;
+        break;
+
+    default:
+        decoder = HidDevice -> FeatureDecoder;
+        data = HidDevice -> FeatureData;
+        dataLength = HidDevice -> FeatureDataLength;
+        break;
+    }
+
+    if (NULL != decoder)
+    {
+        return (DecodeReport (decoder, ReportBuffer, ReportBufferLength, HidDevice -> Ppd));
+    }
+
+    return (UnpackReport (ReportBuffer,
+                          ReportBufferLength,
+                          ReportType,
+                          data,
+                          dataLength,
+                          HidDevice -> Ppd));
+}
+
+static ULONG
+ExtractBits (
+   _In_ const UCHAR *Report,
+   IN       ULONG                BitOffset,
+   IN       ULONG                BitSize
+)
+/*++
+Routine Description:
+   Return the BitSize bits of the report starting at BitOffset.  Fields are
+   little endian, with bit 0 being the least significant bit of byte 0.
+--*/
+{
+    ULONGLONG   bits = 0;
+    ULONG       first = BitOffset >> 3;
+    ULONG       Index;
+
+    for (Index = (BitOffset + BitSize - 1) >> 3; Index >= first; Index--)
+    {
+        bits = (bits << 8) | Report[Index];
+
+        if (0 == Index)
+        {
+            break;
+        }
+    }
+
+    return ((ULONG) (bits >> (BitOffset & 7)) & HID_FIELD_MASK(BitSize));
+}
+
+static VOID
+InsertBits (
+   _Inout_ PUCHAR Report,
+   IN       ULONG                BitOffset,
+   IN       ULONG                BitSize,
+   IN       ULONG                Value
+)
+/*++
+Routine Description:
+   Store the low BitSize bits of Value in the report starting at BitOffset.
+--*/
+{
+    ULONGLONG   mask;
+    ULONGLONG   bits;
+    ULONG       last = (BitOffset + BitSize - 1) >> 3;
+    ULONG       Index;
+
+    mask = ((ULONGLONG) HID_FIELD_MASK(BitSize)) << (BitOffset & 7);
+    bits = ((ULONGLONG) (Value & HID_FIELD_MASK(BitSize))) << (BitOffset & 7);
+
+    for (Index = BitOffset >> 3; Index <= last; Index++)
+    {
+        Report[Index] = (UCHAR) ((Report[Index] & ~(UCHAR) mask) | (UCHAR) bits);
+        mask >>= 8;
+        bits >>= 8;
+    }
+}
+
+static NTSTATUS
+ScaleValue (
+   IN       PHID_ITEM            Item,
+   IN       ULONG                BitSize,
+   IN       ULONG                Value,
+   OUT      PLONG                ScaledValue
+)
+/*++
+Routine Description:
+   Convert the raw value of a field into its physical value, the way
+   HidP_GetScaledUsageValue does.  ScaledValue is only written if the value
+   is in the logical range of the field.
+--*/
+{
+    LONGLONG    value;
+
+    value = Value;
+
+    if (Item -> IsSigned && (Value & (1UL << (BitSize - 1))))
+    {
+        value = (LONGLONG) (LONG) (Value | ~HID_FIELD_MASK(BitSize));
+    }
+
+    if (value < Item -> LogicalMin || value > Item -> LogicalMax)
+    {
+        return (Item -> HasNull ? HIDP_STATUS_NULL : HIDP_STATUS_VALUE_OUT_OF_RANGE);
+    }
+
+    if (Item -> LogicalMin >= Item -> LogicalMax ||
+        Item -> PhysicalMin >= Item -> PhysicalMax)
+    {
+        return (HIDP_STATUS_BAD_LOG_PHY_VALUES);
+    }
+
+    *ScaledValue = (LONG) (((value - Item -> LogicalMin) *
+                            ((LONGLONG) Item -> PhysicalMax - Item -> PhysicalMin)) /
+                           ((LONGLONG) Item -> LogicalMax - Item -> LogicalMin) +
+                           Item -> PhysicalMin);
+
+    return (HIDP_STATUS_SUCCESS);
+}
+
+static BOOLEAN
+FindProbeBits (
+   IN       PHID_REPORT_DECODER  Decoder,
+   _In_reads_bytes_(Decoder->ReportLength) const UCHAR *Probe,
+   OUT      PULONG               BitOffset,
+   OUT      PULONG               BitSize
+)
+/*++
+Routine Description:
+   Locate the bits a HidP_SetXxx call set in an otherwise empty report.
+   Succeeds only if they form a single run of at most 32 bits.
+--*/
+{
+    ULONG       bit;
+    ULONG       first = 0;
+    ULONG       count = 0;
+    BOOLEAN     ended = FALSE;
+
+    //
+    // The first byte holds the report ID, which the probe has already set
+    //
+
+    for (bit = 8; bit < (ULONG) Decoder -> ReportLength * 8; bit++)
+    {
+        if (Probe[bit >> 3] & (1 << (bit & 7)))
+        {
+            if (ended)
+            {
+                return (FALSE);
+            }
+
+            if (0 == count)
+            {
+                first = bit;
+            }
+            count++;
+        }
+        else if (0 != count)
+        {
+            ended = TRUE;
+        }
+    }
+
+    if (0 == count || count > 32)
+    {
+        return (FALSE);
+    }
+
+    *BitOffset = first;
+    *BitSize = count;
+    return (TRUE);
+}
+
+static BOOLEAN
+CompileButtonItem (
+   IN       PHID_REPORT_DECODER  Decoder,
+   IN       PHID_ITEM            Item,
+   _In_reads_(NumberButtonCaps) PHIDP_BUTTON_CAPS ButtonCaps,
+   IN       USHORT               NumberButtonCaps,
+   _Inout_updates_bytes_(Decoder->ReportLength) PCHAR Probe,
+   IN       PHIDP_PREPARSED_DATA Ppd
+)
+/*++
+Routine Description:
+   Find the bit of every usage in the range of a button HID_DATA by setting
+   each usage alone in an empty report.  Only variable fields can be
+   compiled this way; array fields report usages as indexes.
+--*/
+{
+    PHID_DATA   data = Item -> Data;
+    PHID_FIELD  field;
+    ULONG       Index;
+    ULONG       usage;
+    USAGE       usageToSet;
+    ULONG       numUsages;
+    ULONG       bitOffset;
+    ULONG       bitSize;
+    NTSTATUS    status;
+
+    for (Index = 0; Index < NumberButtonCaps; Index++)
+    {
+        if (ButtonCaps[Index].ReportID == data -> ReportID &&
+            ButtonCaps[Index].UsagePage == data -> UsagePage &&
+            !(ButtonCaps[Index].BitField & HID_MAIN_ITEM_VARIABLE))
+        {
+            return (FALSE);
+        }
+    }
+
+    if (data -> ButtonData.UsageMax - data -> ButtonData.UsageMin >= HID_MAX_BUTTON_FIELDS)
+    {
+        return (FALSE);
+    }
+
+    for (usage = data -> ButtonData.UsageMin; usage <= data -> ButtonData.UsageMax; usage++)
+    {
+        memset (Probe, 0, Decoder -> ReportLength);
+        Probe[0] = (CHAR) data -> ReportID;
+
+        usageToSet = (USAGE) usage;
+        numUsages = 1;
+
+        status = HidP_SetUsages (Decoder -> ReportType,
+                                 data -> UsagePage,
+                                 0, // All collections
+                                 &usageToSet,
+                                 &numUsages,
+                                 Ppd,
+                                 Probe,
+                                 Decoder -> ReportLength);
+
+        //
+        // Usages of the range that are not in this report are never reported
+        //
+
+        if (HIDP_STATUS_USAGE_NOT_FOUND == status ||
+            HIDP_STATUS_INCOMPATIBLE_REPORT_ID == status)
+        {
+            continue;
+        }
+
+        if (HIDP_STATUS_SUCCESS != status ||
+            !FindProbeBits (Decoder, (PUCHAR) Probe, &bitOffset, &bitSize) ||
+            1 != bitSize)
+        {
+            return (FALSE);
+        }
+
+        field = &Decoder -> Fields[Decoder -> FieldCount++];
+        field -> BitOffset = bitOffset;
+        field -> BitSize = 1;
+        field -> Usage = usageToSet;
+    }
+
+    return (TRUE);
+}
+
+static BOOLEAN
+CompileValueItem (
+   IN       PHID_REPORT_DECODER  Decoder,
+   IN       PHID_ITEM            Item,
+   _In_reads_(NumberValueCaps) PHIDP_VALUE_CAPS ValueCaps,
+   IN       USHORT               NumberValueCaps,
+   _Inout_updates_bytes_(Decoder->ReportLength) PCHAR Probe,
+   IN       PHIDP_PREPARSED_DATA Ppd
+)
+/*++
+Routine Description:
+   Find the field of a value HID_DATA by setting it to all ones in an empty
+   report, then check that ScaleValue gives the same results as
+   HidP_GetScaledUsageValue at the edges and middle of its range.
+--*/
+{
+    PHID_DATA           data = Item -> Data;
+    PHIDP_VALUE_CAPS    caps = NULL;
+    PHID_FIELD          field;
+    ULONG               Index;
+    ULONG               bitOffset;
+    ULONG               bitSize;
+    ULONG               mask;
+    ULONG               probeValues[6];
+    LONG                expected;
+    LONG                scaled;
+    NTSTATUS            expectedStatus;
+    NTSTATUS            status;
+
+    for (Index = 0; Index < NumberValueCaps; Index++)
+    {
+        if (ValueCaps[Index].ReportID == data -> ReportID &&
+            ValueCaps[Index].UsagePage == data -> UsagePage &&
+            (ValueCaps[Index].IsRange ?
+                (ValueCaps[Index].Range.UsageMin <= data -> ValueData.Usage &&
+                 data -> ValueData.Usage <= ValueCaps[Index].Range.UsageMax) :
+                (ValueCaps[Index].NotRange.Usage == data -> ValueData.Usage)))
+        {
+            caps = &ValueCaps[Index];
+            break;
+        }
+    }
+
+    //
+    // Value arrays are only available through HidP_GetUsageValueArray
+    //
+
+    if (NULL == caps ||
+        0 == caps -> BitSize ||
+        caps -> BitSize > 32 ||
+        (!caps -> IsRange && caps -> ReportCount > 1))
+    {
+        return (FALSE);
+    }
+
+    mask = HID_FIELD_MASK(caps -> BitSize);
+
+    memset (Probe, 0, Decoder -> ReportLength);
+    Probe[0] = (CHAR) data -> ReportID;
+
+    status = HidP_SetUsageValue (Decoder -> ReportType,
+                                 data -> UsagePage,
+                                 0, // All Collections.
+                                 data -> ValueData.Usage,
+                                 mask,
+                                 Ppd,
+                                 Probe,
+                                 Decoder -> ReportLength);
+
+    if (HIDP_STATUS_SUCCESS != status ||
+        !FindProbeBits (Decoder, (PUCHAR) Probe, &bitOffset, &bitSize) ||
+        caps -> BitSize != bitSize)
+    {
+        return (FALSE);
+    }
+
+    Item -> IsSigned = (caps -> LogicalMin < 0);
+    Item -> HasNull = caps -> HasNull;
+    Item -> LogicalMin = caps -> LogicalMin;
+    Item -> LogicalMax = caps -> LogicalMax;
+    Item -> PhysicalMin = caps -> PhysicalMin;
+    Item -> PhysicalMax = caps -> PhysicalMax;
+
+    probeValues[0] = 0;
+    probeValues[1] = 1;
+    probeValues[2] = mask;
+    probeValues[3] = (ULONG) caps -> LogicalMin & mask;
+    probeValues[4] = (ULONG) caps -> LogicalMax & mask;
+    probeValues[5] = (ULONG) (caps -> LogicalMin +
+                              ((LONGLONG) caps -> LogicalMax - caps -> LogicalMin) / 2) & mask;
+
+    for (Index = 0; Index < sizeof (probeValues) / sizeof (probeValues[0]); Index++)
+    {
+        memset (Probe, 0, Decoder -> ReportLength);
+        Probe[0] = (CHAR) data -> ReportID;
+
+        status = HidP_SetUsageValue (Decoder -> ReportType,
+                                     data -> UsagePage,
+                                     0, // All Collections.
+                                     data -> ValueData.Usage,
+                                     probeValues[Index],
+                                     Ppd,
+                                     Probe,
+                                     Decoder -> ReportLength);
+
+        if (HIDP_STATUS_SUCCESS != status)
+        {
+            return (FALSE);
+        }
+
+        expected = scaled = 0;
+
+        expectedStatus = HidP_GetScaledUsageValue (Decoder -> ReportType,
+                                                   data -> UsagePage,
+                                                   0, // All Collections.
+                                                   data -> ValueData.Usage,
+                                                   &expected,
+                                                   Ppd,
+                                                   Probe,
+                                                   Decoder -> ReportLength);
+
+        status = ScaleValue (Item, bitSize, probeValues[Index], &scaled);
+
+        if (expectedStatus != status ||
+            (HIDP_STATUS_SUCCESS == status && expected != scaled))
+        {
+            return (FALSE);
+        }
+    }
+
+    field = &Decoder -> Fields[Decoder -> FieldCount++];
+    field -> BitOffset = bitOffset;
+    field -> BitSize = (UCHAR) bitSize;
+    field -> Usage = data -> ValueData.Usage;
+
+    return (TRUE);
+}
+
+PHID_REPORT_DECODER
+CompileReportDecoder (
+   IN       HIDP_REPORT_TYPE     ReportType,
+   IN       USHORT               ReportLength,
+   _In_reads_(DataLength) PHID_DATA Data,
+   IN       ULONG                DataLength,
+   _In_reads_(NumberButtonCaps) PHIDP_BUTTON_CAPS ButtonCaps,
+   IN       USHORT               NumberButtonCaps,
+   _In_reads_(NumberValueCaps) PHIDP_VALUE_CAPS ValueCaps,
+   IN       USHORT               NumberValueCaps,
+   IN       PHIDP_PREPARSED_DATA Ppd
+)
+/*++
+Routine Description:
+   Build the report decoder for the given HID_DATA array of a device.  The
+   HidP_ functions are only used here, to locate each field by setting it in
+   an empty report; decoding reports afterwards is table driven.
+
+   Returns NULL if the decoder could not be allocated, in which case reports
+   should be unpacked with UnpackReport.  The HID_DATA array must outlive the
+   decoder.
+--*/
+{
+    PHID_REPORT_DECODER decoder = NULL;
+    PHID_ITEM           item;
+    PCHAR               probe = NULL;
+    ULONG               nextItem[HID_MAX_REPORT_IDS];
+    ULONG               maxFields;
+    ULONG               Index;
+    BOOLEAN             compiled;
+    BOOLEAN             result = FALSE;
+
+    if (0 == ReportLength || 0 == DataLength)
+    {
+        goto Done;
+    }
+
+    decoder = (PHID_REPORT_DECODER) calloc (1, sizeof (HID_REPORT_DECODER));
+    probe = (PCHAR) calloc (ReportLength, sizeof (CHAR));
+
+    if (NULL == decoder || NULL == probe)
+    {
+        goto Done;
+    }
+
+    decoder -> ReportType = ReportType;
+    decoder -> ReportLength = ReportLength;
+    decoder -> ItemCount = DataLength;
+
+    //
+    // Sort the items by report ID, and size the field table: one field per
+    //  button usage and one per value.
+    //
+
+    maxFields = 0;
+
+    for (Index = 0; Index < DataLength; Index++)
+    {
+        if (Data[Index].ReportID >= HID_MAX_REPORT_IDS)
+        {
+            goto Done;
+        }
+
+        decoder -> ReportStart[Data[Index].ReportID + 1]++;
+
+        if (Data[Index].IsButtonData)
+        {
+            maxFields += min (Data[Index].ButtonData.UsageMax - Data[Index].ButtonData.UsageMin + 1,
+                              HID_MAX_BUTTON_FIELDS);
+        }
+        else
+        {
+            maxFields++;
+        }
+    }
+
+    for (Index = 0; Index < HID_MAX_REPORT_IDS; Index++)
+    {
+        decoder -> ReportStart[Index + 1] += decoder -> ReportStart[Index];
+        nextItem[Index] = decoder -> ReportStart[Index];
+    }
+
+    decoder -> Items = (PHID_ITEM) calloc (DataLength, sizeof (HID_ITEM));
+    decoder -> Fields = (PHID_FIELD) calloc (maxFields, sizeof (HID_FIELD));
+
+    if (NULL == decoder -> Items || NULL == decoder -> Fields)
+    {
+        goto Done;
+    }
+
+    for (Index = 0; Index < DataLength; Index++)
+    {
+        decoder -> Items[nextItem[Data[Index].ReportID]++].Data = &Data[Index];
+    }
+
+    //
+    // Compile each item.  Items that cannot be compiled keep no fields and
+    //  are unpacked with the HidP_ functions.
+    //
+
+    for (Index = 0, item = decoder -> Items; Index < DataLength; Index++, item++)
+    {
+        item -> FirstField = decoder -> FieldCount;
+
+        if (item -> Data -> IsButtonData)
+        {
+            compiled = CompileButtonItem (decoder,
+                                          item,
+                                          ButtonCaps,
+                                          NumberButtonCaps,
+                                          probe,
+                                          Ppd);
+        }
+        else
+        {
+            compiled = CompileValueItem (decoder,
+                                         item,
+                                         ValueCaps,
+                                         NumberValueCaps,
+                                         probe,
+                                         Ppd);
+        }
+
+        if (!compiled)
+        {
+            decoder -> FieldCount = item -> FirstField;
+            continue;
+        }
+
+        item -> IsCompiled = TRUE;
+        item -> FieldCount = decoder -> FieldCount - item -> FirstField;
+        decoder -> CompiledCount++;
+    }
+
+    result = TRUE;
+
+Done:
+    if (NULL != probe)
+    {
+        free(probe);
+    }
+
+    if (!result && NULL != decoder)
+    {
+        FreeReportDecoder(decoder);
+        decoder = NULL;
+    }
+
+    return (decoder);
+}
+
+VOID
+FreeReportDecoder (
+   IN       PHID_REPORT_DECODER  Decoder
+)
+{
+    if (NULL == Decoder)
+    {
+        return;
+    }
+
+    if (NULL != Decoder -> Items)
+    {
+        free(Decoder -> Items);
+    }
+
+    if (NULL != Decoder -> Fields)
+    {
+        free(Decoder -> Fields);
+    }
+
+    free(Decoder);
+}
+
+BOOLEAN
+DecodeReport (
+   IN       PHID_REPORT_DECODER  Decoder,
+   _In_reads_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN       USHORT               ReportBufferLength,
+   IN       PHIDP_PREPARSED_DATA Ppd
+)
+/*++
+Routine Description:
+   Table driven equivalent of UnpackReport: extract all the HID_DATA of the
+   decoder that belong to the report ID in the first byte of ReportBuffer.
+   Only the items of that report ID are visited.
+--*/
+{
+    const UCHAR *report = (const UCHAR *) ReportBuffer;
+    PHID_ITEM   item;
+    PHID_ITEM   lastItem;
+    PHID_FIELD  field;
+    PHID_DATA   data;
+    ULONG       Index;
+    ULONG       numUsages;
+    BOOLEAN     result = FALSE;
+
+    if (ReportBufferLength < Decoder -> ReportLength)
+    {
+        goto Done;
+    }
+
+    item = &Decoder -> Items[Decoder -> ReportStart[report[0]]];
+    lastItem = &Decoder -> Items[Decoder -> ReportStart[report[0] + 1]];
+
+    for ( ; item < lastItem; item++)
+    {
+        data = item -> Data;
+
+        if (!item -> IsCompiled)
+        {
+            if (!UnpackData (ReportBuffer,
+                             ReportBufferLength,
+                             Decoder -> ReportType,
+                             data,
+                             Ppd))
+            {
+                goto Done;
+            }
+            continue;
+        }
+
+        field = &Decoder -> Fields[item -> FirstField];
+
+        if (data -> IsButtonData)
+        {
+            for (Index = 0, numUsages = 0; Index < item -> FieldCount; Index++, field++)
+            {
+                if ((report[field -> BitOffset >> 3] & (1 << (field -> BitOffset & 7))) &&
+                    numUsages < data -> ButtonData.MaxUsageLength)
+                {
+                    data -> ButtonData.Usages[numUsages++] = field -> Usage;
+                }
+            }
+
+            if (numUsages < data -> ButtonData.MaxUsageLength)
+            {
+                data -> ButtonData.Usages[numUsages] = 0;
+            }
+
+            data -> Status = HIDP_STATUS_SUCCESS;
+        }
+        else
+        {
+            data -> ValueData.Value = ExtractBits (report, field -> BitOffset, field -> BitSize);
+
+            data -> Status = ScaleValue (item,
+                                         field -> BitSize,
+                                         data -> ValueData.Value,
+                                         &data -> ValueData.ScaledValue);
+
+            if (HIDP_STATUS_SUCCESS != data -> Status &&
+                HIDP_STATUS_NULL != data -> Status)
+            {
+                goto Done;
+            }
+        }
+
+        data -> IsDataSet = TRUE;
+    }
+
+    result = TRUE;
+
+Done:
+    return (result);
+}
+
+ULONG
+DecodeReports (
+   IN       PHID_REPORT_DECODER  Decoder,
+   _In_reads_bytes_(ReportBufferLength * NumberReports)PCHAR Reports,
+   IN       USHORT               ReportBufferLength,
+   IN       ULONG                NumberReports,
+   IN       PHIDP_PREPARSED_DATA Ppd
+)
+/*++
+Routine Description:
+   Decode a batch of consecutive reports of ReportBufferLength bytes each,
+   such as the result of a ReadFile call with room for several reports.
+   The HID_DATA are left holding the values of the last report of each
+   report ID.  Returns the number of reports decoded without error.
+--*/
+{
+    ULONG       Index;
+    ULONG       numDecoded = 0;
+
+    for (Index = 0; Index < NumberReports; Index++, Reports += ReportBufferLength)
+    {
+        if (DecodeReport (Decoder, Reports, ReportBufferLength, Ppd))
+        {
+            numDecoded++;
+        }
+    }
+
+    return (numDecoded);
+}
+
+BOOLEAN
+EncodeReport (
+   IN       PHID_REPORT_DECODER  Decoder,
+   IN       UCHAR                ReportID,
+   _Out_writes_bytes_(ReportBufferLength)PCHAR ReportBuffer,
+   IN       USHORT               ReportBufferLength,
+   IN       PHIDP_PREPARSED_DATA Ppd
+)
+/*++
+Routine Description:
+   Table driven equivalent of PackReport: build in ReportBuffer the report
+   with the given ID from all the HID_DATA of the decoder that belong to it,
+   and mark those HID_DATA as set.
+--*/
+{
+    PUCHAR      report = (PUCHAR) ReportBuffer;
+    PHID_ITEM   item;
+    PHID_ITEM   firstItem;
+    PHID_ITEM   lastItem;
+    PHID_FIELD  field;
+    PHID_DATA   data;
+    ULONG       Index;
+    ULONG       fieldIndex;
+    BOOLEAN     result = FALSE;
+
+    memset (ReportBuffer, (UCHAR) 0, ReportBufferLength);
+
+    if (ReportBufferLength < Decoder -> ReportLength)
+    {
+        goto Done;
+    }
+
+    report[0] = ReportID;
+
+    firstItem = &Decoder -> Items[Decoder -> ReportStart[ReportID]];
+    lastItem = &Decoder -> Items[Decoder -> ReportStart[ReportID + 1]];
+
+    for (item = firstItem; item < lastItem; item++)
+    {
+        data = item -> Data;
+
+        if (item -> IsCompiled && data -> IsButtonData)
+        {
+            data -> Status = HIDP_STATUS_SUCCESS;
+
+            for (Index = 0; Index < data -> ButtonData.MaxUsageLength; Index++)
+            {
+                if (0 == data -> ButtonData.Usages[Index])
+                {
+                    continue;
+                }
+
+                field = &Decoder -> Fields[item -> FirstField];
+                for (fieldIndex = 0; fieldIndex < item -> FieldCount; fieldIndex++, field++)
+                {
+                    if (field -> Usage == data -> ButtonData.Usages[Index])
+                    {
+                        report[field -> BitOffset >> 3] |= (UCHAR) (1 << (field -> BitOffset & 7));
+                        break;
+                    }
+                }
+
+                //
+                // Let HidP_SetUsages report usages that are not in the report
+                //
+
+                if (fieldIndex == item -> FieldCount)
+                {
+                    data -> Status = HIDP_STATUS_USAGE_NOT_FOUND;
+                    break;
+                }
+            }
+
+            if (HIDP_STATUS_SUCCESS == data -> Status)
+            {
+                continue;
+            }
+        }
+        else if (item -> IsCompiled)
+        {
+            field = &Decoder -> Fields[item -> FirstField];
+            InsertBits (report, field -> BitOffset, field -> BitSize, data -> ValueData.Value);
+            data -> Status = HIDP_STATUS_SUCCESS;
+            continue;
+        }
+
+        if (!PackData (ReportBuffer,
+                       ReportBufferLength,
+                       Decoder -> ReportType,
+                       data,
+                       Ppd))
+        {
+            goto Done;
+        }
+    }
+
+    for (item = firstItem; item < lastItem; item++)
+    {
+        item -> Data -> IsDataSet = TRUE;
+    }
+
+    result = TRUE;
+
+Done:
+    return result;
+}
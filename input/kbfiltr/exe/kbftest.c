@@ -49,6 +49,75 @@ DEFINE_GUID(GUID_DEVINTERFACE_KBFILTER,
 0x3fb7299d, 0x6847, 0x4490, 0xb0, 0xc9, 0x99, 0xe0, 0x98, 0x6a, 0xb8, 0x86);
 // {3FB7299D-6847-4490-B0C9-99E0986AB886}
 
+//
+// How long to watch key events, and how often to collect them
+//
+#define KEY_EVENT_WATCH_TIME_MS     10000
+#define KEY_EVENT_POLL_INTERVAL_MS  100
+#define KEY_EVENTS_PER_REQUEST      64
+
+VOID
+WatchKeyEvents(
+    _In_ HANDLE file
+    )
+{
+    PKBFILTR_KEY_EVENTS keyEvents;
+    ULONG               length;
+    ULONG               bytes;
+    ULONG               elapsed;
+    ULONG               i;
+    ULONGLONG           lastTimestamp = 0;
+
+    length = FIELD_OFFSET(KBFILTR_KEY_EVENTS, Events) +
+             KEY_EVENTS_PER_REQUEST * sizeof(KBFILTR_KEY_EVENT);
+
+    keyEvents = malloc(length);
+    if (keyEvents == NULL) {
+        printf("Couldn't allocate %d bytes for key events.\n", length);
+        return;
+    }
+
+    printf("\nWatching key events for %d seconds, press some keys...\n",
+           KEY_EVENT_WATCH_TIME_MS / 1000);
+
+    for (elapsed = 0;
+         elapsed < KEY_EVENT_WATCH_TIME_MS;
+         elapsed += KEY_EVENT_POLL_INTERVAL_MS) {
+
+        if (!DeviceIoControl (file,
+                              IOCTL_KBFILTR_GET_KEY_EVENTS,
+                              NULL, 0,
+                              keyEvents, length,
+                              &bytes, NULL)) {
+            printf("Retrieve Key Events request failed:0x%x\n", GetLastError());
+            break;
+        }
+
+        if (keyEvents->Dropped) {
+            printf(" (%d key events dropped)\n", keyEvents->Dropped);
+        }
+
+        for (i = 0; i < keyEvents->Count; i++) {
+
+            //
+            // Timestamps are in 100ns units
+            //
+            printf(" Unit %d  MakeCode 0x%02x  %-5s  +%I64u us\n",
+                   keyEvents->Events[i].UnitId,
+                   keyEvents->Events[i].MakeCode,
+                   (keyEvents->Events[i].Flags & KEY_BREAK) ? "Break" : "Make",
+                   lastTimestamp ?
+                       (keyEvents->Events[i].Timestamp - lastTimestamp) / 10 : 0);
+
+            lastTimestamp = keyEvents->Events[i].Timestamp;
+        }
+
+        Sleep(KEY_EVENT_POLL_INTERVAL_MS);
+    }
+
+    free(keyEvents);
+}
+
 
 int
 _cdecl
@@ -229,6 +298,8 @@ main(
            kbdattrib.NumberOfIndicators,
            kbdattrib.NumberOfKeysTotal, 
            kbdattrib.InputDataQueueLength);
+
+    WatchKeyEvents(file);
     
     free (deviceInterfaceDetailData);
     CloseHandle(file);
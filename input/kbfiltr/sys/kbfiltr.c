@@ -228,6 +228,18 @@ Return Value:
 
     filterExt->rawPdoQueue = hQueue;
 
+    //
+    // Create the lock that serializes readers of the key event ring
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT(&deviceAttributes);
+    deviceAttributes.ParentObject = hDevice;
+
+    status = WdfSpinLockCreate(&deviceAttributes, &filterExt->KeyRingLock);
+    if (!NT_SUCCESS(status)) {
+        DebugPrint( ("WdfSpinLockCreate failed 0x%x\n", status));
+        return status;
+    }
+
     //
     // Create a RAW pdo so we can provide a sideband communication with
     // the application. Please note that not filter drivers desire to
@@ -324,6 +336,13 @@ Return Value:
         bytesTransferred = sizeof(KEYBOARD_ATTRIBUTES);
         
         break;    
+    case IOCTL_KBFILTR_GET_KEY_EVENTS:
+
+        status = KbFilter_GetKeyEvents(devExt,
+                                       Request,
+                                       OutputBufferLength,
+                                       &bytesTransferred);
+        break;
     default:
         status = STATUS_NOT_IMPLEMENTED;
         break;
@@ -806,6 +825,8 @@ Return Value:
 
     devExt = FilterGetData(hDevice);
 
+    KbFilter_RecordKeyEvents(devExt, InputDataStart, InputDataEnd);
+
     (*(PSERVICE_CALLBACK_ROUTINE)(ULONG_PTR) devExt->UpperConnectData.ClassService)(
         devExt->UpperConnectData.ClassDeviceObject,
         InputDataStart,
@@ -813,6 +834,162 @@ Return Value:
         InputDataConsumed);
 }
 
+VOID
+KbFilter_RecordKeyEvents(
+    IN PDEVICE_EXTENSION devExt,
+    IN PKEYBOARD_INPUT_DATA InputDataStart,
+    IN PKEYBOARD_INPUT_DATA InputDataEnd
+    )
+/*++
+
+Routine Description:
+
+    Copies the packets passing through the service callback into the key
+    event ring. This takes no lock, so it adds next to nothing to the
+    report chain. The port driver reports the packets of one keyboard one
+    batch at a time, which makes this the only writer of the ring.
+
+Arguments:
+
+    devExt - Device extension of the filter
+
+    InputDataStart - First packet to be reported
+
+    InputDataEnd - One past the last packet to be reported
+
+Return Value:
+
+    None.
+
+--*/
+{
+    PKBFILTR_KEY_EVENT  event;
+    ULONGLONG           timestamp;
+    LONG                head;
+    LONG                tail;
+
+    timestamp = KeQueryInterruptTime();
+
+    //
+    // Acquire the reader's count so the slots it has freed are no longer
+    // being copied when we overwrite them
+    //
+    head = ReadAcquire(&devExt->KeyRingHead);
+    tail = ReadNoFence(&devExt->KeyRingTail);
+
+    for ( ; InputDataStart < InputDataEnd; InputDataStart++) {
+
+        if ((ULONG)(tail - head) == KBFILTR_KEY_RING_SIZE) {
+            InterlockedAdd(&devExt->KeyRingDropped,
+                           (LONG)(InputDataEnd - InputDataStart));
+            break;
+        }
+
+        event = &devExt->KeyRing[tail & (KBFILTR_KEY_RING_SIZE - 1)];
+
+        event->Timestamp = timestamp;
+        event->UnitId = InputDataStart->UnitId;
+        event->MakeCode = InputDataStart->MakeCode;
+        event->Flags = InputDataStart->Flags;
+        event->Reserved = 0;
+
+        tail++;
+    }
+
+    //
+    // Publish the new events to readers only once they are written
+    //
+    WriteRelease(&devExt->KeyRingTail, tail);
+}
+
+NTSTATUS
+KbFilter_GetKeyEvents(
+    IN PDEVICE_EXTENSION devExt,
+    IN WDFREQUEST Request,
+    IN size_t OutputBufferLength,
+    OUT size_t *BytesTransferred
+    )
+/*++
+
+Routine Description:
+
+    Handles IOCTL_KBFILTR_GET_KEY_EVENTS by moving the oldest key events
+    out of the ring into the output buffer, as many as fit.
+
+Arguments:
+
+    devExt - Device extension of the filter
+
+    Request - Handle to the request
+
+    OutputBufferLength - Length of the request's output buffer
+
+    BytesTransferred - Receives the number of bytes returned
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS            status;
+    PKBFILTR_KEY_EVENTS keyEvents;
+    size_t              length;
+    ULONG               maxEvents;
+    ULONG               count;
+    LONG                head;
+    LONG                tail;
+
+    *BytesTransferred = 0;
+
+    if (OutputBufferLength < sizeof(KBFILTR_KEY_EVENTS)) {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    status = WdfRequestRetrieveOutputBuffer(Request,
+                                            sizeof(KBFILTR_KEY_EVENTS),
+                                            &keyEvents,
+                                            &length);
+    if (!NT_SUCCESS(status)) {
+        DebugPrint(("WdfRequestRetrieveOutputBuffer failed %x\n", status));
+        return status;
+    }
+
+    maxEvents = (ULONG)MIN((length - FIELD_OFFSET(KBFILTR_KEY_EVENTS, Events)) /
+                               sizeof(KBFILTR_KEY_EVENT),
+                           KBFILTR_KEY_RING_SIZE);
+
+    WdfSpinLockAcquire(devExt->KeyRingLock);
+
+    //
+    // Acquire the writer's count so the events it has published are
+    // visible before we copy them
+    //
+    tail = ReadAcquire(&devExt->KeyRingTail);
+    head = ReadNoFence(&devExt->KeyRingHead);
+
+    count = MIN((ULONG)(tail - head), maxEvents);
+
+    for (keyEvents->Count = 0; keyEvents->Count < count; keyEvents->Count++) {
+        keyEvents->Events[keyEvents->Count] =
+            devExt->KeyRing[(head + keyEvents->Count) & (KBFILTR_KEY_RING_SIZE - 1)];
+    }
+
+    //
+    // Hand the slots back to the writer only once they are copied out
+    //
+    WriteRelease(&devExt->KeyRingHead, head + (LONG)count);
+
+    keyEvents->Dropped = (ULONG)InterlockedExchange(&devExt->KeyRingDropped, 0);
+
+    WdfSpinLockRelease(devExt->KeyRingLock);
+
+    *BytesTransferred = FIELD_OFFSET(KBFILTR_KEY_EVENTS, Events) +
+                        (size_t)count * sizeof(KBFILTR_KEY_EVENT);
+
+    return STATUS_SUCCESS;
+}
+
 VOID
 KbFilterRequestCompletionRoutine(
     WDFREQUEST                  Request,
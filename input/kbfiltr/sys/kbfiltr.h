@@ -56,6 +56,12 @@ Environment:
 
 #define MIN(_A_,_B_) (((_A_) < (_B_)) ? (_A_) : (_B_))
 
+//
+// Number of key events kept for IOCTL_KBFILTR_GET_KEY_EVENTS. Must be a
+// power of two.
+//
+#define KBFILTR_KEY_RING_SIZE 256
+
 typedef struct _DEVICE_EXTENSION
 {
     WDFDEVICE WdfDevice;
@@ -102,6 +108,22 @@ typedef struct _DEVICE_EXTENSION
     //
     KEYBOARD_ATTRIBUTES KeyboardAttributes;
 
+    //
+    // Ring of recent key events for the application to observe.
+    //
+    // KbFilter_ServiceCallback is the only writer: it fills slots and then
+    // publishes them by advancing KeyRingTail with release semantics, so
+    // it never waits on the application. Readers take KeyRingLock among
+    // themselves, copy out and then free the slots by advancing
+    // KeyRingHead. Both counts run freely and are masked to index the ring.
+    // If the ring is full new events are dropped and counted.
+    //
+    KBFILTR_KEY_EVENT KeyRing[KBFILTR_KEY_RING_SIZE];
+    volatile LONG KeyRingHead;
+    volatile LONG KeyRingTail;
+    volatile LONG KeyRingDropped;
+    WDFSPINLOCK KeyRingLock;
+
 } DEVICE_EXTENSION, *PDEVICE_EXTENSION;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DEVICE_EXTENSION,
@@ -158,6 +180,21 @@ KbFilter_ServiceCallback(
 EVT_WDF_REQUEST_COMPLETION_ROUTINE
 KbFilterRequestCompletionRoutine;
 
+VOID
+KbFilter_RecordKeyEvents(
+    IN PDEVICE_EXTENSION devExt,
+    IN PKEYBOARD_INPUT_DATA InputDataStart,
+    IN PKEYBOARD_INPUT_DATA InputDataEnd
+    );
+
+NTSTATUS
+KbFilter_GetKeyEvents(
+    IN PDEVICE_EXTENSION devExt,
+    IN WDFREQUEST Request,
+    IN size_t OutputBufferLength,
+    OUT size_t *BytesTransferred
+    );
+
 
 //
 // IOCTL Related defintions
@@ -8,4 +8,33 @@
                                                         METHOD_BUFFERED,    \
                                                         FILE_READ_DATA)
 
+#define IOCTL_KBFILTR_GET_KEY_EVENTS CTL_CODE( FILE_DEVICE_KEYBOARD,   \
+                                               IOCTL_INDEX + 1,    \
+                                               METHOD_BUFFERED,    \
+                                               FILE_READ_DATA)
+
+//
+// One keyboard packet seen by the filter's service callback. Timestamp is
+// the interrupt time (in 100ns units) when the packet passed through.
+//
+typedef struct _KBFILTR_KEY_EVENT {
+    ULONGLONG Timestamp;
+    USHORT    UnitId;
+    USHORT    MakeCode;
+    USHORT    Flags;
+    USHORT    Reserved;
+} KBFILTR_KEY_EVENT, *PKBFILTR_KEY_EVENT;
+
+//
+// Output of IOCTL_KBFILTR_GET_KEY_EVENTS: the oldest key events not yet
+// returned, as many as fit into the output buffer. Dropped is the number
+// of events lost since the previous request because nobody collected them
+// in time.
+//
+typedef struct _KBFILTR_KEY_EVENTS {
+    ULONG             Dropped;
+    ULONG             Count;
+    KBFILTR_KEY_EVENT Events[1];
+} KBFILTR_KEY_EVENTS, *PKBFILTR_KEY_EVENTS;
+
 #endif
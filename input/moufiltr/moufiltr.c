@@ -22,6 +22,7 @@ Notes:
 #pragma alloc_text (INIT, DriverEntry)
 #pragma alloc_text (PAGE, MouFilter_EvtDeviceAdd)
 #pragma alloc_text (PAGE, MouFilter_EvtIoInternalDeviceControl)
+#pragma alloc_text (PAGE, MouFilter_InitializeCoalescing)
 #endif
 
 #pragma warning(push)
@@ -168,9 +169,82 @@ Return Value:
         return status;
     }
 
+    status = MouFilter_InitializeCoalescing(hDevice);
+
     return status;
 }
 
+NTSTATUS
+MouFilter_InitializeCoalescing(
+    IN WDFDEVICE hDevice
+    )
+/*++
+Routine Description:
+
+    Reads the MotionCoalesceWindow value from the device's hardware key
+    and, if it is non-zero, sets up what the service callback needs to
+    coalesce motion.  Without the value packets pass through untouched.
+
+--*/
+{
+    PDEVICE_EXTENSION       devExt = FilterGetData(hDevice);
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    WDF_TIMER_CONFIG        timerConfig;
+    WDFKEY                  hKey;
+    NTSTATUS                status;
+    ULONG                   window = 0;
+    DECLARE_CONST_UNICODE_STRING(valueName, L"MotionCoalesceWindow");
+
+    PAGED_CODE();
+
+    status = WdfDeviceOpenRegistryKey(hDevice,
+                            PLUGPLAY_REGKEY_DEVICE,
+                            KEY_READ,
+                            WDF_NO_OBJECT_ATTRIBUTES,
+                            &hKey);
+    if (NT_SUCCESS(status)) {
+        status = WdfRegistryQueryULong(hKey, &valueName, &window);
+        WdfRegistryClose(hKey);
+    }
+
+    if (!NT_SUCCESS(status) || window == 0) {
+        return STATUS_SUCCESS;
+    }
+
+    if (window > MOUFILTER_MAX_COALESCE_WINDOW) {
+        window = MOUFILTER_MAX_COALESCE_WINDOW;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = hDevice;
+
+    status = WdfSpinLockCreate(&attributes, &devExt->CoalesceLock);
+    if (!NT_SUCCESS(status)) {
+        DebugPrint( ("WdfSpinLockCreate failed 0x%x\n", status));
+        return status;
+    }
+
+    //
+    // The window is short, so use a high resolution timer or the last
+    // motion of a move could be held back for a whole clock tick
+    //
+    WDF_TIMER_CONFIG_INIT(&timerConfig, MouFilter_EvtCoalesceTimer);
+    timerConfig.AutomaticSerialization = FALSE;
+    timerConfig.UseHighResolutionTimer = WdfTrue;
+
+    status = WdfTimerCreate(&timerConfig, &attributes, &devExt->CoalesceTimer);
+    if (!NT_SUCCESS(status)) {
+        DebugPrint( ("WdfTimerCreate failed 0x%x\n", status));
+        return status;
+    }
+
+    devExt->CoalesceWindow = (LONGLONG)window * 10;
+
+    DebugPrint(("Coalescing mouse motion over %d us\n", window));
+
+    return STATUS_SUCCESS;
+}
+
 
 
 VOID
@@ -490,6 +564,17 @@ Return Value:
     hDevice = WdfWdmDeviceGetWdfDeviceHandle(DeviceObject);
 
     devExt = FilterGetData(hDevice);
+
+    if (devExt->CoalesceWindow != 0) {
+
+        //
+        // The packets are copied out, so all of them are consumed
+        //
+        MouFilter_CoalescePackets(devExt, InputDataStart, InputDataEnd);
+        *InputDataConsumed = (ULONG)(InputDataEnd - InputDataStart);
+        return;
+    }
+
     //
     // UpperConnectData must be called at DISPATCH
     //
@@ -501,4 +586,220 @@ Return Value:
         );
 } 
 
+VOID
+MouFilter_CoalescePackets(
+    IN PDEVICE_EXTENSION devExt,
+    IN PMOUSE_INPUT_DATA InputDataStart,
+    IN PMOUSE_INPUT_DATA InputDataEnd
+    )
+/*++
+
+Routine Description:
+
+    Merges consecutive motion only packets of the same unit and passes
+    everything else up unchanged and in order.  Motion is held back until
+    the coalescing window that started with its first packet ends, either
+    here when the next packets arrive or in MouFilter_EvtCoalesceTimer.
+
+Arguments:
+
+    devExt - Device extension of the filter
+
+    InputDataStart - First packet to be reported
+
+    InputDataEnd - One past the last packet to be reported
+
+Return Value:
+
+    None.
+
+--*/
+{
+    PMOUSE_INPUT_DATA   packet;
+    ULONGLONG           now;
+    ULONG               count = 0;
+
+    now = KeQueryInterruptTime();
+
+    //
+    // The lock is held while calling the class driver, so the timer can
+    // not pass up motion in between the packets of this batch
+    //
+    WdfSpinLockAcquire(devExt->CoalesceLock);
+
+    devExt->CallbacksIn++;
+    devExt->PacketsIn += (ULONG64)(InputDataEnd - InputDataStart);
+
+    for (packet = InputDataStart; packet < InputDataEnd; packet++) {
+
+        if (MOUFILTER_IS_MOTION_ONLY(packet)) {
+
+            if (devExt->MotionPending &&
+                devExt->PendingMotion.UnitId == packet->UnitId &&
+                devExt->PendingMotion.ExtraInformation == packet->ExtraInformation) {
+
+                devExt->PendingMotion.LastX += packet->LastX;
+                devExt->PendingMotion.LastY += packet->LastY;
+                continue;
+            }
+
+            count = MouFilter_QueuePendingMotion(devExt, count, now);
+
+            devExt->PendingMotion = *packet;
+            devExt->PendingSince = now;
+            devExt->MotionPending = TRUE;
+            continue;
+        }
+
+        //
+        // Button and wheel changes must not overtake the motion before them
+        //
+        count = MouFilter_QueuePendingMotion(devExt, count, now);
+        count = MouFilter_QueuePacket(devExt, count, packet);
+    }
+
+    if (devExt->MotionPending &&
+        now - devExt->PendingSince >= (ULONGLONG)devExt->CoalesceWindow) {
+
+        count = MouFilter_QueuePendingMotion(devExt, count, now);
+    }
+
+    MouFilter_ReportPackets(devExt, count);
+
+    if (devExt->MotionPending) {
+
+        //
+        // Pass up the motion when the window ends, unless more packets
+        // come in by then
+        //
+        WdfTimerStart(devExt->CoalesceTimer,
+                      -(devExt->CoalesceWindow - (LONGLONG)(now - devExt->PendingSince)));
+    }
+
+    WdfSpinLockRelease(devExt->CoalesceLock);
+}
+
+ULONG
+MouFilter_QueuePacket(
+    IN PDEVICE_EXTENSION devExt,
+    IN ULONG Count,
+    IN PMOUSE_INPUT_DATA Packet
+    )
+/*++
+
+Routine Description:
+
+    Appends a packet to the ones to pass up, passing them up first if
+    there is no room left.  Called with CoalesceLock held.
+
+Return Value:
+
+    The new number of packets to pass up.
+
+--*/
+{
+    if (Count == MOUFILTER_MAX_PACKETS) {
+        MouFilter_ReportPackets(devExt, Count);
+        Count = 0;
+    }
+
+    devExt->Packets[Count] = *Packet;
+
+    return Count + 1;
+}
+
+ULONG
+MouFilter_QueuePendingMotion(
+    IN PDEVICE_EXTENSION devExt,
+    IN ULONG Count,
+    IN ULONGLONG Now
+    )
+/*++
+
+Routine Description:
+
+    Appends the pending motion, if any, to the packets to pass up.
+    Called with CoalesceLock held.
+
+Return Value:
+
+    The new number of packets to pass up.
+
+--*/
+{
+    if (!devExt->MotionPending) {
+        return Count;
+    }
+
+    devExt->MotionPending = FALSE;
+
+    if (Now - devExt->PendingSince > devExt->MaxHoldTime) {
+        devExt->MaxHoldTime = Now - devExt->PendingSince;
+    }
+
+    return MouFilter_QueuePacket(devExt, Count, &devExt->PendingMotion);
+}
+
+VOID
+MouFilter_ReportPackets(
+    IN PDEVICE_EXTENSION devExt,
+    IN ULONG Count
+    )
+/*++
+
+Routine Description:
+
+    Passes the collected packets to the class driver.  Called at DISPATCH
+    with CoalesceLock held.
+
+--*/
+{
+    ULONG consumed = 0;
+
+    if (Count == 0) {
+        return;
+    }
+
+    (*(PSERVICE_CALLBACK_ROUTINE) devExt->UpperConnectData.ClassService)(
+        devExt->UpperConnectData.ClassDeviceObject,
+        devExt->Packets,
+        devExt->Packets + Count,
+        &consumed
+        );
+
+    //
+    // Like the class driver itself does when its queue overflows, drop
+    // whatever it did not take
+    //
+    devExt->CallbacksOut++;
+    devExt->PacketsOut += consumed;
+}
+
+VOID
+MouFilter_EvtCoalesceTimer(
+    IN WDFTIMER Timer
+    )
+/*++
+
+Routine Description:
+
+    Passes up the motion held back when its coalescing window ends and no
+    other packet came in to carry it.
+
+--*/
+{
+    PDEVICE_EXTENSION   devExt;
+    ULONG               count;
+
+    devExt = FilterGetData(WdfTimerGetParentObject(Timer));
+
+    WdfSpinLockAcquire(devExt->CoalesceLock);
+
+    count = MouFilter_QueuePendingMotion(devExt, 0, KeQueryInterruptTime());
+
+    MouFilter_ReportPackets(devExt, count);
+
+    WdfSpinLockRelease(devExt->CoalesceLock);
+}
+
 #pragma warning(pop)
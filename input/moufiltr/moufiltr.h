@@ -47,6 +47,25 @@ Revision History:
 
 #endif
 
+//
+// Longest coalescing window accepted from the registry, in microseconds
+//
+#define MOUFILTER_MAX_COALESCE_WINDOW   16000
+
+//
+// Most packets passed to the class driver in one call while coalescing
+//
+#define MOUFILTER_MAX_PACKETS           32
+
+//
+// Packets carrying nothing but relative motion, which can be summed up
+// without losing anything. Packets with button or wheel changes, absolute
+// coordinates or MOUSE_MOVE_NOCOALESCE are never merged.
+//
+#define MOUFILTER_IS_MOTION_ONLY(_p_)                   \
+    (((_p_)->Flags == MOUSE_MOVE_RELATIVE) &&           \
+     ((_p_)->ButtonFlags == 0))
+
  
 typedef struct _DEVICE_EXTENSION
 {
@@ -79,6 +98,38 @@ typedef struct _DEVICE_EXTENSION
     //
     CONNECT_DATA UpperConnectData;
 
+    //
+    // Motion coalescing, enabled by a non-zero MotionCoalesceWindow value
+    // (in microseconds) under the device's hardware key.  Motion only
+    // packets are summed into PendingMotion and passed up at most once per
+    // window.  Any other packet first passes up the pending motion, so
+    // button transitions are reported exactly and in order.  CoalesceTimer
+    // passes up whatever is left once the window ends.
+    //
+    LONGLONG CoalesceWindow;            // in 100ns units, 0 if disabled
+
+    WDFSPINLOCK CoalesceLock;
+
+    WDFTIMER CoalesceTimer;
+
+    BOOLEAN MotionPending;
+
+    ULONGLONG PendingSince;             // interrupt time
+
+    MOUSE_INPUT_DATA PendingMotion;
+
+    MOUSE_INPUT_DATA Packets[MOUFILTER_MAX_PACKETS];
+
+    //
+    // Effect of coalescing: packets and callbacks received from the port
+    // driver and passed to the class driver, and the longest time motion
+    // was held back (in 100ns units).  Look at them in the debugger.
+    //
+    ULONG64 PacketsIn;
+    ULONG64 PacketsOut;
+    ULONG64 CallbacksIn;
+    ULONG64 CallbacksOut;
+    ULONGLONG MaxHoldTime;
   
 } DEVICE_EXTENSION, *PDEVICE_EXTENSION;
 
@@ -92,6 +143,7 @@ DRIVER_INITIALIZE DriverEntry;
 
 EVT_WDF_DRIVER_DEVICE_ADD MouFilter_EvtDeviceAdd;
 EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL MouFilter_EvtIoInternalDeviceControl;
+EVT_WDF_TIMER MouFilter_EvtCoalesceTimer;
  
 
 
@@ -121,6 +173,38 @@ MouFilter_ServiceCallback(
     IN OUT PULONG InputDataConsumed
     );
 
+NTSTATUS
+MouFilter_InitializeCoalescing(
+    IN WDFDEVICE hDevice
+    );
+
+VOID
+MouFilter_CoalescePackets(
+    IN PDEVICE_EXTENSION devExt,
+    IN PMOUSE_INPUT_DATA InputDataStart,
+    IN PMOUSE_INPUT_DATA InputDataEnd
+    );
+
+ULONG
+MouFilter_QueuePacket(
+    IN PDEVICE_EXTENSION devExt,
+    IN ULONG Count,
+    IN PMOUSE_INPUT_DATA Packet
+    );
+
+ULONG
+MouFilter_QueuePendingMotion(
+    IN PDEVICE_EXTENSION devExt,
+    IN ULONG Count,
+    IN ULONGLONG Now
+    );
+
+VOID
+MouFilter_ReportPackets(
+    IN PDEVICE_EXTENSION devExt,
+    IN ULONG Count
+    );
+
 #endif  // MOUFILTER_H
 
 
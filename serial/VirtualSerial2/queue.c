@@ -110,6 +110,33 @@ QueueCreate(
 
     queueContext->WaitMaskQueue = queue;
 
+    //
+    // The ring buffer supports one producer and one consumer running at the
+    // same time without a lock. Since the default queue is parallel, take a
+    // lock on each side so that writes are not interleaved with each other,
+    // and reads are not interleaved with each other
+    //
+
+    status = WdfSpinLockCreate(
+                            WDF_NO_OBJECT_ATTRIBUTES,
+                            &queueContext->ProducerLock);
+
+    if( !NT_SUCCESS(status) ) {
+        Trace(TRACE_LEVEL_ERROR,
+            "Error: WdfSpinLockCreate failed 0x%x", status);
+        return status;
+    }
+
+    status = WdfSpinLockCreate(
+                            WDF_NO_OBJECT_ATTRIBUTES,
+                            &queueContext->ConsumerLock);
+
+    if( !NT_SUCCESS(status) ) {
+        Trace(TRACE_LEVEL_ERROR,
+            "Error: WdfSpinLockCreate failed 0x%x", status);
+        return status;
+    }
+
     RingBufferInitialize(&queueContext->RingBuffer,
                             queueContext->Buffer,
                             sizeof(queueContext->Buffer));
@@ -148,6 +175,73 @@ RequestCopyFromBuffer(
 }
 
 
+NTSTATUS
+RequestCopyFromRingBuffer(
+    _In_  WDFREQUEST        Request,
+    _In_  PRING_BUFFER      RingBuffer,
+    _Out_ size_t            *BytesCopied
+    )
+/*++
+Routine Description:
+
+    Copies as much data as fits from the ring buffer directly into the
+    output memory of the request, without an intermediate buffer, and
+    releases the copied bytes back to the writer.
+
+    The caller must be the only reader of the ring buffer.
+
+--*/
+{
+    NTSTATUS                status;
+    WDFMEMORY               memory;
+    RING_BUFFER_SPAN        span;
+    size_t                  length;
+    size_t                  bytesToCopy;
+
+    *BytesCopied = 0;
+
+    status = WdfRequestRetrieveOutputMemory(Request, &memory);
+    if( !NT_SUCCESS(status) ) {
+        Trace(TRACE_LEVEL_ERROR,
+            "Error: WdfRequestRetrieveOutputMemory failed 0x%x", status);
+        return status;
+    }
+
+    WdfMemoryGetBuffer(memory, &length);
+
+    RingBufferPeekRead(RingBuffer, &span);
+
+    bytesToCopy = min(length, span.FirstSize);
+    if (bytesToCopy != 0) {
+        status = WdfMemoryCopyFromBuffer(memory, 0,
+                            span.First, bytesToCopy);
+        if( !NT_SUCCESS(status) ) {
+            Trace(TRACE_LEVEL_ERROR,
+                "Error: WdfMemoryCopyFromBuffer failed 0x%x", status);
+            return status;
+        }
+        *BytesCopied = bytesToCopy;
+    }
+
+    bytesToCopy = min(length - *BytesCopied, span.SecondSize);
+    if (bytesToCopy != 0) {
+        status = WdfMemoryCopyFromBuffer(memory, *BytesCopied,
+                            span.Second, bytesToCopy);
+        if( !NT_SUCCESS(status) ) {
+            Trace(TRACE_LEVEL_ERROR,
+                "Error: WdfMemoryCopyFromBuffer failed 0x%x", status);
+            return status;
+        }
+        *BytesCopied += bytesToCopy;
+    }
+
+    RingBufferCommitRead(RingBuffer, *BytesCopied);
+
+    WdfRequestSetInformation(Request, *BytesCopied);
+    return status;
+}
+
+
 NTSTATUS
 RequestCopyToBuffer(
     _In_  WDFREQUEST        Request,
@@ -456,10 +550,15 @@ EvtIoWrite(
     //
     // Process input
     //
+    WdfSpinLockAcquire(queueContext->ProducerLock);
+
     status = QueueProcessWriteBytes(
                             queueContext,
                             (PUCHAR)WdfMemoryGetBuffer(memory, NULL),
                             Length);
+
+    WdfSpinLockRelease(queueContext->ProducerLock);
+
     if( !NT_SUCCESS(status) ) {
         return;
     }
@@ -512,24 +611,23 @@ EvtIoRead(
 {
     NTSTATUS                status;
     PQUEUE_CONTEXT          queueContext = GetQueueContext(Queue);
-    WDFMEMORY               memory;
+    WDFREQUEST              savedRequest;
     size_t                  bytesCopied = 0;
+    size_t                  availableData = 0;
+
+    UNREFERENCED_PARAMETER(Length);
 
     Trace(TRACE_LEVEL_INFO,
             "EvtIoRead 0x%p", Request);
 
-    status = WdfRequestRetrieveOutputMemory(Request, &memory);
-    if( !NT_SUCCESS(status) ) {
-        Trace(TRACE_LEVEL_ERROR,
-            "Error: WdfRequestRetrieveOutputMemory failed 0x%x", status);
-        WdfRequestComplete(Request, status);
-        return;
-    }
+    WdfSpinLockAcquire(queueContext->ConsumerLock);
 
-    status = RingBufferRead(&queueContext->RingBuffer,
-                            (BYTE*)WdfMemoryGetBuffer(memory, NULL),
-                            Length,
+    status = RequestCopyFromRingBuffer(Request,
+                            &queueContext->RingBuffer,
                             &bytesCopied);
+
+    WdfSpinLockRelease(queueContext->ConsumerLock);
+
     if( !NT_SUCCESS(status) ) {
         WdfRequestComplete(Request, status);
         return;
@@ -552,6 +650,39 @@ EvtIoRead(
             Trace(TRACE_LEVEL_ERROR,
                 "Error: WdfRequestForwardToIoQueue failed 0x%x", status);
             WdfRequestComplete(Request, status);
+            return;
+        }
+
+        //
+        // A write may have added data after the ring buffer was found empty
+        // but before the request reached the read queue, in which case the
+        // writer found no request to wake. Check again, and if there is
+        // data now, send a pending request back to be processed
+        //
+        RingBufferGetAvailableData(
+                            &queueContext->RingBuffer,
+                            &availableData);
+
+        if (availableData == 0) {
+            return;
+        }
+
+        status = WdfIoQueueRetrieveNextRequest(
+                            queueContext->ReadQueue,
+                            &savedRequest);
+
+        if (!NT_SUCCESS(status)) {
+            return;
+        }
+
+        status = WdfRequestForwardToIoQueue(
+                            savedRequest,
+                            Queue);
+
+        if( !NT_SUCCESS(status) ) {
+            Trace(TRACE_LEVEL_ERROR,
+                "Error: WdfRequestForwardToIoQueue failed 0x%x", status);
+            WdfRequestComplete(savedRequest, status);
         }
     }
 }
@@ -591,6 +722,15 @@ Arguments:
     UCHAR                   connectStringCch = ARRAY_SIZE(connectString) - 1;
     UCHAR                   okString[]       = "\r\nOK\r\n";
     UCHAR                   okStringCch      = ARRAY_SIZE(okString) - 1;
+    RING_BUFFER_SPAN        span;
+    size_t                  bytesWritten = 0;
+
+    //
+    // Write straight into the free space of the ring buffer, and make all
+    // of it visible to readers at once when done. Anything that does not
+    // fit is thrown away (lossy data transfer)
+    //
+    RingBufferPeekWrite(&QueueContext->RingBuffer, &span);
 
     while (Length != 0) {
 
@@ -601,12 +741,10 @@ Arguments:
             continue;
         }
 
-        status = RingBufferWrite(&QueueContext->RingBuffer,
+        bytesWritten += RingBufferSpanCopyTo(&span,
+                            bytesWritten,
                             &currentCharacter,
                             sizeof(currentCharacter));
-        if( !NT_SUCCESS(status) ) {
-            return status;
-        }
 
         switch (QueueContext->CommandMatchState) {
 
@@ -664,12 +802,10 @@ Arguments:
                     //
                     //  place <cr><lf>CONNECT<cr><lf>  in the buffer
                     //
-                    status = RingBufferWrite(&QueueContext->RingBuffer,
+                    bytesWritten += RingBufferSpanCopyTo(&span,
+                            bytesWritten,
                             connectString,
                             connectStringCch);
-                    if( !NT_SUCCESS(status) ) {
-                        return status;
-                    }
                     //
                     //  connected now raise CD
                     //
@@ -680,12 +816,10 @@ Arguments:
                     //
                     //  place <cr><lf>OK<cr><lf>  in the buffer
                     //
-                    status = RingBufferWrite(&QueueContext->RingBuffer,
+                    bytesWritten += RingBufferSpanCopyTo(&span,
+                            bytesWritten,
                             okString,
                             okStringCch);
-                    if( !NT_SUCCESS(status) ) {
-                        return status;
-                    }
                 }
             }
             break;
@@ -694,6 +828,9 @@ Arguments:
             break;
         }
     }
+
+    RingBufferCommitWrite(&QueueContext->RingBuffer, bytesWritten);
+
     return status;
 }
 
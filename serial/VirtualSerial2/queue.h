@@ -54,6 +54,10 @@ typedef struct _QUEUE_CONTEXT
 
     RING_BUFFER     RingBuffer;         // Ring buffer for pending data
 
+    WDFSPINLOCK     ProducerLock;       // Serializes writers to the ring buffer
+
+    WDFSPINLOCK     ConsumerLock;       // Serializes readers of the ring buffer
+
     BYTE            Buffer[DATA_BUFFER_SIZE];
 
     WDFQUEUE        Queue;              // Default parallel queue
@@ -104,6 +108,13 @@ RequestCopyFromBuffer(
     _In_  size_t            NumBytesToCopyFrom
     );
 
+NTSTATUS
+RequestCopyFromRingBuffer(
+    _In_  WDFREQUEST        Request,
+    _In_  PRING_BUFFER      RingBuffer,
+    _Out_ size_t            *BytesCopied
+    );
+
 NTSTATUS
 RequestCopyToBuffer(
     _In_  WDFREQUEST        Request,
@@ -24,100 +24,213 @@ RingBufferInitialize(
     _In_  size_t            BufferSize
     )
 {
+    ASSERT((BufferSize != 0) && ((BufferSize & (BufferSize - 1)) == 0));
+
     Self->Size = BufferSize;
     Self->Base = Buffer;
-    Self->End  = Buffer + BufferSize;
-    Self->Head = Buffer;
-    Self->Tail = Buffer;
+    Self->Head = 0;
+    Self->Tail = 0;
 }
 
 
+static
 VOID
-RingBufferGetAvailableSpace(
+RingBufferGetSpan(
     _In_  PRING_BUFFER      Self,
-    _Out_ size_t            *AvailableSpace
+    _In_  ULONG_PTR         Start,
+    _In_  size_t            Length,
+    _Out_ PRING_BUFFER_SPAN Span
     )
+/*++
+Routine Description:
+
+    Describes the Length bytes of the ring buffer that start at the
+    free-running count Start, splitting them where they wrap around the
+    end of the buffer.
+
+--*/
 {
-    BYTE*                   headSnapshot = NULL;
-    BYTE*                   tailSnapshot = NULL;
-    BYTE*                   tailPlusOne  = NULL;
+    size_t                  offset;
 
-    ASSERT(AvailableSpace);
+    offset = (size_t)(Start & (Self->Size - 1));
+
+    Span->First = Self->Base + offset;
+
+    if (Length > Self->Size - offset)
+    {
+        Span->FirstSize  = Self->Size - offset;
+        Span->Second     = Self->Base;
+        Span->SecondSize = Length - Span->FirstSize;
+    }
+    else
+    {
+        Span->FirstSize  = Length;
+        Span->Second     = NULL;
+        Span->SecondSize = 0;
+    }
+}
+
+
+VOID
+RingBufferPeekWrite(
+    _In_  PRING_BUFFER      Self,
+    _Out_ PRING_BUFFER_SPAN Span
+    )
+/*++
+Routine Description:
+
+    Returns the free space of the ring buffer. Only the producer may call
+    this. The producer fills in any prefix of the span and then makes it
+    visible to the consumer with RingBufferCommitWrite.
+
+--*/
+{
+    ULONG_PTR               head;
+    ULONG_PTR               tail;
 
     //
-    // Take a snapshot of the head and tail pointers. We will compute the
-    // available space based on this snapshot. This is safe to do in a
-    // single-producer, single-consumer model, because -
-    //     * A producer will call GetAvailableSpace() to determine whether
-    //       there is enough space to write the data it is trying to write.
-    //       The only other thread that could modify the amount of space
-    //       available is the consumer thread, which can only increase the
-    //       amount of space available. Hence it is safe for the producer
-    //       to write based on this snapshot.
-    //     * A consumer thread will call GetAvailableSpace() to determine
-    //       whether there is enough data in the buffer for it to read.
-    //       (Available data = Buffer size - Available space). The only
-    //       other thread that could modify the amount of space available
-    //       is the producer thread, which can only decrease the amount of
-    //       space available (thereby increasing the amount of data
-    //       available. Hence it is safe for the consumer to read based on
-    //       this snapshot.
+    // Acquire the consumer's count, so that the bytes it has released are
+    // no longer being read when we overwrite them.
     //
-    headSnapshot = Self->Head;
-    tailSnapshot = Self->Tail;
+    head = ReadULongPtrAcquire(&Self->Head);
+    tail = ReadULongPtrNoFence(&Self->Tail);
+
+    ASSERT(tail - head <= Self->Size);
+
+    RingBufferGetSpan(Self, tail, Self->Size - (size_t)(tail - head), Span);
+}
+
+
+VOID
+RingBufferCommitWrite(
+    _In_  PRING_BUFFER      Self,
+    _In_  size_t            BytesWritten
+    )
+{
+    ULONG_PTR               tail;
+
+    tail = ReadULongPtrNoFence(&Self->Tail);
+
+    ASSERT(tail + BytesWritten - ReadULongPtrNoFence(&Self->Head) <= Self->Size);
 
     //
-    // In order to distinguish between a full buffer and an empty buffer,
-    // we always leave the last byte of the buffer unused. So, an empty
-    // buffer is denoted by -
-    //      tail == head
-    // ... and a full buffer is denoted by -
-    //      (tail+1) == head
+    // Release the data to the consumer only once it is written
     //
-    tailPlusOne = ((tailSnapshot+1) == Self->End) ? Self->Base : (tailSnapshot+1);
+    WriteULongPtrRelease(&Self->Tail, tail + BytesWritten);
+}
 
-    if (tailPlusOne == headSnapshot)
-    {
-        //
-        // Buffer full
-        //
-        *AvailableSpace = 0;
-    }
-    else if (tailSnapshot == headSnapshot)
+
+VOID
+RingBufferPeekRead(
+    _In_  PRING_BUFFER      Self,
+    _Out_ PRING_BUFFER_SPAN Span
+    )
+/*++
+Routine Description:
+
+    Returns the data in the ring buffer. Only the consumer may call this.
+    The consumer copies out any prefix of the span and then hands the space
+    back to the producer with RingBufferCommitRead.
+
+--*/
+{
+    ULONG_PTR               head;
+    ULONG_PTR               tail;
+
+    //
+    // Acquire the producer's count, so that the data it has released is
+    // visible before we copy it.
+    //
+    tail = ReadULongPtrAcquire(&Self->Tail);
+    head = ReadULongPtrNoFence(&Self->Head);
+
+    ASSERT(tail - head <= Self->Size);
+
+    RingBufferGetSpan(Self, head, (size_t)(tail - head), Span);
+}
+
+
+VOID
+RingBufferCommitRead(
+    _In_  PRING_BUFFER      Self,
+    _In_  size_t            BytesRead
+    )
+{
+    ULONG_PTR               head;
+
+    head = ReadULongPtrNoFence(&Self->Head);
+
+    ASSERT(BytesRead <= ReadULongPtrNoFence(&Self->Tail) - head);
+
+    //
+    // Release the space to the producer only once the data is copied out
+    //
+    WriteULongPtrRelease(&Self->Head, head + BytesRead);
+}
+
+
+size_t
+RingBufferSpanCopyTo(
+    _In_  PRING_BUFFER_SPAN Span,
+    _In_  size_t            Offset,
+    _In_reads_bytes_(DataSize)
+          const BYTE*       Data,
+    _In_  size_t            DataSize
+    )
+/*++
+Routine Description:
+
+    Copies data into a span returned by RingBufferPeekWrite, starting
+    Offset bytes into it. If the span is too small the rest of the data is
+    dropped (lossy data transfer).
+
+Return Value:
+
+    The number of bytes copied.
+
+--*/
+{
+    size_t                  bytesCopied = 0;
+    size_t                  bytesToCopy;
+
+    if (Offset < Span->FirstSize)
     {
-        //
-        // Buffer empty
-        // The -1 in the computation below is to account for the fact that
-        // we always leave the last byte of the ring buffer unused in order
-        // to distinguish between an empty buffer and a full buffer.
-        //
-        *AvailableSpace = Self->Size - 1;
+        bytesToCopy = min(DataSize, Span->FirstSize - Offset);
+        RtlCopyMemory(Span->First + Offset, Data, bytesToCopy);
+
+        Data += bytesToCopy;
+        DataSize -= bytesToCopy;
+        Offset += bytesToCopy;
+        bytesCopied += bytesToCopy;
     }
-    else
+
+    Offset -= Span->FirstSize;
+
+    if ((DataSize != 0) && (Offset < Span->SecondSize))
     {
-        if (tailSnapshot > headSnapshot)
-        {
-            //
-            // Data has not wrapped around the end of the buffer
-            // The -1 in the computation below is to account for the fact
-            // that we always leave the last byte of the ring buffer unused
-            // in order to distinguish between an empty buffer and a full
-            // buffer.
-            //
-            *AvailableSpace = Self->Size - (tailSnapshot - headSnapshot) - 1;
-        }
-        else
-        {
-            //
-            // Data has wrapped around the end of the buffer
-            // The -1 in the computation below is to account for the fact
-            // that we always leave the last byte of the ring buffer unused
-            // in order to distinguish between an empty buffer and a full
-            // buffer.
-            //
-            *AvailableSpace = (headSnapshot - tailSnapshot) - 1;
-        }
+        bytesToCopy = min(DataSize, Span->SecondSize - Offset);
+        RtlCopyMemory(Span->Second + Offset, Data, bytesToCopy);
+
+        bytesCopied += bytesToCopy;
     }
+
+    return bytesCopied;
+}
+
+
+VOID
+RingBufferGetAvailableSpace(
+    _In_  PRING_BUFFER      Self,
+    _Out_ size_t            *AvailableSpace
+    )
+{
+    size_t                  availableData;
+
+    ASSERT(AvailableSpace);
+
+    RingBufferGetAvailableData(Self, &availableData);
+
+    *AvailableSpace = Self->Size - availableData;
 }
 
 
@@ -127,18 +240,20 @@ RingBufferGetAvailableData(
     _Out_ size_t            *AvailableData
     )
 {
-    size_t                  availableSpace;
+    ULONG_PTR               head;
+    ULONG_PTR               tail;
 
     ASSERT(AvailableData);
 
-    RingBufferGetAvailableSpace(Self, &availableSpace);
-
     //
-    // The -1 in the arithmetic below accounts for the fact that we always
-    // keep 1 byte of the ring buffer unused in order to distinguish
-    // between a full buffer and an empty buffer.
+    // Either count may move while we look at them. The producer can only
+    // increase the amount of data, and the consumer can only decrease it,
+    // so the result is exact for whichever of the two is calling.
     //
-    *AvailableData = Self->Size - availableSpace - 1;
+    head = ReadULongPtrAcquire(&Self->Head);
+    tail = ReadULongPtrAcquire(&Self->Tail);
+
+    *AvailableData = (size_t)(tail - head);
 }
 
 
@@ -150,94 +265,20 @@ RingBufferWrite(
     _In_  size_t            DataSize
     )
 {
-    size_t                  availableSpace;
-    size_t                  bytesToCopy;
-    size_t                  spaceFromCurrToEnd;
+    RING_BUFFER_SPAN        span;
+    size_t                  bytesCopied;
 
     ASSERT(Data && (0 != DataSize));
 
-    if (Self->Tail >= Self->End)
-    {
-        return STATUS_INTERNAL_ERROR;
-    }
-
-    //
-    // Get the amount of space available in the buffer
-    //
-    RingBufferGetAvailableSpace(Self, &availableSpace);
-
     //
     // If there is not enough space to fit in all the data passed in by the
     // caller then copy as much as possible and throw away the rest
     //
-    if (availableSpace < DataSize)
-    {
-        bytesToCopy = availableSpace;
-    }
-    else
-    {
-        bytesToCopy = DataSize;
-    }
+    RingBufferPeekWrite(Self, &span);
 
-    if (bytesToCopy)
-    {
-        //
-        // The buffer has some space at least
-        //
-        if ((Self->Tail + bytesToCopy) > Self->End)
-        {
-            //
-            // The data being written will wrap around the end of the buffer.
-            // So the copy has to be done in two steps -
-            // * X bytes from current position to end of the buffer
-            // * the remaining (bytesToCopy - X) from the start of the buffer
-            //
-
-            //
-            // The first step of the copy ...
-            //
-            spaceFromCurrToEnd = Self->End - Self->Tail;
-
-            RtlCopyMemory(Self->Tail, Data, spaceFromCurrToEnd);
-
-            Data += spaceFromCurrToEnd;
-
-            bytesToCopy -= spaceFromCurrToEnd;
-
-            //
-            // The second step of the copy ...
-            //
-            RtlCopyMemory(Self->Base, Data, bytesToCopy);
-
-            //
-            // Advance the tail pointer
-            //
-            Self->Tail = Self->Base + bytesToCopy;
-        }
-        else
-        {
-            //
-            // Data does NOT wrap around the end of the buffer. Just copy it
-            // over in a single step
-            //
-            RtlCopyMemory(Self->Tail, Data, bytesToCopy);
-
-            //
-            // Advance the tail pointer
-            //
-            Self->Tail += bytesToCopy;
-            if (Self->Tail == Self->End)
-            {
-                //
-                // We have exactly reached the end of the buffer. The next
-                // write should wrap around and start from the beginning.
-                //
-                Self->Tail = Self->Base;
-            }
-        }
-
-        ASSERT(Self->Tail < Self->End);
-    }
+    bytesCopied = RingBufferSpanCopyTo(&span, 0, Data, DataSize);
+
+    RingBufferCommitWrite(Self, bytesCopied);
 
     return STATUS_SUCCESS;
 }
@@ -252,87 +293,32 @@ RingBufferRead(
     _Out_ size_t            *BytesCopied
     )
 {
-    size_t                  availableData;
-    size_t                  dataFromCurrToEnd;
+    RING_BUFFER_SPAN        span;
+    size_t                  bytesToCopy;
 
     ASSERT(Data && (DataSize != 0));
 
-    if (Self->Head >= Self->End)
-    {
-        return STATUS_INTERNAL_ERROR;
-    }
+    RingBufferPeekRead(Self, &span);
 
     //
-    // Get the amount of data available in the buffer
+    // The first step of the copy, up to the end of the buffer ...
     //
-    RingBufferGetAvailableData(Self, &availableData);
+    bytesToCopy = min(DataSize, span.FirstSize);
+    RtlCopyMemory(Data, span.First, bytesToCopy);
+    *BytesCopied = bytesToCopy;
 
-    if (availableData == 0)
-    {
-        *BytesCopied = 0;
-        return STATUS_SUCCESS;
-    }
-
-    if (DataSize > availableData)
-    {
-        DataSize = availableData;
-    }
-
-    *BytesCopied = DataSize;
-
-    if ((Self->Head + DataSize) > Self->End)
-    {
-        //
-        // The data requested by the caller is wrapped around the end of the
-        // buffer. So we'll do the copy in two steps -
-        //    * Copy X bytes from the current position to the end buffer into
-        //      the caller's buffer
-        //    * Copy (DataSize - X) bytes from the beginning to the buffer into
-        //      the caller's buffer
-        //
-
-        //
-        // The first step of the copy ...
-        //
-        dataFromCurrToEnd = Self->End - Self->Head;
-        RtlCopyMemory(Data, Self->Head, dataFromCurrToEnd);
-        Data += dataFromCurrToEnd;
-        DataSize -= dataFromCurrToEnd;
-
-        //
-        // The second step of the copy ...
-        //
-        RtlCopyMemory(Data, Self->Base, DataSize);
-
-        //
-        // Advance the head pointer
-        //
-        Self->Head = Self->Base + DataSize;
-    }
-    else
+    //
+    // ... and the second step, from the beginning of the buffer, if the
+    // data wraps around
+    //
+    bytesToCopy = min(DataSize - bytesToCopy, span.SecondSize);
+    if (bytesToCopy != 0)
     {
-        //
-        // The data in the buffer is NOT wrapped around the end of the buffer.
-        // Simply copy the data over to the caller's buffer in a single step.
-        //
-        RtlCopyMemory(Data, Self->Head, DataSize);
-
-        //
-        // Advance the head pointer
-        //
-        Self->Head += DataSize;
-        if (Self->Head == Self->End)
-        {
-            //
-            // We have exactly reached the end of the buffer. The next
-            // read should wrap around and start from the beginning.
-            //
-            Self->Head = Self->Base;
-        }
+        RtlCopyMemory(Data + *BytesCopied, span.Second, bytesToCopy);
+        *BytesCopied += bytesToCopy;
     }
 
-    ASSERT(Self->Head < Self->End);
+    RingBufferCommitRead(Self, *BytesCopied);
 
     return STATUS_SUCCESS;
 }
-
@@ -13,7 +13,9 @@ Module Name:
 typedef struct _RING_BUFFER
 {
     //
-    // The size in bytes of the ring buffer.
+    // The size in bytes of the ring buffer. Must be a power of two, so that
+    // the free-running counts below can be reduced to an offset with a mask
+    // and stay consistent when they wrap around.
     //
     size_t          Size;
 
@@ -23,61 +25,51 @@ typedef struct _RING_BUFFER
     BYTE*           Base;
 
     //
-    // A pointer to the byte beyond the end of the ring buffer.  Used for
-    // quick comparisons when determining if we need to wrap.
+    // The total number of bytes ever read from the ring buffer. The read
+    // point is Base + (Head & (Size - 1)).
     //
-    BYTE*           End;
-
-    //
-    // A pointer to the current read point in the ring buffer.
-    //
-    // Updates to this are not protected by any lock. This is different from
-    // the write pointer, which is protected by the "pending read pointer"
-    // lock. The reason for this difference is that in this driver, we do not
-    // keep write requests pending. If there is not enough space to write all
-    // the data that was requested, we write as much as we can and drop the
-    // rest (lossy data transfer).
-    //
-    // If we had multiple threads modifying this pointer, then that would
-    // provide yet another reason for protecting updates to the pointer using a
-    // lock. However, in this driver, at any given time we have only one thread
-    // that modifies this pointer (the thread that runs the read callback).
-    // This is true because we use a sequential queue for read requests. If we
-    // were to change our read queue to be a parallel queue, this would no
-    // longer be true.
+    // Only the consumer updates this count, and it does so with release
+    // semantics after it has finished copying the data out, so the producer,
+    // which reads it with acquire semantics, never overwrites bytes that are
+    // still being read.
     //
-    //
-    BYTE*           Head;
+    volatile ULONG_PTR  Head;
 
     //
-    // A pointer to the current write point in the ring buffer.
+    // The total number of bytes ever written to the ring buffer. The write
+    // point is Base + (Tail & (Size - 1)).
     //
-    // Updates to this pointer are protected by the "pending read pointer
-    // lock", because we do not want a consumer thread to mark a read request
-    // as pending while we are in the process of writing data to the buffer.
-    // The reason is that the write that we are currently performing might
-    // actually supply enough data to satisfy the read request, in which case
-    // it should not be marked pending at all.
-    // If the read request were to be marked pending in the situation described
-    // above, then we would need some trigger to later retrieve the request and
-    // complete it. In our driver, arrival of data is the only event that can
-    // trigger this. So if no more data arrives, the request will remain
-    // pending forever, even though there is enough data in the buffer to
-    // complete it. Hence we do not keep a read request pending in situations
-    // where the read buffer contains enough data to satisfy it.
+    // Only the producer updates this count, and it does so with release
+    // semantics after it has finished copying the data in, so the consumer,
+    // which reads it with acquire semantics, never sees bytes before they
+    // are written.
     //
-    // If we had multiple threads modifying this pointer, then that would
-    // provide yet another reason for protecting updates to the pointer using a
-    // lock. However, in this driver, at any given time we have only one thread
-    // that modifies this pointer (the thread that runs the write callback).
-    // This is true because we use a sequential queue for write requests. If we
-    // were to change our write queue to be a parallel queue, this would no
-    // longer be true.
+    // The ring buffer itself takes no lock. The data in the buffer is
+    // Tail - Head bytes, so the buffer can be completely filled, and a
+    // producer and a consumer can run at the same time. Callers must still
+    // make sure there is only one producer and one consumer at any given
+    // time. In this driver the read and write callbacks run on a parallel
+    // queue, so each side takes its own lock (see queue.c).
     //
-    BYTE*           Tail;
+    volatile ULONG_PTR  Tail;
 
 } RING_BUFFER, *PRING_BUFFER;
 
+//
+// The free space or the data in the ring buffer, as at most two contiguous
+// regions: one up to the end of the buffer, and one from its start when the
+// region wraps around. Lets callers copy directly between request memory
+// and the ring buffer.
+//
+typedef struct _RING_BUFFER_SPAN
+{
+    BYTE*           First;
+    size_t          FirstSize;
+    BYTE*           Second;
+    size_t          SecondSize;
+
+} RING_BUFFER_SPAN, *PRING_BUFFER_SPAN;
+
 
 VOID
 RingBufferInitialize(
@@ -87,6 +79,39 @@ RingBufferInitialize(
     _In_  size_t            BufferSize
     );
 
+VOID
+RingBufferPeekWrite(
+    _In_  PRING_BUFFER      Self,
+    _Out_ PRING_BUFFER_SPAN Span
+    );
+
+VOID
+RingBufferCommitWrite(
+    _In_  PRING_BUFFER      Self,
+    _In_  size_t            BytesWritten
+    );
+
+VOID
+RingBufferPeekRead(
+    _In_  PRING_BUFFER      Self,
+    _Out_ PRING_BUFFER_SPAN Span
+    );
+
+VOID
+RingBufferCommitRead(
+    _In_  PRING_BUFFER      Self,
+    _In_  size_t            BytesRead
+    );
+
+size_t
+RingBufferSpanCopyTo(
+    _In_  PRING_BUFFER_SPAN Span,
+    _In_  size_t            Offset,
+    _In_reads_bytes_(DataSize)
+          const BYTE*       Data,
+    _In_  size_t            DataSize
+    );
+
 NTSTATUS
 RingBufferWrite(
     _In_  PRING_BUFFER      Self,
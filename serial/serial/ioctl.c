@@ -419,6 +419,14 @@ Return Value:
    //
    WRITE_FIFO_CONTROL(Extension, Extension->Controller, (UCHAR)*Result);
 
+   //
+   // Keep track of the receive trigger level the isr now gets.
+   //
+   Extension->RxFifoTrigger = (UCHAR)((*Result & SERIAL_FCR_ENABLE) ?
+                                      (*Result & SERIAL_14_BYTE_HIGH_WATER) :
+                                      SERIAL_1_BYTE_HIGH_WATER);
+   Extension->RxFifoTriggerRun = 0;
+
    return FALSE;
 }
 
@@ -278,6 +278,55 @@ Return Value:
                     // It may also reveal a new interrupt cause.
                     //
                     UCHAR ReceivedChar;
+                    UCHAR RxFifoTrigger;
+
+                    //
+                    // Remember the trigger level that raised this
+                    // interrupt before it is possibly adapted below.
+                    //
+
+                    RxFifoTrigger = (InterruptIdReg == SERIAL_IIR_RDA) ?
+                                    Extension->RxFifoTrigger :
+                                    SERIAL_1_BYTE_HIGH_WATER;
+
+                    if (InterruptIdReg == SERIAL_IIR_RDA) {
+
+                        SerialAdaptRxFifoTrigger(
+                            Extension,
+                            FALSE
+                            );
+
+                    }
+
+                    //
+                    // If none of the per character processing below
+                    // applies, take what is in the fifo in one burst.
+                    // The burst stops either with the fifo empty, or with
+                    // a line status error on the next character, which
+                    // we then receive the usual way.
+                    //
+
+                    if (!Extension->EscapeChar &&
+                        !Extension->CountSinceXoff &&
+                        !Extension->UartRemovalDetect &&
+                        !(Extension->IsrWaitMask & SERIAL_EV_RXFLAG) &&
+                        !(Extension->HandFlow.FlowReplace &
+                          (SERIAL_NULL_STRIPPING | SERIAL_AUTO_TRANSMIT)) &&
+                        !(Extension->HandFlow.ControlHandShake &
+                          SERIAL_DSR_SENSITIVITY)) {
+
+                        tempLSR = SerialReceiveBurst(
+                                      Extension,
+                                      RxFifoTrigger
+                                      );
+
+                        if (!(tempLSR & SERIAL_LSR_DR)) {
+
+                            break;
+
+                        }
+
+                    }
 
                     do {
 
@@ -1221,6 +1270,250 @@ Return Value:
 
 }
 
+UCHAR
+SerialReceiveBurst(
+    IN PSERIAL_DEVICE_EXTENSION Extension,
+    IN UCHAR RxFifoTrigger
+    )
+
+/*++
+
+Routine Description:
+
+    This routine, which only runs at device level, empties the
+    receive fifo when the received characters need no individual
+    processing: no null stripping, no xon/xoff or event character
+    recognition, no dsr sensitivity, no xoff counter and no line
+    status insertion.
+
+    A receive data available interrupt means the fifo holds at least
+    as many characters as the trigger level, so that many are read
+    without polling the line status register in between.  After that
+    the line status is checked before each character as usual.
+
+    While a read is pending the characters go straight into the
+    users buffer.
+
+Arguments:
+
+    Extension - The serial device extension.
+
+    RxFifoTrigger - The receive fifo trigger level that raised a receive
+                    data available interrupt, or SERIAL_1_BYTE_HIGH_WATER
+                    for a character timeout.  The caller captures it
+                    before the trigger level is adapted.
+
+Return Value:
+
+    The last value of the line status register.  If it still shows
+    data ready, the next character has a line status error which has
+    already been processed, and the character itself still needs to
+    be received.
+
+--*/
+
+{
+    //
+    // The number of characters each encoded trigger level stands for.
+    // Deeper fifos using the same encoding trigger no earlier.
+    //
+    static const UCHAR TriggerDepth[] = { 1, 4, 8, 14 };
+
+    PREQUEST_CONTEXT reqContext = NULL;
+    ULONG CharsKnown;
+    ULONG CharsReceived = 0;
+    UCHAR LineStatus;
+    UCHAR ReceivedChar;
+
+    if (Extension->FifoPresent) {
+
+        CharsKnown = TriggerDepth[RxFifoTrigger >> 6];
+
+    } else {
+
+        CharsKnown = 1;
+
+    }
+
+    //
+    // The fifo error bit is set as long as any character in the fifo
+    // has a line status error, so while the line status shows nothing
+    // but data ready we can take the characters we know about without
+    // looking at it again.
+    //
+
+    LineStatus = SerialProcessLSR(Extension);
+
+    while ((LineStatus & ~(SERIAL_LSR_THRE | SERIAL_LSR_TEMT)) ==
+           SERIAL_LSR_DR) {
+
+        do {
+
+            ReceivedChar =
+                READ_RECEIVE_BUFFER(Extension, Extension->Controller);
+
+            ReceivedChar &= Extension->ValidDataMask;
+
+            //
+            // If a read is pending and this is not the character
+            // that fills it, store it directly.  Anything else,
+            // including completing the read, is up to SerialPutChar.
+            //
+
+            if ((Extension->ReadBufferBase !=
+                 Extension->InterruptReadBuffer) &&
+                (Extension->CurrentCharSlot !=
+                 Extension->LastCharSlot)) {
+
+                *Extension->CurrentCharSlot = ReceivedChar;
+                Extension->CurrentCharSlot++;
+                Extension->ReadByIsr++;
+
+            } else {
+
+                SerialPutChar(
+                    Extension,
+                    ReceivedChar
+                    );
+
+            }
+
+            CharsReceived++;
+
+        } while (--CharsKnown);
+
+        CharsKnown = 1;
+
+        LineStatus = SerialProcessLSR(Extension);
+
+    }
+
+    if (!CharsReceived) {
+
+        return LineStatus;
+
+    }
+
+    Extension->PerfStats.ReceivedCount += CharsReceived;
+    Extension->WmiPerfData.ReceivedCount += CharsReceived;
+
+    //
+    // Note the receive character event once for the whole burst.
+    //
+
+    if (Extension->IsrWaitMask & SERIAL_EV_RXCHAR) {
+
+        Extension->HistoryMask |= SERIAL_EV_RXCHAR;
+
+        if (Extension->IrpMaskLocation) {
+
+            *Extension->IrpMaskLocation =
+             Extension->HistoryMask;
+            Extension->IrpMaskLocation = NULL;
+            Extension->HistoryMask = 0;
+            reqContext = SerialGetRequestContext(Extension->CurrentWaitRequest);
+            reqContext->Information = sizeof(ULONG);
+            SerialInsertQueueDpc(
+                Extension->CommWaitDpc
+                );
+
+        }
+
+    }
+
+    return LineStatus;
+
+}
+
+VOID
+SerialAdaptRxFifoTrigger(
+    IN PSERIAL_DEVICE_EXTENSION Extension,
+    IN BOOLEAN Overrun
+    )
+
+/*++
+
+Routine Description:
+
+    This routine, which only runs at device level, tunes the receive
+    fifo trigger level when that has been enabled via the registry.
+
+    A high trigger level means fewer interrupts per character, but
+    leaves less room in the fifo to cover the time until the isr
+    runs.  So on an overrun the trigger level drops one step, and
+    after SERIAL_RX_FIFO_RAISE_COUNT receive data available
+    interrupts without an overrun it goes up one step again.
+
+Arguments:
+
+    Extension - The serial device extension.
+
+    Overrun - TRUE if the receive fifo overran, FALSE for a receive
+              data available interrupt.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    UCHAR RxFifoTrigger = Extension->RxFifoTrigger;
+
+    if (!Extension->RxFifoAdaptive || !Extension->FifoPresent) {
+
+        return;
+
+    }
+
+    //
+    // The encoded trigger levels are SERIAL_4_BYTE_HIGH_WATER apart.
+    //
+
+    if (Overrun) {
+
+        Extension->RxFifoTriggerRun = 0;
+
+        if (RxFifoTrigger == SERIAL_1_BYTE_HIGH_WATER) {
+
+            return;
+
+        }
+
+        RxFifoTrigger = (UCHAR)(RxFifoTrigger - SERIAL_4_BYTE_HIGH_WATER);
+
+    } else {
+
+        if (++Extension->RxFifoTriggerRun < SERIAL_RX_FIFO_RAISE_COUNT) {
+
+            return;
+
+        }
+
+        Extension->RxFifoTriggerRun = 0;
+
+        if (RxFifoTrigger == SERIAL_14_BYTE_HIGH_WATER) {
+
+            return;
+
+        }
+
+        RxFifoTrigger = (UCHAR)(RxFifoTrigger + SERIAL_4_BYTE_HIGH_WATER);
+
+    }
+
+    //
+    // Without the reset bits this leaves the contents of the fifos
+    // alone.
+    //
+
+    Extension->RxFifoTrigger = RxFifoTrigger;
+
+    WRITE_FIFO_CONTROL(Extension, Extension->Controller,
+                       (UCHAR)(SERIAL_FCR_ENABLE | RxFifoTrigger));
+
+}
+
 UCHAR
 SerialProcessLSR(
     IN PSERIAL_DEVICE_EXTENSION Extension
@@ -1310,6 +1603,11 @@ Return Value:
             Extension->WmiPerfData.SerialOverrunErrorCount++;
             Extension->ErrorWord |= SERIAL_ERROR_OVERRUN;
 
+            SerialAdaptRxFifoTrigger(
+                Extension,
+                TRUE
+                );
+
             if (Extension->HandFlow.FlowReplace &
                 SERIAL_ERROR_CHAR) {
 
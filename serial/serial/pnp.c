@@ -421,6 +421,7 @@ Return Value:
 
     pDevExt->TxFifoAmount           = driverDefaults.TxFIFODefault;
     pDevExt->UartRemovalDetect      = driverDefaults.UartRemovalDetect;
+    pDevExt->RxFifoAdaptive         = driverDefaults.RxFifoAdaptive;
     pDevExt->CreatedSymbolicLink    = FALSE;
     pDevExt->OwnsPowerPolicy = relinquishPowerPolicy ? FALSE : TRUE;
 
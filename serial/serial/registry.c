@@ -241,6 +241,19 @@ Return Value:
         DriverDefaultsPtr->UartRemovalDetect = 0;
     }
 
+    status = RtlUnicodeStringPrintf(&valueName,L"RxFIFOAdaptive");
+    if (!NT_SUCCESS (status)) {
+            goto End;
+    }
+
+    status = WdfRegistryQueryULong (hKey,
+              &valueName,
+              &DriverDefaultsPtr->RxFifoAdaptive);
+
+    if (!NT_SUCCESS (status)) {
+        DriverDefaultsPtr->RxFifoAdaptive = 0;
+    }
+
 
 End:
        WdfRegistryClose(hKey);
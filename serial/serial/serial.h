@@ -26,6 +26,13 @@ Abstract:
 #define SERIAL_PERMIT_SHARE_DEFAULT     0
 #define SERIAL_LOG_FIFO_DEFAULT         0
 
+//
+// With adaptive receive fifo triggering enabled, the isr raises the
+// trigger level one step after this many trigger level interrupts
+// in a row without a receive overrun.
+//
+#define SERIAL_RX_FIFO_RAISE_COUNT      256
+
 
 //
 // This define gives the default Object directory
@@ -472,6 +479,7 @@ typedef struct _SERIAL_FIRMWARE_DATA {
     ULONG           PermitSystemWideShare;
     ULONG           LogFifoDefault;
     ULONG           UartRemovalDetect;
+    ULONG           RxFifoAdaptive;
     UNICODE_STRING  Directory;
     UNICODE_STRING  NtNameSuffix;
     UNICODE_STRING  DirectorySymbolicName;
@@ -610,6 +618,16 @@ typedef struct _SERIAL_DEVICE_EXTENSION {
     //
     ULONG UartRemovalDetect;
 
+    //
+    // If non-zero the isr tunes RxFifoTrigger to the traffic.  It
+    // lowers the trigger level when the receive fifo overruns, and
+    // raises it again after SERIAL_RX_FIFO_RAISE_COUNT trigger level
+    // interrupts without one.  RxFifoTriggerRun counts those
+    // interrupts.  Both are only used at interrupt level.
+    //
+    ULONG RxFifoAdaptive;
+    ULONG RxFifoTriggerRun;
+
     //
     // We keep track of whether the somebody has the device currently
     // opened with a simple boolean.  We need to know this so that
@@ -1172,6 +1190,10 @@ typedef struct _SERIAL_DEVICE_EXTENSION {
     // set to when the fifo is turned on.  This is not the actual
     // value, but the encoded value that goes into the register.
     //
+    // It must always match what was last written to the fifo
+    // control register, since the isr relies on it to know how
+    // many characters a receive data available interrupt implies.
+    //
     UCHAR RxFifoTrigger;
 
     //
@@ -263,6 +263,18 @@ SerialPutChar(
     IN UCHAR CharToPut
     );
 
+UCHAR
+SerialReceiveBurst(
+    IN PSERIAL_DEVICE_EXTENSION Extension,
+    IN UCHAR RxFifoTrigger
+    );
+
+VOID
+SerialAdaptRxFifoTrigger(
+    IN PSERIAL_DEVICE_EXTENSION Extension,
+    IN BOOLEAN Overrun
+    );
+
 NTSTATUS
 SerialGetConfigDefaults(
     IN PSERIAL_FIRMWARE_DATA DriverDefaultsPtr,
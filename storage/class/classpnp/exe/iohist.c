@@ -0,0 +1,369 @@
+/*++
+
+Copyright (c) Microsoft Corporation
+
+Module Name:
+
+    iohist.c
+
+Abstract:
+
+    Win32 application that reads the I/O completion history classpnp keeps
+    for a disk through IOCTL_CLASS_GET_IO_HISTORY and bins the records by
+    LBA region.
+
+    Without a sample count it prints the latency of each region for the
+    records currently in the history. With a sample count it polls the
+    history once per interval and prints one row per interval with the
+    IOPS each region received, followed by the latency of each region for
+    the records seen while sampling.
+
+Environment:
+
+    User mode.
+
+Notes:
+
+    The history holds the last CLASS_IO_HISTORY_RING_SIZE completions. If
+    more than that complete during one interval, the oldest are lost and
+    are reported as dropped.
+
+--*/
+
+#include <windows.h>
+#include <winioctl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strsafe.h>
+#define _NTSCSI_USER_MODE_
+#include <scsi.h>
+#include "iohist.h"
+
+#define DEFAULT_REGION_COUNT    16
+#define MAX_REGION_COUNT        64
+#define DEFAULT_INTERVAL_MS     1000
+#define NAME_COUNT              64
+
+#ifndef SRB_STATUS_SUCCESS
+#define SRB_STATUS_SUCCESS      0x01
+#endif
+
+//
+// Times in the history are in 100ns units.
+//
+#define HUNDRED_NS_TO_US(_t_)   ((_t_) / 10)
+
+typedef struct _REGION_STATISTICS {
+    ULONG     Reads;
+    ULONG     Writes;
+    ULONG     Errors;
+    ULONG     MaxServiceTime;
+    ULONGLONG TotalServiceTime;
+    ULONGLONG TotalQueueTime;
+} REGION_STATISTICS, *PREGION_STATISTICS;
+
+BOOLEAN
+IsWriteOperation(
+    _In_ UCHAR OperationCode
+    )
+{
+    return (OperationCode == SCSIOP_WRITE6 ||
+            OperationCode == SCSIOP_WRITE ||
+            OperationCode == SCSIOP_WRITE12 ||
+            OperationCode == SCSIOP_WRITE16);
+}
+
+ULONG
+RegionOfRecord(
+    _In_ PCLASS_IO_HISTORY_RECORD Record,
+    _In_ ULONGLONG DiskBlocks,
+    _In_ ULONG RegionCount
+    )
+{
+    ULONGLONG region;
+
+    if (DiskBlocks == 0) {
+        return 0;
+    }
+
+    region = (Record->LogicalBlockAddress * RegionCount) / DiskBlocks;
+
+    return (region < RegionCount) ? (ULONG)region : RegionCount - 1;
+}
+
+VOID
+AddRecord(
+    _Inout_ PREGION_STATISTICS Region,
+    _In_ PCLASS_IO_HISTORY_RECORD Record
+    )
+{
+    if (IsWriteOperation(Record->OperationCode)) {
+        Region->Writes++;
+    } else {
+        Region->Reads++;
+    }
+
+    if (Record->SrbStatus != SRB_STATUS_SUCCESS) {
+        Region->Errors++;
+    }
+
+    Region->TotalServiceTime += Record->ServiceTime;
+    Region->TotalQueueTime += Record->QueueTime;
+    Region->MaxServiceTime = max(Region->MaxServiceTime, Record->ServiceTime);
+}
+
+BOOL
+GetIoHistory(
+    _In_ HANDLE DeviceHandle,
+    _Out_writes_bytes_(HistoryLength) PCLASS_IO_HISTORY History,
+    _In_ ULONG HistoryLength
+    )
+{
+    ULONG returned = 0;
+
+    if (!DeviceIoControl(DeviceHandle,
+                         IOCTL_CLASS_GET_IO_HISTORY,
+                         NULL,
+                         0,
+                         History,
+                         HistoryLength,
+                         &returned,
+                         NULL)) {
+        printf("IOCTL_CLASS_GET_IO_HISTORY failed with error %d\n", GetLastError());
+        return FALSE;
+    }
+
+    if (returned < FIELD_OFFSET(CLASS_IO_HISTORY, Records) ||
+        History->Version != CLASS_IO_HISTORY_VERSION) {
+        printf("Unexpected I/O history version %u\n", History->Version);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+VOID
+PrintLatencyMap(
+    _In_reads_(RegionCount) PREGION_STATISTICS Regions,
+    _In_ ULONG RegionCount,
+    _In_ ULONGLONG DiskBlocks
+    )
+{
+    ULONG i;
+    ULONG count;
+
+    printf("\nregion  start LBA            reads   writes  errors  avg svc us  max svc us  avg queue us\n");
+
+    for (i = 0; i < RegionCount; i++) {
+
+        count = Regions[i].Reads + Regions[i].Writes;
+
+        printf("%6u  %-18I64u  %6u   %6u  %6u  %10I64u  %10u  %12I64u\n",
+               i,
+               (DiskBlocks * i) / RegionCount,
+               Regions[i].Reads,
+               Regions[i].Writes,
+               Regions[i].Errors,
+               count ? HUNDRED_NS_TO_US(Regions[i].TotalServiceTime / count) : 0,
+               HUNDRED_NS_TO_US(Regions[i].MaxServiceTime),
+               count ? HUNDRED_NS_TO_US(Regions[i].TotalQueueTime / count) : 0);
+    }
+}
+
+VOID
+PrintPacketStatistics(
+    _In_ PCLASS_TRANSFER_PACKET_STATISTICS Statistics
+    )
+{
+    printf("\npackets submitted %I64d, retried %I64d, failed %I64d, recovered %I64d\n",
+           Statistics->PacketsSubmitted,
+           Statistics->PacketsRetried,
+           Statistics->PacketsFailed,
+           Statistics->PacketsRecovered);
+    printf("packets allocated %I64d, low-memory retry steps %I64d\n",
+           Statistics->PacketsAllocated,
+           Statistics->LowMemRetrySteps);
+}
+
+VOID
+__cdecl
+main(
+    _In_ int argc,
+    _In_z_ char *argv[]
+    )
+{
+    HANDLE deviceHandle = INVALID_HANDLE_VALUE;
+    PCLASS_IO_HISTORY history = NULL;
+    ULONG historyLength;
+    GET_LENGTH_INFORMATION lengthInfo;
+    REGION_STATISTICS regions[MAX_REGION_COUNT];
+    ULONG rowCounts[MAX_REGION_COUNT];
+    ULONG regionCount = DEFAULT_REGION_COUNT;
+    ULONG samples = 0;
+    ULONG sample;
+    ULONG intervalMs = DEFAULT_INTERVAL_MS;
+    ULONGLONG diskBlocks;
+    ULONGLONG lastSequence;
+    ULONGLONG dropped = 0;
+    ULONG returned;
+    ULONG region;
+    ULONG i;
+    CHAR string[NAME_COUNT];
+
+    if ((argc < 2) || (argc > 5)) {
+        printf("Usage:  %s <disk> [regions] [samples] [interval ms]\n", argv[0]);
+        printf("Examples:\n");
+        printf("    iohist PhysicalDrive0           (latency of 16 LBA regions over the current history)\n");
+        printf("    iohist PhysicalDrive1 32 60     (IOPS of 32 LBA regions, once a second for a minute)\n");
+        return;
+    }
+
+    if (argc > 2) {
+        regionCount = atoi(argv[2]);
+        if (regionCount == 0 || regionCount > MAX_REGION_COUNT) {
+            printf("The number of regions must be between 1 and %d\n", MAX_REGION_COUNT);
+            return;
+        }
+    }
+
+    if (argc > 3) {
+        samples = atoi(argv[3]);
+    }
+
+    if (argc > 4) {
+        intervalMs = atoi(argv[4]);
+        if (intervalMs == 0) {
+            printf("The interval must be at least 1 ms\n");
+            return;
+        }
+    }
+
+    StringCbPrintf(string, sizeof(string), "\\\\.\\%s", argv[1]);
+
+    deviceHandle = CreateFile(string,
+                              GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              NULL,
+                              OPEN_EXISTING,
+                              0,
+                              NULL);
+
+    if (deviceHandle == INVALID_HANDLE_VALUE) {
+        printf("Error opening %s. Error: %d\n", string, GetLastError());
+        return;
+    }
+
+    if (!DeviceIoControl(deviceHandle,
+                         IOCTL_DISK_GET_LENGTH_INFO,
+                         NULL,
+                         0,
+                         &lengthInfo,
+                         sizeof(lengthInfo),
+                         &returned,
+                         NULL)) {
+        printf("IOCTL_DISK_GET_LENGTH_INFO failed with error %d\n", GetLastError());
+        goto Cleanup;
+    }
+
+    //
+    // Room for the whole ring, so one call returns every record available.
+    //
+    historyLength = FIELD_OFFSET(CLASS_IO_HISTORY, Records) +
+                    CLASS_IO_HISTORY_RING_SIZE * sizeof(CLASS_IO_HISTORY_RECORD);
+
+    history = (PCLASS_IO_HISTORY)malloc(historyLength);
+    if (history == NULL) {
+        printf("Out of memory\n");
+        goto Cleanup;
+    }
+
+    if (!GetIoHistory(deviceHandle, history, historyLength)) {
+        goto Cleanup;
+    }
+
+    diskBlocks = (ULONGLONG)lengthInfo.Length.QuadPart /
+                 (history->BytesPerBlock ? history->BytesPerBlock : 512);
+
+    ZeroMemory(regions, sizeof(regions));
+
+    if (samples == 0) {
+
+        for (i = 0; i < history->RecordsReturned; i++) {
+            region = RegionOfRecord(&history->Records[i], diskBlocks, regionCount);
+            AddRecord(&regions[region], &history->Records[i]);
+        }
+
+        printf("%u of %u records, %I64u blocks of %u bytes\n",
+               history->RecordsReturned, history->RecordCount,
+               diskBlocks, history->BytesPerBlock);
+
+        PrintLatencyMap(regions, regionCount, diskBlocks);
+        PrintPacketStatistics(&history->Statistics);
+        goto Cleanup;
+    }
+
+    //
+    // Only records completed after the first call are sampled.
+    //
+    lastSequence = history->NextSequence - 1;
+
+    printf("IOPS per region, %u ms intervals\n\nsample", intervalMs);
+    for (i = 0; i < regionCount; i++) {
+        printf(" %5u", i);
+    }
+    printf("\n");
+
+    for (sample = 1; sample <= samples; sample++) {
+
+        Sleep(intervalMs);
+
+        if (!GetIoHistory(deviceHandle, history, historyLength)) {
+            goto Cleanup;
+        }
+
+        ZeroMemory(rowCounts, sizeof(rowCounts));
+
+        for (i = 0; i < history->RecordsReturned; i++) {
+
+            PCLASS_IO_HISTORY_RECORD record = &history->Records[i];
+
+            if (record->Sequence <= lastSequence) {
+                continue;
+            }
+
+            //
+            // Records are returned oldest first, a gap in the sequence is
+            // a record that was overwritten before it could be read.
+            //
+            dropped += record->Sequence - lastSequence - 1;
+            lastSequence = record->Sequence;
+
+            region = RegionOfRecord(record, diskBlocks, regionCount);
+            AddRecord(&regions[region], record);
+            rowCounts[region]++;
+        }
+
+        printf("%6u", sample);
+        for (i = 0; i < regionCount; i++) {
+            printf(" %5I64u", ((ULONGLONG)rowCounts[i] * 1000) / intervalMs);
+        }
+        printf("\n");
+    }
+
+    PrintLatencyMap(regions, regionCount, diskBlocks);
+    PrintPacketStatistics(&history->Statistics);
+
+    if (dropped != 0) {
+        printf("%I64u records were dropped, sample more often\n", dropped);
+    }
+
+Cleanup:
+
+    if (history != NULL) {
+        free(history);
+    }
+
+    CloseHandle(deviceHandle);
+
+    return;
+}
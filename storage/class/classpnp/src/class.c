@@ -8614,6 +8614,28 @@ ClassDeviceControl(
             break;
         }
 
+        case IOCTL_CLASS_GET_IO_HISTORY: {
+
+            FREE_POOL(srb);
+
+            if (!commonExtension->IsFdo) {
+
+                IoCopyCurrentIrpStackLocationToNext(Irp);
+
+                ClassReleaseRemoveLock(DeviceObject, Irp);
+                status = IoCallDriver(commonExtension->LowerDeviceObject, Irp);
+
+            } else {
+
+                status = ClasspGetIoHistory(DeviceObject, Irp);
+
+                Irp->IoStatus.Status = status;
+                ClassReleaseRemoveLock(DeviceObject, Irp);
+                ClassCompleteRequest(DeviceObject, Irp, IO_NO_INCREMENT);
+            }
+            break;
+        }
+
         case IOCTL_STORAGE_EVENT_NOTIFICATION: {
 
             FREE_POOL(srb);
@@ -66,6 +66,8 @@ Revision History:
 #define DEBUG_COMP_ID   DPFLTR_CLASSPNP_ID
 #endif
 
+#include "iohist.h"
+
 //
 // Include header file and setup GUID for tracing
 //
@@ -588,6 +590,12 @@ typedef struct _TRANSFER_PACKET {
         // The time at which this request was sent to port driver.
         ULONGLONG RequestStartTime;
 
+        // The time at which this read/write packet was set up, and the number
+        // of times it has been retried since. Used for the I/O completion
+        // history.
+        ULONGLONG RequestSetupTime;
+        ULONG RequestRetryCount;
+
 #if (NTDDI_VERSION >= NTDDI_WIN8)
         // ActivityId that is associated with the IRP that this transfer packet services.
         GUID ActivityId;
@@ -968,6 +976,18 @@ struct _CLASS_PRIVATE_FDO_DATA {
     //
     BOOLEAN DisableThrottling;
 
+    //
+    // Transfer packet overhead counters.
+    //
+    CLASS_TRANSFER_PACKET_STATISTICS PacketStatistics;
+
+    //
+    // Ring of the last CLASS_IO_HISTORY_RING_SIZE read/write completions,
+    // and the sequence number of the next record to be logged into it.
+    //
+    PCLASS_IO_HISTORY_RECORD IoHistoryRing;
+    volatile LONG64 IoHistoryNextSequence;
+
 };
 
 //
@@ -2333,6 +2353,17 @@ HistoryLogReturnedPacket(
         }                                      \
     }
 
+VOID
+HistoryLogCompletedIo(
+    TRANSFER_PACKET *Pkt
+    );
+
+NTSTATUS
+ClasspGetIoHistory(
+    _In_ PDEVICE_OBJECT DeviceObject,
+    _Inout_ PIRP Irp
+    );
+
 BOOLEAN
 InterpretSenseInfoWithoutHistory(
     _In_  PDEVICE_OBJECT Fdo,
@@ -144,3 +144,142 @@ VOID HistoryLogReturnedPacket(TRANSFER_PACKET *Pkt) {
     return;
 }
 
+
+VOID HistoryLogCompletedIo(TRANSFER_PACKET *Pkt) {
+
+    PFUNCTIONAL_DEVICE_EXTENSION fdoExtension = Pkt->Fdo->DeviceExtension;
+    PCLASS_PRIVATE_FDO_DATA fdoData = fdoExtension->PrivateFdoData;
+    PCLASS_IO_HISTORY_RECORD record;
+    PCDB cdb;
+    LONG64 sequence;
+    ULONGLONG completionTime;
+    ULONGLONG queueTime;
+    ULONGLONG serviceTime;
+
+    // only read/write packets are stamped at setup time
+    if ((fdoData->IoHistoryRing == NULL) || (Pkt->RequestSetupTime == 0)) {
+        return;
+    }
+
+    completionTime = (ULONGLONG)ClasspGetCurrentTime().QuadPart;
+    queueTime = Pkt->RequestStartTime - Pkt->RequestSetupTime;
+    serviceTime = completionTime - Pkt->RequestStartTime;
+
+    // claim the next slot; the ring simply wraps over the oldest record
+    sequence = InterlockedIncrement64(&fdoData->IoHistoryNextSequence);
+    record = &fdoData->IoHistoryRing[(sequence - 1) & (CLASS_IO_HISTORY_RING_SIZE - 1)];
+
+    // mark the slot as being rewritten so that a concurrent reader skips it
+    InterlockedExchange64((volatile LONG64 *)&record->Sequence, 0);
+
+    cdb = SrbGetCdb(Pkt->Srb);
+    record->OperationCode = (cdb != NULL) ? cdb->AsByte[0] : 0;
+    record->LogicalBlockAddress = (ULONGLONG)Pkt->TargetLocationCopy.QuadPart >> fdoExtension->SectorShift;
+    record->TransferLength = Pkt->BufLenCopy;
+    record->QueueTime = (ULONG)min(queueTime, MAXULONG);
+    record->ServiceTime = (ULONG)min(serviceTime, MAXULONG);
+    record->SrbStatus = SRB_STATUS(Pkt->Srb->SrbStatus);
+    record->ScsiStatus = SrbGetScsiStatus(Pkt->Srb);
+    record->RetryCount = (UCHAR)min(Pkt->RequestRetryCount, MAXUCHAR);
+
+    // publish the record
+    InterlockedExchange64((volatile LONG64 *)&record->Sequence, sequence);
+
+    Pkt->RequestSetupTime = 0;
+    return;
+}
+
+NTSTATUS
+ClasspGetIoHistory(
+    _In_ PDEVICE_OBJECT DeviceObject,
+    _Inout_ PIRP Irp
+    )
+/*++
+
+Routine Description:
+
+    This routine handles IOCTL_CLASS_GET_IO_HISTORY. It returns the transfer
+    packet statistics for the device along with as many of the most recent
+    I/O completion records as fit in the output buffer, oldest first.
+
+    Records that are overwritten while being copied are dropped, so the
+    returned records may not be contiguous in sequence.
+
+Arguments:
+
+    DeviceObject - Supplies the FDO.
+    Irp - Supplies the IOCTL_CLASS_GET_IO_HISTORY request.
+
+Return Value:
+
+    NTSTATUS code; Irp->IoStatus.Information is set to the number of bytes
+    returned.
+
+--*/
+{
+    PFUNCTIONAL_DEVICE_EXTENSION fdoExtension = DeviceObject->DeviceExtension;
+    PCLASS_PRIVATE_FDO_DATA fdoData = fdoExtension->PrivateFdoData;
+    PIO_STACK_LOCATION irpStack = IoGetCurrentIrpStackLocation(Irp);
+    PCLASS_IO_HISTORY history = Irp->AssociatedIrp.SystemBuffer;
+    ULONG outputLength = irpStack->Parameters.DeviceIoControl.OutputBufferLength;
+    ULONG headerLength = FIELD_OFFSET(CLASS_IO_HISTORY, Records);
+    PCLASS_IO_HISTORY_RECORD record;
+    LONG64 logged;
+    LONG64 sequence;
+    ULONG available;
+    ULONG room;
+    ULONG returned = 0;
+
+    if (outputLength < headerLength) {
+        Irp->IoStatus.Information = headerLength;
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    logged = ReadNoFence64(&fdoData->IoHistoryNextSequence);
+    available = (fdoData->IoHistoryRing == NULL) ? 0 : (ULONG)min(logged, CLASS_IO_HISTORY_RING_SIZE);
+    room = (outputLength - headerLength) / sizeof(CLASS_IO_HISTORY_RECORD);
+
+    RtlZeroMemory(history, headerLength);
+    history->Version = CLASS_IO_HISTORY_VERSION;
+    history->BytesPerBlock = fdoExtension->DiskGeometry.BytesPerSector;
+    history->RecordCount = available;
+    history->NextSequence = (ULONGLONG)logged + 1;
+    history->Statistics.PacketsSubmitted = ReadNoFence64(&fdoData->PacketStatistics.PacketsSubmitted);
+    history->Statistics.PacketsRetried = ReadNoFence64(&fdoData->PacketStatistics.PacketsRetried);
+    history->Statistics.PacketsFailed = ReadNoFence64(&fdoData->PacketStatistics.PacketsFailed);
+    history->Statistics.PacketsRecovered = ReadNoFence64(&fdoData->PacketStatistics.PacketsRecovered);
+    history->Statistics.PacketsAllocated = ReadNoFence64(&fdoData->PacketStatistics.PacketsAllocated);
+    history->Statistics.LowMemRetrySteps = ReadNoFence64(&fdoData->PacketStatistics.LowMemRetrySteps);
+
+    if ((room == 0) && (available != 0)) {
+        history->Size = headerLength;
+        Irp->IoStatus.Information = headerLength;
+        return STATUS_BUFFER_OVERFLOW;
+    }
+
+    for (sequence = logged - (LONG64)min(room, available) + 1; sequence <= logged; sequence++) {
+
+        record = &fdoData->IoHistoryRing[(sequence - 1) & (CLASS_IO_HISTORY_RING_SIZE - 1)];
+
+        if (ReadAcquire64((volatile LONG64 *)&record->Sequence) != sequence) {
+            continue;
+        }
+
+        history->Records[returned] = *record;
+
+        // drop the copy if the slot was reused while we were copying it
+        KeMemoryBarrier();
+        if (ReadNoFence64((volatile LONG64 *)&record->Sequence) != sequence) {
+            continue;
+        }
+
+        history->Records[returned].Sequence = (ULONGLONG)sequence;
+        returned++;
+    }
+
+    history->RecordsReturned = returned;
+    history->Size = headerLength + (returned * sizeof(CLASS_IO_HISTORY_RECORD));
+    Irp->IoStatus.Information = history->Size;
+
+    return STATUS_SUCCESS;
+}
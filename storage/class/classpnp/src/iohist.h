@@ -0,0 +1,92 @@
+/*++
+
+Copyright (C) Microsoft Corporation, 1991 - 2010
+
+Module Name:
+
+    iohist.h
+
+Abstract:
+
+    Definitions shared between CLASSPNP and user mode tools for retrieving
+    the per-device I/O completion history and transfer packet statistics.
+
+Environment:
+
+    kernel and user mode
+
+Notes:
+
+
+Revision History:
+
+--*/
+
+#ifndef _CLASS_IOHIST_H_
+#define _CLASS_IOHIST_H_
+
+//
+// Returns a CLASS_IO_HISTORY structure for the device (FDO only).
+//
+// Input:  none
+// Output: CLASS_IO_HISTORY, followed by as many CLASS_IO_HISTORY_RECORDs as
+//         fit in the output buffer, oldest first. If the buffer can hold only
+//         the header, STATUS_BUFFER_OVERFLOW is returned along with the header
+//         so the caller can size the buffer from RecordCount.
+//
+#define IOCTL_CLASS_GET_IO_HISTORY  CTL_CODE(IOCTL_STORAGE_BASE, 0x0800, METHOD_BUFFERED, FILE_READ_ACCESS)
+
+#define CLASS_IO_HISTORY_VERSION    1
+
+//
+// Number of completion records kept per device. Must be a power of two.
+//
+#define CLASS_IO_HISTORY_RING_SIZE  1024
+
+/*
+ *  Cumulative per-device counters of the work classpnp does on behalf of
+ *  transfer packets. They are cheap enough to keep always-on and allow the
+ *  overhead of a workload (retries, packet allocations under stress, errors)
+ *  to be measured independently of the underlying hardware's speed.
+ */
+typedef struct _CLASS_TRANSFER_PACKET_STATISTICS {
+    LONG64 PacketsSubmitted;        // every submission, including retries
+    LONG64 PacketsRetried;          // submissions that were retries
+    LONG64 PacketsFailed;           // packets that returned an SRB error
+    LONG64 PacketsRecovered;        // failed packets whose error was recovered
+    LONG64 PacketsAllocated;        // packets allocated beyond the free lists
+    LONG64 LowMemRetrySteps;        // transfer steps taken in low-memory retry mode
+} CLASS_TRANSFER_PACKET_STATISTICS, *PCLASS_TRANSFER_PACKET_STATISTICS;
+
+/*
+ *  One read/write transfer packet that completed.
+ *  Times are in 100ns units.
+ *  QueueTime is the time from the packet being set up until its final
+ *  submission to the port driver (retry back-off, low-memory steps);
+ *  ServiceTime is the time that final submission took to complete.
+ */
+typedef struct _CLASS_IO_HISTORY_RECORD {
+    ULONGLONG Sequence;             // 1-based, increases with each record logged
+    ULONGLONG LogicalBlockAddress;
+    ULONG TransferLength;           // in bytes
+    ULONG QueueTime;
+    ULONG ServiceTime;
+    UCHAR OperationCode;
+    UCHAR SrbStatus;
+    UCHAR ScsiStatus;
+    UCHAR RetryCount;               // times the packet was retried after an error
+} CLASS_IO_HISTORY_RECORD, *PCLASS_IO_HISTORY_RECORD;
+
+typedef struct _CLASS_IO_HISTORY {
+    ULONG Version;                  // CLASS_IO_HISTORY_VERSION
+    ULONG Size;                     // number of bytes returned
+    ULONG BytesPerBlock;
+    ULONG RecordCount;              // number of records available in the ring
+    ULONG RecordsReturned;
+    ULONG Reserved;
+    ULONGLONG NextSequence;         // sequence number the next record will get
+    CLASS_TRANSFER_PACKET_STATISTICS Statistics;
+    CLASS_IO_HISTORY_RECORD Records[ANYSIZE_ARRAY];
+} CLASS_IO_HISTORY, *PCLASS_IO_HISTORY;
+
+#endif // _CLASS_IOHIST_H_
@@ -472,8 +472,12 @@ BOOLEAN RetryTransferPacket(PTRANSFER_PACKET Pkt)
         Pkt->NumRetries--;
     }
 
+    Pkt->RequestRetryCount++;
+
     TracePrint((TRACE_LEVEL_INFORMATION, TRACE_FLAG_GENERAL, "retrying failed transfer (pkt=%ph, op=%s)", Pkt, DBGGETSCSIOPSTR(Pkt->Srb)));
 
+    InterlockedIncrement64(&fdoData->PacketStatistics.PacketsRetried);
+
     if (!fdoData->DisableThrottling) {
 
         //
@@ -705,14 +709,13 @@ BOOLEAN StepLowMemRetry(PTRANSFER_PACKET Pkt)
     }
     else {
         ULONG thisChunkLen;
+        PFUNCTIONAL_DEVICE_EXTENSION fdoExt = Pkt->Fdo->DeviceExtension;
+        PCLASS_PRIVATE_FDO_DATA fdoData = fdoExt->PrivateFdoData;
+
+        InterlockedIncrement64(&fdoData->PacketStatistics.LowMemRetrySteps);
+
         if (Pkt->DriverUsesStartIO)
         {
-            /*
-             * Need the fdoData for the HwMaxXferLen
-             */
-            PFUNCTIONAL_DEVICE_EXTENSION fdoExt = Pkt->Fdo->DeviceExtension;
-            PCLASS_PRIVATE_FDO_DATA fdoData = fdoExt->PrivateFdoData;
-
             /*
              * Need the adapterDesc to limit transfers based on byte count
              */
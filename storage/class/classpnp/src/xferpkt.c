@@ -282,6 +282,19 @@ NTSTATUS InitializeTransferPackets(PDEVICE_OBJECT Fdo)
         SrbSetCdbLength(fdoData->SrbTemplate, 10);
     }
 
+    //
+    //  Allocate the ring for the I/O completion history.
+    //  This is best effort; without it, completions are just not logged.
+    //
+    if ((status == STATUS_SUCCESS) && (fdoData->IoHistoryRing == NULL)) {
+        fdoData->IoHistoryRing = ExAllocatePoolZero(NonPagedPoolNx,
+                                                    CLASS_IO_HISTORY_RING_SIZE * sizeof(CLASS_IO_HISTORY_RECORD),
+                                                    'hIPC');
+        if (fdoData->IoHistoryRing == NULL) {
+            TracePrint((TRACE_LEVEL_WARNING, TRACE_FLAG_INIT, "Failed to allocate I/O history ring."));
+        }
+    }
+
     return status;
 }
 
@@ -318,6 +331,7 @@ VOID DestroyAllTransferPackets(PDEVICE_OBJECT Fdo)
     }
 
     FREE_POOL(fdoData->SrbTemplate);
+    FREE_POOL(fdoData->IoHistoryRing);
 }
 
 __drv_allocatesMem(Mem)
@@ -538,6 +552,8 @@ VOID EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, __drv_aliasesMem PTRANSFER_PA
 
     NT_ASSERT(!Pkt->SlistEntry.Next);
 
+    Pkt->RequestSetupTime = 0;
+
     allocateNode = Pkt->AllocateNode;
     InterlockedPushEntrySList(&(fdoData->FreeTransferPacketsLists[allocateNode].SListHeader), &Pkt->SlistEntry);
     InterlockedIncrement((volatile LONG *)&(fdoData->FreeTransferPacketsLists[allocateNode].NumFreeTransferPackets));
@@ -691,6 +707,7 @@ PTRANSFER_PACKET DequeueFreeTransferPacketEx(
              */
             pkt = NewTransferPacket(Fdo);
             if (pkt) {
+                InterlockedIncrement64(&fdoData->PacketStatistics.PacketsAllocated);
                 InterlockedIncrement((volatile LONG *)&fdoData->FreeTransferPacketsLists[Node].NumTotalTransferPackets);
                 fdoData->FreeTransferPacketsLists[Node].DbgPeakNumTransferPackets =
                     max(fdoData->FreeTransferPacketsLists[Node].DbgPeakNumTransferPackets,
@@ -833,6 +850,8 @@ VOID SetupReadWriteTransferPacket(  PTRANSFER_PACKET Pkt,
     Pkt->CompleteOriginalIrpWhenLastPacketCompletes = TRUE;
     Pkt->NumIoTimeoutRetries = fdoData->MaxNumberOfIoRetries;
     Pkt->NumThinProvisioningRetries = 0;
+    Pkt->RequestSetupTime = (ULONGLONG)ClasspGetCurrentTime().QuadPart;
+    Pkt->RequestRetryCount = 0;
 
 
     if (pCdb) {
@@ -904,6 +923,8 @@ NTSTATUS SubmitTransferPacket(PTRANSFER_PACKET Pkt)
 
     DBGLOGSENDPACKET(Pkt);
     HISTORYLOGSENDPACKET(Pkt);
+    InterlockedIncrement64(&fdoData->PacketStatistics.PacketsSubmitted);
+    Pkt->RequestStartTime = (ULONGLONG)ClasspGetCurrentTime().QuadPart;
 
     //
     // Set the original irp here for SFIO.
@@ -1022,6 +1043,8 @@ NTSTATUS TransferPktComplete(IN PDEVICE_OBJECT NullFdo, IN PIRP Irp, IN PVOID Co
          */
         BOOLEAN shouldRetry;
 
+        InterlockedIncrement64(&fdoData->PacketStatistics.PacketsFailed);
+
         /*
          *  Make sure IRP status matches SRB error status (since we propagate it).
          */
@@ -1065,6 +1088,8 @@ NTSTATUS TransferPktComplete(IN PDEVICE_OBJECT NullFdo, IN PIRP Irp, IN PVOID Co
 
             NT_ASSERT(!shouldRetry);
 
+            InterlockedIncrement64(&fdoData->PacketStatistics.PacketsRecovered);
+
             /*
              *  In the case of a recovered error,
              *  add the transfer length to the original Irp as we would in the success case.
@@ -1106,6 +1131,11 @@ NTSTATUS TransferPktComplete(IN PDEVICE_OBJECT NullFdo, IN PIRP Irp, IN PVOID Co
          */
         ClassAcquireRemoveLock(Fdo, (PVOID)&uniqueAddr);
 
+        /*
+         *  Log the completion in the device's I/O history ring
+         *  while the SRB still holds the final status.
+         */
+        HistoryLogCompletedIo(pkt);
 
         /*
          *  Sometimes the port driver can allocates a new 'sense' buffer
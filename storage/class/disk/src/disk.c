@@ -58,6 +58,7 @@ Revision History:
 #pragma alloc_text(PAGE, DiskIoctlGetDriveGeometryEx)
 #pragma alloc_text(PAGE, DiskIoctlGetCacheInformation)
 #pragma alloc_text(PAGE, DiskIoctlSetCacheInformation)
+#pragma alloc_text(PAGE, DiskIoctlGetFlushStatistics)
 #pragma alloc_text(PAGE, DiskIoctlGetMediaTypesEx)
 #pragma alloc_text(PAGE, DiskIoctlPredictFailure)
 #pragma alloc_text(PAGE, DiskIoctlEnableFailurePrediction)
@@ -975,6 +976,11 @@ Return Value:
             break;
         }
 
+        case IOCTL_DISK_GET_FLUSH_STATISTICS: {
+            status = DiskIoctlGetFlushStatistics(DeviceObject, Irp);
+            break;
+        }
+
         case IOCTL_DISK_GET_CACHE_SETTING: {
             status = DiskIoctlGetCacheSetting(DeviceObject, Irp);
             break;
@@ -1161,6 +1167,8 @@ Return Value:
 
     if (irpStack->MajorFunction == IRP_MJ_FLUSH_BUFFERS) {
 
+        InterlockedIncrement64(&diskData->FlushContext.Statistics.FlushRequests);
+
         if (TEST_FLAG(fdoExtension->DeviceFlags, DEV_POWER_PROTECTED)) {
 
             //
@@ -1168,6 +1176,8 @@ Return Value:
             // and adapter caches are battery-backed
             //
 
+            InterlockedIncrement64(&diskData->FlushContext.Statistics.FlushesPowerProtected);
+
             Irp->IoStatus.Status = STATUS_SUCCESS;
             ClassReleaseRemoveLock(DeviceObject, Irp);
             ClassCompleteRequest(DeviceObject, Irp, IO_NO_INCREMENT);
@@ -1202,6 +1212,8 @@ Return Value:
 
                 InsertTailList(&diskData->FlushContext.NextList, &Irp->Tail.Overlay.ListEntry);
 
+                InterlockedIncrement64(&diskData->FlushContext.Statistics.FlushesCoalesced);
+
                 KeReleaseSpinLock(&diskData->FlushContext.Spinlock, irql);
 
                 //
@@ -1552,6 +1564,14 @@ Return Value:
     PSRBEX_DATA_SCSI_CDB16 srbExDataCdb16;
     NTSTATUS SyncCacheStatus = STATUS_SUCCESS;
 
+    //
+    // Only one representative is outstanding at a time, so the dispatch
+    // time needs no further synchronization. The statistics are updated
+    // with interlocked operations so they can be read at any time.
+    //
+    FlushContext->DispatchTime = KeQueryInterruptTime();
+    InterlockedIncrement64(&FlushContext->Statistics.FlushesIssued);
+
     //
     // Fill in the srb fields appropriately
     //
@@ -1624,6 +1644,8 @@ Return Value:
 
         TracePrint((TRACE_LEVEL_VERBOSE, TRACE_FLAG_SCSI, "DiskFlushDispatch: sending sync cache\n"));
 
+        InterlockedIncrement64(&FlushContext->Statistics.SyncCacheIssued);
+
         SyncCacheStatus = ClassSendSrbSynchronous(Fdo, srb, NULL, 0, TRUE);
     }
 
@@ -1682,6 +1704,52 @@ Return Value:
 
 
 
+VOID
+DiskGetFlushStatistics(
+    IN PFUNCTIONAL_DEVICE_EXTENSION FdoExtension,
+    OUT PDISK_FLUSH_STATISTICS FlushStatistics
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a snapshot of the flush statistics of the disk.
+    All counters are updated with interlocked operations, so each one is
+    read the same way to avoid torn 64-bit values on 32-bit systems. The
+    counters are read one at a time and need not be consistent with each
+    other.
+
+Arguments:
+
+    FdoExtension - The device extension for the disk
+    FlushStatistics - Receives the flush statistics
+
+Return Value:
+
+    None
+
+--*/
+
+{
+    PDISK_DATA diskData = (PDISK_DATA)(FdoExtension->CommonExtension.DriverData);
+    PDISK_FLUSH_STATISTICS statistics = &diskData->FlushContext.Statistics;
+
+    FlushStatistics->Version = statistics->Version;
+    FlushStatistics->Size = statistics->Size;
+
+    FlushStatistics->FlushRequests = InterlockedCompareExchange64(&statistics->FlushRequests, 0, 0);
+    FlushStatistics->FlushesPowerProtected = InterlockedCompareExchange64(&statistics->FlushesPowerProtected, 0, 0);
+    FlushStatistics->FlushesCoalesced = InterlockedCompareExchange64(&statistics->FlushesCoalesced, 0, 0);
+    FlushStatistics->FlushesIssued = InterlockedCompareExchange64(&statistics->FlushesIssued, 0, 0);
+    FlushStatistics->SyncCacheIssued = InterlockedCompareExchange64(&statistics->SyncCacheIssued, 0, 0);
+    FlushStatistics->FlushesFailed = InterlockedCompareExchange64(&statistics->FlushesFailed, 0, 0);
+    FlushStatistics->TotalLatency = InterlockedCompareExchange64(&statistics->TotalLatency, 0, 0);
+    FlushStatistics->MaxLatency = InterlockedCompareExchange64(&statistics->MaxLatency, 0, 0);
+}
+
+
+
 NTSTATUS
 DiskFlushComplete(
     IN PDEVICE_OBJECT Fdo,
@@ -1716,6 +1784,8 @@ Return Value:
     NTSTATUS status;
     PFUNCTIONAL_DEVICE_EXTENSION fdoExt;
     PDISK_DATA diskData;
+    LONG64 latency;
+    LONG64 maxLatency;
     #pragma warning(suppress:4311) // pointer truncation from 'PVOID' to 'NTSTATUS'
     NTSTATUS SyncCacheStatus = (NTSTATUS) Context;
 
@@ -1753,6 +1823,29 @@ Return Value:
         Irp->IoStatus.Status = status = SyncCacheStatus;
     }
 
+    //
+    // Account for this flush before the next group is released
+    //
+    latency = (LONG64)(KeQueryInterruptTime() - FlushContext->DispatchTime);
+
+    InterlockedAdd64(&FlushContext->Statistics.TotalLatency, latency);
+
+    maxLatency = InterlockedCompareExchange64(&FlushContext->Statistics.MaxLatency, 0, 0);
+
+    while (latency > maxLatency) {
+        LONG64 previous = InterlockedCompareExchange64(&FlushContext->Statistics.MaxLatency,
+                                                       latency,
+                                                       maxLatency);
+        if (previous == maxLatency) {
+            break;
+        }
+        maxLatency = previous;
+    }
+
+    if (!NT_SUCCESS(status)) {
+        InterlockedIncrement64(&FlushContext->Statistics.FlushesFailed);
+    }
+
     //
     // Complete the flush requests tagged to this one
     //
@@ -3969,6 +4062,66 @@ Return Value:
     return status;
 }
 
+
+NTSTATUS
+DiskIoctlGetFlushStatistics(
+    IN PDEVICE_OBJECT DeviceObject,
+    IN OUT PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine services IOCTL_DISK_GET_FLUSH_STATISTICS. It returns
+    the flush statistics of the disk (DISK_FLUSH_STATISTICS) to the
+    caller.
+
+    This function must be called at IRQL < DISPATCH_LEVEL.
+
+Arguments:
+
+    DeviceObject - Supplies the device object associated with this request.
+
+    Irp - The IRP to be processed
+
+Return Value:
+
+    NTSTATUS code
+
+--*/
+
+{
+    PFUNCTIONAL_DEVICE_EXTENSION fdoExtension = DeviceObject->DeviceExtension;
+    PIO_STACK_LOCATION irpStack = IoGetCurrentIrpStackLocation (Irp);
+    PDISK_FLUSH_STATISTICS flushStatistics = Irp->AssociatedIrp.SystemBuffer;
+
+    //
+    // This function must be called at less than dispatch level.
+    // Fail if IRQL >= DISPATCH_LEVEL.
+    //
+    PAGED_CODE();
+    CHECK_IRQL();
+
+    //
+    // Validate the request.
+    //
+
+    TracePrint((TRACE_LEVEL_INFORMATION, TRACE_FLAG_IOCTL, "DiskIoctlGetFlushStatistics: DeviceObject %p Irp %p\n", DeviceObject, Irp));
+
+    if (irpStack->Parameters.DeviceIoControl.OutputBufferLength < sizeof(DISK_FLUSH_STATISTICS)) {
+
+        TracePrint((TRACE_LEVEL_ERROR, TRACE_FLAG_IOCTL, "DiskIoctlGetFlushStatistics: Output buffer too small.\n"));
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    DiskGetFlushStatistics(fdoExtension, flushStatistics);
+
+    Irp->IoStatus.Information = sizeof(DISK_FLUSH_STATISTICS);
+
+    return STATUS_SUCCESS;
+}
+
 NTSTATUS
 DiskIoctlGetMediaTypesEx(
     IN PDEVICE_OBJECT DeviceObject,
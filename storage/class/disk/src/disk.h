@@ -24,6 +24,7 @@ Revision History:
 #include "scsi.h"
 #include <wmidata.h>
 #include "classpnp.h"
+#include "diskioctl.h"
 
 #include <wmistr.h>
 #include "ntstrsafe.h"
@@ -138,6 +139,17 @@ typedef struct _DISK_GROUP_CONTEXT
     //
     KEVENT Event;
 
+    //
+    // Interrupt time at which the current representative was dispatched
+    //
+    ULONGLONG DispatchTime;
+
+    //
+    // Cumulative flush statistics, reported through
+    // IOCTL_DISK_GET_FLUSH_STATISTICS
+    //
+    DISK_FLUSH_STATISTICS Statistics;
+
 
 #if DBG
 
@@ -571,6 +583,12 @@ DiskFlushDispatch(
 
 IO_COMPLETION_ROUTINE DiskFlushComplete;
 
+VOID
+DiskGetFlushStatistics(
+    IN PFUNCTIONAL_DEVICE_EXTENSION FdoExtension,
+    OUT PDISK_FLUSH_STATISTICS FlushStatistics
+    );
+
 
 NTSTATUS
 DiskModeSelect(
@@ -870,6 +888,12 @@ DiskIoctlSetCacheInformation(
     IN OUT PIRP Irp
     );
 
+NTSTATUS
+DiskIoctlGetFlushStatistics(
+    IN PDEVICE_OBJECT DeviceObject,
+    IN OUT PIRP Irp
+    );
+
 NTSTATUS
 DiskIoctlGetMediaTypesEx(
     IN PDEVICE_OBJECT DeviceObject,
@@ -0,0 +1,59 @@
+/*++
+
+Copyright (C) Microsoft Corporation, 1991 - 2010
+
+Module Name:
+
+    diskioctl.h
+
+Abstract:
+
+    Private IOCTL interface of the disk class driver sample. This header
+    can be shared with user mode applications, which include winioctl.h
+    before it.
+
+Environment:
+
+    kernel and user mode
+
+Notes:
+
+--*/
+
+#ifndef _DISKIOCTL_H_
+#define _DISKIOCTL_H_
+
+//
+// IOCTL_DISK_GET_FLUSH_STATISTICS
+//
+// Returns the DISK_FLUSH_STATISTICS of the disk. The output buffer must be
+// at least sizeof(DISK_FLUSH_STATISTICS) bytes.
+//
+
+#define IOCTL_DISK_GET_FLUSH_STATISTICS CTL_CODE(IOCTL_DISK_BASE, 0x0800, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+//
+// Flush statistics for a disk. Only one group of flush requests is
+// outstanding at the device at any time, so every request that arrives
+// while one is in progress is either the representative of the next group
+// or is coalesced into it. Times are in 100ns units.
+//
+
+#define DISK_FLUSH_STATISTICS_VERSION   1
+
+typedef struct _DISK_FLUSH_STATISTICS
+{
+    ULONG Version;                      // DISK_FLUSH_STATISTICS_VERSION
+    ULONG Size;                         // sizeof(DISK_FLUSH_STATISTICS)
+    LONG64 FlushRequests;               // IRP_MJ_FLUSH_BUFFERS requests received
+    LONG64 FlushesPowerProtected;       // completed at once, caches are battery-backed
+    LONG64 FlushesCoalesced;            // completed by another request's flush
+    LONG64 FlushesIssued;               // flushes sent to the device
+    LONG64 SyncCacheIssued;             // of those, preceded by a SYNCHRONIZE CACHE
+    LONG64 FlushesFailed;               // of those, completed with an error
+    LONG64 TotalLatency;                // summed over the flushes sent to the device
+    LONG64 MaxLatency;
+
+} DISK_FLUSH_STATISTICS, *PDISK_FLUSH_STATISTICS;
+
+#endif // _DISKIOCTL_H_
@@ -577,6 +577,9 @@ Return Value:
     KeInitializeSpinLock(&diskData->FlushContext.Spinlock);
     KeInitializeEvent(&diskData->FlushContext.Event, SynchronizationEvent, FALSE);
 
+    diskData->FlushContext.Statistics.Version = DISK_FLUSH_STATISTICS_VERSION;
+    diskData->FlushContext.Statistics.Size = sizeof(DISK_FLUSH_STATISTICS);
+
 
     //
     // Restore the saved value
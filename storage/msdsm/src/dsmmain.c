@@ -382,6 +382,11 @@ Return Value:
         group->GroupSig = DSM_GROUP_SIG;
         group->State = DSM_GP_NORMAL;
 
+        //
+        // Start with a stale path snapshot so the first request builds it.
+        //
+        group->PathSnapshotGeneration = 1;
+
         //
         // Add it to the list of multi-path groups.
         //
@@ -3207,7 +3212,14 @@ DsmpIncrementCounters(
         }
     }
 
-    InterlockedIncrement(&FailGroup->NumberOfRequestsInFlight);
+    if (InterlockedIncrement(&FailGroup->NumberOfRequestsInFlight) == 1) {
+
+        //
+        // The path just went from idle to busy, so the service time of this
+        // request is to be measured from now rather than from the last completion.
+        //
+        InterlockedExchange64((LONGLONG volatile*)&FailGroup->LastServiceTimeStamp, KeQueryInterruptTime());
+    }
 
     //
     // Update counters that apply to read/write requests
@@ -3255,6 +3267,9 @@ DsmpDecrementCounters(
     PCDB cdb = NULL;
     BOOLEAN isReadWrite = FALSE;
     BOOLEAN isDeletionEligible = FALSE;
+    ULONGLONG currentTime;
+    ULONGLONG serviceTime;
+    LONGLONG estimate;
 
     TracePrint((TRACE_LEVEL_VERBOSE,
                 TRACE_FLAG_GENERAL,
@@ -3281,6 +3296,35 @@ DsmpDecrementCounters(
         InterlockedExchangeAdd64((LONGLONG volatile*)&FailGroup->OutstandingBytesOfIO, -(LONGLONG)bytes);
     }
 
+    //
+    // Requests on a path complete one after the other, so the time since the
+    // previous completion (or since the path became busy) is the time the path
+    // took to service this one. Only read/write requests are sampled since
+    // they are the ones that get load balanced.
+    //
+    currentTime = KeQueryInterruptTime();
+    serviceTime = currentTime - (ULONGLONG)InterlockedExchange64((LONGLONG volatile*)&FailGroup->LastServiceTimeStamp,
+                                                                 (LONGLONG)currentTime);
+
+    if (isReadWrite) {
+
+        estimate = (LONGLONG)FailGroup->ServiceTimeEstimate;
+        if (estimate) {
+            estimate += ((LONGLONG)serviceTime - estimate) >> DSM_LATENCY_EWMA_SHIFT;
+        } else {
+            estimate = (LONGLONG)serviceTime;
+        }
+        InterlockedExchange64((LONGLONG volatile*)&FailGroup->ServiceTimeEstimate, estimate ? estimate : 1);
+
+        estimate = (LONGLONG)FailGroup->TransferLengthEstimate;
+        if (estimate) {
+            estimate += ((LONGLONG)bytes - estimate) >> DSM_LATENCY_EWMA_SHIFT;
+        } else {
+            estimate = bytes;
+        }
+        InterlockedExchange64((LONGLONG volatile*)&FailGroup->TransferLengthEstimate, estimate);
+    }
+
     NT_ASSERT(FailGroup->NumberOfRequestsInFlight > 0);
     if (InterlockedCompareExchange(&FailGroup->NumberOfRequestsInFlight, 0, 0) > 0) {
 
@@ -3302,6 +3346,383 @@ DsmpDecrementCounters(
 }
 
 
+ULONGLONG
+DsmpGetPredictedCompletionTime(
+    _In_ PDSM_FAILOVER_GROUP FailGroup,
+    _In_ ULONG Bytes,
+    _In_ ULONGLONG CurrentTime
+    )
+/*++
+
+Routine Description:
+
+    This routine estimates how long (in ticks) a new request of the given size
+    would take to complete if it were sent down the given path, based on the
+    path's observed service time and transfer size and its outstanding work.
+
+    A path that has no estimate yet, or that has been idle long enough for its
+    estimate to be stale, is predicted to complete immediately so that it gets
+    chosen and re-sampled.
+
+Arguments:
+
+    FailGroup - The path being considered.
+    Bytes - Transfer length of the new request (0 for non read/write).
+    CurrentTime - Current interrupt time.
+
+Return Value:
+
+    Predicted completion time in ticks.
+
+--*/
+{
+    ULONGLONG serviceTime = FailGroup->ServiceTimeEstimate;
+    ULONGLONG transferLength = FailGroup->TransferLengthEstimate;
+    ULONGLONG requestsInFlight = (ULONGLONG)FailGroup->NumberOfRequestsInFlight;
+    ULONGLONG predictedTime;
+    ULONGLONG bytesTime;
+
+    if (serviceTime == 0 ||
+        (requestsInFlight == 0 &&
+         CurrentTime - FailGroup->LastServiceTimeStamp > DSM_LATENCY_ESTIMATE_STALE_TIME)) {
+
+        return 0;
+    }
+
+    //
+    // Every outstanding request ahead of this one, plus this one, takes on
+    // average serviceTime to go through the path.
+    //
+    predictedTime = (requestsInFlight + 1) * serviceTime;
+
+    //
+    // If requests ahead are larger than usual, the path will take longer to
+    // drain them, so also account for outstanding bytes at the path's rate.
+    //
+    if (transferLength) {
+
+        bytesTime = ((FailGroup->OutstandingBytesOfIO + Bytes) * serviceTime) / transferLength;
+
+        if (bytesTime > predictedTime) {
+            predictedTime = bytesTime;
+        }
+    }
+
+    return predictedTime;
+}
+
+
+VOID
+DsmpInvalidatePathSnapshot(
+    _In_ PDSM_GROUP_ENTRY Group
+    )
+/*++
+
+Routine Description:
+
+    This routine marks the group's snapshot of active/optimized paths as stale,
+    so that the next request goes through the full path selection in
+    DsmpGetPath and rebuilds it.
+
+    It must be called after any change to the state of the group's paths or
+    to its load balance policy has been made.
+
+Arguments:
+
+    Group - The multi-path group whose paths (or policy) changed.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (Group) {
+
+        InterlockedIncrement(&Group->PathSnapshotGeneration);
+    }
+
+    return;
+}
+
+
+VOID
+DsmpBuildPathSnapshot(
+    _In_ PDSM_GROUP_ENTRY Group,
+    _In_ PDSM_IDS DsmList
+    )
+/*++
+
+Routine Description:
+
+    This routine rebuilds the group's snapshot of the usable active/optimized
+    paths from the given list, if the snapshot is stale. Only one caller
+    rebuilds at a time; concurrent callers simply keep using the slow path.
+
+Arguments:
+
+    Group - The multi-path group.
+    DsmList - List of DSM Ids sent by MPIO
+
+Return Value:
+
+    None
+
+--*/
+{
+    PDSM_DEVICE_INFO deviceInfo;
+    LONG generation;
+    ULONG count = 0;
+    ULONG inx;
+
+    if (InterlockedCompareExchange(&Group->PathSnapshotBuilder, 1, 0) != 0) {
+
+        return;
+    }
+
+    generation = ReadAcquire(&Group->PathSnapshotGeneration);
+
+    if (Group->PathSnapshotBuiltGeneration != generation) {
+
+        for (inx = 0; inx < DsmList->Count && count < DSM_MAX_PATHS; inx++) {
+
+            deviceInfo = DsmList->IdList[inx];
+
+            if (deviceInfo &&
+                DsmpIsDeviceInitialized(deviceInfo) &&
+                DsmpIsDeviceUsable(deviceInfo) &&
+                DsmpIsDeviceUsablePR(deviceInfo) &&
+                deviceInfo->State == DSM_DEV_ACTIVE_OPTIMIZED) {
+
+                Group->PathSnapshot[count].DeviceInfo = deviceInfo;
+                Group->PathSnapshot[count].Index = inx;
+                count++;
+            }
+        }
+
+        Group->PathSnapshotCount = count;
+
+        //
+        // Publish the snapshot. If the generation moved on while it was being
+        // built, it gets published as stale and will be rebuilt.
+        //
+        WriteRelease(&Group->PathSnapshotBuiltGeneration, generation);
+
+        TracePrint((TRACE_LEVEL_INFORMATION,
+                    TRACE_FLAG_RW,
+                    "DsmpBuildPathSnapshot (Group %p): Built generation %d with %d paths.\n",
+                    Group,
+                    generation,
+                    count));
+    }
+
+    InterlockedExchange(&Group->PathSnapshotBuilder, 0);
+
+    return;
+}
+
+
+__inline
+BOOLEAN
+DsmpIsPathSnapshotEntryUsable(
+    _In_ PDSM_PATH_SNAPSHOT_ENTRY Entry,
+    _In_ PDSM_IDS DsmList
+    )
+{
+    PDSM_DEVICE_INFO deviceInfo = Entry->DeviceInfo;
+
+    //
+    // Only dereference the devInfo once it is known to still be in the list
+    // MPIO handed us, since the snapshot doesn't hold a reference on it.
+    //
+    return (BOOLEAN)(Entry->Index < DsmList->Count &&
+                     DsmList->IdList[Entry->Index] == deviceInfo &&
+                     DsmpIsDeviceUsable(deviceInfo) &&
+                     DsmpIsDeviceUsablePR(deviceInfo) &&
+                     deviceInfo->State == DSM_DEV_ACTIVE_OPTIMIZED);
+}
+
+
+PDSM_FAILOVER_GROUP
+DsmpGetPathFromSnapshot(
+    _In_ PDSM_GROUP_ENTRY Group,
+    _In_ PDSM_IDS DsmList,
+    _In_opt_ PSCSI_REQUEST_BLOCK Srb
+    )
+/*++
+
+Routine Description:
+
+    This routine picks a path for a request from the group's snapshot of
+    active/optimized paths, without acquiring any lock or walking any list.
+    It handles Round Robin (with or without subset) and Least Queue Depth.
+
+    If the snapshot is stale, changes while being used, or the chosen path is
+    no longer usable, NULL is returned and the caller must fall back to the
+    full path selection.
+
+Arguments:
+
+    Group - The multi-path group.
+    DsmList - List of DSM Ids sent by MPIO
+    Srb - The read/write/verify request
+
+Return Value:
+
+    FailOver Group that should be used for processing the request, or NULL.
+
+--*/
+{
+    PDSM_PATH_SNAPSHOT_ENTRY entry = NULL;
+    PDSM_PATH_SNAPSHOT_ENTRY nextEntry;
+    PDSM_FAILOVER_GROUP failGroup = NULL;
+    LONG generation;
+    ULONG count;
+    ULONG inx;
+
+    generation = ReadAcquire(&Group->PathSnapshotGeneration);
+
+    if (ReadAcquire(&Group->PathSnapshotBuiltGeneration) != generation) {
+
+        goto __Exit_DsmpGetPathFromSnapshot;
+    }
+
+    count = Group->PathSnapshotCount;
+
+    if (count == 0) {
+
+        goto __Exit_DsmpGetPathFromSnapshot;
+    }
+
+    switch (Group->LoadBalanceType) {
+
+        case DSM_LB_ROUND_ROBIN:
+        case DSM_LB_ROUND_ROBIN_WITH_SUBSET: {
+
+            inx = (ULONG)InterlockedIncrement(&Group->PathSnapshotCursor) % count;
+
+            entry = &Group->PathSnapshot[inx];
+            if (!DsmpIsPathSnapshotEntryUsable(entry, DsmList)) {
+
+                entry = NULL;
+                break;
+            }
+
+            //
+            // Keep PathToBeUsed pointing at the next path in the rotation, as
+            // the full selection does.
+            //
+            nextEntry = &Group->PathSnapshot[(inx + 1) % count];
+            if (DsmpIsPathSnapshotEntryUsable(nextEntry, DsmList)) {
+
+                InterlockedExchangePointer(&(Group->PathToBeUsed), (PVOID)nextEntry->DeviceInfo->FailGroup);
+            }
+
+            break;
+        }
+
+        case DSM_LB_DYN_LEAST_QUEUE_DEPTH: {
+
+            LONG leastQueueDepth = 0x7FFFFFFF;
+            ULONGLONG leastPredictedTime = MAXULONGLONG;
+            ULONGLONG predictedTime;
+            ULONGLONG currentTime = 0;
+            ULONG bytes = 0;
+            PCDB cdb;
+            PDSM_FAILOVER_GROUP candidate;
+
+            if (Group->UseLatencyForLeastQueueDepth) {
+
+                currentTime = KeQueryInterruptTime();
+
+                if (Srb) {
+
+                    cdb = SrbGetCdb(Srb);
+
+                    if (cdb && DsmIsReadWrite(cdb->AsByte[0])) {
+
+                        bytes = SrbGetDataTransferLength(Srb);
+                    }
+                }
+            }
+
+            for (inx = 0; inx < count; inx++) {
+
+                if (!DsmpIsPathSnapshotEntryUsable(&Group->PathSnapshot[inx], DsmList)) {
+
+                    //
+                    // A path in the snapshot went away, so let the full
+                    // selection handle this request and rebuild the snapshot.
+                    //
+                    entry = NULL;
+                    break;
+                }
+
+                candidate = Group->PathSnapshot[inx].DeviceInfo->FailGroup;
+
+                if (Group->UseLatencyForLeastQueueDepth) {
+
+                    predictedTime = DsmpGetPredictedCompletionTime(candidate, bytes, currentTime);
+
+                    if (predictedTime < leastPredictedTime ||
+                        (predictedTime == leastPredictedTime &&
+                         candidate->NumberOfRequestsInFlight < leastQueueDepth)) {
+
+                        leastPredictedTime = predictedTime;
+                        leastQueueDepth = candidate->NumberOfRequestsInFlight;
+                        entry = &Group->PathSnapshot[inx];
+                    }
+
+                } else if (candidate->NumberOfRequestsInFlight < leastQueueDepth) {
+
+                    leastQueueDepth = candidate->NumberOfRequestsInFlight;
+                    entry = &Group->PathSnapshot[inx];
+                }
+            }
+
+            break;
+        }
+
+        default: {
+
+            //
+            // Failover and Least Weighted already use the cached PathToBeUsed,
+            // and Least Blocks depends on per-request sequentiality, so they
+            // always go through the full selection.
+            //
+            break;
+        }
+    }
+
+    if (!entry) {
+
+        if (Group->LoadBalanceType == DSM_LB_ROUND_ROBIN ||
+            Group->LoadBalanceType == DSM_LB_ROUND_ROBIN_WITH_SUBSET ||
+            Group->LoadBalanceType == DSM_LB_DYN_LEAST_QUEUE_DEPTH) {
+
+            DsmpInvalidatePathSnapshot(Group);
+        }
+
+        goto __Exit_DsmpGetPathFromSnapshot;
+    }
+
+    failGroup = entry->DeviceInfo->FailGroup;
+
+    //
+    // If the snapshot was invalidated while we were using it, the path that
+    // was chosen may be one that is going away, so don't use it.
+    //
+    if (ReadAcquire(&Group->PathSnapshotGeneration) != generation) {
+
+        failGroup = NULL;
+    }
+
+__Exit_DsmpGetPathFromSnapshot:
+
+    return failGroup;
+}
+
+
 PDSM_FAILOVER_GROUP
 DsmpGetPath(
     _In_ IN PDSM_CONTEXT DsmContext,
@@ -3316,7 +3737,12 @@ Routine Description:
     This routine will pick a path, for processing a request, based
     on the current LoadBalance policy that is set.
 
-    N.B: This routine must be called with DSM Context Lock held in Shared mode.
+    For Round Robin and Least Queue Depth, the path is normally picked from
+    the group's snapshot of active/optimized paths (see DsmpGetPathFromSnapshot),
+    and the full selection below only runs when that snapshot is stale.
+
+    N.B: Unless the snapshot is used, this routine must be called with DSM
+         Context Lock held in Shared mode.
 
 Arguments:
 
@@ -3382,6 +3808,9 @@ Return Value:
     //                                        states after transition) - one with least outstanding I/O is chosen.
     //          Rest of the paths Failed
     //
+    //      If latency-aware selection is enabled for the LUN, instead of the path with the least outstanding
+    //      I/O, the one with the least predicted completion time is chosen (see DsmpGetPredictedCompletionTime).
+    //
     // Least-Weighted:
     // ---------------
     //      If symmetric LUA:
@@ -3435,6 +3864,16 @@ Return Value:
     groupEntry = deviceInfo->Group;
     DSM_ASSERT(groupEntry->GroupSig == DSM_GROUP_SIG);
 
+    //
+    // Try the lock-free selection first. It only succeeds if the snapshot of
+    // active/optimized paths is current.
+    //
+    failGroup = DsmpGetPathFromSnapshot(groupEntry, DsmList, Srb);
+    if (failGroup) {
+
+        goto __Exit_DsmpGetPath;
+    }
+
     switch (groupEntry->LoadBalanceType) {
 
         case DSM_LB_FAILOVER:
@@ -3592,6 +4031,26 @@ Return Value:
         case DSM_LB_DYN_LEAST_QUEUE_DEPTH: {
 
             LONG leastQueueDepth = 0x7FFFFFFF;
+            ULONGLONG leastPredictedTime = MAXULONGLONG;
+            ULONGLONG predictedTime;
+            ULONGLONG currentTime = 0;
+            ULONG bytes = 0;
+            PCDB cdb = NULL;
+
+            if (groupEntry->UseLatencyForLeastQueueDepth) {
+
+                currentTime = KeQueryInterruptTime();
+
+                if (Srb) {
+
+                    cdb = SrbGetCdb(Srb);
+
+                    if (cdb && DsmIsReadWrite(cdb->AsByte[0])) {
+
+                        bytes = SrbGetDataTransferLength(Srb);
+                    }
+                }
+            }
 
             for (inx = 0; inx < DsmList->Count; inx++) {
 
@@ -3602,9 +4061,29 @@ Return Value:
                     continue;
                 }
 
+                if (deviceInfo->State != DSM_DEV_ACTIVE_OPTIMIZED) {
 
-                if (deviceInfo->State == DSM_DEV_ACTIVE_OPTIMIZED &&
-                    deviceInfo->FailGroup->NumberOfRequestsInFlight < leastQueueDepth) {
+                    continue;
+                }
+
+                if (groupEntry->UseLatencyForLeastQueueDepth) {
+
+                    //
+                    // Pick the path expected to complete this request soonest.
+                    // Ties (eg. no estimates yet) go to the least queue depth.
+                    //
+                    predictedTime = DsmpGetPredictedCompletionTime(deviceInfo->FailGroup, bytes, currentTime);
+
+                    if (predictedTime < leastPredictedTime ||
+                        (predictedTime == leastPredictedTime &&
+                         deviceInfo->FailGroup->NumberOfRequestsInFlight < leastQueueDepth)) {
+
+                        leastPredictedTime = predictedTime;
+                        leastQueueDepth = deviceInfo->FailGroup->NumberOfRequestsInFlight;
+                        failGroup = deviceInfo->FailGroup;
+                    }
+
+                } else if (deviceInfo->FailGroup->NumberOfRequestsInFlight < leastQueueDepth) {
 
                     leastQueueDepth = deviceInfo->FailGroup->NumberOfRequestsInFlight;
                     failGroup = deviceInfo->FailGroup;
@@ -3829,6 +4308,18 @@ Return Value:
         }
     }
 
+    //
+    // Now that the full selection has run, refresh the snapshot (if stale) so
+    // that subsequent requests can take the lock-free path.
+    //
+    if (failGroup &&
+        (groupEntry->LoadBalanceType == DSM_LB_ROUND_ROBIN ||
+         groupEntry->LoadBalanceType == DSM_LB_ROUND_ROBIN_WITH_SUBSET ||
+         groupEntry->LoadBalanceType == DSM_LB_DYN_LEAST_QUEUE_DEPTH)) {
+
+        DsmpBuildPathSnapshot(groupEntry, DsmList);
+    }
+
 __Exit_DsmpGetPath:
 
     TracePrint((TRACE_LEVEL_VERBOSE,
@@ -5899,6 +6390,8 @@ Return Value:
         }
     }
 
+    DsmpInvalidatePathSnapshot(group);
+
 __Exit_DsmpSetNewDefaultLBPolicy:
 
     TracePrint((TRACE_LEVEL_VERBOSE,
@@ -6231,6 +6724,8 @@ __Exit_DsmpSetLBForPathArrival:
         InterlockedExchangePointer(&(group->PathToBeUsed), NULL);
     }
 
+    DsmpInvalidatePathSnapshot(group);
+
     TracePrint((TRACE_LEVEL_VERBOSE,
                 TRACE_FLAG_PNP,
                 "DsmpSetLBForPathArrival (DevInfo %p): Exiting function with status %x\n",
@@ -6461,6 +6956,8 @@ __Exit_DsmpSetLBForPathArrivalALUA:
         InterlockedExchangePointer(&(group->PathToBeUsed), NULL);
     }
 
+    DsmpInvalidatePathSnapshot(group);
+
     if (lockHeld) {
         ExReleaseSpinLockExclusive(&(DsmContext->DsmContextLock), irql);
     }
@@ -6643,6 +7140,8 @@ Return Value:
         InterlockedExchangePointer(&(group->PathToBeUsed), NULL);
     }
 
+    DsmpInvalidatePathSnapshot(group);
+
     ExReleaseSpinLockExclusive(&(DsmContext->DsmContextLock), irql);
 
     TracePrint((TRACE_LEVEL_VERBOSE,
@@ -6853,6 +7352,8 @@ Return Value:
         InterlockedExchangePointer(&(group->PathToBeUsed), NULL);
     }
 
+    DsmpInvalidatePathSnapshot(group);
+
     if (lockHeld) {
 
         ExReleaseSpinLockExclusive(&(DsmContext->DsmContextLock), irql);
@@ -7301,6 +7802,8 @@ Return Value:
                     group));
     }
 
+    DsmpInvalidatePathSnapshot(group);
+
     TracePrint((TRACE_LEVEL_VERBOSE,
                 TRACE_FLAG_RW,
                 "DsmpSetLBForPathFailingALUA (DevInfo %p): Exiting function with status %x.\n",
@@ -7784,6 +8287,8 @@ Return Value:
                         group));
         }
 
+        DsmpInvalidatePathSnapshot(group);
+
         status = STATUS_SUCCESS;
     }
 
@@ -8058,6 +8563,8 @@ Return Value:
 
         irql = ExAcquireSpinLockExclusive(&(context->CompletionContext->DsmContext->DsmContextLock));
 
+        DsmpInvalidatePathSnapshot(context->CompletionContext->DeviceInfo->Group);
+
         failDevInfoListEntry = DsmpFindFailPathDevInfoEntry(context->CompletionContext->DsmContext,
                                                             context->CompletionContext->DeviceInfo->Group,
                                                             context->CompletionContext->DeviceInfo);
@@ -8412,6 +8919,8 @@ Return Value:
 
         irql = ExAcquireSpinLockExclusive(&(context->CompletionContext->DsmContext->DsmContextLock));
 
+        DsmpInvalidatePathSnapshot(context->CompletionContext->DeviceInfo->Group);
+
         failDevInfoListEntry = DsmpFindFailPathDevInfoEntry(context->CompletionContext->DsmContext,
                                                             context->CompletionContext->DeviceInfo->Group,
                                                             context->CompletionContext->DeviceInfo);
@@ -8563,6 +9072,8 @@ Return Value:
             }
         }
 
+        DsmpInvalidatePathSnapshot(context->CompletionContext->DeviceInfo->Group);
+
         failDevInfoListEntry = DsmpFindFailPathDevInfoEntry(context->CompletionContext->DsmContext,
                                                             context->CompletionContext->DeviceInfo->Group,
                                                             context->CompletionContext->DeviceInfo);
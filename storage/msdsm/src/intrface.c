@@ -535,6 +535,7 @@ Return Value:
     ULONG maxPRRetryTimeDuringStateTransition = DSM_MAX_PR_UNIT_ATTENTION_RETRY_TIME;
     BOOLEAN useCacheForLeastBlocks = FALSE;
     ULONGLONG cacheSizeForLeastBlocks = 0;
+    BOOLEAN useLatencyForLeastQueueDepth = FALSE;
     BOOLEAN fakeControllerEntryExists = FALSE;
     STORAGE_IDENTIFIER_CODE_SET serialNumberCodeSet = StorageIdCodeSetReserved;
 
@@ -975,6 +976,18 @@ Return Value:
         cacheSizeForLeastBlocks = DSM_LEAST_BLOCKS_DEFAULT_THRESHOLD;
     }
 
+    //
+    // Query the registry to see if the user wants Least Queue Depth to take
+    // per-path latency into account.
+    //
+    status = DsmpQueryLatencyInformationFromRegistry(DsmContext,
+                                                     &useLatencyForLeastQueueDepth);
+
+    if (!NT_SUCCESS(status)) {
+
+        useLatencyForLeastQueueDepth = FALSE;
+    }
+
     //
     // Build LUN's hardware id.  Needs to be called at PASSIVE_LEVEL, so
     // do it before grabbing the lock.  The hardware id of the group is
@@ -1032,6 +1045,7 @@ Return Value:
 
             group->UseCacheForLeastBlocks = useCacheForLeastBlocks;
             group->CacheSizeForLeastBlocks = cacheSizeForLeastBlocks;
+            group->UseLatencyForLeastQueueDepth = useLatencyForLeastQueueDepth;
 
         } else {
 
@@ -2668,6 +2682,7 @@ Return Value:
     }
 
     ((PDSM_DEVICE_INFO)DsmId)->Usable = retVal;
+    DsmpInvalidatePathSnapshot(((PDSM_DEVICE_INFO)DsmId)->Group);
 
     ExReleaseSpinLockExclusive(&(dsmContext->DsmContextLock), irql);
 
@@ -2843,6 +2858,8 @@ Return Value:
 
                     foGroup->State = DSM_FG_NORMAL;
                     deviceInfo->State = deviceInfo->LastKnownGoodState;
+
+                    DsmpInvalidatePathSnapshot(group);
                 }
             }
         }
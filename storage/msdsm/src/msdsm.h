@@ -71,6 +71,13 @@ Notes:
 #define DSM_USE_CACHE_FOR_LEAST_BLOCKS          L"DsmUseCacheForLeastBlocks"
 #define DSM_CACHE_SIZE_FOR_LEAST_BLOCKS         L"DsmCacheSizeForLeastBlocks"
 
+//
+// Name of the value in the registry for whether Least Queue Depth load balance
+// policy should pick the path with the least predicted completion time (based
+// on observed per-path service time) instead of the least number of requests.
+//
+#define DSM_USE_LATENCY_FOR_LEAST_QUEUE_DEPTH   L"DsmUseLatencyForLeastQueueDepth"
+
 //
 // Name of the value in the registry for the maximum request retry time during ALUA
 // state transitions. This value is found in the DSM's Services' Parameters key, and
@@ -112,6 +119,19 @@ Notes:
 //
 #define DSM_LEAST_BLOCKS_DEFAULT_THRESHOLD 0x00100000
 
+//
+// Weight given to a new sample in the per-path service time and transfer size
+// moving averages, expressed as a shift (ie. new sample contributes 1/8th).
+//
+#define DSM_LATENCY_EWMA_SHIFT 3
+
+//
+// If a path has been idle for this long (in ticks), its service time estimate
+// is considered stale and the path is treated as having no predicted latency,
+// so that it gets re-sampled.
+//
+#define DSM_LATENCY_ESTIMATE_STALE_TIME DSM_SECONDS_TO_TICKS(1)
+
 //
 // Initialization data structure that needs to be filled in for MPIO
 //
@@ -826,6 +846,16 @@ typedef enum _DSM_DEFAULT_LB_POLICY_TYPE {
 
 typedef ULONG   DSM_LOAD_BALANCE_TYPE, *PDSM_LOAD_BALANCE_TYPE;
 
+//
+// An entry in a group's snapshot of usable active/optimized paths. Index is
+// the position of DeviceInfo in the DSM_IDS list that MPIO passes in, so that
+// the entry can be validated against that list before it is dereferenced.
+//
+typedef struct _DSM_PATH_SNAPSHOT_ENTRY {
+    PDSM_DEVICE_INFO DeviceInfo;
+    ULONG Index;
+} DSM_PATH_SNAPSHOT_ENTRY, *PDSM_PATH_SNAPSHOT_ENTRY;
+
 
 //
 // Information about multi-path groups: The same device found via multiple paths
@@ -904,6 +934,12 @@ typedef struct _DSM_GROUP_ENTRY {
     //
     BOOLEAN UseCacheForLeastBlocks;    
 
+    //
+    // Flag to indicate whether or not to choose the path with the least
+    // predicted completion time when employing Least Queue Depth policy.
+    //
+    BOOLEAN UseLatencyForLeastQueueDepth;
+
     //
     // Flag used to indicate if a throttle request succeeded.
     //
@@ -941,6 +977,21 @@ typedef struct _DSM_GROUP_ENTRY {
     //
     PVOID PathToBeUsed;
 
+    //
+    // Snapshot of the usable active/optimized paths, used to pick a path for
+    // read/write requests without walking the device list. The snapshot is
+    // valid only while PathSnapshotBuiltGeneration equals PathSnapshotGeneration;
+    // the latter is bumped whenever path states or the LB policy change.
+    // PathSnapshotBuilder serializes rebuilds and PathSnapshotCursor is the
+    // Round Robin position within the snapshot.
+    //
+    volatile LONG PathSnapshotGeneration;
+    volatile LONG PathSnapshotBuiltGeneration;
+    volatile LONG PathSnapshotBuilder;
+    volatile LONG PathSnapshotCursor;
+    ULONG PathSnapshotCount;
+    DSM_PATH_SNAPSHOT_ENTRY PathSnapshot[DSM_MAX_PATHS];
+
     //
     // Size of cache set by Admin. Used in case of handling sequential
     // IO in Least Blocks policy.
@@ -1025,6 +1076,20 @@ typedef struct _DSM_FAILOVER_GROUP {
     //
     volatile LONG NumberOfRequestsInFlight;
 
+    //
+    // Interrupt time at which the last request on this path completed, or at
+    // which the path went from idle to busy. Used to measure service time.
+    //
+    ULONGLONG LastServiceTimeStamp;
+
+    //
+    // Moving averages of the time (in ticks) taken to service a read/write
+    // request on this path, and of the size of those requests. These will be
+    // used in LQD load balance policy when latency-aware selection is enabled.
+    //
+    ULONGLONG ServiceTimeEstimate;
+    ULONGLONG TransferLengthEstimate;
+
     //
     // Number of devices in this FOG.
     //
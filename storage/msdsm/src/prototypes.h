@@ -500,6 +500,31 @@ DsmpDecrementCounters(
     _In_ PSCSI_REQUEST_BLOCK Srb
     );
 
+ULONGLONG
+DsmpGetPredictedCompletionTime(
+    _In_ PDSM_FAILOVER_GROUP FailGroup,
+    _In_ ULONG Bytes,
+    _In_ ULONGLONG CurrentTime
+    );
+
+VOID
+DsmpInvalidatePathSnapshot(
+    _In_ PDSM_GROUP_ENTRY Group
+    );
+
+VOID
+DsmpBuildPathSnapshot(
+    _In_ PDSM_GROUP_ENTRY Group,
+    _In_ PDSM_IDS DsmList
+    );
+
+PDSM_FAILOVER_GROUP
+DsmpGetPathFromSnapshot(
+    _In_ PDSM_GROUP_ENTRY Group,
+    _In_ PDSM_IDS DsmList,
+    _In_opt_ PSCSI_REQUEST_BLOCK Srb
+    );
+
 PDSM_FAILOVER_GROUP
 DsmpGetPath(
     _In_ IN PDSM_CONTEXT DsmContext,
@@ -1111,6 +1136,12 @@ DsmpQueryCacheInformationFromRegistry(
     _Out_ OUT PULONGLONG CacheSizeForLeastBlocks
     );
 
+NTSTATUS
+DsmpQueryLatencyInformationFromRegistry(
+    _In_ IN PDSM_CONTEXT DsmContext,
+    _Out_ OUT PBOOLEAN UseLatencyForLeastQueueDepth
+    );
+
 BOOLEAN
 DsmpConvertSharedSpinLockToExclusive(
     _Inout_ _Requires_lock_held_(*_Curr_) PEX_SPIN_LOCK SpinLock
@@ -6697,7 +6697,8 @@ Return Value:
 
     //
     // There may have been a change to the device states.
-    // DsmpGetPath() will pick these changes for RR, RRWS and LQD.
+    // DsmpGetPath() will pick these changes for RR, RRWS and LQD, once its
+    // path snapshot has been invalidated.
     // However, it won't for FOO and WP, so update PTBU if needed.
     //
     if (Group->LoadBalanceType == DSM_LB_FAILOVER ||
@@ -6711,6 +6712,8 @@ Return Value:
         }
     }
 
+    DsmpInvalidatePathSnapshot(Group);
+
     TracePrint((TRACE_LEVEL_VERBOSE,
                 TRACE_FLAG_GENERAL,
                 "DsmpAdjustDeviceStatesALUA (Group %p): Exiting function with status %x\n",
@@ -7892,6 +7895,80 @@ Return Value:
     return status;
 }
 
+NTSTATUS
+DsmpQueryLatencyInformationFromRegistry(
+    _In_ IN PDSM_CONTEXT DsmContext,
+    _Out_ OUT PBOOLEAN UseLatencyForLeastQueueDepth
+    )
+/*++
+
+Routine Description:
+
+    This routine is used to get the information about whether Least Queue Depth
+    policy should choose paths based on their predicted completion time.
+    The value is determined by querying the value found at
+    "msdsm\Parameters\DsmUseLatencyForLeastQueueDepth"
+
+Arguments:
+
+    Context - The DSM Context value.
+    UseLatencyForLeastQueueDepth - Returns the flag that indicates whether or not
+                                   to use per-path service time estimates when
+                                   LB policy is Least Queue Depth.
+
+Return Value:
+
+    Status of the RtlQueryRegistryValues call.
+
+--*/
+{
+    RTL_QUERY_REGISTRY_TABLE queryTable[2] = {0};
+    WCHAR registryKeyName[56] = {0};
+    NTSTATUS status;
+    BOOLEAN useLatencyForLeastQueueDepthDefault = FALSE;
+
+    TracePrint((TRACE_LEVEL_VERBOSE,
+                TRACE_FLAG_PNP,
+                "DsmpQueryLatencyInformationFromRegistry (DsmCtxt %p): Entering function.\n",
+                DsmContext));
+
+    NT_ASSERT(UseLatencyForLeastQueueDepth);
+
+    RtlZeroMemory(queryTable, sizeof(queryTable));
+
+    //
+    // Build the key value name that we want as the base of the query.
+    //
+    RtlStringCbPrintfW(registryKeyName,
+                       sizeof(registryKeyName),
+                       DSM_PARAMETER_PATH_W);
+
+    //
+    // The query table has two entries. One for whether to use latency, and
+    // and the second which is the 'NULL' terminator.
+    //
+    queryTable[0].Flags = RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_REQUIRED | RTL_QUERY_REGISTRY_TYPECHECK;
+    queryTable[0].Name = DSM_USE_LATENCY_FOR_LEAST_QUEUE_DEPTH;
+    queryTable[0].EntryContext = UseLatencyForLeastQueueDepth;
+    queryTable[0].DefaultType  = (REG_BINARY << RTL_QUERY_REGISTRY_TYPECHECK_SHIFT) | REG_BINARY;
+    queryTable[0].DefaultLength = sizeof(BOOLEAN);
+    queryTable[0].DefaultData = &useLatencyForLeastQueueDepthDefault;
+
+    status = RtlQueryRegistryValues(RTL_REGISTRY_SERVICES,
+                                    registryKeyName,
+                                    queryTable,
+                                    registryKeyName,
+                                    NULL);
+
+    TracePrint((TRACE_LEVEL_VERBOSE,
+                TRACE_FLAG_PNP,
+                "DsmpQueryLatencyInformationFromRegistry (DsmCtxt %p): Exiting function with status %x.\n",
+                DsmContext,
+                status));
+
+    return status;
+}
+
 BOOLEAN
 DsmpConvertSharedSpinLockToExclusive(
     _Inout_ _Requires_lock_held_(*_Curr_) PEX_SPIN_LOCK SpinLock
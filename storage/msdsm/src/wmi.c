@@ -1713,6 +1713,8 @@ Return Value:
                                   SpecialHandlingFlag);
     }
 
+    DsmpInvalidatePathSnapshot(group);
+
 __Exit_DsmpClearLoadBalancePolicy:
 
     if (deviceKey) {
@@ -2422,6 +2424,8 @@ Return Value:
 
             InterlockedExchangePointer(&(groupEntry->PathToBeUsed), NULL);
         }
+
+        DsmpInvalidatePathSnapshot(groupEntry);
     }
 
     ExReleaseSpinLockExclusive(&(DsmContext->DsmContextLock), irql);
@@ -270,7 +270,8 @@ _IRQL_requires_(DISPATCH_LEVEL)
 VOID
 HandleEndpointEvent (
     WDFDEVICE WdfDevice,
-    ENDPOINT_EVENT EndpointEvent
+    ENDPOINT_EVENT EndpointEvent,
+    ULONG PhysicalEndpoint
     )
 /*++
 
@@ -284,6 +285,8 @@ Arguments:
 
     EndpointEvent -  Endpoint specific event.
 
+    PhysicalEndpoint - Physical endpoint the event was raised on.
+
 --*/
 {
     UFXENDPOINT Endpoint;
@@ -295,14 +298,21 @@ Arguments:
     ControllerContext = DeviceGetControllerContext(WdfDevice);
     DeviceContext = UfxDeviceGetContext(ControllerContext->UfxDevice);
 
-    //
-    // #### TODO: Insert code to extract endpoint event and endpoint number ####
-    // 
-    
-    // Sample will assume a transfer complete event on endpoint 1 for illustration purposes
-    EndpointEvent = EndpointEventTransferComplete;
-    
-    Endpoint = DeviceContext->PhysicalEndpointToUfxEndpoint[1];
+    if (PhysicalEndpoint >= MAX_PHYSICAL_ENDPOINTS) {
+        TraceError("Endpoint event on invalid physical endpoint %d", PhysicalEndpoint);
+        NT_ASSERT(FALSE);
+        goto End;
+    }
+
+    Endpoint = DeviceContext->PhysicalEndpointToUfxEndpoint[PhysicalEndpoint];
+    if (Endpoint == NULL) {
+        //
+        // The endpoint may have been destroyed after the controller raised the event.
+        //
+        TraceWarning("Endpoint event %d on unconfigured physical endpoint %d",
+                     EndpointEvent, PhysicalEndpoint);
+        goto End;
+    }
 
     switch (EndpointEvent) {
 
@@ -336,5 +346,6 @@ Arguments:
         NT_ASSERT(FALSE);
     }
 
+End:
     TraceExit();
 }
\ No newline at end of file
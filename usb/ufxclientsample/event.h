@@ -43,6 +43,11 @@ typedef enum _ENDPOINT_EVENT {
 
 typedef struct _CONTROLLER_EVENT {
     CONTROLLER_EVENT_TYPE Type;
+
+    //
+    // Physical endpoint an endpoint event was raised on
+    //
+    ULONG PhysicalEndpoint;
     
     union {
         DEVICE_EVENT DeviceEvent;
@@ -54,7 +59,8 @@ _IRQL_requires_(DISPATCH_LEVEL)
 VOID
 HandleEndpointEvent (
     WDFDEVICE WdfDevice,
-    ENDPOINT_EVENT EndpointEvent
+    ENDPOINT_EVENT EndpointEvent,
+    ULONG PhysicalEndpoint
     );
 
 _IRQL_requires_(DISPATCH_LEVEL)
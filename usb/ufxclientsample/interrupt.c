@@ -30,6 +30,13 @@ EVT_WDF_INTERRUPT_ISR DeviceInterrupt_EvtInterruptIsr;
 EVT_WDF_INTERRUPT_DPC DeviceInterrupt_EvtInterruptDpc;
 EVT_WDF_INTERRUPT_ISR DeviceInterrupt_EvtAttachDetachInterruptIsr;
 
+//
+// Upper bound on events handled in one DPC, so a busy controller cannot keep
+// the processor at DISPATCH_LEVEL indefinitely. Remaining events are handled
+// by a requeued DPC.
+//
+#define MAX_EVENTS_PER_DPC 64
+
 _Must_inspect_result_
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
@@ -167,6 +174,87 @@ Return Value:
     return TRUE;
 }
 
+_IRQL_requires_(DISPATCH_LEVEL)
+BOOLEAN
+InterruptGetNextEvent (
+    _In_ PCONTROLLER_CONTEXT ControllerContext,
+    _In_ ULONG EventIndex,
+    _Out_ CONTROLLER_EVENT *ControllerEvent
+    )
+/*++
+
+Routine Description:
+
+    Reads the next pending event from the controller's event buffer.
+
+Arguments:
+
+    ControllerContext - Context of the controller.
+
+    EventIndex - Number of events already read in this DPC.
+
+    ControllerEvent - Receives the event.
+
+Return Value:
+
+    TRUE if an event was read, FALSE if the event buffer is empty.
+
+--*/
+{
+    UNREFERENCED_PARAMETER(ControllerContext);
+
+    RtlZeroMemory(ControllerEvent, sizeof(*ControllerEvent));
+
+    //
+    // #### TODO: Insert code to read the next event from the controller's event buffer ####
+    //
+
+    //
+    // Sample will assume a single transfer complete event on physical endpoint 1
+    // for illustration purposes.
+    //
+    if (EventIndex > 0) {
+        return FALSE;
+    }
+
+    ControllerEvent->Type = EventTypeEndpoint;
+    ControllerEvent->PhysicalEndpoint = 1;
+    ControllerEvent->u.EndpointEvent = EndpointEventTransferComplete;
+
+    return TRUE;
+}
+
+_IRQL_requires_(DISPATCH_LEVEL)
+VOID
+InterruptFlushTransferComplete (
+    _In_ WDFDEVICE WdfDevice,
+    _Inout_ PULONG PendingTransferComplete
+    )
+/*++
+
+Routine Description:
+
+    Dispatches the transfer complete events collected for data endpoints.
+    Each endpoint is handled once, retiring all TRBs the controller has
+    completed since the endpoint was last serviced.
+
+Arguments:
+
+    WdfDevice - Wdf device object corresponding to the FDO
+
+    PendingTransferComplete - Bitmask of physical endpoints with a pending
+                              transfer complete event. Cleared on return.
+
+--*/
+{
+    ULONG PhysicalEndpoint;
+
+    while (BitScanForward(&PhysicalEndpoint, *PendingTransferComplete)) {
+        *PendingTransferComplete &= ~(1UL << PhysicalEndpoint);
+        HandleEndpointEvent(WdfDevice, EndpointEventTransferComplete, PhysicalEndpoint);
+    }
+}
+
 VOID 
 DeviceInterrupt_EvtInterruptDpc (
     _In_ WDFINTERRUPT Interrupt,
@@ -193,6 +281,8 @@ Arguments:
     BOOLEAN Attached;
     BOOLEAN GotAttachOrDetach;
     CONTROLLER_EVENT ControllerEvent;
+    ULONG EventCount;
+    ULONG PendingTransferComplete;
 
     UNREFERENCED_PARAMETER(Interrupt);
 
@@ -233,29 +323,69 @@ Arguments:
 
     InterruptContext = DeviceInterruptGetContext(ControllerContext->DeviceInterrupt);
 
-    //
-    // #### TODO: Insert code to read and dispatch events from the controller ####
-    // 
+    UNREFERENCED_PARAMETER(InterruptContext);
 
-    // The sample will assume an endpoint event of EndpointEventTransferComplete
-    ControllerEvent.Type = EventTypeEndpoint;
-    ControllerEvent.u.EndpointEvent = EndpointEventTransferComplete;
-    
     //
-    // Handle events from the controller
+    // Drain the event buffer. Transfer complete events on data endpoints are
+    // collected and handled once per endpoint, since a single pass over the
+    // endpoint's TRB ring retires every transfer the controller has finished.
+    // Any other event first flushes the collected ones so the per-endpoint
+    // order of events is preserved. Control endpoint events are not
+    // collected; their setup, data and status stages are handled in order.
     //
-    switch (ControllerEvent.Type) {
-    case EventTypeDevice:
-        HandleDeviceEvent(WdfDevice,  ControllerEvent.u.DeviceEvent);
-        break;
-
-    case EventTypeEndpoint:
-        HandleEndpointEvent(WdfDevice, ControllerEvent.u.EndpointEvent);
-        break;
+    PendingTransferComplete = 0;
+
+    for (EventCount = 0; EventCount < MAX_EVENTS_PER_DPC; EventCount++) {
+
+        if (!InterruptGetNextEvent(ControllerContext, EventCount, &ControllerEvent)) {
+            break;
+        }
+
+        if (ControllerEvent.Type == EventTypeEndpoint &&
+            ControllerEvent.u.EndpointEvent == EndpointEventTransferComplete &&
+            ControllerEvent.PhysicalEndpoint > 1 &&
+            ControllerEvent.PhysicalEndpoint < MAX_PHYSICAL_ENDPOINTS) {
+
+            PendingTransferComplete |= 1UL << ControllerEvent.PhysicalEndpoint;
+            continue;
+        }
+
+        InterruptFlushTransferComplete(WdfDevice, &PendingTransferComplete);
+
+        //
+        // Handle events from the controller
+        //
+        switch (ControllerEvent.Type) {
+        case EventTypeDevice:
+            HandleDeviceEvent(WdfDevice,  ControllerEvent.u.DeviceEvent);
+            break;
+
+        case EventTypeEndpoint:
+            HandleEndpointEvent(WdfDevice,
+                                ControllerEvent.u.EndpointEvent,
+                                ControllerEvent.PhysicalEndpoint);
+            break;
+        }
     }
 
+    InterruptFlushTransferComplete(WdfDevice, &PendingTransferComplete);
+
+    //
+    // #### TODO: Insert code to acknowledge EventCount events to the controller ####
+    //
+    // Acknowledge all events handled in this DPC with a single register write,
+    // rather than one write per event.
+    //
+
     WdfSpinLockRelease(ControllerContext->DpcLock);
 
+    if (EventCount == MAX_EVENTS_PER_DPC) {
+        //
+        // More events may be pending. Let other DPCs run before handling them.
+        //
+        (void) WdfInterruptQueueDpcForIsr(ControllerContext->DeviceInterrupt);
+    }
+
     TraceExit();
 }
 
@@ -162,6 +162,257 @@ Parameters Description:
     WdfSpinLockRelease(UfxEndpointGetTransferContext(Endpoint)->TransferLock);
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+TransferTrbRingReset (
+    _In_ UFXENDPOINT Endpoint
+    )
+/*++
+Routine Description:
+
+    Empties the TRB ring of an endpoint and points its last entry back to
+    the first one. Must only be called while no transfer is started on the
+    endpoint.
+
+Parameters Description:
+
+    Endpoint - The endpoint whose ring to reset.
+
+--*/
+{
+    PTRANSFER_CONTEXT TransferContext;
+    PTRB LinkTrb;
+
+    TransferContext = UfxEndpointGetTransferContext(Endpoint);
+
+    RtlZeroMemory(TransferContext->Trbs, TRB_RING_SIZE * sizeof(TRB));
+
+    LinkTrb = &TransferContext->Trbs[TRB_RING_SIZE - 1];
+    LinkTrb->BufferLow = TransferContext->LogicalTrbs.LowPart;
+    LinkTrb->BufferHigh = (ULONG) TransferContext->LogicalTrbs.HighPart;
+    LinkTrb->Control = TRB_CONTROL_LINK | TRB_CONTROL_HWO;
+
+    TransferContext->TrbEnqueue = 0;
+    TransferContext->TrbDequeue = 0;
+    TransferContext->TrbsInUse = 0;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+TransferTrbEnqueue (
+    _In_ UFXENDPOINT Endpoint,
+    _In_ PHYSICAL_ADDRESS Address,
+    _In_ ULONG Length,
+    _In_ ULONG Control
+    )
+/*++
+Routine Description:
+
+    Fills in the next free TRB of the endpoint's ring. The caller has made
+    sure there is one. Ownership is handed to the controller last, so it
+    never sees a partially written TRB.
+
+Parameters Description:
+
+    Endpoint - The endpoint on which to transfer.
+
+    Address - Logical address of the buffer.
+
+    Length - Length of the buffer.
+
+    Control - TRB_CONTROL_XXX bits, other than TRB_CONTROL_HWO.
+
+--*/
+{
+    PTRANSFER_CONTEXT TransferContext;
+    PTRB Trb;
+
+    TransferContext = UfxEndpointGetTransferContext(Endpoint);
+
+    NT_ASSERT(TransferContext->TrbsInUse < TRB_RING_SIZE - 1);
+
+    Trb = &TransferContext->Trbs[TransferContext->TrbEnqueue];
+    Trb->BufferLow = Address.LowPart;
+    Trb->BufferHigh = (ULONG) Address.HighPart;
+    Trb->Length = Length & TRB_LENGTH_MASK;
+
+    KeMemoryBarrier();
+
+    Trb->Control = Control | TRB_CONTROL_HWO;
+
+    TransferContext->TrbEnqueue = (TransferContext->TrbEnqueue + 1) % (TRB_RING_SIZE - 1);
+    TransferContext->TrbsInUse += 1;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG
+TransferRetireTrbs (
+    _In_ UFXENDPOINT Endpoint
+    )
+/*++
+Routine Description:
+
+    Frees the TRBs the controller has handed back, oldest first.
+
+Parameters Description:
+
+    Endpoint - The endpoint that completed a transfer.
+
+Return Value:
+
+    Number of bytes the controller left untransferred in the retired TRBs.
+
+--*/
+{
+    PTRANSFER_CONTEXT TransferContext;
+    PTRB Trb;
+    ULONG BytesRemaining;
+
+    TransferContext = UfxEndpointGetTransferContext(Endpoint);
+    BytesRemaining = 0;
+
+    while (TransferContext->TrbsInUse > 0) {
+
+        Trb = &TransferContext->Trbs[TransferContext->TrbDequeue];
+
+        if (Trb->Control & TRB_CONTROL_HWO) {
+            break;
+        }
+
+        //
+        // #### TODO: Check the TRB status the controller wrote back ####
+        //
+
+        BytesRemaining += Trb->Length & TRB_LENGTH_MASK;
+
+        TransferContext->TrbDequeue = (TransferContext->TrbDequeue + 1) % (TRB_RING_SIZE - 1);
+        TransferContext->TrbsInUse -= 1;
+    }
+
+    return BytesRemaining;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+TransferCompletePrepared (
+    _In_ WDFDMATRANSACTION Transaction,
+    _In_ NTSTATUS Status
+    )
+/*++
+Routine Description:
+
+    Completes a request that was prepared but never programmed, and frees
+    its DMA transaction. The request must not be cancelable anymore.
+
+Parameters Description:
+
+    Transaction - DMA transaction of the prepared request.
+
+    Status - Completion status.
+
+--*/
+{
+    PDMA_CONTEXT DmaContext;
+    WDFREQUEST Request;
+
+    DmaContext = DmaGetContext(Transaction);
+    Request = DmaContext->Request;
+
+    if (!DmaContext->ZeroLength) {
+        WdfDmaTransactionRelease(Transaction);
+    }
+
+    WdfObjectDelete(Transaction);
+    WdfRequestComplete(Request, Status);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+TransferRemovePrepared (
+    _In_ UFXENDPOINT Endpoint,
+    _In_opt_ WDFDMATRANSACTION Transaction
+    )
+/*++
+Routine Description:
+
+    Removes a DMA transaction from the endpoint's prepared requests.
+
+Parameters Description:
+
+    Endpoint - The endpoint of the request.
+
+    Transaction - DMA transaction to remove.
+
+Return Value:
+
+    TRUE if the transaction was prepared, FALSE otherwise.
+
+--*/
+{
+    PTRANSFER_CONTEXT TransferContext;
+    ULONG Index;
+
+    TransferContext = UfxEndpointGetTransferContext(Endpoint);
+
+    if (Transaction == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < TransferContext->PreparedCount; Index++) {
+        if (TransferContext->Prepared[Index] == Transaction) {
+            RtlMoveMemory(&TransferContext->Prepared[Index],
+                          &TransferContext->Prepared[Index + 1],
+                          (TransferContext->PreparedCount - Index - 1) * sizeof(WDFDMATRANSACTION));
+            TransferContext->PreparedCount -= 1;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+TransferFlushPrepared (
+    _In_ UFXENDPOINT Endpoint
+    )
+/*++
+Routine Description:
+
+    Cancels the endpoint's prepared requests when it is disabled. A request
+    whose cancel routine is already running is left in place; the cancel
+    routine completes it once it gets the TransferLock.
+
+Parameters Description:
+
+    Endpoint - The endpoint being disabled.
+
+--*/
+{
+    PTRANSFER_CONTEXT TransferContext;
+    WDFDMATRANSACTION Transaction;
+    NTSTATUS Status;
+    ULONG Index;
+    ULONG Kept;
+
+    TransferContext = UfxEndpointGetTransferContext(Endpoint);
+    Kept = 0;
+
+    for (Index = 0; Index < TransferContext->PreparedCount; Index++) {
+        Transaction = TransferContext->Prepared[Index];
+
+        Status = WdfRequestUnmarkCancelable(DmaGetContext(Transaction)->Request);
+        if (Status == STATUS_CANCELLED) {
+            TransferContext->Prepared[Kept++] = Transaction;
+        } else {
+            TRACE_TRANSFER("FLUSH (Prepared)", Endpoint, DmaGetContext(Transaction)->Request);
+            TransferCompletePrepared(Transaction, STATUS_CANCELLED);
+        }
+    }
+
+    TransferContext->PreparedCount = Kept;
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 CommandStallSet (
@@ -470,6 +721,15 @@ Parameters Description:
         TRACE_TRANSFER("CANCEL", Endpoint, Request);
     }
 
+    //
+    // A request that was only prepared has not been handed to the
+    // controller, so it can be completed right away.
+    //
+    if (TransferRemovePrepared(Endpoint, RequestContext->Transaction)) {
+        TransferCompletePrepared(RequestContext->Transaction, STATUS_CANCELLED);
+        goto End;
+    }
+
     //
     // After this function exists, KMDF will release the reference to this
     // request. Acquire a reference to make sure it doesn't get deleted.
@@ -671,6 +931,10 @@ Parameters Description:
         }
         WdfObjectDelete(Transaction);
         TransferContext->Transaction = NULL;
+
+        if (!TransferContext->TransferStarted) {
+            TransferTrbRingReset(Endpoint);
+        }
     }
 
     //
@@ -717,6 +981,8 @@ Parameters Description:
     // If endpoint is disabled, need to clear any stall.
     //
     if (!TransferContext->Enabled) {
+        TransferFlushPrepared(Endpoint);
+
         if (TransferContext->Stalled) {
             CommandStallClear(Endpoint);
         }
@@ -748,8 +1014,11 @@ TransferProgram (
 /*++
 Routine Description:
 
-    DMA callback for transfers that use DMA. This function may be called
-    multiple times for a single transfer request.
+    Programs the scatter gather list of a DMA transaction into the
+    endpoint's TRB ring as one chain. This function may be called multiple
+    times for a single transfer request: once for each DMA transfer of the
+    request, and again from TransferCompleteData when the ring filled up
+    before the whole list was programmed.
 
 Parameters Description:
 
@@ -757,10 +1026,6 @@ Parameters Description:
 
     Transaction - The DMA transaction object associated with the request.
 
-Return Value:
-
-    TRUE if nothing went wrong, FALSE otherwise.
-
 --*/
 {
     PTRANSFER_CONTEXT TransferContext;
@@ -773,35 +1038,51 @@ Return Value:
     EpContext = UfxEndpointGetContext(Endpoint);
     DmaContext = DmaGetContext(Transaction);
 
-    DmaContext->BytesProgrammedCurrent = 0;
-    DmaContext->BytesRemaining = 0;
-
     TRACE_TRANSFER("PROGRAMMING", Endpoint, DmaContext->Request);
 
     //
-    // Try to program transfer structures
+    // One TRB per scatter gather element, chained together. If the ring
+    // fills up, the chain ends early with an interrupt and the rest of the
+    // list is programmed once the controller has given those TRBs back.
     //
     while (DmaContext->SgIndex < DmaContext->SgList->NumberOfElements) {
         PSCATTER_GATHER_ELEMENT Sg;
         BOOLEAN NoMoreSgs;
-        BOOLEAN DmaComplete;
         BOOLEAN LastSgInDma;
+        BOOLEAN AppendExtra;
+        ULONG TrbsFree;
+        ULONG Control;
 
         Sg = &DmaContext->SgList->Elements[DmaContext->SgIndex];
 
         NoMoreSgs = (DmaContext->SgIndex == DmaContext->SgList->NumberOfElements - 1);
         LastSgInDma = ((DmaContext->BytesProgrammed + Sg->Length) == DmaContext->BytesRequested);
+        AppendExtra = LastSgInDma && DmaContext->NeedExtraBuffer;
 
         //
-        // #### TODO: Insert code to map scatter gather buffers to controller transfer structures ####
+        // The extra buffer must go right behind the last element, so keep
+        // a TRB for it.
         //
+        TrbsFree = (TRB_RING_SIZE - 1) - TransferContext->TrbsInUse;
+        if (TrbsFree < (AppendExtra ? 2U : 1U)) {
+            break;
+        }
+
+        if (AppendExtra || (!NoMoreSgs && TrbsFree > 1)) {
+            Control = TRB_CONTROL_CHAIN;
+        } else if (LastSgInDma) {
+            Control = TRB_CONTROL_LAST | TRB_CONTROL_IOC;
+        } else {
+            Control = TRB_CONTROL_IOC;
+        }
+
+        TransferTrbEnqueue(Endpoint, Sg->Address, Sg->Length, Control);
 
         //
         // Need to remember how much we really programmed
         //
         DmaContext->BytesProgrammed += Sg->Length;
         DmaContext->BytesProgrammedCurrent += Sg->Length;
-        DmaComplete = (DmaContext->BytesProgrammed == DmaContext->BytesRequested);
 
         //
         // Advance to next SG
@@ -813,14 +1094,18 @@ Return Value:
     // Append IN ZLP or extra OUT buffer if needed.
     //
     if (DmaContext->BytesProgrammed == DmaContext->BytesRequested &&
-        DmaContext->NeedExtraBuffer) {
+        DmaContext->NeedExtraBuffer &&
+        !DmaContext->ExtraProgrammed) {
 
         TRACE_TRANSFER("EXTRA", Endpoint, DmaContext->Request);
 
-        //
-        // #### TODO: Insert code to append an extra buffer to the transfer structures ####
-        //
+        TransferTrbEnqueue(
+            Endpoint,
+            WdfCommonBufferGetAlignedLogicalAddress(TransferContext->ExtraBuffer),
+            DmaContext->ExtraBytes,
+            TRB_CONTROL_LAST | TRB_CONTROL_IOC);
 
+        DmaContext->ExtraProgrammed = TRUE;
     }
 
     //
@@ -910,6 +1195,8 @@ Parameters Description:
 
     DmaContext->SgList = SgList;
     DmaContext->SgIndex = 0;
+    DmaContext->BytesProgrammedCurrent = 0;
+    DmaContext->BytesRemaining = 0;
     TransferProgram(Endpoint, Transaction);
     Transaction = NULL;
 
@@ -1110,6 +1397,7 @@ Parameters Description:
     }
 
     TransferContext->TransferStarted = FALSE;
+    TransferTrbRingReset(Endpoint);
     Transaction = TransferNextRequest(Endpoint);
 
 End:
@@ -1164,6 +1452,11 @@ Parameters Description:
 
     DmaContext = DmaGetContext(Transaction);
 
+    //
+    // Take back the TRBs the controller has finished with.
+    //
+    BytesRemaining = TransferRetireTrbs(Endpoint);
+
     //
     // #### TODO: Insert code to determine if the transfer is complete, or terminated due to a short packet. ####
 
@@ -1179,6 +1472,21 @@ Parameters Description:
         TransferContext->PendingCompletion = TRUE;
         WdfWorkItemEnqueue(TransferContext->CompletionWorkItem);
 
+    //
+    // If the ring filled up before the whole scatter gather list of this
+    // DMA transfer was programmed, continue the chain in the TRBs just
+    // retired.
+    //
+    } else if (!DmaContext->ZeroLength &&
+               (DmaContext->SgIndex < DmaContext->SgList->NumberOfElements ||
+                (DmaContext->BytesProgrammed == DmaContext->BytesRequested &&
+                 DmaContext->NeedExtraBuffer &&
+                 !DmaContext->ExtraProgrammed))) {
+
+        TRACE_TRANSFER("COMPLETE (Ring full)", Endpoint, NULL);
+
+        TransferProgram(Endpoint, Transaction);
+
     //
     // If transfer is still in progress, we need to program more transfers
     //
@@ -1339,6 +1647,7 @@ Parameters Description:
     PUFXDEVICE_CONTEXT DeviceContext;
     WDFCOMMONBUFFER ExtraBuffer;
     WDFCOMMONBUFFER SetupPacketBuffer;
+    WDFCOMMONBUFFER TrbBuffer;
 
     TraceEntry();
 
@@ -1363,6 +1672,10 @@ Parameters Description:
     ExtraBuffer = TransferContext->ExtraBuffer;
     TransferContext->ExtraBuffer = NULL;
 
+    TrbBuffer = TransferContext->TrbBuffer;
+    TransferContext->TrbBuffer = NULL;
+    TransferContext->Trbs = NULL;
+
     SetupPacketBuffer = NULL;
     if (CONTROL_ENDPOINT(Endpoint)) {
         PCONTROL_CONTEXT ControlContext;
@@ -1395,6 +1708,10 @@ Parameters Description:
         WdfObjectDelete(SetupPacketBuffer);
     }
 
+    if (TrbBuffer != NULL) {
+        WdfObjectDelete(TrbBuffer);
+    }
+
     TraceExit();
 }
 
@@ -1479,6 +1796,25 @@ Return Value:
     // #### TODO: Insert code to initialize controller data structures in the shared common buffer
     //
 
+    //
+    // Allocate the TRB ring for the endpoint
+    //
+    if (TransferContext->TrbBuffer == NULL) {
+        WDF_COMMON_BUFFER_CONFIG_INIT(&BufferConfig, COMMON_BUFFER_ALIGNMENT);
+        Status = WdfCommonBufferCreateWithConfig(
+                    ControllerContext->DmaEnabler,
+                    TRB_RING_SIZE * sizeof(TRB),
+                    &BufferConfig,
+                    WDF_NO_OBJECT_ATTRIBUTES,
+                    &TransferContext->TrbBuffer);
+        CHK_NT_MSG(Status, "Failed to create TRB ring");
+    }
+
+    TransferContext->Trbs = WdfCommonBufferGetAlignedVirtualAddress(TransferContext->TrbBuffer);
+    TransferContext->LogicalTrbs =
+        WdfCommonBufferGetAlignedLogicalAddress(TransferContext->TrbBuffer);
+    TransferTrbRingReset(Endpoint);
+
     //
     // Map physical endpoint
     //
@@ -1588,7 +1924,6 @@ Parameters Description:
     NTSTATUS Status;
     PCONTROLLER_CONTEXT ControllerContext;
     PUFXENDPOINT_CONTEXT EpContext;
-    PTRANSFER_CONTEXT TransferContext;
     WDF_OBJECT_ATTRIBUTES Attributes;
     PDMA_CONTEXT DmaContext;
     PREQUEST_CONTEXT RequestContext;
@@ -1598,13 +1933,10 @@ Parameters Description:
     TraceEntry();
 
     EpContext = UfxEndpointGetContext(Endpoint);
-    TransferContext = UfxEndpointGetTransferContext(Endpoint);
     ControllerContext = DeviceGetControllerContext(EpContext->WdfDevice);
 
     NT_ASSERT(DirectionIn || !AppendZlp);
 
-    TransferContext->PendingCompletion = FALSE;
-
     //
     // Create a DMA Transaction over the data
     //
@@ -1664,11 +1996,6 @@ Parameters Description:
         ControlContext->DataStageExists = TRUE;
     }
 
-    //
-    // Keep track of DMA
-    //
-    TransferContext->Transaction = Transaction;
-
     //
     // We need to mark cancelable before starting DMA (which may take time)
     //
@@ -1683,13 +2010,8 @@ Parameters Description:
     if (DmaContext->BytesRequested == 0) {
 
         DmaContext->ZeroLength = TRUE;
-
-        TRACE_TRANSFER("ZERO LENGTH", Endpoint, DmaContext->Request);
-
         DmaContext->ExtraBytes = 0;
 
-        TransferCommandStartOrUpdate(Endpoint);
-
     } else {
         //
         // Use request to initialize DMA
@@ -1710,7 +2032,6 @@ End:
     if (!NT_SUCCESS(Status)) {
         WdfRequestComplete(Request, Status);
         if (Transaction != NULL) {
-            TransferContext->Transaction = NULL;
             WdfObjectDelete(Transaction);
             Transaction = NULL;
         }
@@ -1720,6 +2041,45 @@ End:
     return Transaction;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+TransferActivate (
+    _In_ UFXENDPOINT Endpoint,
+    _In_ WDFDMATRANSACTION Transaction
+    )
+/*++
+Routine Description:
+
+    Makes a transaction set up by TransferBegin the endpoint's current
+    transfer. Zero-length transfers are started here; the caller executes
+    the DMA of the others.
+
+Parameters Description:
+
+    Endpoint - The endpoint to transfer on.
+
+    Transaction - The DMA transaction of the request.
+
+--*/
+{
+    PTRANSFER_CONTEXT TransferContext;
+    PDMA_CONTEXT DmaContext;
+
+    TransferContext = UfxEndpointGetTransferContext(Endpoint);
+    DmaContext = DmaGetContext(Transaction);
+
+    //
+    // Keep track of DMA
+    //
+    TransferContext->PendingCompletion = FALSE;
+    TransferContext->Transaction = Transaction;
+
+    if (DmaContext->ZeroLength) {
+        TRACE_TRANSFER("ZERO LENGTH", Endpoint, DmaContext->Request);
+        TransferCommandStartOrUpdate(Endpoint);
+    }
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 TransferHandshake (
@@ -1808,6 +2168,119 @@ End:
 }
 
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+WDFDMATRANSACTION
+TransferBeginRequest (
+    _In_ UFXENDPOINT Endpoint,
+    _In_ WDFREQUEST Request,
+    _In_ ULONG Ioctl
+    )
+/*++
+Routine Description:
+
+    Sets up a data transfer for a request retrieved from the endpoint's
+    transfer queue. Requests that are not valid on the endpoint are
+    completed.
+
+Parameters Description:
+
+    Endpoint - Endpoint with request.
+
+    Request - The request.
+
+    Ioctl - The request's IOCTL.
+
+Return Value:
+
+    The request's DMA transaction, or NULL if the request was completed.
+
+--*/
+{
+    PUFXENDPOINT_CONTEXT EpContext;
+
+    EpContext = UfxEndpointGetContext(Endpoint);
+
+    if (DIRECTION_IN(Endpoint) &&
+        Ioctl == IOCTL_INTERNAL_USBFN_TRANSFER_IN) {
+
+        return TransferBegin(Endpoint, Request, TRUE, FALSE);
+
+    } else if (DIRECTION_IN(Endpoint) &&
+               Ioctl == IOCTL_INTERNAL_USBFN_TRANSFER_IN_APPEND_ZERO_PKT) {
+
+        return TransferBegin(Endpoint, Request, TRUE, TRUE);
+
+    } else if (DIRECTION_OUT(Endpoint) &&
+               Ioctl == IOCTL_INTERNAL_USBFN_TRANSFER_OUT) {
+
+        return TransferBegin(Endpoint, Request, FALSE, FALSE);
+    }
+
+    TraceWarning("INVALID: 0x%p (%d), Ioctl: %08X",
+        Endpoint, EpContext->PhysicalEndpoint, Ioctl);
+    WdfRequestComplete(Request, STATUS_INVALID_DEVICE_REQUEST);
+
+    return NULL;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+TransferPrepareRequests (
+    _In_ UFXENDPOINT Endpoint
+    )
+/*++
+Routine Description:
+
+    Retrieves requests from the transfer queue of a data endpoint and sets
+    up their DMA transactions, up to TRANSFER_MAX_PREPARED, so the next
+    transfer can be programmed as soon as the current one completes. The
+    caller holds the TransferLock.
+
+Parameters Description:
+
+    Endpoint - Endpoint with requests.
+
+--*/
+{
+    NTSTATUS Status;
+    PTRANSFER_CONTEXT TransferContext;
+    WDFREQUEST Request;
+    WDF_REQUEST_PARAMETERS Params;
+    WDFDMATRANSACTION Transaction;
+
+    TraceEntry();
+
+    TransferContext = UfxEndpointGetTransferContext(Endpoint);
+
+    NT_ASSERT(!CONTROL_ENDPOINT(Endpoint));
+
+    while (TransferContext->PreparedCount < TRANSFER_MAX_PREPARED) {
+
+        Status = WdfIoQueueRetrieveNextRequest(UfxEndpointGetTransferQueue(Endpoint),
+                                               &Request);
+        if (Status == STATUS_NO_MORE_ENTRIES || Status == STATUS_WDF_PAUSED) {
+            break;
+        }
+
+        CHK_NT_MSG(Status, "Failed to retrieve next request");
+
+        WDF_REQUEST_PARAMETERS_INIT(&Params);
+        WdfRequestGetParameters(Request, &Params);
+
+        Transaction = TransferBeginRequest(Endpoint,
+                                           Request,
+                                           Params.Parameters.DeviceIoControl.IoControlCode);
+        if (Transaction != NULL) {
+            TRACE_TRANSFER("PREPARED", Endpoint, Request);
+            TransferContext->Prepared[TransferContext->PreparedCount] = Transaction;
+            TransferContext->PreparedCount += 1;
+        }
+    }
+
+End:
+    TraceExit();
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 WDFDMATRANSACTION
 TransferNextRequest (
@@ -1816,7 +2289,8 @@ TransferNextRequest (
 /*++
 Routine Description:
 
-    Handles IOCTL requests on the endpoint.
+    Handles IOCTL requests on the endpoint. Data endpoints take the oldest
+    prepared request, and prepare more behind it.
 
 Parameters Description:
 
@@ -1828,14 +2302,30 @@ Parameters Description:
     WDFREQUEST Request;
     WDF_REQUEST_PARAMETERS Params;
     ULONG Ioctl;
-    PUFXENDPOINT_CONTEXT EpContext;
+    PTRANSFER_CONTEXT TransferContext;
     WDFDMATRANSACTION Transaction;
 
     TraceEntry();
 
-    EpContext = UfxEndpointGetContext(Endpoint);
+    TransferContext = UfxEndpointGetTransferContext(Endpoint);
     Transaction = NULL;
 
+    if (!CONTROL_ENDPOINT(Endpoint)) {
+
+        TransferPrepareRequests(Endpoint);
+
+        if (TransferContext->PreparedCount == 0) {
+            goto End;
+        }
+
+        Transaction = TransferContext->Prepared[0];
+        TransferRemovePrepared(Endpoint, Transaction);
+        TransferActivate(Endpoint, Transaction);
+
+        TransferPrepareRequests(Endpoint);
+        goto End;
+    }
+
 Fetch:
 
     //
@@ -1859,26 +2349,13 @@ Fetch:
     } else if (Ioctl == IOCTL_INTERNAL_USBFN_CONTROL_STATUS_HANDSHAKE_OUT) {
         TransferHandshake(Endpoint, Request, FALSE);
 
-    } else if (DIRECTION_IN(Endpoint) &&
-               Ioctl == IOCTL_INTERNAL_USBFN_TRANSFER_IN) {
-
-        Transaction = TransferBegin(Endpoint, Request, TRUE, FALSE);
-
-    } else if (DIRECTION_IN(Endpoint) &&
-               Ioctl == IOCTL_INTERNAL_USBFN_TRANSFER_IN_APPEND_ZERO_PKT) {
-
-        Transaction = TransferBegin(Endpoint, Request, TRUE, TRUE);
-
-    } else if (DIRECTION_OUT(Endpoint) &&
-               Ioctl == IOCTL_INTERNAL_USBFN_TRANSFER_OUT) {
-
-        Transaction = TransferBegin(Endpoint, Request, FALSE, FALSE);
-
     } else {
-        TraceWarning("INVALID: 0x%p (%d), Ioctl: %08X",
-            Endpoint, EpContext->PhysicalEndpoint, Ioctl);
-        WdfRequestComplete(Request, STATUS_INVALID_DEVICE_REQUEST);
-        goto Fetch;
+        Transaction = TransferBeginRequest(Endpoint, Request, Ioctl);
+        if (Transaction == NULL) {
+            goto Fetch;
+        }
+
+        TransferActivate(Endpoint, Transaction);
     }
 
 End:
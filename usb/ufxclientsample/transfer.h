@@ -24,6 +24,18 @@ Environment:
 
 #define MAX_TRANSFER_SIZE 0x20000000
 
+//
+// Number of requests per data endpoint that are set up ahead of the one
+// the controller is working on.
+//
+#define TRANSFER_MAX_PREPARED 4
+
+//
+// Number of TRBs in the ring of an endpoint. The last entry links back to
+// the first one.
+//
+#define TRB_RING_SIZE 64
+
 // nonstandard extension used : bit field types other than int
 #pragma warning(disable:4214)
 
@@ -34,6 +46,28 @@ typedef enum _DMA_STATE {
     Completed
 } DMA_STATE;
 
+//
+// Transfer request block. Each TRB describes one contiguous buffer; a TRB
+// with TRB_CONTROL_CHAIN set continues in the next one, so a whole scatter
+// gather list is handed to the controller as one chain.
+//
+// #### TODO: Adjust the TRB layout and control bits to the controller's ####
+//
+typedef struct _TRB {
+    ULONG BufferLow;
+    ULONG BufferHigh;
+    ULONG Length;
+    ULONG Control;
+} TRB, *PTRB;
+
+#define TRB_LENGTH_MASK         0x00FFFFFF
+
+#define TRB_CONTROL_HWO         0x00000001  // owned by the controller
+#define TRB_CONTROL_LAST        0x00000002  // last TRB of the transfer
+#define TRB_CONTROL_CHAIN       0x00000004  // buffer continues in the next TRB
+#define TRB_CONTROL_LINK        0x00000080  // points back to the start of the ring
+#define TRB_CONTROL_IOC         0x00000800  // raise an event on completion
+
 typedef struct _CONTROL_CONTEXT {
     WDFCOMMONBUFFER SetupPacketBuffer;
     BOOLEAN SetupRequested;
@@ -62,6 +96,24 @@ typedef struct _TRANSFER_CONTEXT {
     BOOLEAN CleanupOnEndComplete;
     WDFWORKITEM CompletionWorkItem;
     BOOLEAN PendingCompletion;
+
+    //
+    // TRB ring of the endpoint. TrbsInUse counts the entries between
+    // TrbDequeue and TrbEnqueue, not including the link TRB.
+    //
+    WDFCOMMONBUFFER TrbBuffer;
+    PTRB Trbs;
+    PHYSICAL_ADDRESS LogicalTrbs;
+    ULONG TrbEnqueue;
+    ULONG TrbDequeue;
+    ULONG TrbsInUse;
+
+    //
+    // Requests retrieved from the transfer queue and set up for DMA, in the
+    // order they will be programmed after Transaction.
+    //
+    WDFDMATRANSACTION Prepared[TRANSFER_MAX_PREPARED];
+    ULONG PreparedCount;
 } TRANSFER_CONTEXT, *PTRANSFER_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(TRANSFER_CONTEXT, UfxEndpointGetTransferContext);
@@ -81,6 +133,7 @@ typedef struct _DMA_CONTEXT {
     ULONG BytesRemaining;
     BOOLEAN CleanupOnProgramDma;
     BOOLEAN NeedExtraBuffer;
+    BOOLEAN ExtraProgrammed;
 } DMA_CONTEXT, *PDMA_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DMA_CONTEXT, DmaGetContext);
@@ -62,12 +62,15 @@ BOOL fDumpReadData = FALSE;
 BOOL fRead = FALSE;
 BOOL fWrite = FALSE;
 BOOL fCompareData = TRUE;
+BOOL fThroughput = FALSE;
+BOOL fIsochStream = FALSE;
 
 int gDebugLevel = 1;      // higher == more verbose, default is 1, 0 turns off all
 
 ULONG IterationCount = 1; //count of iterations of the test we are to perform
 int WriteLen = 0;         // #bytes to write
 int ReadLen = 0;          // #bytes to read
+ULONG PipelineDepth = 0;  // stages kept in flight by the driver, 0 leaves the driver default
 
 // functions
 
@@ -434,6 +437,10 @@ Return Value:
         printf("-o [s] where s is the output pipe\n");
         printf("-v verbose -- dumps read data\n");
         printf("-x to skip validation of read and write data\n");
+        printf("-p [n] where n is the number of stages the driver keeps in flight (1-%d)\n",
+               USBSAMP_MAX_PIPELINE_DEPTH);
+        printf("-t throughput mode -- reports MB/s and per-stage latency\n");
+        printf("-s reads an isoch input pipe through the driver's continuous reader\n");
 
         printf("\nUsage for USB and Endpoint info:\n");
         printf("-u to dump USB configuration and pipe info \n");
@@ -545,6 +552,29 @@ Return Value:
                 fCompareData = FALSE;
                 i++;
                 break;
+            case 'p':
+            case 'P':
+                if (i+1 >= argc) {
+                    usage();
+                    exit(1);
+                }
+                else {
+                    PipelineDepth = atoi(&argv[i+1][0]);
+                    if (PipelineDepth == 0 || PipelineDepth > USBSAMP_MAX_PIPELINE_DEPTH) {
+                        usage();
+                        exit(1);
+                    }
+                }
+                i++;
+                break;
+            case 't':
+            case 'T':
+                fThroughput = TRUE;
+                break;
+            case 's':
+            case 'S':
+                fIsochStream = TRUE;
+                break;
              case 'o':
              case 'O':
                  if (i+1 >= argc) {
@@ -1154,6 +1184,134 @@ Return Value:
 
 
 
+void
+set_pipeline_depth(
+    _In_ HANDLE hPipe,
+    _In_ PCSTR  PipeName
+    )
+/*++
+Routine Description:
+
+    Sets the number of stages the driver keeps in flight on a pipe. This
+    also resets the statistics of the pipe.
+
+--*/
+{
+    ULONG depth = PipelineDepth;
+    ULONG nBytes;
+
+    if (!DeviceIoControl(hPipe,
+                         IOCTL_USBSAMP_SET_PIPELINE_DEPTH,
+                         &depth,
+                         sizeof(depth),
+                         NULL,
+                         0,
+                         &nBytes,
+                         NULL)) {
+        printf("<%s> failed to set pipeline depth %d, error %d\n",
+               PipeName, depth, GetLastError());
+    }
+}
+
+BOOL
+get_pipe_statistics(
+    _In_  HANDLE                   hPipe,
+    _Out_ PUSBSAMP_PIPE_STATISTICS Stats
+    )
+{
+    ULONG nBytes;
+
+    ZeroMemory(Stats, sizeof(*Stats));
+
+    return DeviceIoControl(hPipe,
+                           IOCTL_USBSAMP_GET_PIPE_STATISTICS,
+                           NULL,
+                           0,
+                           Stats,
+                           sizeof(*Stats),
+                           &nBytes,
+                           NULL);
+}
+
+void
+print_throughput(
+    _In_ HANDLE    hPipe,
+    _In_ PCSTR     PipeName,
+    _In_ PCSTR     Operation,
+    _In_ PUSBSAMP_PIPE_STATISTICS StartStats,
+    _In_ ULONGLONG TotalBytes,
+    _In_ LONGLONG  Ticks,
+    _In_ LONGLONG  Frequency
+    )
+/*++
+Routine Description:
+
+    Prints the throughput of a pipe over the test, and the per-stage
+    latency the driver measured for it since StartStats was taken. The
+    maximum latency is the driver's, since the depth was last set.
+
+--*/
+{
+    USBSAMP_PIPE_STATISTICS stats;
+    ULONGLONG stages;
+    double seconds;
+
+    seconds = (double)Ticks / (double)Frequency;
+
+    printf("<%s> %s: %I64u bytes in %.3f s -- %.2f MB/s\n",
+           PipeName, Operation, TotalBytes, seconds,
+           seconds > 0 ? (double)TotalBytes / (1024.0 * 1024.0) / seconds : 0.0);
+
+    if (!get_pipe_statistics(hPipe, &stats)) {
+        return;
+    }
+
+    stages = stats.StagesCompleted - StartStats->StagesCompleted;
+
+    if (stages != 0) {
+        printf("<%s> pipeline depth %u, %I64u stages -- latency avg %I64u us, max %I64u us\n",
+               PipeName, stats.PipelineDepth, stages,
+               (stats.TotalStageLatency - StartStats->TotalStageLatency) / stages,
+               stats.MaxStageLatency);
+    }
+}
+
+void
+print_isoch_statistics(
+    _In_ HANDLE hPipe,
+    _In_ PCSTR  PipeName
+    )
+/*++
+Routine Description:
+
+    Prints the counters of the continuous isoch reader on a pipe.
+
+--*/
+{
+    USBSAMP_ISOCH_STATISTICS stats;
+    ULONG nBytes;
+
+    if (!DeviceIoControl(hPipe,
+                         IOCTL_USBSAMP_GET_ISOCH_STATISTICS,
+                         NULL,
+                         0,
+                         &stats,
+                         sizeof(stats),
+                         &nBytes,
+                         NULL)) {
+        printf("<%s> failed to get isoch statistics, error %d\n",
+               PipeName, GetLastError());
+        return;
+    }
+
+    printf("<%s> %I64u URBs, %I64u failed -- %I64u packets, %I64u bytes received\n",
+           PipeName, stats.UrbsCompleted, stats.UrbErrors,
+           stats.PacketsReceived, stats.BytesReceived);
+    printf("<%s> %I64u packets dropped, %I64u errors, %I64u late -- %I64u frames missed\n",
+           PipeName, stats.PacketsDropped, stats.PacketErrors,
+           stats.LatePackets, stats.MissedFrames);
+}
+
 int
 _cdecl
 main(
@@ -1188,6 +1346,15 @@ Return Value:
     HANDLE hRead = INVALID_HANDLE_VALUE;
     HANDLE hWrite = INVALID_HANDLE_VALUE;
     ULONG  fail = 0L;
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER start;
+    LARGE_INTEGER end;
+    LONGLONG readTicks = 0;
+    LONGLONG writeTicks = 0;
+    ULONGLONG totalRead = 0;
+    ULONGLONG totalWritten = 0;
+    USBSAMP_PIPE_STATISTICS readStats;
+    USBSAMP_PIPE_STATISTICS writeStats;
 
     parse(argc, argv );
 
@@ -1211,6 +1378,22 @@ Return Value:
             }
 
             hRead = open_file( inPipe);
+            if (PipelineDepth != 0) {
+                set_pipeline_depth(hRead, inPipe);
+            }
+            if (fIsochStream &&
+                !DeviceIoControl(hRead,
+                                 IOCTL_USBSAMP_START_ISOCH_STREAM,
+                                 NULL,
+                                 0,
+                                 NULL,
+                                 0,
+                                 (PULONG) &nBytesRead,
+                                 NULL)) {
+                printf("<%s> failed to start the continuous reader, error %d\n",
+                       inPipe, GetLastError());
+                fIsochStream = FALSE;
+            }
             pinBuf = (char*) malloc(ReadLen);
             if (pinBuf == NULL) {
                 return 0;
@@ -1226,12 +1409,22 @@ Return Value:
             }
 
             hWrite = open_file( outPipe);
+            if (PipelineDepth != 0) {
+                set_pipeline_depth(hWrite, outPipe);
+            }
             poutBuf = (char*)malloc(WriteLen);
             if (poutBuf == NULL) {
                 return 0;
             }
         }
 
+        QueryPerformanceFrequency(&frequency);
+
+        if (fThroughput) {
+            get_pipe_statistics(hRead, &readStats);
+            get_pipe_statistics(hWrite, &writeStats);
+        }
+
         for (i=0; i<IterationCount; i++) {
 
             if (fWrite && poutBuf && hWrite != INVALID_HANDLE_VALUE) {
@@ -1249,21 +1442,37 @@ Return Value:
                 //
                 // send the write
                 //
-                WriteFile(hWrite, poutBuf, WriteLen,  (PULONG) &nBytesWrite, NULL);
+                QueryPerformanceCounter(&start);
+                if (!WriteFile(hWrite, poutBuf, WriteLen,  (PULONG) &nBytesWrite, NULL)) {
+                    nBytesWrite = 0;
+                }
+                QueryPerformanceCounter(&end);
 
-                printf("<%s> W (%04.4u) : request %06.6d bytes -- %06.6d bytes written\n",
-                        outPipe, i, WriteLen, nBytesWrite);
+                writeTicks += end.QuadPart - start.QuadPart;
+                totalWritten += nBytesWrite;
+
+                if (!fThroughput) {
+                    printf("<%s> W (%04.4u) : request %06.6d bytes -- %06.6d bytes written\n",
+                            outPipe, i, WriteLen, nBytesWrite);
+                }
 
                 //assert(nBytesWrite == WriteLen);
             }
 
             if (fRead && pinBuf) {
 
+                QueryPerformanceCounter(&start);
                 success = ReadFile(hRead, pinBuf, ReadLen, (PULONG) &nBytesRead, NULL);
+                QueryPerformanceCounter(&end);
 
                 if (success) {
-                    printf("<%s> R (%04.4u) : request %06.6d bytes -- %06.6d bytes read\n",
-                           inPipe, i, ReadLen, nBytesRead);
+                    readTicks += end.QuadPart - start.QuadPart;
+                    totalRead += nBytesRead;
+
+                    if (!fThroughput) {
+                        printf("<%s> R (%04.4u) : request %06.6d bytes -- %06.6d bytes read\n",
+                               inPipe, i, ReadLen, nBytesRead);
+                    }
 
                     if (fWrite && fCompareData) {
 
@@ -1293,6 +1502,29 @@ Return Value:
             }
         }
 
+        if (fThroughput) {
+            if (fWrite && hWrite != INVALID_HANDLE_VALUE) {
+                print_throughput(hWrite, outPipe, "write", &writeStats,
+                                 totalWritten, writeTicks, frequency.QuadPart);
+            }
+            if (fRead && hRead != INVALID_HANDLE_VALUE) {
+                print_throughput(hRead, inPipe, "read", &readStats,
+                                 totalRead, readTicks, frequency.QuadPart);
+            }
+        }
+
+        if (fIsochStream) {
+            print_isoch_statistics(hRead, inPipe);
+            DeviceIoControl(hRead,
+                            IOCTL_USBSAMP_STOP_ISOCH_STREAM,
+                            NULL,
+                            0,
+                            NULL,
+                            0,
+                            (PULONG) &nBytesRead,
+                            NULL);
+        }
+
         if (pinBuf) {
             free(pinBuf);
         }
@@ -157,6 +157,40 @@ Return Value:
         stageLength = totalLength;
     }
 
+#if (NTDDI_VERSION >= NTDDI_WIN8)
+    if(WdfUsbPipeTypeBulk == pipeInfo.PipeType &&
+        pipeContext->StreamConfigured == TRUE) {
+        //
+        // For super speed bulk pipe with streams, we specify one of its associated
+        // usbd pipe handles to format an URB for sending or receiving data.
+        // The usbd pipe handle is returned by the HCD via successful open-streams request
+        //
+        usbdPipeHandle = GetStreamPipeHandleFromBulkPipe(pipe);
+    }
+    else {
+        usbdPipeHandle = WdfUsbTargetPipeWdmGetPipeHandle(pipe);
+    }
+#else
+    usbdPipeHandle = WdfUsbTargetPipeWdmGetPipeHandle(pipe);
+#endif
+
+    if (totalLength > stageLength && pipeContext->PipelineDepth > 1) {
+        //
+        // Keep several stages in flight at once, so the bus is not idle
+        // while a completed stage is being resubmitted.
+        //
+        status = PerformPipelinedBulkTransfer(deviceContext,
+                                              Request,
+                                              pipe,
+                                              usbdPipeHandle,
+                                              requestMdl,
+                                              urbFlags,
+                                              totalLength,
+                                              stageLength,
+                                              pipeContext->PipelineDepth);
+        goto Exit;
+    }
+
     newMdl = IoAllocateMdl((PVOID) virtualAddress,
                            totalLength,
                            FALSE,
@@ -190,23 +224,6 @@ Return Value:
         goto Exit;
     }
 
-#if (NTDDI_VERSION >= NTDDI_WIN8)
-    if(WdfUsbPipeTypeBulk == pipeInfo.PipeType &&
-        pipeContext->StreamConfigured == TRUE) {
-        //
-        // For super speed bulk pipe with streams, we specify one of its associated
-        // usbd pipe handles to format an URB for sending or receiving data.
-        // The usbd pipe handle is returned by the HCD via successful open-streams request
-        //
-        usbdPipeHandle = GetStreamPipeHandleFromBulkPipe(pipe);
-    }
-    else {
-        usbdPipeHandle = WdfUsbTargetPipeWdmGetPipeHandle(pipe);
-    }
-#else
-    usbdPipeHandle = WdfUsbTargetPipeWdmGetPipeHandle(pipe);
-#endif
-
     UsbBuildInterruptOrBulkTransferRequest(urb,
                                            sizeof(struct _URB_BULK_OR_INTERRUPT_TRANSFER),
                                            usbdPipeHandle,
@@ -233,6 +250,7 @@ Return Value:
     rwContext->Length          = totalLength - stageLength;
     rwContext->Numxfer         = 0;
     rwContext->VirtualAddress  = virtualAddress + stageLength;
+    rwContext->StageStartTime  = KeQueryPerformanceCounter(NULL).QuadPart;
 
     if (!WdfRequestSend(Request, WdfUsbTargetPipeGetIoTarget(pipe), WDF_NO_SEND_OPTIONS)) {
         status = WdfRequestGetStatus(Request);
@@ -319,6 +337,8 @@ Return Value:
     bytesReadWritten = urb->UrbBulkOrInterruptTransfer.TransferBufferLength;
     rwContext->Numxfer += bytesReadWritten;
 
+    UpdatePipeStageStatistics(pipe, rwContext->StageStartTime, bytesReadWritten);
+
     //
     // If there is anything left to transfer.
     //
@@ -397,6 +417,8 @@ Return Value:
 
     WdfRequestSetCompletionRoutine(Request, UsbSamp_EvtReadWriteCompletion, deviceContext);
 
+    rwContext->StageStartTime = KeQueryPerformanceCounter(NULL).QuadPart;
+
     //
     // Send the request asynchronously.
     //
@@ -429,6 +451,621 @@ End:
     return;
 }
 
+VOID
+ReleasePipelinedRequestRef(
+    _In_ WDFREQUEST Request
+    )
+/*++
+
+Routine Description:
+
+    Drops a reference on a pipelined master request. The master is
+    completed when the last reference goes away: one is held for every
+    stage in flight, one by whoever is starting stages and one until the
+    request is no longer cancelable.
+
+--*/
+{
+    PREQUEST_CONTEXT rwContext;
+    NTSTATUS         status;
+
+    rwContext = GetRequestContext(Request);
+
+    if (InterlockedDecrement(&rwContext->CompletionRefs) != 0) {
+        return;
+    }
+
+    DbgPrintRWContext(rwContext);
+
+    status = rwContext->StageStatus;
+
+    UsbSamp_DbgPrint(3, ("%s request completed with status 0x%x\n",
+                         rwContext->Read ? "Read" : "Write", status));
+
+    WdfRequestCompleteWithInformation(Request,
+                                      status,
+                                      NT_SUCCESS(status) ? rwContext->TransferEnd : 0);
+    return;
+}
+
+VOID
+CheckPipelinedStagesDone(
+    _In_ WDFREQUEST Request
+    )
+/*++
+
+Routine Description:
+
+    Called whenever a sub-request has no further stage to carry. Once no
+    stage is in flight and none will be started anymore, the master is made
+    non-cancelable. If the cancel routine is already running, it will drop
+    the cancel reference itself.
+
+--*/
+{
+    PREQUEST_CONTEXT rwContext;
+    BOOLEAN          done;
+
+    rwContext = GetRequestContext(Request);
+
+    WdfSpinLockAcquire(rwContext->StageLock);
+
+    done = (!rwContext->StagesDone &&
+            rwContext->StagesInFlight == 0 &&
+            (rwContext->StopStages || rwContext->Length == 0));
+
+    if (done) {
+        rwContext->StagesDone = TRUE;
+    }
+
+    WdfSpinLockRelease(rwContext->StageLock);
+
+    if (done && WdfRequestUnmarkCancelable(Request) != STATUS_CANCELLED) {
+        ReleasePipelinedRequestRef(Request);
+    }
+
+    return;
+}
+
+BOOLEAN
+SendNextPipelinedStage(
+    _In_ WDFREQUEST       Request,
+    _In_ WDFREQUEST       SubRequest,
+    _In_ WDFUSBPIPE       Pipe
+    )
+/*++
+
+Routine Description:
+
+    Carries the next stage of the master request on SubRequest. The caller
+    holds a reference on the master.
+
+Return Value:
+
+    TRUE if a stage was sent and the completion routine will be called.
+
+--*/
+{
+    PREQUEST_CONTEXT        rwContext;
+    PSUB_REQUEST_CONTEXT    subContext;
+    WDF_REQUEST_REUSE_PARAMS reuseParams;
+    ULONG_PTR               virtualAddress;
+    ULONG                   stageLength;
+    PURB                    urb;
+    NTSTATUS                status;
+    BOOLEAN                 stop;
+
+    rwContext = GetRequestContext(Request);
+    subContext = GetSubRequestContext(SubRequest);
+
+    WdfSpinLockAcquire(rwContext->StageLock);
+
+    if (rwContext->StopStages || rwContext->Length == 0) {
+        WdfSpinLockRelease(rwContext->StageLock);
+        return FALSE;
+    }
+
+    if (rwContext->Length > rwContext->StageLength) {
+        stageLength = rwContext->StageLength;
+    }
+    else {
+        stageLength = rwContext->Length;
+    }
+
+    virtualAddress = rwContext->VirtualAddress;
+    rwContext->VirtualAddress += stageLength;
+    rwContext->Length -= stageLength;
+    rwContext->StagesInFlight++;
+
+    WdfSpinLockRelease(rwContext->StageLock);
+
+    InterlockedIncrement(&rwContext->CompletionRefs);
+
+    subContext->Offset = (ULONG)(virtualAddress -
+                                 (ULONG_PTR)MmGetMdlVirtualAddress(rwContext->RequestMdl));
+    subContext->Length = stageLength;
+
+    //
+    // Following call is required to free any mapping made on the partial MDL
+    // and reset internal MDL state.
+    //
+    MmPrepareMdlForReuse(subContext->Mdl);
+
+    IoBuildPartialMdl(rwContext->RequestMdl,
+                      subContext->Mdl,
+                      (PVOID) virtualAddress,
+                      stageLength);
+
+    urb = (PURB) WdfMemoryGetBuffer(subContext->UrbMemory, NULL);
+    urb->UrbBulkOrInterruptTransfer.TransferBufferLength = stageLength;
+
+    WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+    status = WdfRequestReuse(SubRequest, &reuseParams);
+    NT_ASSERT(NT_SUCCESS(status));
+
+    status = WdfUsbTargetPipeFormatRequestForUrb(Pipe,
+                                                 SubRequest,
+                                                 subContext->UrbMemory,
+                                                 NULL);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("Failed to format requset for urb\n"));
+        goto Error;
+    }
+
+    WdfRequestSetCompletionRoutine(SubRequest, UsbSamp_EvtPipelinedStageCompletion, Request);
+
+    subContext->StartTime = KeQueryPerformanceCounter(NULL).QuadPart;
+
+    if (!WdfRequestSend(SubRequest, WdfUsbTargetPipeGetIoTarget(Pipe), WDF_NO_SEND_OPTIONS)) {
+        status = WdfRequestGetStatus(SubRequest);
+        UsbSamp_DbgPrint(1, ("WdfRequestSend for stage failed 0x%x\n", status));
+        goto Error;
+    }
+
+    //
+    // The master may have been canceled after the stage was taken but before
+    // it was sent; the cancel routine could not see it then.
+    //
+    WdfSpinLockAcquire(rwContext->StageLock);
+    stop = rwContext->StopStages;
+    WdfSpinLockRelease(rwContext->StageLock);
+
+    if (stop) {
+        WdfRequestCancelSentRequest(SubRequest);
+    }
+
+    return TRUE;
+
+Error:
+    WdfSpinLockAcquire(rwContext->StageLock);
+    rwContext->StagesInFlight--;
+    rwContext->StopStages = TRUE;
+    if (NT_SUCCESS(rwContext->StageStatus)) {
+        rwContext->StageStatus = status;
+    }
+    WdfSpinLockRelease(rwContext->StageLock);
+
+    ReleasePipelinedRequestRef(Request);
+
+    return FALSE;
+}
+
+NTSTATUS
+PerformPipelinedBulkTransfer(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFREQUEST       Request,
+    _In_ WDFUSBPIPE       Pipe,
+    _In_ USBD_PIPE_HANDLE UsbdPipeHandle,
+    _In_ PMDL             RequestMdl,
+    _In_ ULONG            UrbFlags,
+    _In_ ULONG            TotalLength,
+    _In_ ULONG            StageLength,
+    _In_ ULONG            PipelineDepth
+    )
+/*++
+
+Routine Description:
+
+    Performs a bulk transfer with up to PipelineDepth stages in flight at
+    once. Each stage is carried by a sub-request with its own URB and
+    partial MDL. When a stage completes, its sub-request is reused for the
+    next stage that has not been started yet. USB completes the stages of
+    a pipe in order, so the data lands in the buffer as it would with one
+    stage at a time.
+
+    A short stage on a read ends the transfer. The stages still queued
+    behind it are canceled, so the read completes without waiting for
+    the device to send more data. A stage that completes before its
+    cancel lands may already hold data of the device's next transfer,
+    which is dropped. This is why reads are only pipelined when asked
+    for with IOCTL_USBSAMP_SET_PIPELINE_DEPTH.
+
+Arguments:
+
+    Request - Read/Write request received from the user app, owned by the
+              driver until it is completed here.
+
+    UsbdPipeHandle - Handle the URBs are built for, a stream's handle for
+                     bulk pipes with streams.
+
+Return Value:
+
+    If an error is returned, no stage was sent and the caller completes
+    the request.
+
+--*/
+{
+    PREQUEST_CONTEXT        rwContext;
+    PSUB_REQUEST_CONTEXT    subContext;
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    WDFREQUEST              subRequest;
+    PURB                    urb;
+    ULONG                   numberOfStages;
+    ULONG                   i;
+    NTSTATUS                status;
+
+    rwContext = GetRequestContext(Request);
+
+    numberOfStages = (TotalLength + StageLength - 1) / StageLength;
+
+    if (PipelineDepth > numberOfStages) {
+        PipelineDepth = numberOfStages;
+    }
+
+    if (PipelineDepth > USBSAMP_MAX_PIPELINE_DEPTH) {
+        PipelineDepth = USBSAMP_MAX_PIPELINE_DEPTH;
+    }
+
+    UsbSamp_DbgPrint(3, ("%d stages, %d in flight\n", numberOfStages, PipelineDepth));
+
+    rwContext->UrbMemory       = NULL;
+    rwContext->Mdl             = NULL;
+    rwContext->Length          = TotalLength;
+    rwContext->Numxfer         = 0;
+    rwContext->VirtualAddress  = (ULONG_PTR) MmGetMdlVirtualAddress(RequestMdl);
+    rwContext->RequestMdl      = RequestMdl;
+    rwContext->StageLength     = StageLength;
+    rwContext->StagesInFlight  = 0;
+    rwContext->TransferEnd     = TotalLength;
+    rwContext->StageStatus     = STATUS_SUCCESS;
+    rwContext->StopStages      = FALSE;
+    rwContext->ShortStage      = FALSE;
+    rwContext->StagesDone      = FALSE;
+    rwContext->NumberOfSubRequests = 0;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Request;
+
+    status = WdfSpinLockCreate(&attributes, &rwContext->StageLock);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("WdfSpinLockCreate failed %x\n", status));
+        return status;
+    }
+
+    //
+    // The sub-requests are children of the master, so they go away with it.
+    //
+    for (i = 0; i < PipelineDepth; i++) {
+
+        WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, SUB_REQUEST_CONTEXT);
+        attributes.ParentObject = Request;
+        attributes.EvtCleanupCallback = UsbSamp_EvtSubRequestCleanup;
+
+        status = WdfRequestCreate(&attributes,
+                                  WdfUsbTargetPipeGetIoTarget(Pipe),
+                                  &subRequest);
+        if (!NT_SUCCESS(status)) {
+            UsbSamp_DbgPrint(1, ("WdfRequestCreate failed %x\n", status));
+            return status;
+        }
+
+        subContext = GetSubRequestContext(subRequest);
+        subContext->MasterRequest = Request;
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = subRequest;
+
+        status = WdfUsbTargetDeviceCreateUrb(DeviceContext->WdfUsbTargetDevice,
+                                             &attributes,
+                                             &subContext->UrbMemory,
+                                             &urb);
+        if (!NT_SUCCESS(status)) {
+            UsbSamp_DbgPrint(1, ("WdfUsbTargetDeviceCreateUrb failed %x\n", status));
+            return status;
+        }
+
+        //
+        // Big enough to map a stage anywhere in the request buffer.
+        //
+        subContext->Mdl = IoAllocateMdl((PVOID) rwContext->VirtualAddress,
+                                        TotalLength,
+                                        FALSE,
+                                        FALSE,
+                                        NULL);
+        if (subContext->Mdl == NULL) {
+            UsbSamp_DbgPrint(1, ("Failed to alloc mem for mdl\n"));
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        UsbBuildInterruptOrBulkTransferRequest(urb,
+                                               sizeof(struct _URB_BULK_OR_INTERRUPT_TRANSFER),
+                                               UsbdPipeHandle,
+                                               NULL,
+                                               subContext->Mdl,
+                                               0,
+                                               UrbFlags,
+                                               NULL);
+
+        rwContext->SubRequests[i] = subRequest;
+        rwContext->NumberOfSubRequests++;
+    }
+
+    //
+    // One reference until the request is no longer cancelable, one held
+    // while the stages are started below.
+    //
+    rwContext->CompletionRefs = 2;
+
+    status = WdfRequestMarkCancelableEx(Request, UsbSamp_EvtPipelinedRequestCancel);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("WdfRequestMarkCancelableEx failed %x\n", status));
+        return status;
+    }
+
+    for (i = 0; i < rwContext->NumberOfSubRequests; i++) {
+        if (!SendNextPipelinedStage(Request, rwContext->SubRequests[i], Pipe)) {
+            break;
+        }
+    }
+
+    CheckPipelinedStagesDone(Request);
+
+    ReleasePipelinedRequestRef(Request);
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+UsbSamp_EvtPipelinedStageCompletion(
+    _In_ WDFREQUEST                  Request,
+    _In_ WDFIOTARGET                 Target,
+    PWDF_REQUEST_COMPLETION_PARAMS CompletionParams,
+    _In_ WDFCONTEXT                  Context
+    )
+/*++
+
+Routine Description:
+
+    Completion routine for one stage of a pipelined transfer. Accounts for
+    the stage and, unless the transfer is over, sends the next stage on the
+    same sub-request.
+
+Arguments:
+
+    Request - The sub-request that carried the stage
+
+    Context - The master request
+
+--*/
+{
+    WDFREQUEST              masterRequest;
+    PREQUEST_CONTEXT        rwContext;
+    PSUB_REQUEST_CONTEXT    subContext;
+    WDFUSBPIPE              pipe;
+    PURB                    urb;
+    ULONG                   bytesReadWritten;
+    ULONG                   i;
+    NTSTATUS                status;
+    BOOLEAN                 firstError = FALSE;
+    BOOLEAN                 cancelStages = FALSE;
+
+    masterRequest = (WDFREQUEST) Context;
+    rwContext = GetRequestContext(masterRequest);
+    subContext = GetSubRequestContext(Request);
+    pipe = (WDFUSBPIPE) Target;
+    status = CompletionParams->IoStatus.Status;
+
+    urb = (PURB) WdfMemoryGetBuffer(subContext->UrbMemory, NULL);
+    bytesReadWritten = NT_SUCCESS(status) ? urb->UrbBulkOrInterruptTransfer.TransferBufferLength : 0;
+
+    WdfSpinLockAcquire(rwContext->StageLock);
+
+    rwContext->StagesInFlight--;
+
+    if (!NT_SUCCESS(status)) {
+        //
+        // Stages behind a short stage are canceled below, that is not an
+        // error of the transfer.
+        //
+        if (NT_SUCCESS(rwContext->StageStatus) &&
+            !(status == STATUS_CANCELLED && rwContext->ShortStage)) {
+            rwContext->StageStatus = status;
+            firstError = (status != STATUS_CANCELLED);
+        }
+        rwContext->StopStages = TRUE;
+    }
+    else {
+        rwContext->Numxfer += bytesReadWritten;
+
+        if (bytesReadWritten < subContext->Length) {
+            //
+            // Short stage, the device has no more data for this transfer.
+            // The stages queued behind it would wait for the device to send
+            // more, so they are canceled.
+            //
+            rwContext->StopStages = TRUE;
+            if (rwContext->TransferEnd > subContext->Offset + bytesReadWritten) {
+                rwContext->TransferEnd = subContext->Offset + bytesReadWritten;
+            }
+            if (!rwContext->ShortStage && rwContext->StagesInFlight != 0) {
+                cancelStages = TRUE;
+            }
+            rwContext->ShortStage = TRUE;
+        }
+    }
+
+    WdfSpinLockRelease(rwContext->StageLock);
+
+    if (cancelStages) {
+        //
+        // USB completes the stages of a pipe in order, so every stage still
+        // in flight lies behind this one. The lock is not held here, a
+        // canceled stage may complete inline.
+        //
+        for (i = 0; i < rwContext->NumberOfSubRequests; i++) {
+            if (rwContext->SubRequests[i] != Request) {
+                WdfRequestCancelSentRequest(rwContext->SubRequests[i]);
+            }
+        }
+    }
+
+    if (NT_SUCCESS(status)) {
+        UpdatePipeStageStatistics(pipe, subContext->StartTime, bytesReadWritten);
+    }
+    else if (firstError) {
+        //
+        // Queue a workitem to reset the pipe because the completion could be
+        // running at DISPATCH_LEVEL.
+        //
+        QueuePassiveLevelCallback(WdfIoTargetGetDevice(Target), pipe);
+    }
+
+    if (!SendNextPipelinedStage(masterRequest, Request, pipe)) {
+        CheckPipelinedStagesDone(masterRequest);
+    }
+
+    //
+    // Drop the reference of the stage that just completed.
+    //
+    ReleasePipelinedRequestRef(masterRequest);
+
+    return;
+}
+
+VOID
+CancelPipelinedStages(
+    _In_ WDFREQUEST Request
+    )
+/*++
+
+Routine Description:
+
+    Fails a pipelined master request with STATUS_CANCELLED, stops further
+    stages and cancels the ones in flight. The master completes once they
+    are back. The caller holds a reference on the master.
+
+--*/
+{
+    PREQUEST_CONTEXT rwContext;
+    ULONG            i;
+
+    rwContext = GetRequestContext(Request);
+
+    WdfSpinLockAcquire(rwContext->StageLock);
+
+    if (NT_SUCCESS(rwContext->StageStatus)) {
+        rwContext->StageStatus = STATUS_CANCELLED;
+    }
+    rwContext->StopStages = TRUE;
+
+    WdfSpinLockRelease(rwContext->StageLock);
+
+    //
+    // The lock is not held here, a canceled stage may complete inline.
+    //
+    for (i = 0; i < rwContext->NumberOfSubRequests; i++) {
+        WdfRequestCancelSentRequest(rwContext->SubRequests[i]);
+    }
+
+    return;
+}
+
+VOID
+UsbSamp_EvtPipelinedRequestCancel(
+    _In_ WDFREQUEST Request
+    )
+/*++
+
+Routine Description:
+
+    Cancel routine of a pipelined master request. The cancel reference is
+    held until the stages are canceled.
+
+--*/
+{
+    CancelPipelinedStages(Request);
+
+    ReleasePipelinedRequestRef(Request);
+
+    return;
+}
+
+BOOLEAN
+StopPipelinedRequest(
+    _In_ WDFREQUEST Request
+    )
+/*++
+
+Routine Description:
+
+    Called when a queue is purged. A pipelined master request is never
+    sent to the I/O target, so it cannot be canceled as a sent request;
+    its stages are canceled instead.
+
+Return Value:
+
+    FALSE if Request is not a pipelined master request.
+
+--*/
+{
+    PREQUEST_CONTEXT rwContext;
+    BOOLEAN          running;
+
+    rwContext = GetRequestContext(Request);
+
+    if (rwContext->NumberOfSubRequests == 0) {
+        return FALSE;
+    }
+
+    //
+    // Until StagesDone is set, a stage in flight, the code starting the
+    // stages or the cancel routine still holds a reference, so one can be
+    // taken here to keep the sub-requests around.
+    //
+    WdfSpinLockAcquire(rwContext->StageLock);
+
+    running = !rwContext->StagesDone;
+    if (running) {
+        InterlockedIncrement(&rwContext->CompletionRefs);
+    }
+
+    WdfSpinLockRelease(rwContext->StageLock);
+
+    if (running) {
+        CancelPipelinedStages(Request);
+        ReleasePipelinedRequestRef(Request);
+    }
+
+    return TRUE;
+}
+
+VOID
+UsbSamp_EvtSubRequestCleanup(
+    _In_ WDFOBJECT Object
+    )
+{
+    PSUB_REQUEST_CONTEXT subContext;
+
+    subContext = GetSubRequestContext(Object);
+
+    if (subContext->Mdl != NULL) {
+        IoFreeMdl(subContext->Mdl);
+        subContext->Mdl = NULL;
+    }
+
+    return;
+}
+
 #else
 
 VOID
@@ -803,6 +1440,48 @@ End:
 
 #endif
 
+VOID
+UpdatePipeStageStatistics(
+    _In_ WDFUSBPIPE       Pipe,
+    _In_ LONGLONG         StageStartTime,
+    _In_ ULONG            BytesTransferred
+    )
+/*++
+
+Routine Description:
+
+    Accounts for a stage of a bulk transfer that completed with success.
+    Called from completion routines, possibly at DISPATCH_LEVEL and on
+    several processors at once.
+
+--*/
+{
+    PPIPE_CONTEXT   pipeContext;
+    LARGE_INTEGER   frequency;
+    LONGLONG        latency;
+    LONGLONG        maxLatency;
+
+    pipeContext = GetPipeContext(Pipe);
+
+    latency = KeQueryPerformanceCounter(&frequency).QuadPart - StageStartTime;
+    latency = latency * 1000000 / frequency.QuadPart;
+
+    InterlockedIncrement64(&pipeContext->StagesCompleted);
+    InterlockedAdd64(&pipeContext->BytesTransferred, BytesTransferred);
+    InterlockedAdd64(&pipeContext->TotalStageLatency, latency);
+
+    do {
+        maxLatency = pipeContext->MaxStageLatency;
+        if (latency <= maxLatency) {
+            break;
+        }
+    } while (InterlockedCompareExchange64(&pipeContext->MaxStageLatency,
+                                          latency,
+                                          maxLatency) != maxLatency);
+
+    return;
+}
+
 VOID
 UsbSamp_EvtReadWriteWorkItem(
     _In_ WDFWORKITEM  WorkItem
@@ -123,7 +123,7 @@ Return Value:
         &fileConfig,
         UsbSamp_EvtDeviceFileCreate,
         WDF_NO_EVENT_CALLBACK,
-        WDF_NO_EVENT_CALLBACK
+        UsbSamp_EvtFileCleanup
         );
 
     //
@@ -294,6 +294,34 @@ Return Value:
         return status;
     }
 
+    //
+    // Create a manual queue where reads wait for data from a continuous isoch
+    // reader. The URBs of the reader keep the device in D0 themselves, so the
+    // queue is not power-managed.
+    //
+    WDF_IO_QUEUE_CONFIG_INIT(&ioQueueConfig,
+                              WdfIoQueueDispatchManual);
+
+    ioQueueConfig.PowerManaged = WdfFalse;
+
+    status = WdfIoQueueCreate(device,
+                              &ioQueueConfig,
+                              WDF_NO_OBJECT_ATTRIBUTES,
+                              &pDevContext->IsochStreamReadQueue);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("WdfIoQueueCreate failed  for isoch stream 0x%x\n", status));
+        return status;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = device;
+
+    status = WdfSpinLockCreate(&attributes, &pDevContext->IsochStreamLock);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("WdfSpinLockCreate failed 0x%x\n", status));
+        return status;
+    }
+
     //
     // Register a device interface so that app can find our device and talk to it.
     //
@@ -703,6 +731,14 @@ Return Value:
                                                     i, //PipeIndex,
                                                     NULL
                                                     );
+
+            if (WdfUsbTargetPipeIsInEndpoint(pipe)) {
+                GetPipeContext(pipe)->PipelineDepth = DEFAULT_BULK_IN_PIPELINE_DEPTH;
+            }
+            else {
+                GetPipeContext(pipe)->PipelineDepth = DEFAULT_BULK_PIPELINE_DEPTH;
+            }
+
 #if (NTDDI_VERSION >= NTDDI_WIN8)
             if (pDeviceContext->IsDeviceSuperSpeed) {
                 status = InitializePipeContextForSuperSpeedDevice(pDeviceContext,
@@ -82,6 +82,15 @@ Routine Description:
     deviceContext = GetDeviceContext(WdfIoQueueGetDevice(Queue));
     rwContext = GetRequestContext(Request);
 
+    //
+    // Reads on a handle with a continuous reader are served from its ring.
+    //
+    if (RequestType == WdfRequestTypeRead &&
+        fileContext->IsochStream != NULL &&
+        ReadIsochStream(deviceContext, Request)) {
+        return;
+    }
+
     if (RequestType == WdfRequestTypeRead) {       
         rwContext->Read = TRUE;
         status = WdfRequestForwardToIoQueue(Request, deviceContext->IsochReadQueue);
@@ -527,6 +536,725 @@ Return Value:
     return;
 }
 
+PISOCH_STREAM_CONTEXT
+ReferenceIsochStream(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFFILEOBJECT    FileObject
+    )
+/*++
+
+Routine Description:
+
+    Returns the continuous isoch reader started on a handle with a reference
+    taken on it, or NULL. The caller drops the reference with
+    WdfObjectDereference on the object the context belongs to.
+
+--*/
+{
+    WDFOBJECT       stream;
+
+    WdfSpinLockAcquire(DeviceContext->IsochStreamLock);
+
+    stream = GetFileContext(FileObject)->IsochStream;
+    if (stream != NULL) {
+        WdfObjectReference(stream);
+    }
+
+    WdfSpinLockRelease(DeviceContext->IsochStreamLock);
+
+    return (stream != NULL) ? GetIsochStreamContext(stream) : NULL;
+}
+
+NTSTATUS
+StartIsochStream(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFFILEOBJECT    FileObject
+    )
+/*++
+
+Routine Description:
+
+    Starts a continuous reader on the isoch IN pipe a handle was opened for.
+
+    Instead of building a URB for every read, the reader keeps
+    ISOCH_STREAM_URBS URBs of ISOCH_STREAM_FRAMES_PER_URB frames posted on
+    the pipe with USBD_START_ISO_TRANSFER_ASAP, so the host controller always
+    has the next frames scheduled. Each completion copies its packets into
+    a ring buffer and reposts the same request and URB. Reads on the handle
+    are satisfied from the ring; when the reader falls behind and the ring
+    is full, new packets are dropped and counted.
+
+    Called at PASSIVE_LEVEL. Not pageable, as it takes spin locks.
+
+Arguments:
+
+    DeviceContext - Device context
+    FileObject - Handle the reader is started on
+
+Return Value:
+
+    NT status value
+
+--*/
+{
+    NTSTATUS                    status;
+    PFILE_CONTEXT               fileContext;
+    WDFUSBPIPE                  pipe;
+    PPIPE_CONTEXT               pipeContext;
+    WDF_OBJECT_ATTRIBUTES       attributes;
+    WDFOBJECT                   stream = NULL;
+    PISOCH_STREAM_CONTEXT       streamContext;
+    PISOCH_STREAM_URB_CONTEXT   urbContext;
+    WDFMEMORY                   memory;
+    WDFREQUEST                  request;
+    ULONG                       i, posted;
+
+    fileContext = GetFileContext(FileObject);
+    pipe = fileContext->Pipe;
+
+    if (pipe == NULL ||
+        WdfUsbTargetPipeGetType(pipe) != WdfUsbPipeTypeIsochronous ||
+        WdfUsbTargetPipeIsInEndpoint(pipe) == FALSE) {
+        UsbSamp_DbgPrint(1, ("Continuous reader needs an isoch IN pipe\n"));
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    pipeContext = GetPipeContext(pipe);
+
+    if (InterlockedCompareExchange(&pipeContext->IsochStreamActive, 1, 0) != 0) {
+        UsbSamp_DbgPrint(1, ("Pipe already has a continuous reader\n"));
+        return STATUS_DEVICE_BUSY;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, ISOCH_STREAM_CONTEXT);
+    attributes.ParentObject = FileObject;
+
+    status = WdfObjectCreate(&attributes, &stream);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("WdfObjectCreate failed 0x%x\n", status));
+        stream = NULL;
+        goto Exit;
+    }
+
+    streamContext = GetIsochStreamContext(stream);
+    streamContext->DeviceContext = DeviceContext;
+    streamContext->Pipe = pipe;
+    streamContext->FileObject = FileObject;
+    KeInitializeSpinLock(&streamContext->Lock);
+    KeInitializeEvent(&streamContext->UrbsDrained, NotificationEvent, FALSE);
+
+    if (DeviceContext->IsDeviceHighSpeed || DeviceContext->IsDeviceSuperSpeed) {
+        streamContext->PacketSize = pipeContext->TransferSizePerMicroframe;
+    }
+    else {
+        streamContext->PacketSize = pipeContext->TransferSizePerFrame;
+    }
+
+    streamContext->BytesPerUrb = ISOCH_STREAM_FRAMES_PER_URB * pipeContext->TransferSizePerFrame;
+    streamContext->PacketsPerUrb = streamContext->BytesPerUrb / streamContext->PacketSize;
+    streamContext->RingSize = ISOCH_STREAM_RING_URBS * streamContext->BytesPerUrb;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = stream;
+
+    status = WdfMemoryCreate(&attributes,
+                             NonPagedPoolNx,
+                             POOL_TAG,
+                             streamContext->RingSize,
+                             &memory,
+                             (PVOID*)&streamContext->Ring);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("WdfMemoryCreate failed for the ring 0x%x\n", status));
+        goto Exit;
+    }
+
+    for (i = 0; i < ISOCH_STREAM_URBS; i++) {
+
+        WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, ISOCH_STREAM_URB_CONTEXT);
+        attributes.ParentObject = stream;
+
+        status = WdfRequestCreate(&attributes,
+                                  WdfUsbTargetPipeGetIoTarget(pipe),
+                                  &request);
+        if (!NT_SUCCESS(status)) {
+            UsbSamp_DbgPrint(1, ("WdfRequestCreate failed 0x%x\n", status));
+            goto Exit;
+        }
+
+        streamContext->Requests[i] = request;
+        urbContext = GetIsochStreamUrbContext(request);
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = request;
+
+        status = WdfUsbTargetDeviceCreateIsochUrb(DeviceContext->WdfUsbTargetDevice,
+                                                  &attributes,
+                                                  streamContext->PacketsPerUrb,
+                                                  &urbContext->UrbMemory,
+                                                  NULL);
+        if (!NT_SUCCESS(status)) {
+            UsbSamp_DbgPrint(1, ("WdfUsbTargetDeviceCreateIsochUrb failed 0x%x\n", status));
+            goto Exit;
+        }
+
+        status = WdfMemoryCreate(&attributes,
+                                 NonPagedPoolNx,
+                                 POOL_TAG,
+                                 streamContext->BytesPerUrb,
+                                 &memory,
+                                 (PVOID*)&urbContext->Buffer);
+        if (!NT_SUCCESS(status)) {
+            UsbSamp_DbgPrint(1, ("WdfMemoryCreate failed for the URB buffer 0x%x\n", status));
+            goto Exit;
+        }
+    }
+
+    //
+    // The URBs we post don't come through a power-managed queue, so keep
+    // the device out of selective suspend while they are running.
+    //
+    status = WdfDeviceStopIdle(WdfObjectContextGetObject(DeviceContext), FALSE);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("WdfDeviceStopIdle failed 0x%x\n", status));
+        goto Exit;
+    }
+
+    //
+    // Count every URB as posted before sending the first one, so an early
+    // completion cannot drain the count while the others are still going out.
+    //
+    streamContext->UrbsPosted = ISOCH_STREAM_URBS;
+    posted = 0;
+
+    WdfSpinLockAcquire(DeviceContext->IsochStreamLock);
+    fileContext->IsochStream = stream;
+    WdfSpinLockRelease(DeviceContext->IsochStreamLock);
+
+    for (i = 0; i < ISOCH_STREAM_URBS; i++) {
+        if (PostIsochStreamUrb(streamContext, streamContext->Requests[i])) {
+            posted++;
+        }
+        else {
+            RetireIsochStreamUrb(streamContext);
+        }
+    }
+
+    if (posted == 0) {
+        StopIsochStream(DeviceContext, FileObject);
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    UsbSamp_DbgPrint(3, ("Continuous reader started: %d URBs of %d packets of %d bytes\n",
+                         posted, streamContext->PacketsPerUrb, streamContext->PacketSize));
+
+    return STATUS_SUCCESS;
+
+Exit:
+
+    if (stream != NULL) {
+        WdfObjectDelete(stream);
+    }
+
+    InterlockedExchange(&pipeContext->IsochStreamActive, 0);
+
+    return status;
+}
+
+NTSTATUS
+StopIsochStream(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFFILEOBJECT    FileObject
+    )
+/*++
+
+Routine Description:
+
+    Stops the continuous reader on a handle. Waits for every posted URB to
+    come back and fails the reads that are still waiting for data. Data
+    left in the ring is discarded. Called at PASSIVE_LEVEL.
+
+--*/
+{
+    PFILE_CONTEXT           fileContext;
+    WDFOBJECT               stream;
+    PISOCH_STREAM_CONTEXT   streamContext;
+    WDFREQUEST              request;
+    KIRQL                   oldIrql;
+    ULONG                   i;
+
+    fileContext = GetFileContext(FileObject);
+
+    WdfSpinLockAcquire(DeviceContext->IsochStreamLock);
+    stream = fileContext->IsochStream;
+    fileContext->IsochStream = NULL;
+    WdfSpinLockRelease(DeviceContext->IsochStreamLock);
+
+    if (stream == NULL) {
+        return STATUS_INVALID_DEVICE_STATE;
+    }
+
+    streamContext = GetIsochStreamContext(stream);
+
+    KeAcquireSpinLock(&streamContext->Lock, &oldIrql);
+    streamContext->Stopping = TRUE;
+    KeReleaseSpinLock(&streamContext->Lock, oldIrql);
+
+    //
+    // A URB that is being reposted right now may miss the cancel, but isoch
+    // URBs complete on their own once their frames have gone by.
+    //
+    for (i = 0; i < ISOCH_STREAM_URBS; i++) {
+        WdfRequestCancelSentRequest(streamContext->Requests[i]);
+    }
+
+    KeWaitForSingleObject(&streamContext->UrbsDrained,
+                          Executive,
+                          KernelMode,
+                          FALSE,
+                          NULL);
+
+    while (NT_SUCCESS(WdfIoQueueRetrieveRequestByFileObject(DeviceContext->IsochStreamReadQueue,
+                                                            FileObject,
+                                                            &request))) {
+        WdfRequestCompleteWithInformation(request, STATUS_CANCELLED, 0);
+    }
+
+    UsbSamp_DbgPrint(3, ("Continuous reader stopped: %I64u packets, %I64u dropped, %I64u late\n",
+                         streamContext->Statistics.PacketsReceived,
+                         streamContext->Statistics.PacketsDropped,
+                         streamContext->Statistics.LatePackets));
+
+    WdfDeviceResumeIdle(WdfObjectContextGetObject(DeviceContext));
+
+    InterlockedExchange(&GetPipeContext(streamContext->Pipe)->IsochStreamActive, 0);
+
+    //
+    // Readers that still hold a reference see Stopping and keep away from
+    // the ring, which goes away with the object.
+    //
+    WdfObjectDelete(stream);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+GetIsochStreamStatistics(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFFILEOBJECT    FileObject,
+    _Out_ PUSBSAMP_ISOCH_STATISTICS Statistics
+    )
+/*++
+
+Routine Description:
+
+    Returns a snapshot of the counters of the continuous reader on a handle.
+
+--*/
+{
+    PISOCH_STREAM_CONTEXT   streamContext;
+    KIRQL                   oldIrql;
+
+    streamContext = ReferenceIsochStream(DeviceContext, FileObject);
+    if (streamContext == NULL) {
+        return STATUS_INVALID_DEVICE_STATE;
+    }
+
+    KeAcquireSpinLock(&streamContext->Lock, &oldIrql);
+
+    *Statistics = streamContext->Statistics;
+    Statistics->UrbsPosted = streamContext->UrbsPosted;
+    Statistics->BytesBuffered = streamContext->RingCount;
+
+    KeReleaseSpinLock(&streamContext->Lock, oldIrql);
+
+    WdfObjectDereference(WdfObjectContextGetObject(streamContext));
+
+    return STATUS_SUCCESS;
+}
+
+BOOLEAN
+ReadIsochStream(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFREQUEST       Request
+    )
+/*++
+
+Routine Description:
+
+    Serves a read from the ring of the continuous reader on the request's
+    handle. The read completes at once if there is data; otherwise it waits
+    in IsochStreamReadQueue until a URB completion brings some.
+
+Return Value:
+
+    FALSE if no continuous reader is running on the handle and the read
+    should take the per-request path, TRUE if the read was taken care of.
+
+--*/
+{
+    NTSTATUS                status;
+    PISOCH_STREAM_CONTEXT   streamContext;
+    KIRQL                   oldIrql;
+    ULONG                   bytesCopied = 0;
+
+    streamContext = ReferenceIsochStream(DeviceContext, WdfRequestGetFileObject(Request));
+    if (streamContext == NULL) {
+        return FALSE;
+    }
+
+    KeAcquireSpinLock(&streamContext->Lock, &oldIrql);
+
+    if (streamContext->Stopping) {
+        status = STATUS_CANCELLED;
+    }
+    else if (streamContext->RingCount != 0 || streamContext->UrbsPosted == 0) {
+        status = CopyFromIsochStreamRing(streamContext, Request, &bytesCopied);
+    }
+    else {
+        //
+        // Forward while holding the lock so a completion that adds data
+        // right now finds the request in the queue.
+        //
+        status = WdfRequestForwardToIoQueue(Request, DeviceContext->IsochStreamReadQueue);
+        if (NT_SUCCESS(status)) {
+            status = STATUS_PENDING;
+        }
+    }
+
+    KeReleaseSpinLock(&streamContext->Lock, oldIrql);
+
+    if (status != STATUS_PENDING) {
+        WdfRequestCompleteWithInformation(Request, status, bytesCopied);
+    }
+
+    WdfObjectDereference(WdfObjectContextGetObject(streamContext));
+
+    return TRUE;
+}
+
+NTSTATUS
+CopyFromIsochStreamRing(
+    _In_ PISOCH_STREAM_CONTEXT StreamContext,
+    _In_ WDFREQUEST       Request,
+    _Out_ PULONG          BytesCopied
+    )
+/*++
+
+Routine Description:
+
+    Copies as much buffered data as fits into a read request. Called with
+    the stream lock held.
+
+Return Value:
+
+    STATUS_DEVICE_NOT_READY if the ring is empty, which only happens once
+    every URB of the reader has failed.
+
+--*/
+{
+    NTSTATUS        status;
+    PUCHAR          buffer;
+    size_t          bufferLength;
+    ULONG           length, chunk;
+
+    *BytesCopied = 0;
+
+    if (StreamContext->RingCount == 0) {
+        return STATUS_DEVICE_NOT_READY;
+    }
+
+    status = WdfRequestRetrieveOutputBuffer(Request, 1, (PVOID*)&buffer, &bufferLength);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("WdfRequestRetrieveOutputBuffer failed 0x%x\n", status));
+        return status;
+    }
+
+    length = (ULONG)min(bufferLength, StreamContext->RingCount);
+
+    chunk = min(length, StreamContext->RingSize - StreamContext->RingRead);
+    RtlCopyMemory(buffer, StreamContext->Ring + StreamContext->RingRead, chunk);
+    RtlCopyMemory(buffer + chunk, StreamContext->Ring, length - chunk);
+
+    StreamContext->RingRead = (StreamContext->RingRead + length) % StreamContext->RingSize;
+    StreamContext->RingCount -= length;
+
+    *BytesCopied = length;
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+CompleteIsochStreamReads(
+    _In_ PISOCH_STREAM_CONTEXT StreamContext
+    )
+/*++
+
+Routine Description:
+
+    Completes the reads waiting on the handle of a continuous reader while
+    there is data for them, or fails them all once no URB is left posted.
+
+--*/
+{
+    NTSTATUS        status;
+    WDFREQUEST      request;
+    KIRQL           oldIrql;
+    ULONG           bytesCopied;
+
+    for (;;) {
+
+        KeAcquireSpinLock(&StreamContext->Lock, &oldIrql);
+
+        if (StreamContext->Stopping ||
+            (StreamContext->RingCount == 0 && StreamContext->UrbsPosted != 0)) {
+            KeReleaseSpinLock(&StreamContext->Lock, oldIrql);
+            break;
+        }
+
+        status = WdfIoQueueRetrieveRequestByFileObject(StreamContext->DeviceContext->IsochStreamReadQueue,
+                                                       StreamContext->FileObject,
+                                                       &request);
+        if (!NT_SUCCESS(status)) {
+            KeReleaseSpinLock(&StreamContext->Lock, oldIrql);
+            break;
+        }
+
+        status = CopyFromIsochStreamRing(StreamContext, request, &bytesCopied);
+
+        KeReleaseSpinLock(&StreamContext->Lock, oldIrql);
+
+        WdfRequestCompleteWithInformation(request, status, bytesCopied);
+    }
+}
+
+BOOLEAN
+PostIsochStreamUrb(
+    _In_ PISOCH_STREAM_CONTEXT StreamContext,
+    _In_ WDFREQUEST       Request
+    )
+/*++
+
+Routine Description:
+
+    Rebuilds the URB of one of the requests of a continuous reader and
+    sends it down. Called at IRQL <= DISPATCH_LEVEL.
+
+Return Value:
+
+    TRUE if the request was sent.
+
+--*/
+{
+    NTSTATUS                    status;
+    PISOCH_STREAM_URB_CONTEXT   urbContext;
+    WDF_REQUEST_REUSE_PARAMS    reuseParams;
+    PURB                        urb;
+    ULONG                       i;
+
+    urbContext = GetIsochStreamUrbContext(Request);
+
+    WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+
+    status = WdfRequestReuse(Request, &reuseParams);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("WdfRequestReuse failed 0x%x\n", status));
+        return FALSE;
+    }
+
+    urb = WdfMemoryGetBuffer(urbContext->UrbMemory, NULL);
+
+    urb->UrbIsochronousTransfer.Hdr.Length = (USHORT) GET_ISO_URB_SIZE(StreamContext->PacketsPerUrb);
+    urb->UrbIsochronousTransfer.Hdr.Function = URB_FUNCTION_ISOCH_TRANSFER;
+    urb->UrbIsochronousTransfer.PipeHandle = WdfUsbTargetPipeWdmGetPipeHandle(StreamContext->Pipe);
+    urb->UrbIsochronousTransfer.TransferFlags = USBD_TRANSFER_DIRECTION_IN |
+                                                USBD_START_ISO_TRANSFER_ASAP;
+    urb->UrbIsochronousTransfer.TransferBuffer = urbContext->Buffer;
+    urb->UrbIsochronousTransfer.TransferBufferMDL = NULL;
+    urb->UrbIsochronousTransfer.TransferBufferLength = StreamContext->BytesPerUrb;
+    urb->UrbIsochronousTransfer.StartFrame = 0;
+    urb->UrbIsochronousTransfer.NumberOfPackets = StreamContext->PacketsPerUrb;
+    urb->UrbIsochronousTransfer.UrbLink = NULL;
+
+    for (i = 0; i < StreamContext->PacketsPerUrb; i++) {
+        urb->UrbIsochronousTransfer.IsoPacket[i].Offset = i * StreamContext->PacketSize;
+        urb->UrbIsochronousTransfer.IsoPacket[i].Length = 0;
+        urb->UrbIsochronousTransfer.IsoPacket[i].Status = 0;
+    }
+
+    status = WdfUsbTargetPipeFormatRequestForUrb(StreamContext->Pipe,
+                                                 Request,
+                                                 urbContext->UrbMemory,
+                                                 NULL);
+    if (!NT_SUCCESS(status)) {
+        UsbSamp_DbgPrint(1, ("Failed to format request for urb 0x%x\n", status));
+        return FALSE;
+    }
+
+    WdfRequestSetCompletionRoutine(Request,
+                                   UsbSamp_EvtIsochStreamCompletion,
+                                   StreamContext);
+
+    if (WdfRequestSend(Request,
+                       WdfUsbTargetPipeGetIoTarget(StreamContext->Pipe),
+                       WDF_NO_SEND_OPTIONS) == FALSE) {
+        UsbSamp_DbgPrint(1, ("WdfRequestSend failed with status code 0x%x\n",
+                             WdfRequestGetStatus(Request)));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+VOID
+RetireIsochStreamUrb(
+    _In_ PISOCH_STREAM_CONTEXT StreamContext
+    )
+/*++
+
+Routine Description:
+
+    Called for a URB of a continuous reader that is not reposted. When the
+    last one is retired, waiting reads are failed and StopIsochStream is
+    let go. Nothing may touch the stream after the event is set.
+
+--*/
+{
+    KIRQL           oldIrql;
+    ULONG           urbsPosted;
+
+    KeAcquireSpinLock(&StreamContext->Lock, &oldIrql);
+    urbsPosted = --StreamContext->UrbsPosted;
+    KeReleaseSpinLock(&StreamContext->Lock, oldIrql);
+
+    if (urbsPosted == 0) {
+        CompleteIsochStreamReads(StreamContext);
+        KeSetEvent(&StreamContext->UrbsDrained, IO_NO_INCREMENT, FALSE);
+    }
+}
+
+VOID
+UsbSamp_EvtIsochStreamCompletion(
+    _In_ WDFREQUEST                  Request,
+    _In_ WDFIOTARGET                 Target,
+    PWDF_REQUEST_COMPLETION_PARAMS CompletionParams,
+    _In_ WDFCONTEXT                  Context
+    )
+/*++
+
+Routine Description:
+
+    Completion routine for the URBs of a continuous reader. Copies the
+    packets into the ring, updates the counters, hands data to waiting
+    reads and reposts the URB.
+
+Arguments:
+
+    Context - Stream context of the reader
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    NTSTATUS                    status;
+    PISOCH_STREAM_CONTEXT       streamContext;
+    PISOCH_STREAM_URB_CONTEXT   urbContext;
+    PURB                        urb;
+    USBD_STATUS                 packetStatus;
+    ULONG                       i, length, offset, chunk, ringWrite;
+    KIRQL                       oldIrql;
+    BOOLEAN                     repost;
+
+    UNREFERENCED_PARAMETER(Target);
+
+    streamContext = (PISOCH_STREAM_CONTEXT)Context;
+    urbContext = GetIsochStreamUrbContext(Request);
+    urb = WdfMemoryGetBuffer(urbContext->UrbMemory, NULL);
+    status = CompletionParams->IoStatus.Status;
+
+    //
+    // When some of the packets fail the URB completes with
+    // USBD_STATUS_ISOCH_REQUEST_FAILED, but the others still carry data.
+    //
+    repost = NT_SUCCESS(status) ||
+             urb->UrbHeader.Status == USBD_STATUS_ISOCH_REQUEST_FAILED;
+
+    KeAcquireSpinLock(&streamContext->Lock, &oldIrql);
+
+    streamContext->Statistics.UrbsCompleted++;
+
+    if (repost) {
+
+        if (streamContext->NextStartFrameValid &&
+            (LONG)(urb->UrbIsochronousTransfer.StartFrame - streamContext->NextStartFrame) > 0) {
+            streamContext->Statistics.MissedFrames +=
+                urb->UrbIsochronousTransfer.StartFrame - streamContext->NextStartFrame;
+        }
+
+        streamContext->NextStartFrame = urb->UrbIsochronousTransfer.StartFrame +
+                                        ISOCH_STREAM_FRAMES_PER_URB;
+        streamContext->NextStartFrameValid = TRUE;
+
+        for (i = 0; i < urb->UrbIsochronousTransfer.NumberOfPackets; i++) {
+
+            packetStatus = urb->UrbIsochronousTransfer.IsoPacket[i].Status;
+
+            if (packetStatus == USBD_STATUS_ISO_NOT_ACCESSED_LATE ||
+                packetStatus == USBD_STATUS_ISO_NA_LATE_USBPORT ||
+                packetStatus == USBD_STATUS_ISO_NOT_ACCESSED_BY_HW) {
+                streamContext->Statistics.LatePackets++;
+                continue;
+            }
+
+            if (!USBD_SUCCESS(packetStatus)) {
+                streamContext->Statistics.PacketErrors++;
+                continue;
+            }
+
+            length = urb->UrbIsochronousTransfer.IsoPacket[i].Length;
+            offset = urb->UrbIsochronousTransfer.IsoPacket[i].Offset;
+
+            streamContext->Statistics.PacketsReceived++;
+            streamContext->Statistics.BytesReceived += length;
+
+            if (length > streamContext->RingSize - streamContext->RingCount) {
+                streamContext->Statistics.PacketsDropped++;
+                continue;
+            }
+
+            ringWrite = (streamContext->RingRead + streamContext->RingCount) % streamContext->RingSize;
+            chunk = min(length, streamContext->RingSize - ringWrite);
+
+            RtlCopyMemory(streamContext->Ring + ringWrite, urbContext->Buffer + offset, chunk);
+            RtlCopyMemory(streamContext->Ring, urbContext->Buffer + offset + chunk, length - chunk);
+
+            streamContext->RingCount += length;
+        }
+    }
+    else if (!streamContext->Stopping) {
+        UsbSamp_DbgPrint(1, ("Continuous reader URB failed with NTSTATUS 0x%x, USBD_STATUS 0x%x\n",
+                             status, urb->UrbHeader.Status));
+        streamContext->Statistics.UrbErrors++;
+    }
+
+    if (streamContext->Stopping) {
+        repost = FALSE;
+    }
+
+    KeReleaseSpinLock(&streamContext->Lock, oldIrql);
+
+    CompleteIsochStreamReads(streamContext);
+
+    if (repost && PostIsochStreamUrb(streamContext, Request)) {
+        return;
+    }
+
+    RetireIsochStreamUrb(streamContext);
+
+    return;
+}
+
 VOID
 UsbSamp_EvtIoStop(
     _In_ WDFQUEUE         Queue,
@@ -545,6 +1273,9 @@ Routine Description:
     proceeed. When the underlying USB stack gets the request to suspend or
     remove, it will fail all the pending requests.
 
+    Pipelined bulk requests are never sent to the target themselves, so on
+    a purge their stages are canceled instead.
+
 Arguments:
 
 Return Value:
@@ -558,6 +1289,11 @@ Return Value:
         WdfRequestStopAcknowledge(Request, FALSE); // Don't requeue
     } 
     else if (ActionFlags & WdfRequestStopActionPurge) {
+#if !defined(BUFFERED_READ_WRITE)
+        if (StopPipelinedRequest(Request)) {
+            return;
+        }
+#endif
         WdfRequestCancelSentRequest(Request);
     }
 
@@ -73,6 +73,17 @@ Environment:
 
 #define DEFAULT_REGISTRY_TRANSFER_SIZE 65536
 
+//
+// Only writes are pipelined by default. Stages of a read queued behind a
+// short stage can take data the device sends for its next transfer.
+//
+#define DEFAULT_BULK_PIPELINE_DEPTH 4
+#define DEFAULT_BULK_IN_PIPELINE_DEPTH 1
+
+#define ISOCH_STREAM_URBS            4  // URBs kept posted by a continuous reader
+#define ISOCH_STREAM_FRAMES_PER_URB  8
+#define ISOCH_STREAM_RING_URBS      32  // data buffered, in URBs worth
+
 #define IDLE_CAPS_TYPE IdleUsbSelectiveSuspend
 
 
@@ -113,6 +124,13 @@ typedef struct _DEVICE_CONTEXT {
 
     USBD_HANDLE                     UsbdHandle;
 
+    //
+    // Reads waiting for data from a continuous isoch reader. IsochStreamLock
+    // guards the IsochStream field of the file contexts.
+    //
+    WDFQUEUE                        IsochStreamReadQueue;
+
+    WDFSPINLOCK                     IsochStreamLock;
 
 } DEVICE_CONTEXT, *PDEVICE_CONTEXT;
 
@@ -124,6 +142,8 @@ typedef struct _FILE_CONTEXT {
 
     WDFUSBPIPE Pipe;
 
+    WDFOBJECT  IsochStream;     // continuous isoch reader, if started
+
 } FILE_CONTEXT, *PFILE_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(FILE_CONTEXT, GetFileContext)
@@ -160,6 +180,25 @@ typedef struct _PIPE_CONTEXT {
     USBSAMP_STREAM_INFO    StreamInfo;
 #endif
 
+    //
+    // Bulk and interrupt pipes only. Number of stages of a request kept
+    // in flight, and counters returned by IOCTL_USBSAMP_GET_PIPE_STATISTICS.
+    //
+    ULONG   PipelineDepth;
+
+    volatile LONG64 StagesCompleted;
+
+    volatile LONG64 BytesTransferred;
+
+    volatile LONG64 TotalStageLatency;
+
+    volatile LONG64 MaxStageLatency;
+
+    //
+    // Isoch IN pipes only. Set while a continuous reader owns the pipe.
+    //
+    volatile LONG   IsochStreamActive;
+
 } PIPE_CONTEXT, *PPIPE_CONTEXT;
 
 
@@ -178,10 +217,87 @@ typedef struct _REQUEST_CONTEXT {
     ULONG             Numxfer;
     ULONG_PTR         VirtualAddress; // va for next segment of xfer.
     BOOLEAN           Read; // TRUE if Read
+    LONGLONG          StageStartTime; // QPC when the current stage was sent
+
+    //
+    // Used when the stages of a bulk transfer are pipelined through
+    // sub-requests. StageLock guards the fields up to StagesDone.
+    //
+    WDFSPINLOCK       StageLock;
+    PMDL              RequestMdl;
+    ULONG             StageLength;
+    ULONG             StagesInFlight;
+    ULONG             TransferEnd;    // end of the data before the first short stage
+    NTSTATUS          StageStatus;
+    BOOLEAN           StopStages;
+    BOOLEAN           ShortStage;     // a read stage came back short
+    BOOLEAN           StagesDone;
+    volatile LONG     CompletionRefs;
+    ULONG             NumberOfSubRequests;
+    WDFREQUEST        SubRequests[USBSAMP_MAX_PIPELINE_DEPTH];
 } REQUEST_CONTEXT, * PREQUEST_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(REQUEST_CONTEXT, GetRequestContext)
 
+//
+// This context is associated with every sub-request created to carry
+// one stage of a pipelined bulk transfer.
+//
+typedef struct _SUB_REQUEST_CONTEXT {
+
+    WDFREQUEST        MasterRequest;
+    WDFMEMORY         UrbMemory;
+    PMDL              Mdl;
+    ULONG             Offset;         // of the stage in the master's buffer
+    ULONG             Length;
+    LONGLONG          StartTime;      // QPC when the stage was sent
+} SUB_REQUEST_CONTEXT, *PSUB_REQUEST_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(SUB_REQUEST_CONTEXT, GetSubRequestContext)
+
+//
+// State of a continuous isoch reader. The driver keeps ISOCH_STREAM_URBS
+// requests posted on the pipe and copies the packets they return into Ring,
+// which reads on the handle are served from. Lock guards every field below
+// it.
+//
+typedef struct _ISOCH_STREAM_CONTEXT {
+
+    PDEVICE_CONTEXT   DeviceContext;
+    WDFUSBPIPE        Pipe;
+    WDFFILEOBJECT     FileObject;
+    ULONG             PacketSize;
+    ULONG             PacketsPerUrb;
+    ULONG             BytesPerUrb;
+    WDFREQUEST        Requests[ISOCH_STREAM_URBS];
+    KEVENT            UrbsDrained;    // signaled when no URB is posted
+
+    KSPIN_LOCK        Lock;
+    PUCHAR            Ring;
+    ULONG             RingSize;
+    ULONG             RingRead;       // offset of the oldest unread byte
+    ULONG             RingCount;      // bytes waiting to be read
+    ULONG             UrbsPosted;
+    ULONG             NextStartFrame; // expected StartFrame of the next URB
+    BOOLEAN           NextStartFrameValid;
+    BOOLEAN           Stopping;
+    USBSAMP_ISOCH_STATISTICS Statistics;
+} ISOCH_STREAM_CONTEXT, *PISOCH_STREAM_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(ISOCH_STREAM_CONTEXT, GetIsochStreamContext)
+
+//
+// This context is associated with every request a continuous isoch
+// reader keeps posted.
+//
+typedef struct _ISOCH_STREAM_URB_CONTEXT {
+
+    WDFMEMORY         UrbMemory;
+    PUCHAR            Buffer;
+} ISOCH_STREAM_URB_CONTEXT, *PISOCH_STREAM_URB_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(ISOCH_STREAM_URB_CONTEXT, GetIsochStreamUrbContext)
+
 typedef struct _WORKITEM_CONTEXT {
     WDFDEVICE       Device;
     WDFUSBPIPE      Pipe;
@@ -202,13 +318,18 @@ EVT_WDF_OBJECT_CONTEXT_CLEANUP  UsbSamp_EvtPipeContextCleanup;
 #endif
 
 EVT_WDF_DEVICE_FILE_CREATE UsbSamp_EvtDeviceFileCreate;
+EVT_WDF_FILE_CLEANUP UsbSamp_EvtFileCleanup;
 
 EVT_WDF_IO_QUEUE_IO_READ UsbSamp_EvtIoRead;
 EVT_WDF_IO_QUEUE_IO_WRITE UsbSamp_EvtIoWrite;
 EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL UsbSamp_EvtIoDeviceControl;
 
 EVT_WDF_REQUEST_COMPLETION_ROUTINE UsbSamp_EvtReadWriteCompletion;
+EVT_WDF_REQUEST_COMPLETION_ROUTINE UsbSamp_EvtPipelinedStageCompletion;
+EVT_WDF_REQUEST_CANCEL UsbSamp_EvtPipelinedRequestCancel;
+EVT_WDF_OBJECT_CONTEXT_CLEANUP UsbSamp_EvtSubRequestCleanup;
 EVT_WDF_REQUEST_COMPLETION_ROUTINE UsbSamp_EvtIsoRequestCompletionRoutine;
+EVT_WDF_REQUEST_COMPLETION_ROUTINE UsbSamp_EvtIsochStreamCompletion;
 
 EVT_WDF_IO_QUEUE_IO_STOP UsbSamp_EvtIoStop;
 
@@ -287,6 +408,107 @@ PerformIsochTransfer(
     _In_ ULONG            TotalLength
     );
 
+PISOCH_STREAM_CONTEXT
+ReferenceIsochStream(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFFILEOBJECT    FileObject
+    );
+
+NTSTATUS
+StartIsochStream(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFFILEOBJECT    FileObject
+    );
+
+NTSTATUS
+StopIsochStream(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFFILEOBJECT    FileObject
+    );
+
+NTSTATUS
+GetIsochStreamStatistics(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFFILEOBJECT    FileObject,
+    _Out_ PUSBSAMP_ISOCH_STATISTICS Statistics
+    );
+
+BOOLEAN
+ReadIsochStream(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFREQUEST       Request
+    );
+
+BOOLEAN
+PostIsochStreamUrb(
+    _In_ PISOCH_STREAM_CONTEXT StreamContext,
+    _In_ WDFREQUEST       Request
+    );
+
+VOID
+RetireIsochStreamUrb(
+    _In_ PISOCH_STREAM_CONTEXT StreamContext
+    );
+
+VOID
+CompleteIsochStreamReads(
+    _In_ PISOCH_STREAM_CONTEXT StreamContext
+    );
+
+NTSTATUS
+CopyFromIsochStreamRing(
+    _In_ PISOCH_STREAM_CONTEXT StreamContext,
+    _In_ WDFREQUEST       Request,
+    _Out_ PULONG          BytesCopied
+    );
+
+VOID
+ReleasePipelinedRequestRef(
+    _In_ WDFREQUEST       Request
+    );
+
+VOID
+CheckPipelinedStagesDone(
+    _In_ WDFREQUEST       Request
+    );
+
+BOOLEAN
+SendNextPipelinedStage(
+    _In_ WDFREQUEST       Request,
+    _In_ WDFREQUEST       SubRequest,
+    _In_ WDFUSBPIPE       Pipe
+    );
+
+NTSTATUS
+PerformPipelinedBulkTransfer(
+    _In_ PDEVICE_CONTEXT  DeviceContext,
+    _In_ WDFREQUEST       Request,
+    _In_ WDFUSBPIPE       Pipe,
+    _In_ USBD_PIPE_HANDLE UsbdPipeHandle,
+    _In_ PMDL             RequestMdl,
+    _In_ ULONG            UrbFlags,
+    _In_ ULONG            TotalLength,
+    _In_ ULONG            StageLength,
+    _In_ ULONG            PipelineDepth
+    );
+
+VOID
+CancelPipelinedStages(
+    _In_ WDFREQUEST Request
+    );
+
+BOOLEAN
+StopPipelinedRequest(
+    _In_ WDFREQUEST Request
+    );
+
+VOID
+UpdatePipeStageStatistics(
+    _In_ WDFUSBPIPE       Pipe,
+    _In_ LONGLONG         StageStartTime,
+    _In_ ULONG            BytesTransferred
+    );
+
 VOID
 DbgPrintRWContext(
     PREQUEST_CONTEXT                 rwContext
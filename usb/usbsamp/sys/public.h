@@ -46,4 +46,78 @@ DEFINE_GUID(GUID_CLASS_USBSAMP_USB,
                                                      METHOD_BUFFERED,         \
                                                      FILE_ANY_ACCESS)
 
+//
+// Sets the number of stages of a bulk read or write that are kept in flight
+// at once on the pipe the handle was opened for. Input is a ULONG from 1 to
+// USBSAMP_MAX_PIPELINE_DEPTH. It also resets the pipe statistics.
+//
+// Input pipes start at a depth of 1. When a read stage comes back short, the
+// stages queued behind it may already have taken data the device sent for
+// its next transfer, and that data is lost.
+//
+#define IOCTL_USBSAMP_SET_PIPELINE_DEPTH    CTL_CODE(FILE_DEVICE_UNKNOWN,     \
+                                                     IOCTL_INDEX + 3, \
+                                                     METHOD_BUFFERED,         \
+                                                     FILE_ANY_ACCESS)
+
+//
+// Returns a USBSAMP_PIPE_STATISTICS for the pipe the handle was opened for.
+//
+#define IOCTL_USBSAMP_GET_PIPE_STATISTICS   CTL_CODE(FILE_DEVICE_UNKNOWN,     \
+                                                     IOCTL_INDEX + 4, \
+                                                     METHOD_BUFFERED,         \
+                                                     FILE_ANY_ACCESS)
+
+#define USBSAMP_MAX_PIPELINE_DEPTH  16
+
+typedef struct _USBSAMP_PIPE_STATISTICS {
+
+    ULONG       PipelineDepth;          // stages kept in flight per request
+    ULONG       Reserved;
+    ULONGLONG   StagesCompleted;        // stages completed with success
+    ULONGLONG   BytesTransferred;
+    ULONGLONG   TotalStageLatency;      // send to completion, in microseconds
+    ULONGLONG   MaxStageLatency;        // in microseconds
+
+} USBSAMP_PIPE_STATISTICS, *PUSBSAMP_PIPE_STATISTICS;
+
+//
+// Starts a continuous reader on the isoch IN pipe the handle was opened for.
+// The driver keeps isoch URBs posted on the pipe and buffers the packets
+// they return; reads on the handle are then served from that buffer until
+// IOCTL_USBSAMP_STOP_ISOCH_STREAM is sent or the handle is closed.
+//
+#define IOCTL_USBSAMP_START_ISOCH_STREAM    CTL_CODE(FILE_DEVICE_UNKNOWN,     \
+                                                     IOCTL_INDEX + 5, \
+                                                     METHOD_BUFFERED,         \
+                                                     FILE_ANY_ACCESS)
+
+#define IOCTL_USBSAMP_STOP_ISOCH_STREAM     CTL_CODE(FILE_DEVICE_UNKNOWN,     \
+                                                     IOCTL_INDEX + 6, \
+                                                     METHOD_BUFFERED,         \
+                                                     FILE_ANY_ACCESS)
+
+//
+// Returns a USBSAMP_ISOCH_STATISTICS for the continuous reader on the handle.
+//
+#define IOCTL_USBSAMP_GET_ISOCH_STATISTICS  CTL_CODE(FILE_DEVICE_UNKNOWN,     \
+                                                     IOCTL_INDEX + 7, \
+                                                     METHOD_BUFFERED,         \
+                                                     FILE_ANY_ACCESS)
+
+typedef struct _USBSAMP_ISOCH_STATISTICS {
+
+    ULONG       UrbsPosted;             // URBs currently posted on the pipe
+    ULONG       BytesBuffered;          // data waiting to be read
+    ULONGLONG   UrbsCompleted;
+    ULONGLONG   UrbErrors;              // URBs that failed and were not reposted
+    ULONGLONG   PacketsReceived;
+    ULONGLONG   BytesReceived;
+    ULONGLONG   PacketsDropped;         // buffer was full, the reader fell behind
+    ULONGLONG   PacketErrors;
+    ULONGLONG   LatePackets;            // not accessed by the controller in time
+    ULONGLONG   MissedFrames;           // frames skipped between two URBs
+
+} USBSAMP_ISOCH_STATISTICS, *PUSBSAMP_ISOCH_STATISTICS;
+
 #endif
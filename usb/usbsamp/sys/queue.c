@@ -26,6 +26,7 @@ Environment:
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE, UsbSamp_EvtDeviceFileCreate)
+#pragma alloc_text(PAGE, UsbSamp_EvtFileCleanup)
 #pragma alloc_text(PAGE, UsbSamp_EvtIoDeviceControl)
 #pragma alloc_text(PAGE, UsbSamp_EvtIoRead)
 #pragma alloc_text(PAGE, UsbSamp_EvtIoWrite)
@@ -114,6 +115,40 @@ Return Value:
     return;
 }
 
+VOID
+UsbSamp_EvtFileCleanup(
+    _In_ WDFFILEOBJECT    FileObject
+    )
+/*++
+
+Routine Description:
+
+    The framework calls EvtFileCleanup when the last handle to a file
+    object is closed. Stops the continuous isoch reader if the application
+    left it running.
+
+Arguments:
+
+    FileObject - Pointer to fileobject that represents the open handle.
+
+Return Value:
+
+   VOID
+
+--*/
+{
+    PDEVICE_CONTEXT             pDevContext;
+
+    PAGED_CODE();
+
+    if (GetFileContext(FileObject)->IsochStream != NULL) {
+        pDevContext = GetDeviceContext(WdfFileObjectGetDevice(FileObject));
+        StopIsochStream(pDevContext, FileObject);
+    }
+
+    return;
+}
+
 VOID
 UsbSamp_EvtIoDeviceControl(
     _In_ WDFQUEUE   Queue,
@@ -154,6 +189,9 @@ Return Value:
     NTSTATUS           status;
     PDEVICE_CONTEXT    pDevContext;
     PFILE_CONTEXT      pFileContext;
+    PPIPE_CONTEXT      pipeContext;
+    PUSBSAMP_PIPE_STATISTICS pipeStatistics;
+    ULONG              pipelineDepth;
     ULONG              length = 0;
 
     UNREFERENCED_PARAMETER(OutputBufferLength);
@@ -220,6 +258,102 @@ Return Value:
         status = ResetDevice(device);
         break;
 
+    case IOCTL_USBSAMP_SET_PIPELINE_DEPTH:
+
+        pFileContext = GetFileContext(WdfRequestGetFileObject(Request));
+
+        if (pFileContext->Pipe == NULL) {
+            status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(ULONG), &ioBuffer, &bufLength);
+        if (!NT_SUCCESS(status)){
+            UsbSamp_DbgPrint(1, ("WdfRequestRetrieveInputBuffer failed\n"));
+            break;
+        }
+
+        pipelineDepth = *(PULONG)ioBuffer;
+
+        if (pipelineDepth == 0 || pipelineDepth > USBSAMP_MAX_PIPELINE_DEPTH) {
+            status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        //
+        // Requests already in progress keep the depth they started with.
+        //
+        pipeContext = GetPipeContext(pFileContext->Pipe);
+        pipeContext->PipelineDepth = pipelineDepth;
+
+        InterlockedExchange64(&pipeContext->StagesCompleted, 0);
+        InterlockedExchange64(&pipeContext->BytesTransferred, 0);
+        InterlockedExchange64(&pipeContext->TotalStageLatency, 0);
+        InterlockedExchange64(&pipeContext->MaxStageLatency, 0);
+
+        break;
+
+    case IOCTL_USBSAMP_GET_PIPE_STATISTICS:
+
+        pFileContext = GetFileContext(WdfRequestGetFileObject(Request));
+
+        if (pFileContext->Pipe == NULL) {
+            status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        status = WdfRequestRetrieveOutputBuffer(Request,
+                                                sizeof(USBSAMP_PIPE_STATISTICS),
+                                                &ioBuffer,
+                                                &bufLength);
+        if (!NT_SUCCESS(status)){
+            UsbSamp_DbgPrint(1, ("WdfRequestRetrieveOutputBuffer failed\n"));
+            break;
+        }
+
+        pipeContext = GetPipeContext(pFileContext->Pipe);
+        pipeStatistics = (PUSBSAMP_PIPE_STATISTICS)ioBuffer;
+
+        RtlZeroMemory(pipeStatistics, sizeof(USBSAMP_PIPE_STATISTICS));
+        pipeStatistics->PipelineDepth     = pipeContext->PipelineDepth;
+        pipeStatistics->StagesCompleted   = pipeContext->StagesCompleted;
+        pipeStatistics->BytesTransferred  = pipeContext->BytesTransferred;
+        pipeStatistics->TotalStageLatency = pipeContext->TotalStageLatency;
+        pipeStatistics->MaxStageLatency   = pipeContext->MaxStageLatency;
+
+        length = sizeof(USBSAMP_PIPE_STATISTICS);
+        break;
+
+    case IOCTL_USBSAMP_START_ISOCH_STREAM:
+
+        status = StartIsochStream(pDevContext, WdfRequestGetFileObject(Request));
+        break;
+
+    case IOCTL_USBSAMP_STOP_ISOCH_STREAM:
+
+        status = StopIsochStream(pDevContext, WdfRequestGetFileObject(Request));
+        break;
+
+    case IOCTL_USBSAMP_GET_ISOCH_STATISTICS:
+
+        status = WdfRequestRetrieveOutputBuffer(Request,
+                                                sizeof(USBSAMP_ISOCH_STATISTICS),
+                                                &ioBuffer,
+                                                &bufLength);
+        if (!NT_SUCCESS(status)){
+            UsbSamp_DbgPrint(1, ("WdfRequestRetrieveOutputBuffer failed\n"));
+            break;
+        }
+
+        status = GetIsochStreamStatistics(pDevContext,
+                                          WdfRequestGetFileObject(Request),
+                                          (PUSBSAMP_ISOCH_STATISTICS)ioBuffer);
+        if (NT_SUCCESS(status)) {
+            length = sizeof(USBSAMP_ISOCH_STATISTICS);
+        }
+
+        break;
+
     default :
         status = STATUS_INVALID_DEVICE_REQUEST;
         break;
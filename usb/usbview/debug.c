@@ -53,6 +53,11 @@ LIST_ENTRY AllocListHead =
     &AllocListHead
 };
 
+// Hubs are enumerated on thread pool threads, so the allocation list is
+// shared between threads.
+//
+SRWLOCK AllocListLock = SRWLOCK_INIT;
+
 
 /*****************************************************************************
 
@@ -84,7 +89,9 @@ MyAlloc (
 
         if (header != NULL)
         {
+            AcquireSRWLockExclusive(&AllocListLock);
             InsertTailList(&AllocListHead, &header->ListEntry);
+            ReleaseSRWLockExclusive(&AllocListLock);
 
             header->File = File;
             header->Line = Line;
@@ -122,7 +129,9 @@ MyReAlloc (
 
     // Remove the old address from the allocation list
     //
+    AcquireSRWLockExclusive(&AllocListLock);
     RemoveEntryList(&header->ListEntry);
+    ReleaseSRWLockExclusive(&AllocListLock);
 
     if (dwBytes < (dwBytes + (DWORD) sizeof(ALLOCHEADER)))
         {
@@ -135,14 +144,18 @@ MyReAlloc (
             // and the original handle and pointer are still valid.
             // Add the old address back to the allocation list.
             //
+            AcquireSRWLockExclusive(&AllocListLock);
             #pragma prefast(suppress:__WARNING_USING_UNINIT_VAR, "SAL noise")
             InsertTailList(&AllocListHead, &header->ListEntry);
+            ReleaseSRWLockExclusive(&AllocListLock);
         }
         else
         {
             // Add the new address to the allocation list
             //
+            AcquireSRWLockExclusive(&AllocListLock);
             InsertTailList(&AllocListHead, &headerNew->ListEntry);
+            ReleaseSRWLockExclusive(&AllocListLock);
 
             return (HGLOBAL)(headerNew + 1);
         }
@@ -170,7 +183,9 @@ MyFree (
 
         header--;
 
+        AcquireSRWLockExclusive(&AllocListLock);
         RemoveEntryList(&header->ListEntry);
+        ReleaseSRWLockExclusive(&AllocListLock);
 
         return GlobalFree((HGLOBAL)header);
     }
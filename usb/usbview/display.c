@@ -661,10 +661,6 @@ UpdateTreeItemDeviceInfo(
     UNREFERENCED_PARAMETER(bShowVersion)
 #endif
 
-#ifdef H264_SUPPORT
-    ResetErrorCounts();
-#endif
-
     tviName = ALLOC(256);
 
     if(NULL == tviName)
@@ -1942,6 +1938,7 @@ DisplayConfigDesc (
     UCHAR                           bInterfaceSubClass = 0;
     UCHAR                           bInterfaceProtocol = 0;
     BOOL                            displayUnknown = FALSE;
+    USBDESC_MODEL                   configModel;
 
     BOOL                            isSS;
 
@@ -1957,6 +1954,18 @@ DisplayConfigDesc (
     g_pStringDescs = StringDescs;
     g_descEnd      = (PUCHAR)ConfigDesc + ConfigDesc->wTotalLength;
 
+    // The class-specific display routines render the rule results of the
+    // descriptor model instead of checking the descriptors themselves
+    g_pConfigModel = NULL;
+    if (UsbDescParseConfig((const uint8_t *)ConfigDesc, ConfigDesc->wTotalLength, &configModel))
+    {
+        g_pConfigModel = &configModel;
+    }
+    else
+    {
+        OOPS();
+    }
+
     AppendTextBuffer("\r\n       ---===>Full Configuration Descriptor<===---\r\n");
 
     do
@@ -2331,8 +2340,14 @@ DisplayConfigDesc (
                                              -1)) != NULL);
 
 #ifdef H264_SUPPORT
-    DoAdditionalErrorChecks();
+    DoAdditionalErrorChecks(g_pConfigModel);
 #endif
+
+    if (g_pConfigModel != NULL)
+    {
+        UsbDescFreeModel(g_pConfigModel);
+        g_pConfigModel = NULL;
+    }
 }
 
 
@@ -4359,6 +4374,7 @@ InitializePerDeviceSettings (
     g_pConfigDesc  = NULL;
     g_pStringDescs = NULL;
     g_descEnd      = NULL;
+    g_pConfigModel = NULL;
 
     //
     // The GetConfigDescriptor() function in enum.c does not always work
@@ -407,6 +407,10 @@ DisplayStreamPayload(
                      PVIDEO_FORMAT_STREAM StreamPayloadDesc
                      );
 BOOL
+DisplayVSDescriptor (
+                     PVIDEO_SPECIFIC VidCommonDesc
+                     );
+BOOL
 DisplayVSEndpoint (
                    PVIDEO_CS_INTERRUPT VidEndpointDesc
                    );
@@ -449,6 +453,189 @@ VDisplayDescString (
 // L O C A L    F U N C T I O N S
 //*****************************************************************************
 
+//*****************************************************************************
+// V I D E O   S T R E A M I N G   D E S C R I P T O R   D I S P L A Y
+//*****************************************************************************
+
+//
+// Class-specific Video Streaming interface descriptors are dispatched through
+// the table below.  The rules for each subtype (minimum length, UVC version
+// availability and frame counting) live in VSDescriptorRules[] in
+// usbdescmodel.c and are evaluated when DisplayConfigDesc() builds the
+// descriptor model.  DisplayVSDescriptor() renders their results.
+//
+
+typedef BOOL (*PDISPLAY_VS_DESCRIPTOR)(PVIDEO_SPECIFIC VidCommonDesc);
+
+typedef struct _VS_DISPLAY_ENTRY
+{
+    UCHAR                   bDescriptorSubtype;
+    PDISPLAY_VS_DESCRIPTOR  Display;
+} VS_DISPLAY_ENTRY, *PVS_DISPLAY_ENTRY;
+
+//
+// Typed wrappers that give each display routine the common
+// PDISPLAY_VS_DESCRIPTOR signature, VsDisplayXxx() for DisplayXxx().
+//
+#define DEFINE_VS_DISPLAY(Routine, DescType)                \
+    BOOL                                                    \
+    Vs##Routine (                                           \
+        PVIDEO_SPECIFIC VidCommonDesc                       \
+        )                                                   \
+    {                                                       \
+        return Routine((DescType)VidCommonDesc);            \
+    }
+
+DEFINE_VS_DISPLAY(DisplayVidInHeader,           PVIDEO_STREAMING_INPUT_HEADER)
+DEFINE_VS_DISPLAY(DisplayVidOutHeader,          PVIDEO_STREAMING_OUTPUT_HEADER)
+DEFINE_VS_DISPLAY(DisplayStillImageFrame,       PVIDEO_STILL_IMAGE_FRAME)
+DEFINE_VS_DISPLAY(DisplayUncompressedFormat,    PVIDEO_FORMAT_UNCOMPRESSED)
+DEFINE_VS_DISPLAY(DisplayUncompressedFrameType, PVIDEO_FRAME_UNCOMPRESSED)
+DEFINE_VS_DISPLAY(DisplayMJPEGFormat,           PVIDEO_FORMAT_MJPEG)
+DEFINE_VS_DISPLAY(DisplayMJPEGFrameType,        PVIDEO_FRAME_MJPEG)
+DEFINE_VS_DISPLAY(DisplayMPEG1SSFormat,         PVIDEO_FORMAT_MPEG1SS)
+DEFINE_VS_DISPLAY(DisplayMPEG2PSFormat,         PVIDEO_FORMAT_MPEG2PS)
+DEFINE_VS_DISPLAY(DisplayMPEG2TSFormat,         PVIDEO_FORMAT_MPEG2TS)
+DEFINE_VS_DISPLAY(DisplayMPEG4SLFormat,         PVIDEO_FORMAT_MPEG4SL)
+DEFINE_VS_DISPLAY(DisplayDVFormat,              PVIDEO_FORMAT_DV)
+DEFINE_VS_DISPLAY(DisplayColorMatching,         PVIDEO_COLORFORMAT)
+DEFINE_VS_DISPLAY(DisplayVendorVidFormat,       PVIDEO_FORMAT_VENDOR)
+DEFINE_VS_DISPLAY(DisplayVendorVidFrameType,    PVIDEO_FRAME_VENDOR)
+DEFINE_VS_DISPLAY(DisplayFramePayloadFormat,    PVIDEO_FORMAT_FRAME)
+DEFINE_VS_DISPLAY(DisplayFramePayloadFrame,     PVIDEO_FRAME_FRAME)
+DEFINE_VS_DISPLAY(DisplayStreamPayload,         PVIDEO_FORMAT_STREAM)
+#ifdef H264_SUPPORT
+DEFINE_VS_DISPLAY(DisplayVCH264Format,          PVIDEO_FORMAT_H264)
+DEFINE_VS_DISPLAY(DisplayVCH264FrameType,       PVIDEO_FRAME_H264)
+#endif
+
+VS_DISPLAY_ENTRY VSDisplayRoutines[] =
+{
+    {VS_INPUT_HEADER,        VsDisplayVidInHeader},
+    {VS_OUTPUT_HEADER,       VsDisplayVidOutHeader},
+    {VS_STILL_IMAGE_FRAME,   VsDisplayStillImageFrame},
+    {VS_FORMAT_UNCOMPRESSED, VsDisplayUncompressedFormat},
+    {VS_FRAME_UNCOMPRESSED,  VsDisplayUncompressedFrameType},
+    {VS_FORMAT_MJPEG,        VsDisplayMJPEGFormat},
+    {VS_FRAME_MJPEG,         VsDisplayMJPEGFrameType},
+    {VS_FORMAT_MPEG1,        VsDisplayMPEG1SSFormat},
+    {VS_FORMAT_MPEG2PS,      VsDisplayMPEG2PSFormat},
+    {VS_FORMAT_MPEG2TS,      VsDisplayMPEG2TSFormat},
+    {VS_FORMAT_MPEG4SL,      VsDisplayMPEG4SLFormat},
+    {VS_FORMAT_DV,           VsDisplayDVFormat},
+    {VS_COLORFORMAT,         VsDisplayColorMatching},
+    {VS_FORMAT_VENDOR,       VsDisplayVendorVidFormat},
+    {VS_FRAME_VENDOR,        VsDisplayVendorVidFrameType},
+    {VS_FORMAT_FRAME_BASED,  VsDisplayFramePayloadFormat},
+    {VS_FRAME_FRAME_BASED,   VsDisplayFramePayloadFrame},
+    {VS_FORMAT_STREAM_BASED, VsDisplayStreamPayload},
+#ifdef H264_SUPPORT
+    {VS_FORMAT_H264,         VsDisplayVCH264Format},
+    {VS_FRAME_H264,          VsDisplayVCH264FrameType},
+#endif
+};
+
+
+//*****************************************************************************
+//
+// DisplayVSDescriptor()
+//
+// VidCommonDesc - A class-specific Video Streaming interface descriptor
+//
+// Reports the rule finding that the descriptor model holds for this
+// descriptor, then displays it through VSDisplayRoutines[].  Returns FALSE if
+// the descriptor was not displayed, in which case the caller dumps it as an
+// unknown descriptor.
+//
+//*****************************************************************************
+
+BOOL
+DisplayVSDescriptor (
+    PVIDEO_SPECIFIC VidCommonDesc
+    )
+{
+    const USBDESC_RECORD *record = NULL;
+    ULONG                 index = 0;
+
+    if (g_pConfigModel != NULL)
+    {
+        record = UsbDescFindRecord(g_pConfigModel,
+                                   (size_t)((PUCHAR)VidCommonDesc - (PUCHAR)g_pConfigDesc));
+    }
+
+    if (record == NULL)
+    {
+        // The model could not be built, or it stopped before this descriptor
+        OOPS();
+        return FALSE;
+    }
+
+    switch (record->Finding)
+    {
+    case UsbDescFindingNone:
+        break;
+
+    case UsbDescFindingUndefinedSubtype:
+        //@@TestCase B1.3
+        //@@CAUTION
+        //@@Descriptor Field - bDescriptorSubtype
+        //@@An undefined descriptor subtype has been defined
+        AppendTextBuffer("*!*CAUTION:  This is an undefined class specific Video "\
+            "Streaming bDescriptorSubtype\r\n");
+        return FALSE;
+
+    case UsbDescFindingObsoleteSubtype:
+        // this format is obsoleted in UVC version >= 1.1
+        AppendTextBuffer("*!*ERROR:  obsoleted bDescriptorSubtype\r\n");
+        OOPS();
+        return FALSE;
+
+    case UsbDescFindingSubtypeNotInUvc10:
+        // this format did not exist in UVC 1.0
+        AppendTextBuffer("*!*ERROR: bDescriptorSubtype did not exist in UVC 1.0\r\n");
+        OOPS();
+        return FALSE;
+
+    case UsbDescFindingTooShort:
+        //@@TestCase B1.5
+        //@@ERROR
+        //@@Descriptor Field - bLength
+        //@@The declared length is too short to hold the fixed fields of this
+        //@@  descriptor subtype, so the descriptor cannot be decoded
+        AppendTextBuffer("*!*ERROR:  bLength of %d too short for bDescriptorSubtype 0x%02X, "\
+            "should be at least %d\r\n",
+            VidCommonDesc->bLength,
+            VidCommonDesc->bDescriptorSubtype,
+            UsbDescVSMinLength(VidCommonDesc->bDescriptorSubtype));
+        OOPS();
+        return FALSE;
+
+    default:
+        // UsbDescFindingUnknownSubtype, reported below
+        break;
+    }
+
+    if (record->Finding == UsbDescFindingNone)
+    {
+        for (index = 0; index < sizeof(VSDisplayRoutines) / sizeof(VS_DISPLAY_ENTRY); index++)
+        {
+            if (VSDisplayRoutines[index].bDescriptorSubtype == VidCommonDesc->bDescriptorSubtype)
+            {
+                return VSDisplayRoutines[index].Display(VidCommonDesc);
+            }
+        }
+    }
+
+    //@@TestCase B1.4
+    //@@ERROR
+    //@@Descriptor Field - bDescriptorSubtype
+    //@@An unknown descriptor subtype has been defined
+    AppendTextBuffer("*!*ERROR:  unknown bDescriptorSubtype\r\n");
+    OOPS();
+    return FALSE;
+}
+
+
 //*****************************************************************************
 //
 // DisplayVideoDescriptor() UPDATED
@@ -550,238 +737,7 @@ DisplayVideoDescriptor (
 
         case VIDEO_SUBCLASS_STREAMING:
             //@@DisplayVideoDescriptor -Class-Specific Video Streaming Interface Descriptor
-            switch (VidCommonDesc->bDescriptorSubtype)
-            {
-            case VS_INPUT_HEADER:
-                return DisplayVidInHeader(
-                    (PVIDEO_STREAMING_INPUT_HEADER)VidCommonDesc);
-
-            case VS_OUTPUT_HEADER:
-                return DisplayVidOutHeader(
-                    (PVIDEO_STREAMING_OUTPUT_HEADER)VidCommonDesc);
-
-            case VS_STILL_IMAGE_FRAME:
-                return DisplayStillImageFrame(
-                    (PVIDEO_STILL_IMAGE_FRAME)VidCommonDesc);
-
-            case VS_FORMAT_UNCOMPRESSED:
-#ifdef H264_SUPPORT
-                {
-                    BOOL retCode = DisplayUncompressedFormat( (PVIDEO_FORMAT_UNCOMPRESSED)VidCommonDesc );
-                    g_expectedNumberOfUncompressedFrameFrameDescriptors += ((PVIDEO_FORMAT_UNCOMPRESSED)VidCommonDesc)->bNumFrameDescriptors;
-                    return retCode;
-                }
-#else
-                return DisplayUncompressedFormat(
-                    (PVIDEO_FORMAT_UNCOMPRESSED)VidCommonDesc);
-#endif
-
-            case VS_FRAME_UNCOMPRESSED:
-#ifdef H264_SUPPORT
-                {
-                    BOOL retCode = DisplayUncompressedFrameType( (PVIDEO_FRAME_UNCOMPRESSED)VidCommonDesc );
-                    g_numberOfUncompressedFrameFrameDescriptors++;
-                    return retCode;
-                }
-#else
-                return DisplayUncompressedFrameType(
-                    (PVIDEO_FRAME_UNCOMPRESSED)VidCommonDesc);
-#endif
-
-#ifdef H264_SUPPORT
-            case VS_FORMAT_H264:
-                {
-                    BOOL retCode = DisplayVCH264Format( (PVIDEO_FORMAT_H264)VidCommonDesc );
-                    g_expectedNumberOfH264FrameDescriptors += ((PVIDEO_FORMAT_H264)VidCommonDesc)->bNumFrameDescriptors;
-                    return retCode;
-                }
-
-            case VS_FRAME_H264:
-                {
-                    BOOL  retCode = DisplayVCH264FrameType( (PVIDEO_FRAME_H264)VidCommonDesc );
-                    g_numberOfH264FrameDescriptors++;
-                    return retCode;
-                }
-#endif
-
-            case VS_FORMAT_MJPEG:
-#ifdef H264_SUPPORT // additional checks
-                {
-                    BOOL retCode = DisplayMJPEGFormat( (PVIDEO_FORMAT_MJPEG)VidCommonDesc );
-                    g_expectedNumberOfMJPEGFrameDescriptors += ((PVIDEO_FORMAT_MJPEG)VidCommonDesc)->bNumFrameDescriptors;
-                    return retCode;
-                }
-#else
-                return DisplayMJPEGFormat(
-                    (PVIDEO_FORMAT_MJPEG)VidCommonDesc);
-#endif
-
-            case VS_FRAME_MJPEG:
-#ifdef H264_SUPPORT
-                {
-                    BOOL  retCode = DisplayMJPEGFrameType( (PVIDEO_FRAME_MJPEG)VidCommonDesc );
-                    g_numberOfMJPEGFrameDescriptors++;
-                    return retCode;
-                }
-
-#else
-                return DisplayMJPEGFrameType(
-                    (PVIDEO_FRAME_MJPEG)VidCommonDesc);
-#endif
-
-
-
-            case VS_FORMAT_MPEG1:
-            {
-                if (UVC10 == g_chUVCversion)
-                {
-                    return DisplayMPEG1SSFormat(
-                        (PVIDEO_FORMAT_MPEG1SS)VidCommonDesc);
-                }
-                else // this format is obsoleted in UVC version >= 1.1
-                {
-                    AppendTextBuffer("*!*ERROR:  obsoleted bDescriptorSubtype\r\n");
-                    OOPS();
-                    break;
-                }
-            }
-
-            case VS_FORMAT_MPEG2PS:
-            {
-                if (UVC10 == g_chUVCversion)
-                {
-                    return DisplayMPEG2PSFormat(
-                        (PVIDEO_FORMAT_MPEG2PS)VidCommonDesc);
-                }
-                else // this format is obsoleted in UVC version >= 1.1
-                {
-                    AppendTextBuffer("*!*ERROR:  obsoleted bDescriptorSubtype\r\n");
-                    OOPS();
-                    break;
-                }
-            }
-
-            case VS_FORMAT_MPEG2TS:
-                return DisplayMPEG2TSFormat(
-                    (PVIDEO_FORMAT_MPEG2TS)VidCommonDesc);
-
-            case VS_FORMAT_MPEG4SL:
-            {
-                if (UVC10 == g_chUVCversion)
-                {
-                    return DisplayMPEG4SLFormat(
-                        (PVIDEO_FORMAT_MPEG4SL)VidCommonDesc);
-                }
-                else // this format is obsoleted in UVC version >= 1.1
-                {
-                    AppendTextBuffer("*!*ERROR:  obsoleted bDescriptorSubtype\r\n");
-                    OOPS();
-                    break;
-                }
-            }
-
-            case VS_FORMAT_DV:
-                return DisplayDVFormat(
-                    (PVIDEO_FORMAT_DV)VidCommonDesc);
-
-            case VS_COLORFORMAT:
-                return DisplayColorMatching(
-                    (PVIDEO_COLORFORMAT)VidCommonDesc);
-
-            case VS_FORMAT_VENDOR:
-            {
-                if (UVC10 == g_chUVCversion)
-                {
-                     return DisplayVendorVidFormat(
-                        (PVIDEO_FORMAT_VENDOR)VidCommonDesc);
-                }
-                else // this format is obsoleted in UVC version >= 1.1
-                {
-                    AppendTextBuffer("*!*ERROR:  obsoleted bDescriptorSubtype\r\n");
-                    OOPS();
-                    break;
-                }
-            }
-
-            case VS_FRAME_VENDOR:
-            {
-                if (UVC10 == g_chUVCversion)
-                {
-                    return DisplayVendorVidFrameType(
-                        (PVIDEO_FRAME_VENDOR)VidCommonDesc);
-                }
-                else // this format is obsoleted in UVC version >= 1.1
-                {
-                    AppendTextBuffer("*!*ERROR:  obsoleted bDescriptorSubtype\r\n");
-                    OOPS();
-                    break;
-                }
-            }
-
-            case VS_FORMAT_FRAME_BASED:
-            {
-                if (UVC10 != g_chUVCversion)
-                {
-                    return DisplayFramePayloadFormat(
-                        (PVIDEO_FORMAT_FRAME)VidCommonDesc);
-                }
-                else // this format did not exist in UVC 1.0
-                {
-                    AppendTextBuffer("*!*ERROR: bDescriptorSubtype did not exist in UVC 1.0\r\n");
-                    OOPS();
-                    break;
-                }
-            }
-
-            case VS_FRAME_FRAME_BASED:
-            {
-                if (UVC10 != g_chUVCversion)
-                {
-                    return DisplayFramePayloadFrame(
-                        (PVIDEO_FRAME_FRAME)VidCommonDesc);
-                }
-                else // this format did not exist in UVC 1.0
-                {
-                    AppendTextBuffer("*!*ERROR: bDescriptorSubtype did not exist in UVC 1.0\r\n");
-                    OOPS();
-                    break;
-                }
-            }
-
-            case VS_FORMAT_STREAM_BASED:
-            {
-                if (UVC10 != g_chUVCversion)
-                {
-                    return DisplayStreamPayload(
-                        (PVIDEO_FORMAT_STREAM)VidCommonDesc);
-                }
-                else // this format did not exist in UVC 1.0
-                {
-                    AppendTextBuffer("*!*ERROR: bDescriptorSubtype did not exist in UVC 1.0\r\n");
-                    OOPS();
-                    break;
-                }
-            }
-
-            case VS_DESCRIPTOR_UNDEFINED:
-                //@@TestCase B1.3
-                //@@CAUTION
-                //@@Descriptor Field - bDescriptorSubtype
-                //@@An undefined descriptor subtype has been defined
-                AppendTextBuffer("*!*CAUTION:  This is an undefined class specific Video "\
-                    "Streaming bDescriptorSubtype\r\n");
-                break;
-
-            default:
-                //@@TestCase B1.4
-                //@@ERROR
-                //@@Descriptor Field - bDescriptorSubtype
-                //@@An unknown descriptor subtype has been defined
-                AppendTextBuffer("*!*ERROR:  unknown bDescriptorSubtype\r\n");
-                OOPS();
-                break;
-            }
-            break;
+            return DisplayVSDescriptor(VidCommonDesc);
 
         default:
             //@@TestCase B1.6
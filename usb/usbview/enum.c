@@ -9,7 +9,7 @@ Module Name:
 Abstract:
 
     This source file contains the routines which enumerate the USB bus
-    and populate the TreeView control.
+    into a device tree model and populate the TreeView control from it.
 
     The enumeration process goes like this:
 
@@ -18,7 +18,7 @@ Abstract:
     EnumerateHostController()
     Host controllers currently have symbolic link names of the form HCDx,
     where x starts at 0.  Use CreateFile() to open each host controller
-    symbolic link.  Create a node in the TreeView to represent each host
+    symbolic link.  Create a node in the model to represent each host
     controller.
 
     GetRootHubName()
@@ -31,7 +31,9 @@ Abstract:
     Given the name of a hub, use CreateFile() to map the hub.  Send the
     hub an IOCTL_USB_GET_NODE_INFORMATION request to get info about the
     hub, such as the number of downstream ports.  Create a node in the
-    TreeView to represent each hub.
+    model to represent each hub.  Every hub is enumerated on a thread pool
+    thread, so the hubs of all buses and all hub tiers are queried in
+    parallel.
 
     (3) Enumerate Downstream Ports
     EnumerateHubPorts()
@@ -41,14 +43,37 @@ Abstract:
     device (if any) attached to each port.  If there is a device attached
     to a port, send the hub an IOCTL_USB_GET_NODE_CONNECTION_NAME request
     to get the symbolic link name of the hub attached to the downstream
-    port.  If there is a hub attached to the downstream port, recurse to
-    step (2).  
+    port.  If there is a hub attached to the downstream port, queue it
+    for step (2).  
     
     GetAllStringDescriptors()
     GetConfigDescriptor()
-    Create a node in the TreeView to represent each hub port
+    Create a node in the model to represent each hub port
     and attached device.
 
+    (4) Descriptor Cache
+    LookupCachedDescriptors()
+    CacheDescriptors()
+    Descriptors requested from a device are remembered by driver key name
+    together with the device descriptor, device address and current
+    configuration reported for the port.  A refresh that finds the same
+    device still attached hands out copies of the cached descriptors
+    instead of issuing the descriptor requests again.  Entries for devices
+    that were not seen during a refresh are dropped by PruneDescriptorCache(),
+    and FlushDescriptorCache() forces a full rescan.
+
+    (5) TreeView
+    AddTreeNodeItems()
+    Once every queued hub has been enumerated, the UI thread creates the
+    TreeView items from the model.
+
+    (6) Device Changes
+    NoteDeviceChange()
+    RefreshChangedHubs()
+    A device arrival or removal marks the hub the device is attached to.
+    Only the ports of the marked hubs are enumerated again, and only their
+    TreeView items are replaced.
+
 
 Environment:
 
@@ -72,6 +97,74 @@ Revision History:
 
 #define NUM_STRING_DESC_TO_GET 32
 
+//*****************************************************************************
+// L O C A L    T Y P E D E F S
+//*****************************************************************************
+
+//
+// Descriptors retrieved from a connected device, kept across refreshes.
+//
+typedef struct _DESCRIPTOR_CACHE_ENTRY
+{
+    LIST_ENTRY              ListEntry;
+    PCHAR                   DriverKey;
+    USB_DEVICE_DESCRIPTOR   DeviceDescriptor;
+    USHORT                  DeviceAddress;
+    UCHAR                   CurrentConfigurationValue;
+    BOOL                    Seen;
+    PUSB_DESCRIPTOR_REQUEST ConfigDesc;
+    PUSB_DESCRIPTOR_REQUEST BosDesc;
+    PSTRING_DESCRIPTOR_NODE StringDescs;
+} DESCRIPTOR_CACHE_ENTRY, *PDESCRIPTOR_CACHE_ENTRY;
+
+//
+// A node of the USB device tree model.  The node owns Info; the TreeView
+// item created for the node only refers to it.
+//
+typedef struct _USBTREENODE
+{
+    LIST_ENTRY              ListEntry;          // Entry in Parent->Children
+    LIST_ENTRY              Children;           // Ports, in port order
+    struct _USBTREENODE    *Parent;
+    PVOID                   Info;               // NULL if enumeration failed
+    PCHAR                   LeafName;
+    TREEICON                Icon;
+    HTREEITEM               hTreeItem;
+    PCHAR                   InstanceId;         // Hubs only
+    BOOL                    DeviceConnected;
+    BOOL                    DeviceIsHub;
+    BOOL                    RefreshPending;     // Hub ports changed
+    struct _USBTREENODE    *NewPorts;           // Ports found by a refresh
+} USBTREENODE, *PUSBTREENODE;
+
+//
+// Tracks the hubs one enumeration has queued to the thread pool.
+//
+typedef struct _ENUM_CONTEXT
+{
+    volatile LONG           Pending;
+    volatile LONG           Failed;
+    HANDLE                  Done;
+} ENUM_CONTEXT, *PENUM_CONTEXT;
+
+//
+// A hub queued to the thread pool, with the arguments of EnumerateHub().
+//
+typedef struct _HUB_WORK_ITEM
+{
+    PENUM_CONTEXT                          Context;
+    PUSBTREENODE                           Node;
+    PCHAR                                  HubName;
+    size_t                                 cbHubName;
+    PUSB_NODE_CONNECTION_INFORMATION_EX    ConnectionInfo;
+    PUSB_NODE_CONNECTION_INFORMATION_EX_V2 ConnectionInfoV2;
+    PUSB_PORT_CONNECTOR_PROPERTIES         PortConnectorProps;
+    PUSB_DESCRIPTOR_REQUEST                ConfigDesc;
+    PUSB_DESCRIPTOR_REQUEST                BosDesc;
+    PSTRING_DESCRIPTOR_NODE                StringDescs;
+    PUSB_DEVICE_PNP_STRINGS                DevProps;
+} HUB_WORK_ITEM, *PHUB_WORK_ITEM;
+
 //*****************************************************************************
 // L O C A L    F U N C T I O N    P R O T O T Y P E S
 //*****************************************************************************
@@ -84,16 +177,39 @@ EnumerateHostControllers (
 
 VOID
 EnumerateHostController (
-    HTREEITEM                hTreeParent,
+    PENUM_CONTEXT            EnumContext,
+    PUSBTREENODE             ParentNode,
     HANDLE                   hHCDev,
     _Inout_ PCHAR            leafName,
     _In_    HANDLE           deviceInfo,
     _In_    PSP_DEVINFO_DATA deviceInfoData
 );
 
+VOID
+QueueHubEnumeration (
+    PENUM_CONTEXT                                   EnumContext,
+    PUSBTREENODE                                    HubNode,
+    _In_reads_(cbHubName) PCHAR                     HubName,
+    _In_ size_t                                     cbHubName,
+    _In_opt_ PUSB_NODE_CONNECTION_INFORMATION_EX    ConnectionInfo,
+    _In_opt_ PUSB_NODE_CONNECTION_INFORMATION_EX_V2 ConnectionInfoV2,
+    _In_opt_ PUSB_PORT_CONNECTOR_PROPERTIES         PortConnectorProps,
+    _In_opt_ PUSB_DESCRIPTOR_REQUEST                ConfigDesc,
+    _In_opt_ PUSB_DESCRIPTOR_REQUEST                BosDesc,
+    _In_opt_ PSTRING_DESCRIPTOR_NODE                StringDescs,
+    _In_opt_ PUSB_DEVICE_PNP_STRINGS                DevProps
+);
+
+VOID CALLBACK
+EnumerateHubCallback (
+    _Inout_     PTP_CALLBACK_INSTANCE Instance,
+    _Inout_opt_ PVOID                 Context
+);
+
 VOID
 EnumerateHub (
-    HTREEITEM                                       hTreeParent,
+    PENUM_CONTEXT                                   EnumContext,
+    PUSBTREENODE                                    HubNode,
     _In_reads_(cbHubName) PCHAR                     HubName,
     _In_ size_t                                     cbHubName,
     _In_opt_ PUSB_NODE_CONNECTION_INFORMATION_EX    ConnectionInfo,
@@ -107,9 +223,110 @@ EnumerateHub (
 
 VOID
 EnumerateHubPorts (
-    HTREEITEM   hTreeParent,
-    HANDLE      hHubDevice,
-    ULONG       NumPorts
+    PENUM_CONTEXT EnumContext,
+    PUSBTREENODE  HubNode,
+    HANDLE        hHubDevice,
+    ULONG         NumPorts
+);
+
+HANDLE
+OpenHubDevice (
+    _In_reads_(cbHubName) PCHAR HubName,
+    _In_ size_t                 cbHubName
+);
+
+BOOL
+InitializeEnumContext (
+    _Out_ PENUM_CONTEXT EnumContext
+);
+
+VOID
+ReleaseEnumContext (
+    _Inout_ PENUM_CONTEXT EnumContext
+);
+
+VOID
+WaitForEnumeration (
+    _Inout_ PENUM_CONTEXT EnumContext
+);
+
+PUSBTREENODE
+NewTreeNode (
+    _In_opt_ PUSBTREENODE Parent
+);
+
+BOOL
+SetTreeNode (
+    _Inout_ PUSBTREENODE Node,
+    _In_    PVOID        Info,
+    _In_    PCHAR        LeafName,
+    TREEICON             Icon
+);
+
+VOID
+FreeTreeNode (
+    _In_ PUSBTREENODE Node
+);
+
+VOID
+AddTreeNodeItems (
+    _In_ PUSBTREENODE Node
+);
+
+VOID
+CountTreeNodes (
+    _In_    PUSBTREENODE Node,
+    _Inout_ ULONG       *DevicesConnected,
+    _Inout_ ULONG       *HubsConnected
+);
+
+BOOL
+IsHubTreeNode (
+    _In_ PUSBTREENODE Node
+);
+
+PUSBTREENODE
+FindTreeNode (
+    _In_ PUSBTREENODE Node,
+    _In_ PCHAR        InstanceId
+);
+
+PCHAR
+SymbolicLinkToInstanceId (
+    _In_ PCHAR SymbolicLink
+);
+
+VOID
+QueueChangedHubs (
+    PENUM_CONTEXT EnumContext,
+    PUSBTREENODE  Node
+);
+
+VOID CALLBACK
+RefreshHubPortsCallback (
+    _Inout_     PTP_CALLBACK_INSTANCE Instance,
+    _Inout_opt_ PVOID                 Context
+);
+
+VOID
+ReplaceChangedHubPorts (
+    PUSBTREENODE  Node
+);
+
+VOID
+RelinkDeviceInfoNodes (
+    PUSBTREENODE  Node
+);
+
+VOID
+MoveDeviceList (
+    _Inout_ PDEVICE_GUID_LIST From,
+    _Out_   PDEVICE_GUID_LIST To
+);
+
+VOID
+CleanupInfo (
+    _In_ PVOID info
 );
 
 PCHAR GetRootHubName (
@@ -211,6 +428,44 @@ FindMatchingDeviceNodeForDriverName(
     _In_ BOOLEAN IsHub
     );
 
+BOOL
+LookupCachedDescriptors (
+    _In_opt_ PCHAR                               DriverKey,
+    _In_ PUSB_NODE_CONNECTION_INFORMATION_EX     ConnectionInfo,
+    _Out_ PUSB_DESCRIPTOR_REQUEST               *ConfigDesc,
+    _Out_ PUSB_DESCRIPTOR_REQUEST               *BosDesc,
+    _Out_ PSTRING_DESCRIPTOR_NODE               *StringDescs
+);
+
+VOID
+CacheDescriptors (
+    _In_opt_ PCHAR                               DriverKey,
+    _In_ PUSB_NODE_CONNECTION_INFORMATION_EX     ConnectionInfo,
+    _In_ PUSB_DESCRIPTOR_REQUEST                 ConfigDesc,
+    _In_opt_ PUSB_DESCRIPTOR_REQUEST             BosDesc,
+    _In_opt_ PSTRING_DESCRIPTOR_NODE             StringDescs
+);
+
+PUSB_DESCRIPTOR_REQUEST
+CopyDescriptorRequest (
+    _In_ PUSB_DESCRIPTOR_REQUEST DescReq
+);
+
+PSTRING_DESCRIPTOR_NODE
+CopyStringDescriptors (
+    _In_opt_ PSTRING_DESCRIPTOR_NODE StringDescs
+);
+
+VOID
+FreeStringDescriptors (
+    _In_opt_ PSTRING_DESCRIPTOR_NODE StringDescs
+);
+
+VOID
+FreeDescriptorCacheEntry (
+    _In_ PDESCRIPTOR_CACHE_ENTRY Entry
+);
+
 
 //*****************************************************************************
 // G L O B A L S
@@ -227,6 +482,23 @@ LIST_ENTRY EnumeratedHCListHead =
 DEVICE_GUID_LIST gHubList;
 DEVICE_GUID_LIST gDeviceList;
 
+// Descriptors of devices found by previous refreshes.
+//
+LIST_ENTRY DescriptorCacheListHead =
+{
+    &DescriptorCacheListHead,
+    &DescriptorCacheListHead
+};
+
+// Serializes the hub enumerations' access to the descriptor cache
+//
+SRWLOCK DescriptorCacheLock = SRWLOCK_INIT;
+
+// Device tree model.  The root is the "My Computer" item, its children are
+// the host controllers.
+//
+PUSBTREENODE gTreeModel = NULL;
+
 
 //*****************************************************************************
 // G L O B A L S    P R I V A T E    T O    T H I S    F I L E
@@ -247,8 +519,6 @@ PCHAR ConnectionStatuses[] =
     "Reset"               // 10 - DeviceReset
 };
 
-ULONG TotalDevicesConnected;
-
 
 //*****************************************************************************
 //
@@ -257,6 +527,9 @@ ULONG TotalDevicesConnected;
 // hTreeParent - Handle of the TreeView item under which host controllers
 // should be added.
 //
+// Builds a new device tree model, waits for the hubs queued to the thread
+// pool, then adds the TreeView items for the model.
+//
 //*****************************************************************************
 
 VOID
@@ -272,11 +545,31 @@ EnumerateHostControllers (
     PSP_DEVICE_INTERFACE_DETAIL_DATA deviceDetailData = NULL;
     ULONG                            index = 0;
     ULONG                            requiredLength = 0;
+    ULONG                            hubsConnected = 0;
     BOOL                             success;
+    ENUM_CONTEXT                     enumContext;
 
-    TotalDevicesConnected = 0;
+    *DevicesConnected = 0;
     TotalHubs = 0;
 
+    FreeTreeModel();
+
+    gTreeModel = NewTreeNode(NULL);
+    if (gTreeModel == NULL)
+    {
+        OOPS();
+        return;
+    }
+
+    gTreeModel->hTreeItem = hTreeParent;
+
+    if (!InitializeEnumContext(&enumContext))
+    {
+        OOPS();
+        FreeTreeModel();
+        return;
+    }
+
     EnumerateAllDevices();
 
     // Iterate over host controllers using the new GUID based interface
@@ -357,7 +650,8 @@ EnumerateHostControllers (
         //
         if (hHCDev != INVALID_HANDLE_VALUE)
         {
-            EnumerateHostController(hTreeParent,
+            EnumerateHostController(&enumContext,
+                                    gTreeModel,
                                     hHCDev,
                                     deviceDetailData->DevicePath,
                                     deviceInfo,
@@ -371,7 +665,14 @@ EnumerateHostControllers (
 
     SetupDiDestroyDeviceInfoList(deviceInfo);
 
-    *DevicesConnected = TotalDevicesConnected;
+    // Wait for the hubs, then show what was found
+    //
+    WaitForEnumeration(&enumContext);
+
+    AddTreeNodeItems(gTreeModel);
+
+    CountTreeNodes(gTreeModel, DevicesConnected, &hubsConnected);
+    TotalHubs = hubsConnected;
 
     return;
 }
@@ -380,21 +681,24 @@ EnumerateHostControllers (
 //
 // EnumerateHostController()
 //
-// hTreeParent - Handle of the TreeView item under which host controllers
-// should be added.
+// ParentNode - Model node under which host controllers should be added.
+//
+// The root hub is queued to the thread pool.
 //
 //*****************************************************************************
 
 VOID
 EnumerateHostController (
-    HTREEITEM                hTreeParent,
+    PENUM_CONTEXT            EnumContext,
+    PUSBTREENODE             ParentNode,
     HANDLE                   hHCDev,    _Inout_ PCHAR            leafName,
     _In_    HANDLE           deviceInfo,
     _In_    PSP_DEVINFO_DATA deviceInfoData
 )
 {
     PCHAR                   driverKeyName = NULL;
-    HTREEITEM               hHCItem = NULL;
+    PUSBTREENODE            hcNode = NULL;
+    PUSBTREENODE            rootHubNode = NULL;
     PCHAR                   rootHubName = NULL;
     PLIST_ENTRY             listEntry = NULL;
     PUSBHOSTCONTROLLERINFO  hcInfo = NULL;
@@ -543,17 +847,18 @@ EnumerateHostController (
         OOPS();
     }
 
-    // Add this host controller to the USB device tree view.
+    // Add this host controller to the USB device tree model.
     //
-    hHCItem = AddLeaf(hTreeParent,
-                      (LPARAM)hcInfo,
-                      leafName,
-                      hcInfo->Revision == UsbSuperSpeed ? GoodSsDeviceIcon : GoodDeviceIcon);
+    hcNode = NewTreeNode(ParentNode);
 
-    if (NULL == hHCItem)
+    if (NULL == hcNode ||
+        !SetTreeNode(hcNode,
+                     hcInfo,
+                     leafName,
+                     hcInfo->Revision == UsbSuperSpeed ? GoodSsDeviceIcon : GoodDeviceIcon))
     {
         // Failure adding host controller to USB device tree
-        // view.
+        // model.
 
         OOPS();
         FREE(driverKeyName);
@@ -580,16 +885,27 @@ EnumerateHostController (
         hr = StringCbLength(rootHubName, MAX_DRIVER_KEY_NAME, &cbHubName);
         if (SUCCEEDED(hr))
         {
-            EnumerateHub(hHCItem,
-                         rootHubName,
-                         cbHubName,
-                         NULL,       // ConnectionInfo
-                         NULL,       // ConnectionInfoV2
-                         NULL,       // PortConnectorProps
-                         NULL,       // ConfigDesc
-                         NULL,       // BosDesc
-                         NULL,       // StringDescs
-                         NULL);      // We do not pass DevProps for RootHub
+            rootHubNode = NewTreeNode(hcNode);
+        }
+
+        if (rootHubNode != NULL)
+        {
+            QueueHubEnumeration(EnumContext,
+                                rootHubNode,
+                                rootHubName,
+                                cbHubName,
+                                NULL,       // ConnectionInfo
+                                NULL,       // ConnectionInfoV2
+                                NULL,       // PortConnectorProps
+                                NULL,       // ConfigDesc
+                                NULL,       // BosDesc
+                                NULL,       // StringDescs
+                                NULL);      // We do not pass DevProps for RootHub
+        }
+        else
+        {
+            OOPS();
+            FREE(rootHubName);
         }
     }
     else
@@ -603,12 +919,122 @@ EnumerateHostController (
 }
 
 
+//*****************************************************************************
+//
+// QueueHubEnumeration()
+//
+// Queues EnumerateHub() for HubNode to the thread pool.  The hub is
+// enumerated on the calling thread if it cannot be queued.
+//
+//*****************************************************************************
+
+VOID
+QueueHubEnumeration (
+    PENUM_CONTEXT                                   EnumContext,
+    PUSBTREENODE                                    HubNode,
+    _In_reads_(cbHubName) PCHAR                     HubName,
+    _In_ size_t                                     cbHubName,
+    _In_opt_ PUSB_NODE_CONNECTION_INFORMATION_EX    ConnectionInfo,
+    _In_opt_ PUSB_NODE_CONNECTION_INFORMATION_EX_V2 ConnectionInfoV2,
+    _In_opt_ PUSB_PORT_CONNECTOR_PROPERTIES         PortConnectorProps,
+    _In_opt_ PUSB_DESCRIPTOR_REQUEST                ConfigDesc,
+    _In_opt_ PUSB_DESCRIPTOR_REQUEST                BosDesc,
+    _In_opt_ PSTRING_DESCRIPTOR_NODE                StringDescs,
+    _In_opt_ PUSB_DEVICE_PNP_STRINGS                DevProps
+    )
+{
+    PHUB_WORK_ITEM workItem = NULL;
+
+    workItem = (PHUB_WORK_ITEM)ALLOC(sizeof(HUB_WORK_ITEM));
+
+    if (workItem == NULL)
+    {
+        OOPS();
+        EnumerateHub(EnumContext,
+                     HubNode,
+                     HubName,
+                     cbHubName,
+                     ConnectionInfo,
+                     ConnectionInfoV2,
+                     PortConnectorProps,
+                     ConfigDesc,
+                     BosDesc,
+                     StringDescs,
+                     DevProps);
+        return;
+    }
+
+    workItem->Context = EnumContext;
+    workItem->Node = HubNode;
+    workItem->HubName = HubName;
+    workItem->cbHubName = cbHubName;
+    workItem->ConnectionInfo = ConnectionInfo;
+    workItem->ConnectionInfoV2 = ConnectionInfoV2;
+    workItem->PortConnectorProps = PortConnectorProps;
+    workItem->ConfigDesc = ConfigDesc;
+    workItem->BosDesc = BosDesc;
+    workItem->StringDescs = StringDescs;
+    workItem->DevProps = DevProps;
+
+    InterlockedIncrement(&EnumContext->Pending);
+
+    if (!TrySubmitThreadpoolCallback(EnumerateHubCallback, workItem, NULL))
+    {
+        OOPS();
+        EnumerateHubCallback(NULL, workItem);
+    }
+}
+
+//*****************************************************************************
+//
+// EnumerateHubCallback()
+//
+// Thread pool callback for a hub queued by QueueHubEnumeration().
+//
+//*****************************************************************************
+
+VOID CALLBACK
+EnumerateHubCallback (
+    _Inout_     PTP_CALLBACK_INSTANCE Instance,
+    _Inout_opt_ PVOID                 Context
+    )
+{
+    PHUB_WORK_ITEM workItem = (PHUB_WORK_ITEM)Context;
+    PENUM_CONTEXT  enumContext = NULL;
+
+    UNREFERENCED_PARAMETER(Instance);
+
+    if (workItem == NULL)
+    {
+        return;
+    }
+
+    enumContext = workItem->Context;
+
+    EnumerateHub(enumContext,
+                 workItem->Node,
+                 workItem->HubName,
+                 workItem->cbHubName,
+                 workItem->ConnectionInfo,
+                 workItem->ConnectionInfoV2,
+                 workItem->PortConnectorProps,
+                 workItem->ConfigDesc,
+                 workItem->BosDesc,
+                 workItem->StringDescs,
+                 workItem->DevProps);
+
+    FREE(workItem);
+
+    ReleaseEnumContext(enumContext);
+}
+
 //*****************************************************************************
 //
 // EnumerateHub()
 //
-// hTreeParent - Handle of the TreeView item under which this hub should be
-// added.
+// HubNode - Model node of this hub, already linked to its parent.  Only the
+// thread enumerating the hub touches the node until the enumeration is
+// complete.
 //
 // HubName - Name of this hub.  This pointer is kept so the caller can neither
 // free nor reuse this memory.
@@ -629,7 +1055,8 @@ EnumerateHostController (
 
 VOID
 EnumerateHub (
-    HTREEITEM                                       hTreeParent,
+    PENUM_CONTEXT                                   EnumContext,
+    PUSBTREENODE                                    HubNode,
     _In_reads_(cbHubName) PCHAR                     HubName,
     _In_ size_t                                     cbHubName,
     _In_opt_ PUSB_NODE_CONNECTION_INFORMATION_EX    ConnectionInfo,
@@ -648,16 +1075,12 @@ EnumerateHub (
     PUSB_HUB_INFORMATION_EX  hubInfoEx = NULL;
     PUSB_HUB_CAPABILITIES_EX hubCapabilityEx = NULL;
     HANDLE                  hHubDevice = INVALID_HANDLE_VALUE;
-    HTREEITEM               hItem = NULL;
     PVOID                   info = NULL;
-    PCHAR                   deviceName = NULL;
     ULONG                   nBytes = 0;
     BOOL                    success = 0;
     DWORD                   dwSizeOfLeafName = 0;
     CHAR                    leafName[512] = {0}; 
     HRESULT                 hr = S_OK;
-    size_t                  cchHeader = 0;
-    size_t                  cchFullHubName = 0;
 
     // Allocate some space for a USBDEVICEINFO structure to hold the
     // hub info, hub name, and connection info pointers.  GPTR zero
@@ -721,47 +1144,9 @@ EnumerateHub (
         ((PUSBROOTHUBINFO)info)->UsbDeviceProperties = DevProps;
     }
 
-    // Allocate a temp buffer for the full hub device name.
-    //
-    hr = StringCbLength("\\\\.\\", MAX_DEVICE_PROP, &cchHeader);
-    if (FAILED(hr))
-    {
-        goto EnumerateHubError;
-    }
-    cchFullHubName = cchHeader + cbHubName + 1;
-    deviceName = (PCHAR)ALLOC((DWORD) cchFullHubName);
-    if (deviceName == NULL)
-    {
-        OOPS();
-        goto EnumerateHubError;
-    }
-
-    // Create the full hub device name
-    //
-    hr = StringCchCopyN(deviceName, cchFullHubName, "\\\\.\\", cchHeader);
-    if (FAILED(hr))
-    {
-        goto EnumerateHubError;
-    }
-    hr = StringCchCatN(deviceName, cchFullHubName, HubName, cbHubName);
-    if (FAILED(hr))
-    {
-        goto EnumerateHubError;
-    }
-
     // Try to hub the open device
     //
-    hHubDevice = CreateFile(deviceName,
-                            GENERIC_WRITE,
-                            FILE_SHARE_WRITE,
-                            NULL,
-                            OPEN_EXISTING,
-                            0,
-                            NULL);
-
-    // Done with temp buffer for full hub device name
-    //
-    FREE(deviceName);
+    hHubDevice = OpenHubDevice(HubName, cbHubName);
 
     if (hHubDevice == INVALID_HANDLE_VALUE)
     {
@@ -891,25 +1276,28 @@ EnumerateHub (
         }
     }
 
-    // Now add an item to the TreeView with the PUSBDEVICEINFO pointer info
-    // as the LPARAM reference value containing everything we know about the
-    // hub.
+    // Now fill in the model node with the PUSBDEVICEINFO pointer info
+    // containing everything we know about the hub.  Its TreeView item is
+    // added by the UI thread once the enumeration is complete.
     //
-    hItem = AddLeaf(hTreeParent,
-                    (LPARAM)info,
-                    leafName,
-                    HubIcon);
-
-    if (hItem == NULL)
+    if (!SetTreeNode(HubNode,
+                     info,
+                     leafName,
+                     HubIcon))
     {
         OOPS();
         goto EnumerateHubError;
     }
 
-    // Now recursively enumerate the ports of this hub.
+    // Used to find the hub again when a device is attached or removed
+    //
+    HubNode->InstanceId = SymbolicLinkToInstanceId(HubName);
+
+    // Now enumerate the ports of this hub.
     //
     EnumerateHubPorts(
-        hItem,
+        EnumContext,
+        HubNode,
         hHubDevice,
         hubInfo->u.HubInformation.HubDescriptor.bNumberOfPorts
         );
@@ -982,20 +1370,22 @@ EnumerateHubError:
 //
 // EnumerateHubPorts()
 //
-// hTreeParent - Handle of the TreeView item under which the hub port should
-// be added.
+// HubNode - Model node under which the hub ports should be added.
 //
 // hHubDevice - Handle of the hub device to enumerate.
 //
 // NumPorts - Number of ports on the hub.
 //
+// External hubs are queued to the thread pool.
+//
 //*****************************************************************************
 
 VOID
 EnumerateHubPorts (
-    HTREEITEM   hTreeParent,
-    HANDLE      hHubDevice,
-    ULONG       NumPorts
+    PENUM_CONTEXT EnumContext,
+    PUSBTREENODE  HubNode,
+    HANDLE        hHubDevice,
+    ULONG         NumPorts
 )
 {
     ULONG       index = 0;
@@ -1016,6 +1406,8 @@ EnumerateHubPorts (
     PUSBDEVICEINFO                         info;
     PUSB_NODE_CONNECTION_INFORMATION_EX_V2 connectionInfoExV2;
     PDEVICE_INFO_NODE                      pNode;
+    PUSBTREENODE                           portNode;
+    BOOL                                   cached;
 
     // Loop over all ports of the hub.
     //
@@ -1028,6 +1420,7 @@ EnumerateHubPorts (
 
         connectionInfoEx = NULL;
         pPortConnectorProps = NULL;
+        driverKeyName = NULL;
         ZeroMemory(&portConnectorProps, sizeof(portConnectorProps));
         configDesc = NULL;
         bosDesc = NULL;
@@ -1035,6 +1428,7 @@ EnumerateHubPorts (
         info = NULL;
         connectionInfoExV2 = NULL;
         pNode = NULL;
+        portNode = NULL;
         DevProps = NULL;
         ZeroMemory(leafName, sizeof(leafName));
 
@@ -1240,18 +1634,29 @@ EnumerateHubPorts (
             FREE(connectionInfo);
         }
 
-        // Update the count of connected devices
+        // Add the port to the model in port order, the connected devices
+        // and hubs are counted from the model
         //
-        if (connectionInfoEx->ConnectionStatus == DeviceConnected)
-        {
-            TotalDevicesConnected++;
-        }
+        portNode = NewTreeNode(HubNode);
 
-        if (connectionInfoEx->DeviceIsHub)
+        if (portNode == NULL)
         {
-            TotalHubs++;
+            OOPS();
+            FREE(connectionInfoEx);
+            if (pPortConnectorProps != NULL)
+            {
+                FREE(pPortConnectorProps);
+            }
+            if (connectionInfoExV2 != NULL)
+            {
+                FREE(connectionInfoExV2);
+            }
+            break;
         }
 
+        portNode->DeviceConnected = (connectionInfoEx->ConnectionStatus == DeviceConnected);
+        portNode->DeviceIsHub = connectionInfoEx->DeviceIsHub;
+
         // If there is a device connected, get the Device Description
         //
         if (connectionInfoEx->ConnectionStatus != NoDeviceConnected)
@@ -1268,54 +1673,78 @@ EnumerateHubPorts (
                     DevProps = DriverNameToDeviceProperties(driverKeyName, cbDriverName);
                     pNode = FindMatchingDeviceNodeForDriverName(driverKeyName, connectionInfoEx->DeviceIsHub);
                 }
-                FREE(driverKeyName);
             }
 
         }
 
         // If there is a device connected to the port, try to retrieve the
-        // Configuration Descriptor from the device.
+        // Configuration Descriptor from the device.  A device that is still
+        // attached since the last refresh is served from the descriptor cache.
         //
+        configDesc = NULL;
+        bosDesc = NULL;
+        stringDescs = NULL;
+
+        cached = FALSE;
+
         if (gDoConfigDesc &&
             connectionInfoEx->ConnectionStatus == DeviceConnected)
+        {
+            AcquireSRWLockExclusive(&DescriptorCacheLock);
+            cached = LookupCachedDescriptors(driverKeyName,
+                                             connectionInfoEx,
+                                             &configDesc,
+                                             &bosDesc,
+                                             &stringDescs);
+            ReleaseSRWLockExclusive(&DescriptorCacheLock);
+        }
+
+        if (gDoConfigDesc &&
+            connectionInfoEx->ConnectionStatus == DeviceConnected &&
+            !cached)
         {
             configDesc = GetConfigDescriptor(hHubDevice,
                                              index,
                                              0);
-        }
-        else
-        {
-            configDesc = NULL;
-        }
 
-        if (configDesc != NULL &&
-            connectionInfoEx->DeviceDescriptor.bcdUSB > 0x0200)
-        {
-            bosDesc = GetBOSDescriptor(hHubDevice,
-                                       index);
-        }
-        else
-        {
-            bosDesc = NULL;
-        }
+            if (configDesc != NULL &&
+                connectionInfoEx->DeviceDescriptor.bcdUSB > 0x0200)
+            {
+                bosDesc = GetBOSDescriptor(hHubDevice,
+                                           index);
+            }
 
-        if (configDesc != NULL &&
-            AreThereStringDescriptors(&connectionInfoEx->DeviceDescriptor,
-                                      (PUSB_CONFIGURATION_DESCRIPTOR)(configDesc+1)))
-        {
-            stringDescs = GetAllStringDescriptors (
-                              hHubDevice,
-                              index,
-                              &connectionInfoEx->DeviceDescriptor,
-                              (PUSB_CONFIGURATION_DESCRIPTOR)(configDesc+1));
+            if (configDesc != NULL &&
+                AreThereStringDescriptors(&connectionInfoEx->DeviceDescriptor,
+                                          (PUSB_CONFIGURATION_DESCRIPTOR)(configDesc+1)))
+            {
+                stringDescs = GetAllStringDescriptors (
+                                  hHubDevice,
+                                  index,
+                                  &connectionInfoEx->DeviceDescriptor,
+                                  (PUSB_CONFIGURATION_DESCRIPTOR)(configDesc+1));
+            }
+
+            if (configDesc != NULL)
+            {
+                AcquireSRWLockExclusive(&DescriptorCacheLock);
+                CacheDescriptors(driverKeyName,
+                                 connectionInfoEx,
+                                 configDesc,
+                                 bosDesc,
+                                 stringDescs);
+                ReleaseSRWLockExclusive(&DescriptorCacheLock);
+            }
         }
-        else
+
+        if (driverKeyName != NULL)
         {
-            stringDescs = NULL;
+            FREE(driverKeyName);
+            driverKeyName = NULL;
         }
 
         // If the device connected to the port is an external hub, get the
-        // name of the external hub and recursively enumerate it.
+        // name of the external hub and queue it for enumeration.
         //
         if (connectionInfoEx->DeviceIsHub)
         {
@@ -1328,7 +1757,8 @@ EnumerateHubPorts (
                 hr = StringCbLength(extHubName, MAX_DRIVER_KEY_NAME, &cbHubName);
                 if (SUCCEEDED(hr))
                 {
-                    EnumerateHub(hTreeParent, //hPortItem,
+                    QueueHubEnumeration(EnumContext,
+                            portNode,
                             extHubName,
                             cbHubName,
                             connectionInfoEx,
@@ -1438,12 +1868,903 @@ EnumerateHubPorts (
                 icon = BadDeviceIcon;
             }
 
-            AddLeaf(hTreeParent, //hPortItem,
-                            (LPARAM)info,
-                            leafName,
-                            icon);
+            if (!SetTreeNode(portNode,
+                             info,
+                             leafName,
+                             icon))
+            {
+                OOPS();
+                CleanupInfo(info);
+            }
+        }
+    } // for
+}
+
+
+//*****************************************************************************
+//
+// OpenHubDevice()
+//
+// Returns INVALID_HANDLE_VALUE on failure.
+//
+//*****************************************************************************
+
+HANDLE
+OpenHubDevice (
+    _In_reads_(cbHubName) PCHAR HubName,
+    _In_ size_t                 cbHubName
+)
+{
+    HANDLE  hHubDevice = INVALID_HANDLE_VALUE;
+    PCHAR   deviceName = NULL;
+    HRESULT hr = S_OK;
+    size_t  cchHeader = 0;
+    size_t  cchFullHubName = 0;
+
+    // Allocate a temp buffer for the full hub device name.
+    //
+    hr = StringCbLength("\\\\.\\", MAX_DEVICE_PROP, &cchHeader);
+    if (FAILED(hr))
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+    cchFullHubName = cchHeader + cbHubName + 1;
+    deviceName = (PCHAR)ALLOC((DWORD) cchFullHubName);
+    if (deviceName == NULL)
+    {
+        OOPS();
+        return INVALID_HANDLE_VALUE;
+    }
+
+    // Create the full hub device name
+    //
+    hr = StringCchCopyN(deviceName, cchFullHubName, "\\\\.\\", cchHeader);
+    if (SUCCEEDED(hr))
+    {
+        hr = StringCchCatN(deviceName, cchFullHubName, HubName, cbHubName);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hHubDevice = CreateFile(deviceName,
+                                GENERIC_WRITE,
+                                FILE_SHARE_WRITE,
+                                NULL,
+                                OPEN_EXISTING,
+                                0,
+                                NULL);
+    }
+
+    // Done with temp buffer for full hub device name
+    //
+    FREE(deviceName);
+
+    return hHubDevice;
+}
+
+
+//*****************************************************************************
+//
+// InitializeEnumContext()
+//
+// The context holds one reference for the thread queuing the first hubs,
+// WaitForEnumeration() releases it.
+//
+//*****************************************************************************
+
+BOOL
+InitializeEnumContext (
+    _Out_ PENUM_CONTEXT EnumContext
+)
+{
+    EnumContext->Pending = 1;
+    EnumContext->Failed = FALSE;
+    EnumContext->Done = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    return (EnumContext->Done != NULL);
+}
+
+
+//*****************************************************************************
+//
+// ReleaseEnumContext()
+//
+//*****************************************************************************
+
+VOID
+ReleaseEnumContext (
+    _Inout_ PENUM_CONTEXT EnumContext
+)
+{
+    if (InterlockedDecrement(&EnumContext->Pending) == 0)
+    {
+        SetEvent(EnumContext->Done);
+    }
+}
+
+
+//*****************************************************************************
+//
+// WaitForEnumeration()
+//
+// Waits until every hub queued with EnumContext has been enumerated,
+// including the hubs queued by the thread pool callbacks themselves.
+//
+//*****************************************************************************
+
+VOID
+WaitForEnumeration (
+    _Inout_ PENUM_CONTEXT EnumContext
+)
+{
+    ReleaseEnumContext(EnumContext);
+
+    WaitForSingleObject(EnumContext->Done, INFINITE);
+
+    CloseHandle(EnumContext->Done);
+    EnumContext->Done = NULL;
+}
+
+
+//*****************************************************************************
+//
+// NewTreeNode()
+//
+// Allocates a model node and appends it to the children of Parent.
+//
+//*****************************************************************************
+
+PUSBTREENODE
+NewTreeNode (
+    _In_opt_ PUSBTREENODE Parent
+)
+{
+    PUSBTREENODE node = NULL;
+
+    node = (PUSBTREENODE)ALLOC(sizeof(USBTREENODE));
+    if (node == NULL)
+    {
+        return NULL;
+    }
+
+    InitializeListHead(&node->Children);
+    node->Parent = Parent;
+
+    if (Parent != NULL)
+    {
+        InsertTailList(&Parent->Children, &node->ListEntry);
+    }
+
+    return node;
+}
+
+
+//*****************************************************************************
+//
+// SetTreeNode()
+//
+// Hands Info to Node.  On failure the caller keeps ownership of Info.
+//
+//*****************************************************************************
+
+BOOL
+SetTreeNode (
+    _Inout_ PUSBTREENODE Node,
+    _In_    PVOID        Info,
+    _In_    PCHAR        LeafName,
+    TREEICON             Icon
+)
+{
+    HRESULT hr = S_OK;
+    size_t  cbLeafName = 0;
+
+    hr = StringCbLength(LeafName, STRSAFE_MAX_CCH, &cbLeafName);
+    if (FAILED(hr))
+    {
+        return FALSE;
+    }
+
+    Node->LeafName = (PCHAR)ALLOC((DWORD)cbLeafName + sizeof(CHAR));
+    if (Node->LeafName == NULL)
+    {
+        return FALSE;
+    }
+
+    StringCbCopy(Node->LeafName, cbLeafName + sizeof(CHAR), LeafName);
+
+    Node->Info = Info;
+    Node->Icon = Icon;
+
+    return TRUE;
+}
+
+
+//*****************************************************************************
+//
+// FreeTreeNode()
+//
+// Frees Node, its info and everything below it.  The TreeView items of the
+// nodes must already be deleted.
+//
+//*****************************************************************************
+
+VOID
+FreeTreeNode (
+    _In_ PUSBTREENODE Node
+)
+{
+    while (!IsListEmpty(&Node->Children))
+    {
+        FreeTreeNode(CONTAINING_RECORD(Node->Children.Flink,
+                                       USBTREENODE,
+                                       ListEntry));
+    }
+
+    if (Node->Parent != NULL)
+    {
+        RemoveEntryList(&Node->ListEntry);
+    }
+
+    if (Node->NewPorts != NULL)
+    {
+        FreeTreeNode(Node->NewPorts);
+    }
+
+    if (Node->Info != NULL)
+    {
+        CleanupInfo(Node->Info);
+    }
+
+    if (Node->LeafName != NULL)
+    {
+        FREE(Node->LeafName);
+    }
+
+    if (Node->InstanceId != NULL)
+    {
+        FREE(Node->InstanceId);
+    }
+
+    FREE(Node);
+}
+
+
+//*****************************************************************************
+//
+// FreeTreeModel()
+//
+// Called after the TreeView items have been deleted.
+//
+//*****************************************************************************
+
+VOID
+FreeTreeModel (
+    VOID
+)
+{
+    if (gTreeModel != NULL)
+    {
+        FreeTreeNode(gTreeModel);
+        gTreeModel = NULL;
+    }
+}
+
+
+//*****************************************************************************
+//
+// AddTreeNodeItems()
+//
+// Adds the TreeView items for the nodes below Node.  Nodes whose
+// enumeration failed are kept in the model but not shown.
+//
+//*****************************************************************************
+
+VOID
+AddTreeNodeItems (
+    _In_ PUSBTREENODE Node
+)
+{
+    PLIST_ENTRY  listEntry = NULL;
+    PUSBTREENODE child = NULL;
+
+    if (Node->hTreeItem == NULL)
+    {
+        return;
+    }
+
+    for (listEntry = Node->Children.Flink;
+         listEntry != &Node->Children;
+         listEntry = listEntry->Flink)
+    {
+        child = CONTAINING_RECORD(listEntry,
+                                  USBTREENODE,
+                                  ListEntry);
+
+        if (child->Info == NULL)
+        {
+            continue;
+        }
+
+        child->hTreeItem = AddLeaf(Node->hTreeItem,
+                                   (LPARAM)child->Info,
+                                   child->LeafName,
+                                   child->Icon);
+
+        if (child->hTreeItem == NULL)
+        {
+            OOPS();
+            continue;
+        }
+
+        AddTreeNodeItems(child);
+    }
+}
+
+
+//*****************************************************************************
+//
+// CountTreeNodes()
+//
+//*****************************************************************************
+
+VOID
+CountTreeNodes (
+    _In_    PUSBTREENODE Node,
+    _Inout_ ULONG       *DevicesConnected,
+    _Inout_ ULONG       *HubsConnected
+)
+{
+    PLIST_ENTRY  listEntry = NULL;
+    PUSBTREENODE child = NULL;
+
+    for (listEntry = Node->Children.Flink;
+         listEntry != &Node->Children;
+         listEntry = listEntry->Flink)
+    {
+        child = CONTAINING_RECORD(listEntry,
+                                  USBTREENODE,
+                                  ListEntry);
+
+        if (child->DeviceConnected)
+        {
+            (*DevicesConnected)++;
+        }
+
+        if (child->DeviceIsHub)
+        {
+            (*HubsConnected)++;
+        }
+
+        CountTreeNodes(child, DevicesConnected, HubsConnected);
+    }
+}
+
+
+//*****************************************************************************
+//
+// IsHubTreeNode()
+//
+//*****************************************************************************
+
+BOOL
+IsHubTreeNode (
+    _In_ PUSBTREENODE Node
+)
+{
+    return (Node->Info != NULL &&
+            (*(PUSBDEVICEINFOTYPE)Node->Info == RootHubInfo ||
+             *(PUSBDEVICEINFOTYPE)Node->Info == ExternalHubInfo));
+}
+
+
+//*****************************************************************************
+//
+// FindTreeNode()
+//
+// Returns the hub or device below Node with the given device instance ID.
+//
+//*****************************************************************************
+
+PUSBTREENODE
+FindTreeNode (
+    _In_ PUSBTREENODE Node,
+    _In_ PCHAR        InstanceId
+)
+{
+    PLIST_ENTRY             listEntry = NULL;
+    PUSBTREENODE            child = NULL;
+    PUSBTREENODE            found = NULL;
+    PUSB_DEVICE_PNP_STRINGS devProps = NULL;
+    PCHAR                   childInstanceId = NULL;
+
+    for (listEntry = Node->Children.Flink;
+         listEntry != &Node->Children;
+         listEntry = listEntry->Flink)
+    {
+        child = CONTAINING_RECORD(listEntry,
+                                  USBTREENODE,
+                                  ListEntry);
+
+        childInstanceId = child->InstanceId;
+
+        if (childInstanceId == NULL &&
+            child->Info != NULL &&
+            *(PUSBDEVICEINFOTYPE)child->Info == DeviceInfo)
+        {
+            devProps = ((PUSBDEVICEINFO)child->Info)->UsbDeviceProperties;
+            if (devProps != NULL)
+            {
+                childInstanceId = devProps->DeviceId;
+            }
+        }
+
+        if (childInstanceId != NULL &&
+            _stricmp(childInstanceId, InstanceId) == 0)
+        {
+            return child;
+        }
+
+        found = FindTreeNode(child, InstanceId);
+        if (found != NULL)
+        {
+            return found;
+        }
+    }
+
+    return NULL;
+}
+
+
+//*****************************************************************************
+//
+// SymbolicLinkToInstanceId()
+//
+// Converts a hub name or a device interface path such as
+// \\?\USB#VID_045E&PID_0040#5&2f3e1a3c&0&2#{a5dcbf10-6530-11d2-901f-00c04fb951ed}
+// to the device instance ID USB\VID_045E&PID_0040\5&2f3e1a3c&0&2.
+//
+//*****************************************************************************
+
+PCHAR
+SymbolicLinkToInstanceId (
+    _In_ PCHAR SymbolicLink
+)
+{
+    PCHAR   instanceId = NULL;
+    PCHAR   interfaceClass = NULL;
+    PCHAR   separator = NULL;
+    size_t  cbSymbolicLink = 0;
+    HRESULT hr = S_OK;
+
+    if (strncmp(SymbolicLink, "\\\\?\\", 4) == 0 ||
+        strncmp(SymbolicLink, "\\\\.\\", 4) == 0)
+    {
+        SymbolicLink += 4;
+    }
+
+    hr = StringCbLength(SymbolicLink, MAX_DRIVER_KEY_NAME, &cbSymbolicLink);
+    if (FAILED(hr))
+    {
+        return NULL;
+    }
+
+    instanceId = (PCHAR)ALLOC((DWORD)cbSymbolicLink + sizeof(CHAR));
+    if (instanceId == NULL)
+    {
+        return NULL;
+    }
+
+    StringCbCopy(instanceId, cbSymbolicLink + sizeof(CHAR), SymbolicLink);
+
+    // Drop the interface class GUID
+    //
+    interfaceClass = strrchr(instanceId, '#');
+    if (interfaceClass != NULL && interfaceClass[1] == '{')
+    {
+        *interfaceClass = '\0';
+    }
+
+    for (separator = instanceId; *separator != '\0'; separator++)
+    {
+        if (*separator == '#')
+        {
+            *separator = '\\';
+        }
+    }
+
+    return instanceId;
+}
+
+
+//*****************************************************************************
+//
+// NoteDeviceChange()
+//
+// SymbolicLink - Interface path of a device or hub that was attached or
+// removed.
+//
+// Marks the hub the device is attached to so that RefreshChangedHubs()
+// enumerates its ports again.  Returns FALSE if that hub is not in the model,
+// the caller must then refresh the whole tree.
+//
+//*****************************************************************************
+
+BOOL
+NoteDeviceChange (
+    _In_ PCHAR SymbolicLink,
+    BOOL       Arrival
+)
+{
+    PCHAR        instanceId = NULL;
+    PUSBTREENODE node = NULL;
+    DEVINST      devInst = 0;
+    DEVINST      devInstParent = 0;
+    CHAR         parentId[MAX_DEVICE_ID_LEN];
+    BOOL         marked = FALSE;
+
+    if (gTreeModel == NULL)
+    {
+        return FALSE;
+    }
+
+    instanceId = SymbolicLinkToInstanceId(SymbolicLink);
+    if (instanceId == NULL)
+    {
+        return FALSE;
+    }
+
+    if (!Arrival)
+    {
+        // The device is still in the model, its parent is the hub
+        //
+        node = FindTreeNode(gTreeModel, instanceId);
+
+        if (node != NULL && node->Parent != NULL && IsHubTreeNode(node->Parent))
+        {
+            node->Parent->RefreshPending = TRUE;
+            marked = TRUE;
+        }
+    }
+    else if (CM_Locate_DevNode(&devInst, instanceId, CM_LOCATE_DEVNODE_NORMAL) == CR_SUCCESS)
+    {
+        // Walk up the device tree to the first hub in the model
+        //
+        while (!marked &&
+               CM_Get_Parent(&devInstParent, devInst, 0) == CR_SUCCESS &&
+               CM_Get_Device_ID(devInstParent, parentId, MAX_DEVICE_ID_LEN, 0) == CR_SUCCESS)
+        {
+            node = FindTreeNode(gTreeModel, parentId);
+
+            if (node != NULL && IsHubTreeNode(node))
+            {
+                node->RefreshPending = TRUE;
+                marked = TRUE;
+            }
+
+            devInst = devInstParent;
+        }
+    }
+
+    FREE(instanceId);
+
+    return marked;
+}
+
+
+//*****************************************************************************
+//
+// RefreshChangedHubs()
+//
+// Enumerates the ports of the hubs marked by NoteDeviceChange() again and
+// replaces their TreeView items.  The rest of the tree is left alone.
+// Returns FALSE if a hub could not be enumerated, the caller must then
+// refresh the whole tree.
+//
+//*****************************************************************************
+
+BOOL
+RefreshChangedHubs (
+    ULONG *DevicesConnected
+)
+{
+    ENUM_CONTEXT     enumContext;
+    DEVICE_GUID_LIST oldDeviceList;
+    DEVICE_GUID_LIST oldHubList;
+    ULONG            hubsConnected = 0;
+
+    *DevicesConnected = 0;
+
+    if (gTreeModel == NULL || !InitializeEnumContext(&enumContext))
+    {
+        return FALSE;
+    }
+
+    // The devices left alone point into the current device lists, keep
+    // them until they point into the new ones.
+    //
+    MoveDeviceList(&gDeviceList, &oldDeviceList);
+    MoveDeviceList(&gHubList, &oldHubList);
+
+    EnumerateAllDevices();
+
+    QueueChangedHubs(&enumContext, gTreeModel);
+
+    WaitForEnumeration(&enumContext);
+
+    ReplaceChangedHubPorts(gTreeModel);
+
+    RelinkDeviceInfoNodes(gTreeModel);
+
+    ClearDeviceList(&oldDeviceList);
+    ClearDeviceList(&oldHubList);
+
+    CountTreeNodes(gTreeModel, DevicesConnected, &hubsConnected);
+    TotalHubs = hubsConnected;
+
+    return !enumContext.Failed;
+}
+
+
+//*****************************************************************************
+//
+// QueueChangedHubs()
+//
+// Queues the ports of the top-most marked hubs below Node.  A marked hub
+// below another marked hub is enumerated again with its parent.
+//
+//*****************************************************************************
+
+VOID
+QueueChangedHubs (
+    PENUM_CONTEXT EnumContext,
+    PUSBTREENODE  Node
+)
+{
+    PLIST_ENTRY    listEntry = NULL;
+    PUSBTREENODE   child = NULL;
+    PHUB_WORK_ITEM workItem = NULL;
+
+    for (listEntry = Node->Children.Flink;
+         listEntry != &Node->Children;
+         listEntry = listEntry->Flink)
+    {
+        child = CONTAINING_RECORD(listEntry,
+                                  USBTREENODE,
+                                  ListEntry);
+
+        if (!child->RefreshPending)
+        {
+            QueueChangedHubs(EnumContext, child);
+            continue;
+        }
+
+        child->NewPorts = NewTreeNode(NULL);
+        workItem = (PHUB_WORK_ITEM)ALLOC(sizeof(HUB_WORK_ITEM));
+
+        if (child->NewPorts == NULL || workItem == NULL)
+        {
+            OOPS();
+            if (workItem != NULL)
+            {
+                FREE(workItem);
+            }
+            InterlockedExchange(&EnumContext->Failed, TRUE);
+            continue;
+        }
+
+        workItem->Context = EnumContext;
+        workItem->Node = child;
+
+        InterlockedIncrement(&EnumContext->Pending);
+
+        if (!TrySubmitThreadpoolCallback(RefreshHubPortsCallback, workItem, NULL))
+        {
+            OOPS();
+            RefreshHubPortsCallback(NULL, workItem);
+        }
+    }
+}
+
+
+//*****************************************************************************
+//
+// RefreshHubPortsCallback()
+//
+// Thread pool callback that enumerates the ports of a marked hub into its
+// NewPorts node.  The hub info itself is kept.
+//
+//*****************************************************************************
+
+VOID CALLBACK
+RefreshHubPortsCallback (
+    _Inout_     PTP_CALLBACK_INSTANCE Instance,
+    _Inout_opt_ PVOID                 Context
+)
+{
+    PHUB_WORK_ITEM  workItem = (PHUB_WORK_ITEM)Context;
+    PENUM_CONTEXT   enumContext = NULL;
+    PUSBROOTHUBINFO hubInfo = NULL;
+    HANDLE          hHubDevice = INVALID_HANDLE_VALUE;
+    size_t          cbHubName = 0;
+
+    UNREFERENCED_PARAMETER(Instance);
+
+    if (workItem == NULL)
+    {
+        return;
+    }
+
+    enumContext = workItem->Context;
+
+    // USBROOTHUBINFO and USBEXTERNALHUBINFO start alike
+    //
+    hubInfo = (PUSBROOTHUBINFO)workItem->Node->Info;
+
+    if (SUCCEEDED(StringCbLength(hubInfo->HubName, MAX_DRIVER_KEY_NAME, &cbHubName)))
+    {
+        hHubDevice = OpenHubDevice(hubInfo->HubName, cbHubName);
+    }
+
+    if (hHubDevice != INVALID_HANDLE_VALUE)
+    {
+        EnumerateHubPorts(enumContext,
+                          workItem->Node->NewPorts,
+                          hHubDevice,
+                          hubInfo->HubInfo->u.HubInformation.HubDescriptor.bNumberOfPorts);
+
+        CloseHandle(hHubDevice);
+    }
+    else
+    {
+        // The hub itself is gone
+        //
+        InterlockedExchange(&enumContext->Failed, TRUE);
+    }
+
+    FREE(workItem);
+
+    ReleaseEnumContext(enumContext);
+}
+
+
+//*****************************************************************************
+//
+// ReplaceChangedHubPorts()
+//
+// Replaces the ports of the refreshed hubs below Node with their NewPorts
+// and adds the TreeView items for them.
+//
+//*****************************************************************************
+
+VOID
+ReplaceChangedHubPorts (
+    PUSBTREENODE  Node
+)
+{
+    PLIST_ENTRY  listEntry = NULL;
+    PLIST_ENTRY  portEntry = NULL;
+    PUSBTREENODE child = NULL;
+    PUSBTREENODE port = NULL;
+
+    for (listEntry = Node->Children.Flink;
+         listEntry != &Node->Children;
+         listEntry = listEntry->Flink)
+    {
+        child = CONTAINING_RECORD(listEntry,
+                                  USBTREENODE,
+                                  ListEntry);
+
+        if (child->NewPorts == NULL)
+        {
+            ReplaceChangedHubPorts(child);
+            continue;
+        }
+
+        // The items refer to the info of the old ports, delete them first
+        //
+        if (child->hTreeItem != NULL)
+        {
+            DeleteChildLeaves(child->hTreeItem);
+        }
+
+        while (!IsListEmpty(&child->Children))
+        {
+            FreeTreeNode(CONTAINING_RECORD(child->Children.Flink,
+                                           USBTREENODE,
+                                           ListEntry));
+        }
+
+        while (!IsListEmpty(&child->NewPorts->Children))
+        {
+            portEntry = RemoveHeadList(&child->NewPorts->Children);
+            port = CONTAINING_RECORD(portEntry,
+                                     USBTREENODE,
+                                     ListEntry);
+            port->Parent = child;
+            InsertTailList(&child->Children, portEntry);
+        }
+
+        FreeTreeNode(child->NewPorts);
+        child->NewPorts = NULL;
+        child->RefreshPending = FALSE;
+
+        if (child->hTreeItem != NULL)
+        {
+            AddTreeNodeItems(child);
+            ExpandLeaves(child->hTreeItem);
+        }
+    }
+}
+
+
+//*****************************************************************************
+//
+// RelinkDeviceInfoNodes()
+//
+// Points the devices below Node to their entries in the current device
+// list.
+//
+//*****************************************************************************
+
+VOID
+RelinkDeviceInfoNodes (
+    PUSBTREENODE  Node
+)
+{
+    PLIST_ENTRY       listEntry = NULL;
+    PUSBTREENODE      child = NULL;
+    PUSBDEVICEINFO    info = NULL;
+    PDEVICE_INFO_NODE pNode = NULL;
+
+    for (listEntry = Node->Children.Flink;
+         listEntry != &Node->Children;
+         listEntry = listEntry->Flink)
+    {
+        child = CONTAINING_RECORD(listEntry,
+                                  USBTREENODE,
+                                  ListEntry);
+
+        info = (PUSBDEVICEINFO)child->Info;
+
+        if (info != NULL &&
+            info->DeviceInfoType == DeviceInfo &&
+            info->DeviceInfoNode != NULL)
+        {
+            pNode = info->DeviceInfoNode;
+
+            info->DeviceInfoNode = (pNode->DeviceDriverName != NULL) ?
+                FindMatchingDeviceNodeForDriverName(pNode->DeviceDriverName, FALSE) :
+                NULL;
         }
-    } // for
+
+        RelinkDeviceInfoNodes(child);
+    }
+}
+
+
+//*****************************************************************************
+//
+// MoveDeviceList()
+//
+// Moves the entries of From to To and leaves From empty.
+//
+//*****************************************************************************
+
+VOID
+MoveDeviceList (
+    _Inout_ PDEVICE_GUID_LIST From,
+    _Out_   PDEVICE_GUID_LIST To
+)
+{
+    To->DeviceInfo = From->DeviceInfo;
+    InitializeListHead(&To->ListHead);
+
+    while (!IsListEmpty(&From->ListHead))
+    {
+        InsertTailList(&To->ListHead, RemoveHeadList(&From->ListHead));
+    }
+
+    From->DeviceInfo = INVALID_HANDLE_VALUE;
 }
 
 
@@ -2740,30 +4061,17 @@ GetStringDescriptors (
 
 //*****************************************************************************
 //
-// CleanupItem()
+// CleanupInfo()
+//
+// Frees the info of a model node.
 //
 //*****************************************************************************
 
 VOID
-CleanupItem (
-    HWND      hTreeWnd,
-    HTREEITEM hTreeItem,
-    PVOID pContext
+CleanupInfo (
+    _In_ PVOID info
 )
 {
-    TV_ITEM tvi;
-    PVOID   info = NULL;
-
-    UNREFERENCED_PARAMETER(pContext);
-
-    tvi.mask = TVIF_HANDLE | TVIF_PARAM;
-    tvi.hItem = hTreeItem;
-
-    TreeView_GetItem(hTreeWnd,
-                     &tvi);
-
-    info = (PVOID)tvi.lParam;
-
     if (info)
     {
         PCHAR                                  DriverKey = NULL;
@@ -3364,3 +4672,407 @@ FindMatchingDeviceNodeForDriverName(
     return NULL;
 }
 
+
+//*****************************************************************************
+//
+// LookupCachedDescriptors()
+//
+// Returns copies of the descriptors cached for the device identified by
+// DriverKey.  The cached entry is only used while the device descriptor,
+// device address and current configuration reported for the port still
+// match; otherwise the entry is discarded and FALSE is returned so that the
+// caller requests the descriptors from the device.
+//
+//*****************************************************************************
+
+BOOL
+LookupCachedDescriptors (
+    _In_opt_ PCHAR                               DriverKey,
+    _In_ PUSB_NODE_CONNECTION_INFORMATION_EX     ConnectionInfo,
+    _Out_ PUSB_DESCRIPTOR_REQUEST               *ConfigDesc,
+    _Out_ PUSB_DESCRIPTOR_REQUEST               *BosDesc,
+    _Out_ PSTRING_DESCRIPTOR_NODE               *StringDescs
+)
+{
+    PLIST_ENTRY             listEntry = NULL;
+    PDESCRIPTOR_CACHE_ENTRY entry = NULL;
+
+    *ConfigDesc = NULL;
+    *BosDesc = NULL;
+    *StringDescs = NULL;
+
+    if (DriverKey == NULL)
+    {
+        return FALSE;
+    }
+
+    for (listEntry = DescriptorCacheListHead.Flink;
+         listEntry != &DescriptorCacheListHead;
+         listEntry = listEntry->Flink)
+    {
+        entry = CONTAINING_RECORD(listEntry,
+                                  DESCRIPTOR_CACHE_ENTRY,
+                                  ListEntry);
+
+        if (_stricmp(DriverKey, entry->DriverKey) != 0)
+        {
+            continue;
+        }
+
+        // A different device now uses this driver key, or the device was
+        // reset or reconfigured since it was cached.
+        //
+        if (memcmp(&entry->DeviceDescriptor,
+                   &ConnectionInfo->DeviceDescriptor,
+                   sizeof(USB_DEVICE_DESCRIPTOR)) != 0 ||
+            entry->DeviceAddress != ConnectionInfo->DeviceAddress ||
+            entry->CurrentConfigurationValue != ConnectionInfo->CurrentConfigurationValue)
+        {
+            RemoveEntryList(&entry->ListEntry);
+            FreeDescriptorCacheEntry(entry);
+            return FALSE;
+        }
+
+        *ConfigDesc = CopyDescriptorRequest(entry->ConfigDesc);
+        if (*ConfigDesc == NULL)
+        {
+            return FALSE;
+        }
+
+        if (entry->BosDesc != NULL)
+        {
+            *BosDesc = CopyDescriptorRequest(entry->BosDesc);
+            if (*BosDesc == NULL)
+            {
+                FREE(*ConfigDesc);
+                *ConfigDesc = NULL;
+                return FALSE;
+            }
+        }
+
+        if (entry->StringDescs != NULL)
+        {
+            *StringDescs = CopyStringDescriptors(entry->StringDescs);
+            if (*StringDescs == NULL)
+            {
+                if (*BosDesc != NULL)
+                {
+                    FREE(*BosDesc);
+                    *BosDesc = NULL;
+                }
+                FREE(*ConfigDesc);
+                *ConfigDesc = NULL;
+                return FALSE;
+            }
+        }
+
+        entry->Seen = TRUE;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+//*****************************************************************************
+//
+// CacheDescriptors()
+//
+// Remembers copies of the descriptors just retrieved from a device.  The
+// caller keeps ownership of the descriptors it passes in.  Caching is best
+// effort; on allocation failure the device is simply requeried next time.
+//
+//*****************************************************************************
+
+VOID
+CacheDescriptors (
+    _In_opt_ PCHAR                               DriverKey,
+    _In_ PUSB_NODE_CONNECTION_INFORMATION_EX     ConnectionInfo,
+    _In_ PUSB_DESCRIPTOR_REQUEST                 ConfigDesc,
+    _In_opt_ PUSB_DESCRIPTOR_REQUEST             BosDesc,
+    _In_opt_ PSTRING_DESCRIPTOR_NODE             StringDescs
+)
+{
+    HRESULT                 hr = S_OK;
+    size_t                  cbDriverKey = 0;
+    PLIST_ENTRY             listEntry = NULL;
+    PDESCRIPTOR_CACHE_ENTRY entry = NULL;
+
+    if (DriverKey == NULL)
+    {
+        return;
+    }
+
+    hr = StringCbLength(DriverKey, MAX_DRIVER_KEY_NAME, &cbDriverKey);
+    if (FAILED(hr))
+    {
+        OOPS();
+        return;
+    }
+
+    // Drop any stale entry for this driver key
+    //
+    for (listEntry = DescriptorCacheListHead.Flink;
+         listEntry != &DescriptorCacheListHead;
+         listEntry = listEntry->Flink)
+    {
+        entry = CONTAINING_RECORD(listEntry,
+                                  DESCRIPTOR_CACHE_ENTRY,
+                                  ListEntry);
+
+        if (_stricmp(DriverKey, entry->DriverKey) == 0)
+        {
+            RemoveEntryList(&entry->ListEntry);
+            FreeDescriptorCacheEntry(entry);
+            break;
+        }
+    }
+
+    entry = (PDESCRIPTOR_CACHE_ENTRY)ALLOC(sizeof(DESCRIPTOR_CACHE_ENTRY));
+    if (entry == NULL)
+    {
+        OOPS();
+        return;
+    }
+
+    entry->DriverKey = (PCHAR)ALLOC((DWORD)cbDriverKey + sizeof(CHAR));
+    if (entry->DriverKey == NULL)
+    {
+        OOPS();
+        FreeDescriptorCacheEntry(entry);
+        return;
+    }
+    StringCbCopy(entry->DriverKey, cbDriverKey + sizeof(CHAR), DriverKey);
+
+    entry->ConfigDesc = CopyDescriptorRequest(ConfigDesc);
+    if (entry->ConfigDesc == NULL)
+    {
+        FreeDescriptorCacheEntry(entry);
+        return;
+    }
+
+    if (BosDesc != NULL)
+    {
+        entry->BosDesc = CopyDescriptorRequest(BosDesc);
+        if (entry->BosDesc == NULL)
+        {
+            FreeDescriptorCacheEntry(entry);
+            return;
+        }
+    }
+
+    if (StringDescs != NULL)
+    {
+        entry->StringDescs = CopyStringDescriptors(StringDescs);
+        if (entry->StringDescs == NULL)
+        {
+            FreeDescriptorCacheEntry(entry);
+            return;
+        }
+    }
+
+    entry->DeviceDescriptor = ConnectionInfo->DeviceDescriptor;
+    entry->DeviceAddress = ConnectionInfo->DeviceAddress;
+    entry->CurrentConfigurationValue = ConnectionInfo->CurrentConfigurationValue;
+    entry->Seen = TRUE;
+
+    InsertTailList(&DescriptorCacheListHead, &entry->ListEntry);
+}
+
+
+//*****************************************************************************
+//
+// PruneDescriptorCache()
+//
+// Called after a refresh.  Discards the entries of devices that were not
+// found during the refresh and resets the Seen flag of the others.
+//
+//*****************************************************************************
+
+VOID
+PruneDescriptorCache (
+    VOID
+)
+{
+    PLIST_ENTRY             listEntry = NULL;
+    PDESCRIPTOR_CACHE_ENTRY entry = NULL;
+
+    listEntry = DescriptorCacheListHead.Flink;
+
+    while (listEntry != &DescriptorCacheListHead)
+    {
+        entry = CONTAINING_RECORD(listEntry,
+                                  DESCRIPTOR_CACHE_ENTRY,
+                                  ListEntry);
+
+        listEntry = listEntry->Flink;
+
+        if (entry->Seen)
+        {
+            entry->Seen = FALSE;
+        }
+        else
+        {
+            RemoveEntryList(&entry->ListEntry);
+            FreeDescriptorCacheEntry(entry);
+        }
+    }
+}
+
+
+//*****************************************************************************
+//
+// FlushDescriptorCache()
+//
+// Discards all cached descriptors so that the next refresh requests them
+// from every device again.
+//
+//*****************************************************************************
+
+VOID
+FlushDescriptorCache (
+    VOID
+)
+{
+    PLIST_ENTRY             listEntry = NULL;
+    PDESCRIPTOR_CACHE_ENTRY entry = NULL;
+
+    while (!IsListEmpty(&DescriptorCacheListHead))
+    {
+        listEntry = RemoveHeadList(&DescriptorCacheListHead);
+
+        entry = CONTAINING_RECORD(listEntry,
+                                  DESCRIPTOR_CACHE_ENTRY,
+                                  ListEntry);
+
+        FreeDescriptorCacheEntry(entry);
+    }
+}
+
+
+//*****************************************************************************
+//
+// CopyDescriptorRequest()
+//
+// Duplicates a Configuration or BOS Descriptor request as returned by
+// GetConfigDescriptor() or GetBOSDescriptor().  Both descriptors start with
+// the same bLength, bDescriptorType, wTotalLength header.
+//
+//*****************************************************************************
+
+PUSB_DESCRIPTOR_REQUEST
+CopyDescriptorRequest (
+    _In_ PUSB_DESCRIPTOR_REQUEST DescReq
+)
+{
+    PUSB_DESCRIPTOR_REQUEST copyReq = NULL;
+    ULONG                   nBytes = 0;
+
+    nBytes = sizeof(USB_DESCRIPTOR_REQUEST) +
+             ((PUSB_CONFIGURATION_DESCRIPTOR)(DescReq+1))->wTotalLength;
+
+    copyReq = (PUSB_DESCRIPTOR_REQUEST)ALLOC(nBytes);
+    if (copyReq == NULL)
+    {
+        OOPS();
+        return NULL;
+    }
+
+    memcpy(copyReq, DescReq, nBytes);
+
+    return copyReq;
+}
+
+
+//*****************************************************************************
+//
+// CopyStringDescriptors()
+//
+//*****************************************************************************
+
+PSTRING_DESCRIPTOR_NODE
+CopyStringDescriptors (
+    _In_opt_ PSTRING_DESCRIPTOR_NODE StringDescs
+)
+{
+    PSTRING_DESCRIPTOR_NODE  head = NULL;
+    PSTRING_DESCRIPTOR_NODE *tail = &head;
+    PSTRING_DESCRIPTOR_NODE  node = NULL;
+    ULONG                    nBytes = 0;
+
+    for (; StringDescs != NULL; StringDescs = StringDescs->Next)
+    {
+        nBytes = sizeof(STRING_DESCRIPTOR_NODE) +
+                 StringDescs->StringDescriptor->bLength;
+
+        node = (PSTRING_DESCRIPTOR_NODE)ALLOC(nBytes);
+        if (node == NULL)
+        {
+            OOPS();
+            FreeStringDescriptors(head);
+            return NULL;
+        }
+
+        memcpy(node, StringDescs, nBytes);
+        node->Next = NULL;
+
+        *tail = node;
+        tail = &node->Next;
+    }
+
+    return head;
+}
+
+
+//*****************************************************************************
+//
+// FreeStringDescriptors()
+//
+//*****************************************************************************
+
+VOID
+FreeStringDescriptors (
+    _In_opt_ PSTRING_DESCRIPTOR_NODE StringDescs
+)
+{
+    PSTRING_DESCRIPTOR_NODE next = NULL;
+
+    while (StringDescs != NULL)
+    {
+        next = StringDescs->Next;
+        FREE(StringDescs);
+        StringDescs = next;
+    }
+}
+
+
+//*****************************************************************************
+//
+// FreeDescriptorCacheEntry()
+//
+//*****************************************************************************
+
+VOID
+FreeDescriptorCacheEntry (
+    _In_ PDESCRIPTOR_CACHE_ENTRY Entry
+)
+{
+    if (Entry->DriverKey != NULL)
+    {
+        FREE(Entry->DriverKey);
+    }
+
+    if (Entry->ConfigDesc != NULL)
+    {
+        FREE(Entry->ConfigDesc);
+    }
+
+    if (Entry->BosDesc != NULL)
+    {
+        FREE(Entry->BosDesc);
+    }
+
+    FreeStringDescriptors(Entry->StringDescs);
+
+    FREE(Entry);
+}
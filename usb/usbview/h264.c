@@ -7,21 +7,6 @@
 
 #ifdef H264_SUPPORT
 
-//*****************************************************************************
-// G L O B A L S    
-//*****************************************************************************
-// H.264 format
-UCHAR g_expectedNumberOfH264FrameDescriptors = 0;
-UCHAR g_numberOfH264FrameDescriptors = 0;
-
-// MJPEG format
-UCHAR g_expectedNumberOfMJPEGFrameDescriptors = 0;
-UCHAR g_numberOfMJPEGFrameDescriptors = 0;
-
-// Uncompressed frame format
-UCHAR g_expectedNumberOfUncompressedFrameFrameDescriptors = 0;
-UCHAR g_numberOfUncompressedFrameFrameDescriptors = 0;
-
 //*****************************************************************************
 //
 // external function prototypes 
@@ -658,6 +643,31 @@ BOOL DisplayVCH264EncodingUnit(
     return TRUE;
 }
 
+//*****************************************************************************
+//
+// Frame descriptor count checks
+//
+// One entry per format whose frame descriptor counts are reported.  The
+// counts are kept by the descriptor model (see VSDescriptorRules[] in
+// usbdescmodel.c).
+//
+//*****************************************************************************
+typedef struct _FRAME_COUNT_CHECK
+{
+    USBDESC_FORMAT  Format;
+    PCHAR           FrameName;
+    PCHAR           FormatName;
+} FRAME_COUNT_CHECK, *PFRAME_COUNT_CHECK;
+
+FRAME_COUNT_CHECK FrameCountChecks[] =
+{
+    {UsbDescFormatH264,         "H.264",              "H.264"},
+    {UsbDescFormatUncompressed, "uncompressed-frame", "uncompressed"},
+    {UsbDescFormatMJPEG,        "MJPEG",              "MJPEG"},
+};
+
+#define NUM_FRAME_COUNT_CHECKS (sizeof(FrameCountChecks) / sizeof(FRAME_COUNT_CHECK))
+
 //*****************************************************************************
 //
 // DoAdditionalErrorChecks()
@@ -670,81 +680,45 @@ BOOL DisplayVCH264EncodingUnit(
 // call this routine after the video descriptor has been parsed and displayed.
 //
 //*****************************************************************************
-void DoAdditionalErrorChecks()
+void DoAdditionalErrorChecks(PUSBDESC_MODEL Model)
 {
-    if( g_expectedNumberOfH264FrameDescriptors > 0 || g_numberOfH264FrameDescriptors > 0
-        || g_expectedNumberOfUncompressedFrameFrameDescriptors > 0 || g_numberOfUncompressedFrameFrameDescriptors > 0
-        || g_expectedNumberOfMJPEGFrameDescriptors > 0 || g_numberOfMJPEGFrameDescriptors > 0)
+    PFRAME_COUNT_CHECK   check = NULL;
+    PUSBDESC_FRAME_COUNT count = NULL;
+    BOOL                 header = FALSE;
+    ULONG                index = 0;
+
+    if (Model == NULL)
     {
-        AppendTextBuffer("\r\n          ===>Additional Error Checking<===\r\n");
+        return;
+    }
+
+    for (index = 0; index < NUM_FRAME_COUNT_CHECKS; index++)
+    {
+        check = &FrameCountChecks[index];
+        count = &Model->FrameCounts[check->Format];
 
-        // H.264 frame descriptor
-        if( g_expectedNumberOfH264FrameDescriptors > 0 || g_numberOfH264FrameDescriptors > 0)
+        if (count->Expected == 0 && count->Found == 0)
         {
-            if ( g_expectedNumberOfH264FrameDescriptors == g_numberOfH264FrameDescriptors )
-            {
-                AppendTextBuffer("PASS: number of H.264 frame descriptors (%d) == number of frame descriptors (%d) specified in H.264 format descriptor(s)\r\n",
-                    g_expectedNumberOfH264FrameDescriptors, g_numberOfH264FrameDescriptors );
-            }
-            else
-            {
-                AppendTextBuffer("FAIL: number of H.264 frame descriptors (%d) != number of frame descriptors (%d) specified in H.264 format descriptor(s)\r\n",
-                    g_expectedNumberOfH264FrameDescriptors, g_numberOfH264FrameDescriptors );
-            }
+            continue;
         }
 
-        // uncompressed frame descriptor
-        if( g_expectedNumberOfUncompressedFrameFrameDescriptors > 0 || g_numberOfUncompressedFrameFrameDescriptors > 0)
+        if (!header)
         {
-
-            if ( g_expectedNumberOfUncompressedFrameFrameDescriptors == g_numberOfUncompressedFrameFrameDescriptors )
-            {
-                AppendTextBuffer("PASS: number of uncompressed-frame frame descriptors (%d) == number of frame descriptors (%d) specified in uncompressed format descriptor(s)\r\n",
-                    g_expectedNumberOfUncompressedFrameFrameDescriptors, g_numberOfUncompressedFrameFrameDescriptors );
-            }
-            else
-            {
-                AppendTextBuffer("FAIL: number of uncompressed-frame frame descriptors (%d) != number of frame descriptors (%d) specified in uncompressed format descriptor(s)\r\n",
-                    g_expectedNumberOfUncompressedFrameFrameDescriptors, g_numberOfUncompressedFrameFrameDescriptors );
-            }
+            AppendTextBuffer("\r\n          ===>Additional Error Checking<===\r\n");
+            header = TRUE;
         }
 
-        // MJPEG frame descriptor
-        if( g_expectedNumberOfMJPEGFrameDescriptors > 0 || g_numberOfMJPEGFrameDescriptors > 0)
+        if (count->Expected == count->Found)
         {
-            if ( g_expectedNumberOfMJPEGFrameDescriptors == g_numberOfMJPEGFrameDescriptors )
-            {
-                AppendTextBuffer("PASS: number of MJPEG frame descriptors (%d) == number of frame descriptors (%d) specified in MJPEG format descriptor(s)\r\n",
-                    g_expectedNumberOfMJPEGFrameDescriptors, g_numberOfMJPEGFrameDescriptors );
-            }
-            else
-            {
-                AppendTextBuffer("FAIL: number of MJPEG frame descriptors (%d) != number of frame descriptors (%d) specified in MJPEG format descriptor(s)\r\n",
-                    g_expectedNumberOfMJPEGFrameDescriptors, g_numberOfMJPEGFrameDescriptors );
-            }
+            AppendTextBuffer("PASS: number of %s frame descriptors (%u) == number of frame descriptors (%u) specified in %s format descriptor(s)\r\n",
+                check->FrameName, count->Found, count->Expected, check->FormatName );
+        }
+        else
+        {
+            AppendTextBuffer("FAIL: number of %s frame descriptors (%u) != number of frame descriptors (%u) specified in %s format descriptor(s)\r\n",
+                check->FrameName, count->Found, count->Expected, check->FormatName );
         }
     }
 }
 
-//*****************************************************************************
-//
-// ResetErrorCounts()
-//
-//*****************************************************************************
-void ResetErrorCounts()
-{
-
-    // H.264 format
-    g_expectedNumberOfH264FrameDescriptors = 0;
-    g_numberOfH264FrameDescriptors = 0;
-
-    // MJPEG format
-    g_expectedNumberOfMJPEGFrameDescriptors = 0;
-    g_numberOfMJPEGFrameDescriptors = 0;
-
-    // Uncompressed frame format
-    g_expectedNumberOfUncompressedFrameFrameDescriptors = 0;
-    g_numberOfUncompressedFrameFrameDescriptors = 0;
-}
-
 #endif //H264_SUPPORT
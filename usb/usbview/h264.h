@@ -1,23 +1,5 @@
 #pragma once
 
-#ifdef H264_SUPPORT
-
-//*****************************************************************************
-//
-// external variables 
-//
-//*****************************************************************************
-extern UCHAR g_expectedNumberOfH264FrameDescriptors;
-extern UCHAR g_numberOfH264FrameDescriptors;
-
-extern UCHAR g_expectedNumberOfMJPEGFrameDescriptors;
-extern UCHAR g_numberOfMJPEGFrameDescriptors;
-
-extern UCHAR g_expectedNumberOfUncompressedFrameFrameDescriptors;
-extern UCHAR g_numberOfUncompressedFrameFrameDescriptors;
-
-#endif
-
 
 
 //*****************************************************************************
@@ -160,5 +142,4 @@ BOOL DisplayVCH264FrameType( _In_reads_(sizeof(VIDEO_FRAME_H264)) PVIDEO_FRAME_H
 BOOL DisplayVCH264EncodingUnit( _In_reads_(sizeof(VIDEO_ENCODING_UNIT))  PVIDEO_ENCODING_UNIT VidEncodingDesc );
 void DisplayBitmapData(  _In_reads_(byteCount) PUCHAR pData, UCHAR byteCount,  _In_ char * stringLabel);
 void DisplayBitmapDataWithStrings(  _In_reads_(byteCount) PUCHAR pData, UCHAR byteCount,  _In_ char * stringLabel,  _In_ PSTRINGLIST stringList, ULONG numEntriesInTable );
-void DoAdditionalErrorChecks();
-void ResetErrorCounts();
+void DoAdditionalErrorChecks(PUSBDESC_MODEL Model);
@@ -0,0 +1,394 @@
+/*++
+
+Copyright (c) Microsoft Corporation
+
+Module Name:
+
+USBDESCINV.C
+
+Abstract:
+
+Command line descriptor inventory built on the portable descriptor model
+in USBDESCMODEL.C.  It reads descriptor dumps and prints one line per
+configuration, so the descriptors of a fleet of devices can be collected
+and compared without usbview.exe.
+
+A dump is a device descriptor followed by its configuration descriptors,
+which is the layout of the Linux sysfs "descriptors" attribute, or a
+single configuration descriptor.  On Linux:
+
+    find /sys/bus/usb/devices/ -name descriptors | usbdescinv -
+
+Environment:
+
+user mode, any platform with a C99 compiler
+
+    cc -O2 -o usbdescinv usbdescinv.c usbdescmodel.c
+
+--*/
+
+/*****************************************************************************
+ I N C L U D E S
+*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "usbdescmodel.h"
+
+/*****************************************************************************
+ D E F I N E S
+*****************************************************************************/
+
+#define READ_CHUNK      4096
+#define MAX_PATH_LENGTH 4096
+
+/*****************************************************************************
+ G L O B A L S    P R I V A T E    T O    T H I S    F I L E
+*****************************************************************************/
+
+// The dump buffer is reused from one file to the next
+static uint8_t *DumpBuffer = NULL;
+static size_t   DumpBufferSize = 0;
+
+static int      Verbose = 0;
+
+static unsigned long FileCount = 0;
+static unsigned long ConfigCount = 0;
+static unsigned long FlaggedCount = 0;
+
+/*****************************************************************************
+ L O C A L    F U N C T I O N S
+*****************************************************************************/
+
+static int
+ReadDump (
+    const char *Path,
+    size_t     *Length
+    )
+{
+    FILE   *file;
+    size_t  count;
+    uint8_t *buffer;
+
+    *Length = 0;
+
+    file = fopen(Path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "%s: cannot open\n", Path);
+        return 0;
+    }
+
+    for (;;)
+    {
+        if (DumpBufferSize - *Length < READ_CHUNK)
+        {
+            buffer = (uint8_t *)realloc(DumpBuffer, DumpBufferSize + 16 * READ_CHUNK);
+            if (buffer == NULL)
+            {
+                fprintf(stderr, "%s: out of memory\n", Path);
+                fclose(file);
+                return 0;
+            }
+            DumpBuffer = buffer;
+            DumpBufferSize += 16 * READ_CHUNK;
+        }
+
+        count = fread(DumpBuffer + *Length, 1, DumpBufferSize - *Length, file);
+        *Length += count;
+
+        if (count == 0)
+        {
+            break;
+        }
+    }
+
+    fclose(file);
+    return 1;
+}
+
+static void
+PrintFindings (
+    const USBDESC_MODEL *Model
+    )
+{
+    const USBDESC_RECORD *record;
+    size_t                index;
+
+    if (Model->WalkFinding != UsbDescFindingNone)
+    {
+        printf("    %s\n", UsbDescFindingText((USBDESC_FINDING)Model->WalkFinding));
+    }
+
+    if (Model->TotalLengthFinding != UsbDescFindingNone)
+    {
+        printf("    %s (wTotalLength %u)\n",
+               UsbDescFindingText((USBDESC_FINDING)Model->TotalLengthFinding),
+               Model->wTotalLength);
+    }
+
+    for (index = 0; index < Model->RecordCount; index++)
+    {
+        record = &Model->Records[index];
+
+        if (record->Finding != UsbDescFindingNone)
+        {
+            printf("    %s: offset %u type 0x%02X subtype 0x%02X bLength %u, interface %u: %s\n",
+                   UsbDescFindingIsError((USBDESC_FINDING)record->Finding) ? "error" : "caution",
+                   (unsigned)record->Offset,
+                   record->bDescriptorType,
+                   record->bDescriptorSubtype,
+                   record->bLength,
+                   record->bInterfaceNumber,
+                   UsbDescFindingText((USBDESC_FINDING)record->Finding));
+        }
+    }
+
+    for (index = 0; index < UsbDescFormatMax; index++)
+    {
+        if (Model->FrameCounts[index].Expected != Model->FrameCounts[index].Found)
+        {
+            printf("    %s: %s, %u found, %u expected\n",
+                   UsbDescFormatName((USBDESC_FORMAT)index),
+                   UsbDescFindingText(UsbDescFindingFrameCount),
+                   (unsigned)Model->FrameCounts[index].Found,
+                   (unsigned)Model->FrameCounts[index].Expected);
+        }
+    }
+}
+
+//
+// <path> <vid:pid> cfg=<n> if=<classes> uvc=<bcd> uac=<bcd> <format>=<found>/<expected> findings=<n>
+//
+static void
+PrintConfig (
+    const char          *Path,
+    const uint8_t       *DeviceDesc,
+    const USBDESC_MODEL *Model
+    )
+{
+    uint8_t classes[32];
+    size_t  classCount = 0;
+    size_t  index;
+    size_t  known;
+
+    printf("%s", Path);
+
+    if (DeviceDesc != NULL)
+    {
+        printf(" %04x:%04x", UsbDescReadWord(&DeviceDesc[8]), UsbDescReadWord(&DeviceDesc[10]));
+    }
+    else
+    {
+        printf(" ----:----");
+    }
+
+    printf(" cfg=%u if=", Model->bConfigurationValue);
+
+    // Interface classes, each listed once in the order they appear
+    for (index = 0; index < Model->RecordCount; index++)
+    {
+        const USBDESC_RECORD *record = &Model->Records[index];
+
+        if (record->bDescriptorType != USBDESC_INTERFACE_TYPE)
+        {
+            continue;
+        }
+
+        for (known = 0; known < classCount; known++)
+        {
+            if (classes[known] == record->bInterfaceClass)
+            {
+                break;
+            }
+        }
+
+        if (known == classCount && classCount < sizeof(classes))
+        {
+            classes[classCount++] = record->bInterfaceClass;
+            printf("%s%02x", classCount > 1 ? "," : "", record->bInterfaceClass);
+        }
+    }
+
+    if (classCount == 0)
+    {
+        printf("-");
+    }
+
+    if (Model->bcdUVC != 0)
+    {
+        printf(" uvc=%x.%02x", Model->bcdUVC >> 8, Model->bcdUVC & 0xFF);
+    }
+
+    if (Model->bcdADC != 0)
+    {
+        printf(" uac=%x.%02x", Model->bcdADC >> 8, Model->bcdADC & 0xFF);
+    }
+
+    for (index = 0; index < UsbDescFormatMax; index++)
+    {
+        if (Model->FrameCounts[index].Expected != 0 || Model->FrameCounts[index].Found != 0)
+        {
+            printf(" %s=%u/%u",
+                   UsbDescFormatName((USBDESC_FORMAT)index),
+                   (unsigned)Model->FrameCounts[index].Found,
+                   (unsigned)Model->FrameCounts[index].Expected);
+        }
+    }
+
+    printf(" findings=%u\n", (unsigned)Model->FindingCount);
+
+    if (Verbose && Model->FindingCount != 0)
+    {
+        PrintFindings(Model);
+    }
+}
+
+static void
+InventoryFile (
+    const char *Path
+    )
+{
+    USBDESC_MODEL  model;
+    const uint8_t *deviceDesc = NULL;
+    size_t         length;
+    size_t         offset = 0;
+    size_t         configLength;
+    unsigned       configs = 0;
+
+    if (!ReadDump(Path, &length))
+    {
+        return;
+    }
+
+    FileCount++;
+
+    if (length >= USBDESC_DEVICE_LENGTH &&
+        DumpBuffer[0] == USBDESC_DEVICE_LENGTH &&
+        DumpBuffer[1] == USBDESC_DEVICE_TYPE)
+    {
+        deviceDesc = DumpBuffer;
+        offset = USBDESC_DEVICE_LENGTH;
+    }
+
+    while (offset + USBDESC_CONFIGURATION_LENGTH <= length)
+    {
+        if (!UsbDescParseConfig(&DumpBuffer[offset], length - offset, &model))
+        {
+            break;
+        }
+
+        ConfigCount++;
+        configs++;
+
+        if (model.FindingCount != 0)
+        {
+            FlaggedCount++;
+        }
+
+        PrintConfig(Path, deviceDesc, &model);
+
+        // A zero wTotalLength would not advance, the model flags it
+        configLength = model.wTotalLength;
+
+        UsbDescFreeModel(&model);
+
+        if (configLength == 0)
+        {
+            break;
+        }
+
+        offset += configLength;
+    }
+
+    if (configs == 0)
+    {
+        fprintf(stderr, "%s: no configuration descriptor\n", Path);
+    }
+}
+
+static void
+Usage (
+    const char *Program
+    )
+{
+    fprintf(stderr,
+            "Usage:  %s [-v] [-s] <dump>... | -\n"
+            "  -v  list the findings of each configuration\n"
+            "  -s  print a summary line at the end\n"
+            "  -   read the dump paths from standard input, one per line\n",
+            Program);
+}
+
+/*****************************************************************************
+ G L O B A L    F U N C T I O N S
+*****************************************************************************/
+
+int
+main (
+    int   argc,
+    char *argv[]
+    )
+{
+    char    path[MAX_PATH_LENGTH];
+    size_t  length;
+    int     summary = 0;
+    int     paths = 0;
+    int     index;
+
+    for (index = 1; index < argc; index++)
+    {
+        if (strcmp(argv[index], "-v") == 0)
+        {
+            Verbose = 1;
+        }
+        else if (strcmp(argv[index], "-s") == 0)
+        {
+            summary = 1;
+        }
+        else if (strcmp(argv[index], "-") == 0)
+        {
+            while (fgets(path, sizeof(path), stdin) != NULL)
+            {
+                length = strlen(path);
+                while (length > 0 && (path[length - 1] == '\n' || path[length - 1] == '\r'))
+                {
+                    path[--length] = '\0';
+                }
+
+                if (length != 0)
+                {
+                    InventoryFile(path);
+                }
+            }
+            paths++;
+        }
+        else if (argv[index][0] == '-')
+        {
+            Usage(argv[0]);
+            return 2;
+        }
+        else
+        {
+            InventoryFile(argv[index]);
+            paths++;
+        }
+    }
+
+    if (paths == 0)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    if (summary)
+    {
+        printf("%lu files, %lu configurations, %lu with findings\n",
+               FileCount, ConfigCount, FlaggedCount);
+    }
+
+    free(DumpBuffer);
+
+    return FlaggedCount != 0 ? 1 : 0;
+}
@@ -0,0 +1,533 @@
+/*++
+
+Copyright (c) Microsoft Corporation
+
+Module Name:
+
+USBDESCMODEL.C
+
+Abstract:
+
+Builds the portable configuration descriptor model declared in
+USBDESCMODEL.H and evaluates the descriptor rules against it.
+
+The rules are tables: StdDescriptorRules[] for the standard descriptors
+and VSDescriptorRules[] for the class-specific Video Streaming interface
+descriptors.  Their results are stored in the records so the same checks
+are shared by usbview.exe and usbdescinv.
+
+Environment:
+
+user mode, any platform
+
+--*/
+
+/*****************************************************************************
+ I N C L U D E S
+*****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "usbdescmodel.h"
+
+/*****************************************************************************
+ D E F I N E S
+*****************************************************************************/
+
+#define ARRAY_COUNT(a)  (sizeof(a) / sizeof((a)[0]))
+
+// Video Streaming interface descriptor subtypes, UVC 1.1 and 1.5
+#define VS_UNDEFINED            0x00
+#define VS_INPUT_HEADER         0x01
+#define VS_OUTPUT_HEADER        0x02
+#define VS_STILL_IMAGE_FRAME    0x03
+#define VS_FORMAT_UNCOMPRESSED  0x04
+#define VS_FRAME_UNCOMPRESSED   0x05
+#define VS_FORMAT_MJPEG         0x06
+#define VS_FRAME_MJPEG          0x07
+#define VS_FORMAT_MPEG1         0x08
+#define VS_FORMAT_MPEG2PS       0x09
+#define VS_FORMAT_MPEG2TS       0x0A
+#define VS_FORMAT_MPEG4SL       0x0B
+#define VS_FORMAT_DV            0x0C
+#define VS_COLORFORMAT          0x0D
+#define VS_FORMAT_VENDOR        0x0E
+#define VS_FRAME_VENDOR         0x0F
+#define VS_FORMAT_FRAME_BASED   0x10
+#define VS_FRAME_FRAME_BASED    0x11
+#define VS_FORMAT_STREAM_BASED  0x12
+#define VS_FORMAT_H264          0x13
+#define VS_FRAME_H264           0x14
+
+// bNumFrameDescriptors is at the same offset in every format descriptor
+#define VS_FORMAT_NUM_FRAMES_OFFSET 4
+
+// bcdUVC and bcdADC follow the subtype in the class-specific headers
+#define CS_HEADER_BCD_OFFSET        3
+
+#define NO_FORMAT   0xFF
+
+/*****************************************************************************
+ T Y P E D E F S
+*****************************************************************************/
+
+//
+// Standard descriptors have one or two allowed lengths.
+//
+typedef struct _STD_DESCRIPTOR_RULE
+{
+    uint8_t bDescriptorType;
+    uint8_t Length;
+    uint8_t AltLength;
+} STD_DESCRIPTOR_RULE;
+
+typedef enum _VS_AVAILABILITY
+{
+    VsAllVersions = 0,
+    VsUVC10Only,            // obsoleted in UVC 1.1 and later
+    VsUVC11AndLater         // did not exist in UVC 1.0
+} VS_AVAILABILITY;
+
+//
+//   MinLength      - fixed part of the descriptor, sizeof() of the matching
+//                    structure in uvcdesc.h or h264.h
+//   Availability   - UVC versions in which the subtype is defined
+//   FormatCount    - format descriptors: bNumFrameDescriptors is added to
+//                    the Expected count of this format
+//   FrameCount     - frame descriptors: the Found count of this format is
+//                    incremented
+//
+typedef struct _VS_DESCRIPTOR_RULE
+{
+    uint8_t bDescriptorSubtype;
+    uint8_t MinLength;
+    uint8_t Availability;
+    uint8_t FormatCount;
+    uint8_t FrameCount;
+} VS_DESCRIPTOR_RULE;
+
+typedef struct _FINDING_TEXT
+{
+    int         IsError;
+    const char *Text;
+} FINDING_TEXT;
+
+/*****************************************************************************
+ G L O B A L S    P R I V A T E    T O    T H I S    F I L E
+*****************************************************************************/
+
+static const STD_DESCRIPTOR_RULE StdDescriptorRules[] =
+{
+    {USBDESC_CONFIGURATION_TYPE,    9,  9},
+    {USBDESC_INTERFACE_TYPE,        9,  11},
+    {USBDESC_ENDPOINT_TYPE,         7,  9},
+    {USBDESC_DEVICE_QUALIFIER_TYPE, 10, 10},
+    {USBDESC_OTHER_SPEED_TYPE,      9,  9},
+    {USBDESC_IAD_TYPE,              8,  8},
+};
+
+static const VS_DESCRIPTOR_RULE VSDescriptorRules[] =
+{
+    {VS_INPUT_HEADER,        13, VsAllVersions,   NO_FORMAT,                 NO_FORMAT},
+    {VS_OUTPUT_HEADER,       8,  VsAllVersions,   NO_FORMAT,                 NO_FORMAT},
+    {VS_STILL_IMAGE_FRAME,   5,  VsAllVersions,   NO_FORMAT,                 NO_FORMAT},
+    {VS_FORMAT_UNCOMPRESSED, 27, VsAllVersions,   UsbDescFormatUncompressed, NO_FORMAT},
+    {VS_FRAME_UNCOMPRESSED,  26, VsAllVersions,   NO_FORMAT,                 UsbDescFormatUncompressed},
+    {VS_FORMAT_MJPEG,        11, VsAllVersions,   UsbDescFormatMJPEG,        NO_FORMAT},
+    {VS_FRAME_MJPEG,         26, VsAllVersions,   NO_FORMAT,                 UsbDescFormatMJPEG},
+    {VS_FORMAT_MPEG1,        7,  VsUVC10Only,     NO_FORMAT,                 NO_FORMAT},
+    {VS_FORMAT_MPEG2PS,      7,  VsUVC10Only,     NO_FORMAT,                 NO_FORMAT},
+    {VS_FORMAT_MPEG2TS,      7,  VsAllVersions,   NO_FORMAT,                 NO_FORMAT},
+    {VS_FORMAT_MPEG4SL,      5,  VsUVC10Only,     NO_FORMAT,                 NO_FORMAT},
+    {VS_FORMAT_DV,           9,  VsAllVersions,   NO_FORMAT,                 NO_FORMAT},
+    {VS_COLORFORMAT,         6,  VsAllVersions,   NO_FORMAT,                 NO_FORMAT},
+    {VS_FORMAT_VENDOR,       56, VsUVC10Only,     NO_FORMAT,                 NO_FORMAT},
+    {VS_FRAME_VENDOR,        26, VsUVC10Only,     NO_FORMAT,                 NO_FORMAT},
+    {VS_FORMAT_FRAME_BASED,  28, VsUVC11AndLater, UsbDescFormatFrameBased,   NO_FORMAT},
+    {VS_FRAME_FRAME_BASED,   26, VsUVC11AndLater, NO_FORMAT,                 UsbDescFormatFrameBased},
+    {VS_FORMAT_STREAM_BASED, 24, VsUVC11AndLater, NO_FORMAT,                 NO_FORMAT},
+    {VS_FORMAT_H264,         52, VsAllVersions,   UsbDescFormatH264,         NO_FORMAT},
+    {VS_FRAME_H264,          44, VsAllVersions,   NO_FORMAT,                 UsbDescFormatH264},
+};
+
+static const FINDING_TEXT FindingText[UsbDescFindingMax] =
+{
+    {0, "no finding"},
+    {1, "bLength not allowed for this descriptor type"},
+    {0, "undefined Video Streaming bDescriptorSubtype"},
+    {1, "unknown Video Streaming bDescriptorSubtype"},
+    {1, "Video Streaming bDescriptorSubtype obsoleted after UVC 1.0"},
+    {1, "Video Streaming bDescriptorSubtype did not exist in UVC 1.0"},
+    {1, "bLength too short for bDescriptorSubtype"},
+    {1, "descriptor with bLength below 2, rest of configuration not parsed"},
+    {1, "descriptor extends past the end of the configuration"},
+    {1, "wTotalLength does not match the descriptors"},
+    {1, "frame descriptors do not match bNumFrameDescriptors"},
+};
+
+static const char *FormatNames[UsbDescFormatMax] =
+{
+    "uncompressed",
+    "MJPEG",
+    "frame-based",
+    "H.264",
+};
+
+/*****************************************************************************
+ L O C A L    F U N C T I O N S
+*****************************************************************************/
+
+static uint8_t
+KindOfRecord (
+    const USBDESC_RECORD *Record
+    )
+{
+    if (Record->bDescriptorType == USBDESC_CS_ENDPOINT_TYPE)
+    {
+        return UsbDescKindClassEndpoint;
+    }
+
+    if (Record->bDescriptorType != USBDESC_CS_INTERFACE_TYPE)
+    {
+        return UsbDescKindStandard;
+    }
+
+    if (Record->bInterfaceClass == USBDESC_CLASS_VIDEO)
+    {
+        switch (Record->bInterfaceSubClass)
+        {
+        case USBDESC_SUBCLASS_CONTROL:
+            return UsbDescKindVideoControl;
+        case USBDESC_SUBCLASS_STREAMING:
+            return UsbDescKindVideoStreaming;
+        }
+    }
+    else if (Record->bInterfaceClass == USBDESC_CLASS_AUDIO)
+    {
+        switch (Record->bInterfaceSubClass)
+        {
+        case USBDESC_SUBCLASS_CONTROL:
+            return UsbDescKindAudioControl;
+        case USBDESC_SUBCLASS_STREAMING:
+            return UsbDescKindAudioStreaming;
+        }
+    }
+
+    return UsbDescKindOther;
+}
+
+static void
+CheckStdDescriptor (
+    PUSBDESC_RECORD Record
+    )
+{
+    size_t index;
+
+    for (index = 0; index < ARRAY_COUNT(StdDescriptorRules); index++)
+    {
+        const STD_DESCRIPTOR_RULE *rule = &StdDescriptorRules[index];
+
+        if (rule->bDescriptorType == Record->bDescriptorType)
+        {
+            if (Record->bLength != rule->Length &&
+                Record->bLength != rule->AltLength)
+            {
+                Record->Finding = UsbDescFindingBadLength;
+            }
+            return;
+        }
+    }
+}
+
+static const VS_DESCRIPTOR_RULE *
+FindVSRule (
+    uint8_t bDescriptorSubtype
+    )
+{
+    size_t index;
+
+    for (index = 0; index < ARRAY_COUNT(VSDescriptorRules); index++)
+    {
+        if (VSDescriptorRules[index].bDescriptorSubtype == bDescriptorSubtype)
+        {
+            return &VSDescriptorRules[index];
+        }
+    }
+
+    return NULL;
+}
+
+static void
+CheckVSDescriptor (
+    PUSBDESC_MODEL  Model,
+    PUSBDESC_RECORD Record
+    )
+{
+    const VS_DESCRIPTOR_RULE *rule = FindVSRule(Record->bDescriptorSubtype);
+
+    if (rule == NULL)
+    {
+        Record->Finding = (uint8_t)((Record->bDescriptorSubtype == VS_UNDEFINED)
+                                    ? UsbDescFindingUndefinedSubtype
+                                    : UsbDescFindingUnknownSubtype);
+        return;
+    }
+
+    if (rule->Availability == VsUVC10Only && Model->bcdUVC != USBDESC_UVC10)
+    {
+        Record->Finding = UsbDescFindingObsoleteSubtype;
+        return;
+    }
+
+    if (rule->Availability == VsUVC11AndLater && Model->bcdUVC == USBDESC_UVC10)
+    {
+        Record->Finding = UsbDescFindingSubtypeNotInUvc10;
+        return;
+    }
+
+    if (Record->bLength < rule->MinLength)
+    {
+        Record->Finding = UsbDescFindingTooShort;
+        return;
+    }
+
+    if (rule->FormatCount != NO_FORMAT)
+    {
+        Model->FrameCounts[rule->FormatCount].Expected +=
+            Record->Data[VS_FORMAT_NUM_FRAMES_OFFSET];
+    }
+
+    if (rule->FrameCount != NO_FORMAT)
+    {
+        Model->FrameCounts[rule->FrameCount].Found++;
+    }
+}
+
+/*****************************************************************************
+ G L O B A L    F U N C T I O N S
+*****************************************************************************/
+
+//*****************************************************************************
+//
+// UsbDescParseConfig()
+//
+// The walk records every descriptor and the interface it belongs to, and
+// picks up the UVC and UAC versions.  The rules run over the records once
+// the walk is done, so a VS descriptor is checked against the UVC version
+// wherever the VC header appears.
+//
+//*****************************************************************************
+
+int
+UsbDescParseConfig (
+    const uint8_t  *Data,
+    size_t          Length,
+    PUSBDESC_MODEL  Model
+    )
+{
+    PUSBDESC_RECORD record;
+    size_t          offset = 0;
+    size_t          end;
+    size_t          index;
+    uint8_t         bInterfaceNumber = 0;
+    uint8_t         bAlternateSetting = 0;
+    uint8_t         bInterfaceClass = 0;
+    uint8_t         bInterfaceSubClass = 0;
+    uint8_t         bLength;
+
+    memset(Model, 0, sizeof(*Model));
+
+    if (Length < USBDESC_CONFIGURATION_LENGTH ||
+        Data[1] != USBDESC_CONFIGURATION_TYPE)
+    {
+        return 0;
+    }
+
+    Model->Data = Data;
+    Model->Length = Length;
+    Model->wTotalLength = UsbDescReadWord(&Data[2]);
+    Model->bNumInterfaces = Data[4];
+    Model->bConfigurationValue = Data[5];
+
+    // Descriptors past wTotalLength do not belong to this configuration
+    end = Length < Model->wTotalLength ? Length : Model->wTotalLength;
+
+    // Every descriptor is at least 2 bytes, so this bounds the record count
+    Model->Records = (PUSBDESC_RECORD)calloc(end / 2 + 1, sizeof(USBDESC_RECORD));
+    if (Model->Records == NULL)
+    {
+        return 0;
+    }
+
+    while (offset + 2 <= end)
+    {
+        bLength = Data[offset];
+
+        if (bLength < 2)
+        {
+            Model->WalkFinding = UsbDescFindingZeroLength;
+            break;
+        }
+
+        if (offset + bLength > end)
+        {
+            Model->WalkFinding = UsbDescFindingOverrun;
+            break;
+        }
+
+        record = &Model->Records[Model->RecordCount++];
+        record->Data = &Data[offset];
+        record->Offset = (uint32_t)offset;
+        record->bLength = bLength;
+        record->bDescriptorType = Data[offset + 1];
+
+        if (record->bDescriptorType == USBDESC_INTERFACE_TYPE && bLength >= 9)
+        {
+            bInterfaceNumber = Data[offset + 2];
+            bAlternateSetting = Data[offset + 3];
+            bInterfaceClass = Data[offset + 5];
+            bInterfaceSubClass = Data[offset + 6];
+        }
+
+        record->bInterfaceNumber = bInterfaceNumber;
+        record->bAlternateSetting = bAlternateSetting;
+        record->bInterfaceClass = bInterfaceClass;
+        record->bInterfaceSubClass = bInterfaceSubClass;
+        record->Kind = KindOfRecord(record);
+
+        if (record->Kind != UsbDescKindStandard && bLength >= 3)
+        {
+            record->bDescriptorSubtype = Data[offset + 2];
+        }
+
+        if (record->bDescriptorSubtype == USBDESC_HEADER_SUBTYPE &&
+            bLength >= CS_HEADER_BCD_OFFSET + 2)
+        {
+            if (record->Kind == UsbDescKindVideoControl && Model->bcdUVC == 0)
+            {
+                Model->bcdUVC = UsbDescReadWord(&Data[offset + CS_HEADER_BCD_OFFSET]);
+            }
+            else if (record->Kind == UsbDescKindAudioControl && Model->bcdADC == 0)
+            {
+                Model->bcdADC = UsbDescReadWord(&Data[offset + CS_HEADER_BCD_OFFSET]);
+            }
+        }
+
+        offset += bLength;
+    }
+
+    if (Model->WalkFinding != UsbDescFindingNone)
+    {
+        Model->FindingCount++;
+    }
+    else if (offset != Model->wTotalLength)
+    {
+        Model->TotalLengthFinding = UsbDescFindingTotalLength;
+        Model->FindingCount++;
+    }
+
+    for (index = 0; index < Model->RecordCount; index++)
+    {
+        record = &Model->Records[index];
+
+        if (record->Kind == UsbDescKindStandard)
+        {
+            CheckStdDescriptor(record);
+        }
+        else if (record->Kind == UsbDescKindVideoStreaming)
+        {
+            CheckVSDescriptor(Model, record);
+        }
+
+        if (record->Finding != UsbDescFindingNone)
+        {
+            Model->FindingCount++;
+        }
+    }
+
+    for (index = 0; index < UsbDescFormatMax; index++)
+    {
+        if (Model->FrameCounts[index].Expected != Model->FrameCounts[index].Found)
+        {
+            Model->FindingCount++;
+        }
+    }
+
+    return 1;
+}
+
+void
+UsbDescFreeModel (
+    PUSBDESC_MODEL  Model
+    )
+{
+    free(Model->Records);
+    memset(Model, 0, sizeof(*Model));
+}
+
+const USBDESC_RECORD *
+UsbDescFindRecord (
+    const USBDESC_MODEL *Model,
+    size_t               Offset
+    )
+{
+    size_t low = 0;
+    size_t high = Model->RecordCount;
+    size_t middle;
+
+    // Records are in offset order
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+
+        if (Model->Records[middle].Offset == Offset)
+        {
+            return &Model->Records[middle];
+        }
+
+        if (Model->Records[middle].Offset < Offset)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return NULL;
+}
+
+uint8_t
+UsbDescVSMinLength (
+    uint8_t bDescriptorSubtype
+    )
+{
+    const VS_DESCRIPTOR_RULE *rule = FindVSRule(bDescriptorSubtype);
+
+    return rule != NULL ? rule->MinLength : 0;
+}
+
+const char *
+UsbDescFindingText (
+    USBDESC_FINDING Finding
+    )
+{
+    return (unsigned)Finding < UsbDescFindingMax ? FindingText[Finding].Text : "";
+}
+
+int
+UsbDescFindingIsError (
+    USBDESC_FINDING Finding
+    )
+{
+    return (unsigned)Finding < UsbDescFindingMax ? FindingText[Finding].IsError : 0;
+}
+
+const char *
+UsbDescFormatName (
+    USBDESC_FORMAT Format
+    )
+{
+    return (unsigned)Format < UsbDescFormatMax ? FormatNames[Format] : "";
+}
@@ -0,0 +1,223 @@
+/*++
+
+Copyright (c) Microsoft Corporation
+
+Module Name:
+
+USBDESCMODEL.H
+
+Abstract:
+
+Portable USB configuration descriptor model.
+
+UsbDescParseConfig() walks a configuration descriptor once and builds an
+array of records, one per descriptor, each tagged with the interface that
+owns it.  The validation rules are then evaluated against the records and
+their results are kept in the model, so callers only render them.
+
+This file and USBDESCMODEL.C use nothing but the C runtime.  They are
+shared by usbview.exe and by the usbdescinv command line tool, which
+inventories descriptor dumps on Linux.
+
+Environment:
+
+user mode, any platform
+
+--*/
+
+#ifndef _USBDESCMODEL_H_
+#define _USBDESCMODEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Descriptor types and class codes the model needs.  The names are
+// prefixed so the header can be included next to the Windows USB headers.
+//
+#define USBDESC_DEVICE_TYPE             0x01
+#define USBDESC_CONFIGURATION_TYPE      0x02
+#define USBDESC_INTERFACE_TYPE          0x04
+#define USBDESC_ENDPOINT_TYPE           0x05
+#define USBDESC_DEVICE_QUALIFIER_TYPE   0x06
+#define USBDESC_OTHER_SPEED_TYPE        0x07
+#define USBDESC_IAD_TYPE                0x0B
+#define USBDESC_CS_INTERFACE_TYPE       0x24
+#define USBDESC_CS_ENDPOINT_TYPE        0x25
+
+#define USBDESC_CLASS_AUDIO             0x01
+#define USBDESC_CLASS_VIDEO             0x0E
+
+#define USBDESC_SUBCLASS_CONTROL        0x01
+#define USBDESC_SUBCLASS_STREAMING      0x02
+
+#define USBDESC_HEADER_SUBTYPE          0x01
+
+#define USBDESC_UVC10                   0x0100
+
+#define USBDESC_DEVICE_LENGTH           18
+#define USBDESC_CONFIGURATION_LENGTH    9
+
+//
+// Which class-specific descriptor set a record belongs to, from the
+// descriptor type and the interface that owns it.
+//
+typedef enum _USBDESC_KIND
+{
+    UsbDescKindStandard = 0,
+    UsbDescKindVideoControl,
+    UsbDescKindVideoStreaming,
+    UsbDescKindAudioControl,
+    UsbDescKindAudioStreaming,
+    UsbDescKindClassEndpoint,
+    UsbDescKindOther
+} USBDESC_KIND;
+
+//
+// Result of the rules, per record and for the whole configuration.
+// UsbDescFindingText() returns the message for each one.
+//
+typedef enum _USBDESC_FINDING
+{
+    UsbDescFindingNone = 0,
+    UsbDescFindingBadLength,            // standard descriptor of the wrong length
+    UsbDescFindingUndefinedSubtype,     // VS subtype 0
+    UsbDescFindingUnknownSubtype,       // VS subtype not in the rule table
+    UsbDescFindingObsoleteSubtype,      // VS subtype removed after UVC 1.0
+    UsbDescFindingSubtypeNotInUvc10,    // VS subtype added after UVC 1.0
+    UsbDescFindingTooShort,             // shorter than the fixed part of the subtype
+    UsbDescFindingZeroLength,           // bLength below 2, walk stopped
+    UsbDescFindingOverrun,              // bLength past the end, walk stopped
+    UsbDescFindingTotalLength,          // wTotalLength differs from the bytes walked
+    UsbDescFindingFrameCount,           // frame descriptors differ from bNumFrameDescriptors
+    UsbDescFindingMax
+} USBDESC_FINDING;
+
+//
+// Formats whose frame descriptors are counted against the
+// bNumFrameDescriptors of their format descriptors.
+//
+typedef enum _USBDESC_FORMAT
+{
+    UsbDescFormatUncompressed = 0,
+    UsbDescFormatMJPEG,
+    UsbDescFormatFrameBased,
+    UsbDescFormatH264,
+    UsbDescFormatMax
+} USBDESC_FORMAT;
+
+typedef struct _USBDESC_FRAME_COUNT
+{
+    uint32_t    Expected;       // sum of bNumFrameDescriptors
+    uint32_t    Found;          // frame descriptors that passed the rules
+} USBDESC_FRAME_COUNT, *PUSBDESC_FRAME_COUNT;
+
+typedef struct _USBDESC_RECORD
+{
+    const uint8_t  *Data;
+    uint32_t        Offset;
+    uint8_t         bLength;
+    uint8_t         bDescriptorType;
+    uint8_t         bDescriptorSubtype;     // 0 unless class-specific
+    uint8_t         Kind;                   // USBDESC_KIND
+    uint8_t         bInterfaceNumber;       // owning interface
+    uint8_t         bAlternateSetting;
+    uint8_t         bInterfaceClass;
+    uint8_t         bInterfaceSubClass;
+    uint8_t         Finding;                // USBDESC_FINDING
+} USBDESC_RECORD, *PUSBDESC_RECORD;
+
+typedef struct _USBDESC_MODEL
+{
+    const uint8_t      *Data;
+    size_t              Length;             // bytes supplied by the caller
+    uint16_t            wTotalLength;
+    uint8_t             bNumInterfaces;
+    uint8_t             bConfigurationValue;
+    uint16_t            bcdUVC;             // from the VC header, 0 if none
+    uint16_t            bcdADC;             // from the AC header, 0 if none
+
+    PUSBDESC_RECORD     Records;
+    size_t              RecordCount;
+
+    USBDESC_FRAME_COUNT FrameCounts[UsbDescFormatMax];
+
+    uint8_t             WalkFinding;        // ZeroLength, Overrun or None
+    uint8_t             TotalLengthFinding; // TotalLength or None
+    size_t              FindingCount;       // every finding in the model
+} USBDESC_MODEL, *PUSBDESC_MODEL;
+
+static __inline uint16_t
+UsbDescReadWord (
+    const uint8_t *Data
+    )
+{
+    return (uint16_t)(Data[0] | (Data[1] << 8));
+}
+
+//
+// Builds the model of the configuration descriptor at Data and evaluates
+// the rules.  Length is the number of bytes available, which may differ
+// from wTotalLength.  Returns 0 if Data is not a configuration descriptor
+// or the record array cannot be allocated.  On success the model must be
+// released with UsbDescFreeModel().  Data must stay valid while the model
+// is in use.
+//
+int
+UsbDescParseConfig (
+    const uint8_t  *Data,
+    size_t          Length,
+    PUSBDESC_MODEL  Model
+    );
+
+void
+UsbDescFreeModel (
+    PUSBDESC_MODEL  Model
+    );
+
+//
+// Returns the record of the descriptor at Offset from the start of the
+// configuration descriptor, or NULL if no descriptor starts there.
+//
+const USBDESC_RECORD *
+UsbDescFindRecord (
+    const USBDESC_MODEL *Model,
+    size_t               Offset
+    );
+
+//
+// Returns the fixed length of a Video Streaming descriptor subtype, the
+// minimum its bLength must cover, or 0 for a subtype without a rule.
+//
+uint8_t
+UsbDescVSMinLength (
+    uint8_t bDescriptorSubtype
+    );
+
+const char *
+UsbDescFindingText (
+    USBDESC_FINDING Finding
+    );
+
+//
+// Nonzero for findings reported as errors, zero for cautions.
+//
+int
+UsbDescFindingIsError (
+    USBDESC_FINDING Finding
+    );
+
+const char *
+UsbDescFormatName (
+    USBDESC_FORMAT Format
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _USBDESCMODEL_H_
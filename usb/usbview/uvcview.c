@@ -44,6 +44,13 @@ D E F I N E S
 #define SIZEBAR             0
 #define WINDOWSCALEFACTOR   15
 
+// Device change notifications arrive in bursts (one per interface, hub
+// and port).  Refresh the hubs they affected once after they have settled
+// for this many ms.
+//
+#define IDT_DEVICECHANGE        1
+#define DEVICECHANGE_DELAY_MS   300
+
 /*****************************************************************************
  L O C A L  T Y P E D E F S
 *****************************************************************************/
@@ -160,15 +167,23 @@ USBView_OnNotify (
 
 BOOL
 USBView_OnDeviceChange (
-                        HWND  hwnd,
-                        UINT  uEvent,
-                        DWORD dwEventData
+                        HWND               hwnd,
+                        UINT               uEvent,
+                        PDEV_BROADCAST_HDR pHdr
                         );
 
+VOID
+USBView_OnTimer (
+                 HWND hwnd,
+                 UINT id
+                 );
+
 VOID DestroyTree (VOID);
 
 VOID RefreshTree (VOID);
 
+VOID UpdateStatusText (ULONG devicesConnected);
+
 LRESULT CALLBACK
 AboutDlgProc (
               HWND   hwnd,
@@ -251,6 +266,7 @@ BOOL            gbConsoleFile  = FALSE;
 BOOL            gbConsoleInitialized = FALSE;
 BOOL            gbButtonDown     = FALSE;
 BOOL            gDoAutoRefresh   = TRUE;
+BOOL            gFullRefreshPending = FALSE;
 
 int             gBarLocation     = 0;
 int             giGoodDevice     = 0;
@@ -335,6 +351,8 @@ WinMain (
 
     ReleaseXmlWriter();
 
+    FlushDescriptorCache();
+
     CHECKFORLEAKS();
 
     return retStatus;
@@ -949,7 +967,15 @@ MainDlgProc (
         HANDLE_MSG(hWnd, WM_MOUSEMOVE,      USBView_OnMouseMove);
         HANDLE_MSG(hWnd, WM_SIZE,           USBView_OnSize);
         HANDLE_MSG(hWnd, WM_NOTIFY,         USBView_OnNotify);
-        HANDLE_MSG(hWnd, WM_DEVICECHANGE,   USBView_OnDeviceChange);
+        HANDLE_MSG(hWnd, WM_TIMER,          USBView_OnTimer);
+
+    case WM_DEVICECHANGE:
+        // HANDLE_WM_DEVICECHANGE truncates the DEV_BROADCAST_HDR pointer
+        // to a DWORD
+        //
+        return USBView_OnDeviceChange(hWnd,
+                                      (UINT)wParam,
+                                      (PDEV_BROADCAST_HDR)lParam);
     }
 
     return 0;
@@ -1089,7 +1115,7 @@ USBView_OnClose (
                  )
 {
 
-    UNREFERENCED_PARAMETER(hWnd);
+    KillTimer(hWnd, IDT_DEVICECHANGE);
 
     DestroyTree();
 
@@ -1416,11 +1442,15 @@ USBView_OnCommand (
     case ID_EXIT:
         UnregisterDeviceNotification(gNotifyDevHandle);
         UnregisterDeviceNotification(gNotifyHubHandle);
+        KillTimer(hWnd, IDT_DEVICECHANGE);
         DestroyTree();
         PostQuitMessage(0);
         break;
 
     case ID_REFRESH:
+        // An explicit refresh requeries every device
+        //
+        FlushDescriptorCache();
         RefreshTree();
         break;
     }
@@ -1565,21 +1595,32 @@ USBView_OnDeviceChange()
 
 BOOL
 USBView_OnDeviceChange (
-                        HWND  hwnd,
-                        UINT  uEvent,
-                        DWORD dwEventData
+                        HWND               hwnd,
+                        UINT               uEvent,
+                        PDEV_BROADCAST_HDR pHdr
                         )
 {
-    UNREFERENCED_PARAMETER(hwnd);
-    UNREFERENCED_PARAMETER(dwEventData);
-
     if (gDoAutoRefresh)
     {
         switch (uEvent)
         {
         case DBT_DEVICEARRIVAL:
         case DBT_DEVICEREMOVECOMPLETE:
-            RefreshTree();
+            // Mark the hub the device is attached to.  If it is not known,
+            // the whole tree is refreshed.
+            //
+            if (pHdr == NULL ||
+                pHdr->dbch_devicetype != DBT_DEVTYP_DEVICEINTERFACE ||
+                !NoteDeviceChange(((PDEV_BROADCAST_DEVICEINTERFACE)pHdr)->dbcc_name,
+                                  uEvent == DBT_DEVICEARRIVAL))
+            {
+                gFullRefreshPending = TRUE;
+            }
+
+            // (Re)arm the timer so that a burst of notifications results
+            // in a single refresh.
+            //
+            SetTimer(hwnd, IDT_DEVICECHANGE, DEVICECHANGE_DELAY_MS, NULL);
             break;
         }
     }
@@ -1587,6 +1628,35 @@ USBView_OnDeviceChange (
     return TRUE;
 }
 
+/*****************************************************************************
+
+USBView_OnTimer()
+
+*****************************************************************************/
+
+VOID
+USBView_OnTimer (
+                 HWND hwnd,
+                 UINT id
+                 )
+{
+    ULONG devicesConnected = 0;
+
+    if (id == IDT_DEVICECHANGE)
+    {
+        KillTimer(hwnd, IDT_DEVICECHANGE);
+
+        if (gFullRefreshPending || !RefreshChangedHubs(&devicesConnected))
+        {
+            RefreshTree();
+        }
+        else
+        {
+            UpdateStatusText(devicesConnected);
+        }
+    }
+}
+
 
 
 /*****************************************************************************
@@ -1607,13 +1677,15 @@ VOID DestroyTree (VOID)
     //
     if (ghTreeRoot)
     {
-        WalkTree(ghTreeRoot, CleanupItem, NULL);
-
         TreeView_DeleteAllItems(ghTreeWnd);
 
         ghTreeRoot = NULL;
     }
 
+    // The device tree model owns the info the items referred to
+    //
+    FreeTreeModel();
+
     ClearDeviceList(&gDeviceList);
     ClearDeviceList(&gHubList);
 }
@@ -1626,9 +1698,10 @@ RefreshTree()
 
 VOID RefreshTree (VOID)
 {
-    CHAR  statusText[128];
     ULONG devicesConnected;
 
+    gFullRefreshPending = FALSE;
+
     // Clear the edit control
     //
     SetWindowText(ghEditWnd, "");
@@ -1647,31 +1720,106 @@ VOID RefreshTree (VOID)
         //
         EnumerateHostControllers(ghTreeRoot, &devicesConnected);
 
+        // Forget the descriptors of devices that are gone
+        //
+        PruneDescriptorCache();
+
         //
         // Expand all tree nodes
         //
         WalkTree(ghTreeRoot, ExpandItem, NULL);
 
-        // Update Status Line with number of devices connected
-        //
-        memset(statusText, 0, sizeof(statusText));
-        StringCchPrintf(statusText, sizeof(statusText),
+        UpdateStatusText(devicesConnected);
+    }
+    else
+    {
+        OOPS();
+    }
+
+}
+
+/*****************************************************************************
+
+UpdateStatusText()
+
+Updates the Status Line with the number of devices connected.
+
+*****************************************************************************/
+
+VOID UpdateStatusText (ULONG devicesConnected)
+{
+    CHAR  statusText[128];
+
+    memset(statusText, 0, sizeof(statusText));
+    StringCchPrintf(statusText, sizeof(statusText),
 #ifdef H264_SUPPORT
-        "UVC Spec Version: %d.%d Version: %d.%d Devices Connected: %d   Hubs Connected: %d",
-        UVC_SPEC_MAJOR_VERSION, UVC_SPEC_MINOR_VERSION, USBVIEW_MAJOR_VERSION, USBVIEW_MINOR_VERSION,
-        devicesConnected, TotalHubs);
+    "UVC Spec Version: %d.%d Version: %d.%d Devices Connected: %d   Hubs Connected: %d",
+    UVC_SPEC_MAJOR_VERSION, UVC_SPEC_MINOR_VERSION, USBVIEW_MAJOR_VERSION, USBVIEW_MINOR_VERSION,
+    devicesConnected, TotalHubs);
 #else
-        "Devices Connected: %d   Hubs Connected: %d",
-        devicesConnected, TotalHubs);
+    "Devices Connected: %d   Hubs Connected: %d",
+    devicesConnected, TotalHubs);
 #endif
 
-        SetWindowText(ghStatusWnd, statusText);
+    SetWindowText(ghStatusWnd, statusText);
+}
+
+/*****************************************************************************
+
+DeleteChildLeaves()
+
+Deletes the items below hTreeParent.  The info they refer to is freed by the
+caller.
+
+*****************************************************************************/
+
+VOID
+DeleteChildLeaves (
+    HTREEITEM hTreeParent
+    )
+{
+    HTREEITEM hSelected;
+    HTREEITEM hItem;
+
+    // Move the selection out of the deleted items first, so that the control
+    // won't "shift" the selection through them.
+    //
+    hSelected = TreeView_GetSelection(ghTreeWnd);
+
+    for (hItem = hSelected; hItem != NULL; hItem = TreeView_GetParent(ghTreeWnd, hItem))
+    {
+        if (hItem == hTreeParent)
+        {
+            if (hSelected != hTreeParent)
+            {
+                TreeView_SelectItem(ghTreeWnd, hTreeParent);
+            }
+            break;
+        }
     }
-    else
+
+    while ((hItem = TreeView_GetChild(ghTreeWnd, hTreeParent)) != NULL)
     {
-        OOPS();
+        TreeView_DeleteItem(ghTreeWnd, hItem);
     }
+}
 
+/*****************************************************************************
+
+ExpandLeaves()
+
+Expands hTreeParent and all items below it.
+
+*****************************************************************************/
+
+VOID
+ExpandLeaves (
+    HTREEITEM hTreeParent
+    )
+{
+    TreeView_Expand(ghTreeWnd, hTreeParent, TVE_EXPAND);
+
+    WalkTree(TreeView_GetChild(ghTreeWnd, hTreeParent), ExpandItem, NULL);
 }
 
 /*****************************************************************************
@@ -2008,10 +2156,6 @@ AddItemInformationToXmlView(
 
     UNREFERENCED_PARAMETER(pContext);
 
-#ifdef H264_SUPPORT
-    ResetErrorCounts();
-#endif
-
     tviName = (PCHAR) ALLOC(256);
 
     if (NULL == tviName)
@@ -58,6 +58,9 @@ Revision History:
 // This is the inbox USBVideo driver descriptor header (copied locally)
 #include "uvcdesc.h"
 
+// Portable descriptor model and rules, shared with the usbdescinv tool
+#include "usbdescmodel.h"
+
 /*****************************************************************************
  P R A G M A S
 *****************************************************************************/
@@ -429,6 +432,11 @@ PUSB_CONFIGURATION_DESCRIPTOR   g_pConfigDesc;
 PSTRING_DESCRIPTOR_NODE         g_pStringDescs;
 PUCHAR                          g_descEnd;
 
+// Model of the Configuration descriptor being displayed, built by
+// DisplayConfigDesc()
+//
+PUSBDESC_MODEL                  g_pConfigModel;
+
 /*****************************************************************************
  F U N C T I O N    P R O T O T Y P E S
 *****************************************************************************/
@@ -562,6 +570,16 @@ WalkTreeTopDown(
 
 VOID RefreshTree (VOID);
 
+VOID
+DeleteChildLeaves (
+    HTREEITEM hTreeParent
+    );
+
+VOID
+ExpandLeaves (
+    HTREEITEM hTreeParent
+    );
+
 //
 // ENUM.C
 //
@@ -572,12 +590,30 @@ EnumerateHostControllers (
     ULONG     *DevicesConnected
     );
 
+VOID
+PruneDescriptorCache (
+    VOID
+    );
 
 VOID
-CleanupItem (
-    HWND      hTreeWnd,
-    HTREEITEM hTreeItem,
-    PVOID pContext
+FlushDescriptorCache (
+    VOID
+    );
+
+BOOL
+NoteDeviceChange (
+    _In_ PCHAR SymbolicLink,
+    BOOL       Arrival
+    );
+
+BOOL
+RefreshChangedHubs (
+    ULONG     *DevicesConnected
+    );
+
+VOID
+FreeTreeModel (
+    VOID
     );
 
 DEVICE_POWER_STATE